@@ -8,31 +8,344 @@
 // - UDP flow from n0 to n1 of packets drawn from a trace file
 //  -- option to use IPv4 or IPv6 addressing
 //  -- option to disable logging statements
+//  -- option to stream a (multi-gigabyte) trace file through a shared memory map,
+//     replayed by several clients with independent offsets
 
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("UdpTraceClientServerExample");
 
+/**
+ * Read-only, memory-mapped frame trace shared by any number of readers.
+ *
+ * The file is mapped once and paged in on demand, so the trace size is bounded only
+ * by the address space. Every reader keeps its own byte offset; once all readers have
+ * moved past a chunk, the chunk's pages are handed back to the kernel, so resident
+ * memory stays constant however long the trace is.
+ */
+class MappedTraceFile : public SimpleRefCount<MappedTraceFile>
+{
+  public:
+    /// One frame of an MPEG4-style trace line: "<index> <type> <time ms> <size>"
+    struct Frame
+    {
+        char frameType;
+        uint32_t timeMs;
+        uint32_t size;
+    };
+
+    MappedTraceFile(const std::string& filename, uint64_t chunkSize);
+    ~MappedTraceFile();
+
+    /// Register a new reader starting at the beginning of the trace; returns its id.
+    uint32_t AddReader();
+
+    /**
+     * Parse the next frame for a reader, wrapping to the start at end of file.
+     * \return false if the trace contains no frame at all
+     */
+    bool Next(uint32_t reader, Frame& frame);
+
+  private:
+    void ReleaseConsumedChunks();
+
+    const char* m_data;
+    uint64_t m_length;
+    uint64_t m_chunkSize;
+    uint64_t m_released;              ///< bytes [0, m_released) already given back
+    std::vector<uint64_t> m_offsets; ///< per-reader byte offset
+};
+
+MappedTraceFile::MappedTraceFile(const std::string& filename, uint64_t chunkSize)
+    : m_data(nullptr),
+      m_length(0),
+      m_chunkSize(chunkSize),
+      m_released(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    NS_ABORT_MSG_IF(fd < 0, "Cannot open trace file " << filename);
+    struct stat st;
+    NS_ABORT_MSG_IF(fstat(fd, &st) != 0, "Cannot stat trace file " << filename);
+    m_length = static_cast<uint64_t>(st.st_size);
+    if (m_length > 0)
+    {
+        void* map = mmap(nullptr, m_length, PROT_READ, MAP_PRIVATE, fd, 0);
+        NS_ABORT_MSG_IF(map == MAP_FAILED, "Cannot map trace file " << filename);
+        madvise(map, m_length, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(map);
+    }
+    close(fd);
+}
+
+MappedTraceFile::~MappedTraceFile()
+{
+    if (m_data)
+    {
+        munmap(const_cast<char*>(m_data), m_length);
+    }
+}
+
+uint32_t
+MappedTraceFile::AddReader()
+{
+    // A new reader starts at offset 0, so everything must be mappable again
+    m_released = 0;
+    m_offsets.push_back(0);
+    return m_offsets.size() - 1;
+}
+
+bool
+MappedTraceFile::Next(uint32_t reader, Frame& frame)
+{
+    uint64_t& offset = m_offsets[reader];
+    uint64_t startChunk = offset / m_chunkSize;
+    // Give up after one full pass without a parsable line
+    for (uint64_t scanned = 0; scanned < m_length;)
+    {
+        if (offset >= m_length)
+        {
+            offset = 0;
+            m_released = 0;
+        }
+        const char* line = m_data + offset;
+        const char* end = static_cast<const char*>(memchr(line, '\n', m_length - offset));
+        uint64_t lineLength = end ? (end - line) + 1 : m_length - offset;
+        offset += lineLength;
+        scanned += lineLength;
+
+        // Only the current line is copied out of the mapping, into a stack buffer
+        char buf[96];
+        uint64_t n = std::min<uint64_t>(lineLength, sizeof(buf) - 1);
+        memcpy(buf, line, n);
+        buf[n] = '\0';
+        unsigned long index;
+        unsigned long timeMs;
+        unsigned long size;
+        char type;
+        if (sscanf(buf, "%lu %c %lu %lu", &index, &type, &timeMs, &size) == 4)
+        {
+            frame.frameType = type;
+            frame.timeMs = static_cast<uint32_t>(timeMs);
+            frame.size = static_cast<uint32_t>(size);
+            if (offset / m_chunkSize != startChunk)
+            {
+                ReleaseConsumedChunks();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+MappedTraceFile::ReleaseConsumedChunks()
+{
+    uint64_t low = *std::min_element(m_offsets.begin(), m_offsets.end());
+    uint64_t chunkStart = (low / m_chunkSize) * m_chunkSize;
+    if (chunkStart > m_released)
+    {
+        madvise(const_cast<char*>(m_data) + m_released, chunkStart - m_released, MADV_DONTNEED);
+        m_released = chunkStart;
+    }
+}
+
+/**
+ * UDP client replaying frames from a shared MappedTraceFile, like UdpTraceClient but
+ * without loading the trace into memory. Frames larger than MaxPacketSize are split;
+ * every packet carries a SeqTsHeader so UdpServer can account for it. Frames are paced
+ * as UdpTraceClient paces them: a B frame goes out with the frame before it, and any
+ * other frame after the time since the last non-B frame.
+ */
+class MappedTraceClient : public Application
+{
+  public:
+    static TypeId GetTypeId();
+
+    MappedTraceClient();
+
+    void SetRemote(Address address, uint16_t port);
+    void SetTrace(Ptr<MappedTraceFile> trace);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    void StartApplication() override;
+    void StopApplication() override;
+    void SendFrame();
+
+    /**
+     * Read the next frame into m_frame.
+     * \param gapMs set to the time to wait before sending it
+     * \return false if the trace contains no frame at all
+     */
+    bool NextFrame(uint32_t& gapMs);
+
+    Ptr<MappedTraceFile> m_trace;
+    uint32_t m_reader;
+    MappedTraceFile::Frame m_frame;
+    uint32_t m_prevTimeMs; ///< timestamp of the last non-B frame read
+    Address m_peerAddress;
+    uint16_t m_peerPort;
+    uint32_t m_maxPacketSize;
+    uint32_t m_sent;
+    Ptr<Socket> m_socket;
+    EventId m_sendEvent;
+};
+
+TypeId
+MappedTraceClient::GetTypeId()
+{
+    static TypeId tid = TypeId("MappedTraceClient")
+                            .SetParent<Application>()
+                            .AddConstructor<MappedTraceClient>()
+                            .AddAttribute("MaxPacketSize",
+                                          "The maximum size of a packet (including the SeqTsHeader).",
+                                          UintegerValue(1024),
+                                          MakeUintegerAccessor(&MappedTraceClient::m_maxPacketSize),
+                                          MakeUintegerChecker<uint32_t>(13));
+    return tid;
+}
+
+MappedTraceClient::MappedTraceClient()
+    : m_reader(0),
+      m_prevTimeMs(0),
+      m_peerPort(0),
+      m_sent(0)
+{
+}
+
+void
+MappedTraceClient::SetRemote(Address address, uint16_t port)
+{
+    m_peerAddress = address;
+    m_peerPort = port;
+}
+
+void
+MappedTraceClient::SetTrace(Ptr<MappedTraceFile> trace)
+{
+    m_trace = trace;
+    m_reader = trace->AddReader();
+}
+
+void
+MappedTraceClient::DoDispose()
+{
+    m_socket = nullptr;
+    m_trace = nullptr;
+    Application::DoDispose();
+}
+
+void
+MappedTraceClient::StartApplication()
+{
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        if (Ipv4Address::IsMatchingType(m_peerAddress))
+        {
+            m_socket->Bind();
+            m_socket->Connect(InetSocketAddress(Ipv4Address::ConvertFrom(m_peerAddress), m_peerPort));
+        }
+        else
+        {
+            m_socket->Bind6();
+            m_socket->Connect(Inet6SocketAddress(Ipv6Address::ConvertFrom(m_peerAddress), m_peerPort));
+        }
+    }
+    m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+    uint32_t gapMs;
+    if (NextFrame(gapMs))
+    {
+        m_sendEvent = Simulator::ScheduleNow(&MappedTraceClient::SendFrame, this);
+    }
+}
+
+void
+MappedTraceClient::StopApplication()
+{
+    Simulator::Cancel(m_sendEvent);
+}
+
+void
+MappedTraceClient::SendFrame()
+{
+    SeqTsHeader seqTs;
+    uint32_t payload = m_maxPacketSize - seqTs.GetSerializedSize();
+    for (uint32_t remaining = m_frame.size; remaining > 0;)
+    {
+        uint32_t size = std::min(remaining, payload);
+        Ptr<Packet> p = Create<Packet>(size);
+        seqTs.SetSeq(m_sent++);
+        p->AddHeader(seqTs);
+        m_socket->Send(p);
+        remaining -= size;
+    }
+
+    uint32_t gapMs;
+    if (NextFrame(gapMs))
+    {
+        m_sendEvent = Simulator::Schedule(MilliSeconds(gapMs), &MappedTraceClient::SendFrame, this);
+    }
+}
+
+bool
+MappedTraceClient::NextFrame(uint32_t& gapMs)
+{
+    if (!m_trace->Next(m_reader, m_frame))
+    {
+        return false;
+    }
+    // As in UdpTraceClient::LoadTrace: B frames do not advance the reference time
+    if (m_frame.frameType == 'B')
+    {
+        gapMs = 0;
+        return true;
+    }
+    // After a wrap the timestamps restart, and the first frame is timed from zero again
+    gapMs = m_frame.timeMs >= m_prevTimeMs ? m_frame.timeMs - m_prevTimeMs : m_frame.timeMs;
+    m_prevTimeMs = m_frame.timeMs;
+    return true;
+}
+
 int
 main(int argc, char* argv[])
 {
     // Declare variables used in command-line arguments
     bool useV6 = false;
     bool logging = true;
+    std::string traceFile;
+    uint32_t numClients = 1;
+    uint32_t chunkMb = 64;
     Address serverAddress;
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("useIpv6", "Use Ipv6", useV6);
     cmd.AddValue("logging", "Enable logging", logging);
+    cmd.AddValue("traceFile", "Frame trace to stream through a memory map (empty: built-in trace)", traceFile);
+    cmd.AddValue("numClients", "Number of clients replaying the mapped trace", numClients);
+    cmd.AddValue("chunkMb", "Chunk size in MiB after which consumed trace pages are released", chunkMb);
     cmd.Parse(argc, argv);
 
+    NS_ABORT_MSG_IF(chunkMb == 0, "chunkMb must be at least 1");
+
     if (logging)
     {
         LogComponentEnable("UdpClient", LOG_LEVEL_INFO);
@@ -78,9 +391,28 @@ main(int argc, char* argv[])
 
     NS_LOG_INFO("Create UdpClient application on node 0 to send to node 1.");
     uint32_t MaxPacketSize = 1472; // Back off 20 (IP) + 8 (UDP) bytes from MTU
-    UdpTraceClientHelper client(serverAddress, port, "");
-    client.SetAttribute("MaxPacketSize", UintegerValue(MaxPacketSize));
-    apps = client.Install(n.Get(0));
+    if (traceFile.empty())
+    {
+        UdpTraceClientHelper client(serverAddress, port, "");
+        client.SetAttribute("MaxPacketSize", UintegerValue(MaxPacketSize));
+        apps = client.Install(n.Get(0));
+    }
+    else
+    {
+        // All clients share one mapping; each keeps its own offset into it
+        Ptr<MappedTraceFile> trace =
+            Create<MappedTraceFile>(traceFile, static_cast<uint64_t>(chunkMb) << 20);
+        apps = ApplicationContainer();
+        for (uint32_t i = 0; i < numClients; ++i)
+        {
+            Ptr<MappedTraceClient> client = CreateObject<MappedTraceClient>();
+            client->SetAttribute("MaxPacketSize", UintegerValue(MaxPacketSize));
+            client->SetRemote(serverAddress, port);
+            client->SetTrace(trace);
+            n.Get(0)->AddApplication(client);
+            apps.Add(client);
+        }
+    }
     apps.Start(Seconds(2.0));
     apps.Stop(Seconds(10.0));
 
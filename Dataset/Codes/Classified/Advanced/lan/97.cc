@@ -13,10 +13,355 @@
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("ObjectNamesExample");
 
+/**
+ * Index of the devices and applications of all nodes, for resolving Config paths
+ * without walking every node and device for every path.
+ *
+ * Build() walks the NodeList once and files each device and application under its
+ * TypeId and all parent TypeIds. "/NodeList/<n or *>/DeviceList/<i or *>/$ns3::Type"
+ * is then one lookup in the list of objects of that type, a single node or list index
+ * is an array access, and named objects, "$" types and pointer attributes after that
+ * are followed one segment at a time from the matches. Resolved paths are cached, so
+ * setting several attributes below the same object path resolves it once. The cost
+ * of a path follows the number of objects it matches, not the number of nodes times
+ * path segments. Paths the index cannot resolve (other namespaces, "|" and "[a-b]"
+ * selectors, object vector attributes, types only reachable through aggregation) go
+ * to Config::LookupMatches and are cached the same way.
+ *
+ * The index is a snapshot: call Build() again after creating nodes, devices,
+ * applications or names.
+ */
+class ConfigIndex
+{
+  public:
+    /// Index the devices and applications of all nodes and drop the cached paths.
+    void Build();
+
+    /**
+     * \param path a Config path to objects, e.g. "/NodeList/1/DeviceList/0/Phy"
+     * \return the matching objects and their paths, as Config::LookupMatches returns them
+     */
+    Config::MatchContainer LookupMatches(const std::string& path);
+
+    /**
+     * Set an attribute of every object matching a path, like Config::Set.
+     * \param path the path to the objects, followed by the attribute name
+     * \param value the attribute value
+     */
+    void Set(const std::string& path, const AttributeValue& value);
+
+    /**
+     * Connect a trace sink to every object matching a path, like Config::Connect.
+     * \param path the path to the objects, followed by the trace source name
+     * \param cb the sink, receiving the resolved path as its context
+     */
+    void Connect(const std::string& path, const CallbackBase& cb);
+
+    /**
+     * Connect a trace sink to every object matching a path, like
+     * Config::ConnectWithoutContext.
+     * \param path the path to the objects, followed by the trace source name
+     * \param cb the sink
+     */
+    void ConnectWithoutContext(const std::string& path, const CallbackBase& cb);
+
+  private:
+    /// A device or application and its place in the NodeList
+    struct Entry
+    {
+        uint32_t node;      //!< Node id.
+        uint32_t index;     //!< Position in the node's DeviceList or ApplicationList.
+        Ptr<Object> object; //!< The device or application.
+    };
+
+    /// Entries by the name of their TypeId and of every parent TypeId, in NodeList order
+    using TypeIndex = std::map<std::string, std::vector<Entry>>;
+
+    /**
+     * File an entry under its TypeId and all parent TypeIds.
+     * \param index the index
+     * \param entry the entry
+     */
+    static void AddByType(TypeIndex& index, const Entry& entry);
+
+    /**
+     * Match a path to objects without the cache.
+     * \param path the path to the objects
+     * \param objects the matching objects
+     * \param contexts the resolved path of each match, ending with '/'
+     * \return false if the path has to be resolved by Config itself
+     */
+    bool Resolve(const std::string& path,
+                 std::vector<Ptr<Object>>& objects,
+                 std::vector<std::string>& contexts) const;
+
+    /**
+     * Resolve all but the last segment of a path, which names an attribute or a
+     * trace source.
+     * \param path the path
+     * \param name set to the last segment
+     * \return the objects matching the rest
+     */
+    Config::MatchContainer LookupParent(const std::string& path, std::string& name);
+
+    TypeIndex m_devices;                                   //!< Devices of all nodes.
+    TypeIndex m_applications;                              //!< Applications of all nodes.
+    std::map<std::string, Config::MatchContainer> m_cache; //!< Resolved paths.
+};
+
+void
+ConfigIndex::Build()
+{
+    m_devices.clear();
+    m_applications.clear();
+    m_cache.clear();
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); ++n)
+    {
+        Ptr<Node> node = NodeList::GetNode(n);
+        for (uint32_t i = 0; i < node->GetNDevices(); ++i)
+        {
+            AddByType(m_devices, Entry{n, i, node->GetDevice(i)});
+        }
+        for (uint32_t i = 0; i < node->GetNApplications(); ++i)
+        {
+            AddByType(m_applications, Entry{n, i, node->GetApplication(i)});
+        }
+    }
+}
+
+void
+ConfigIndex::AddByType(TypeIndex& index, const Entry& entry)
+{
+    // "$ns3::NetDevice" matches every device, so an entry is filed under each ancestor
+    // too; "ns3::Object" then lists them all
+    TypeId tid = entry.object->GetInstanceTypeId();
+    while (true)
+    {
+        index[tid.GetName()].push_back(entry);
+        if (tid == Object::GetTypeId())
+        {
+            break;
+        }
+        tid = tid.GetParent();
+    }
+}
+
+bool
+ConfigIndex::Resolve(const std::string& path,
+                     std::vector<Ptr<Object>>& objects,
+                     std::vector<std::string>& contexts) const
+{
+    std::vector<std::string> segments;
+    std::istringstream iss(path);
+    for (std::string segment; std::getline(iss, segment, '/');)
+    {
+        if (!segment.empty())
+        {
+            segments.push_back(segment);
+        }
+    }
+
+    // "*" or a single index; anything else is left to Config
+    auto parseIndex = [](const std::string& text, bool& all, uint32_t& index) {
+        all = text == "*";
+        char* end = nullptr;
+        index = std::strtoul(text.c_str(), &end, 10);
+        return all || (end != text.c_str() && *end == '\0');
+    };
+
+    std::size_t next = 0;
+    if (segments.size() >= 2 && segments[0] == "NodeList")
+    {
+        bool allNodes;
+        uint32_t nodeId;
+        if (!parseIndex(segments[1], allNodes, nodeId))
+        {
+            return false;
+        }
+        if (!allNodes && nodeId >= NodeList::GetNNodes())
+        {
+            return true;
+        }
+        bool devices = segments.size() >= 4 && segments[2] == "DeviceList";
+        bool applications = segments.size() >= 4 && segments[2] == "ApplicationList";
+        if (devices || applications)
+        {
+            bool allEntries;
+            uint32_t entry;
+            if (!parseIndex(segments[3], allEntries, entry))
+            {
+                return false;
+            }
+            std::string type = "ns3::Object";
+            std::string typeSegment;
+            next = 4;
+            if (segments.size() > 4 && segments[4][0] == '$')
+            {
+                typeSegment = segments[4] + "/";
+                type = segments[4].substr(1);
+                next = 5;
+            }
+            const TypeIndex& index = devices ? m_devices : m_applications;
+            auto matches = index.find(type);
+            if (matches == index.end())
+            {
+                return false;
+            }
+            auto first = matches->second.begin();
+            auto last = matches->second.end();
+            if (!allNodes)
+            {
+                // Entries are in node order, so one node's entries are a contiguous range
+                first = std::lower_bound(first, last, nodeId, [](const Entry& e, uint32_t id) {
+                    return e.node < id;
+                });
+                last = std::upper_bound(first, last, nodeId, [](uint32_t id, const Entry& e) {
+                    return id < e.node;
+                });
+            }
+            for (auto it = first; it != last; ++it)
+            {
+                if (allEntries || it->index == entry)
+                {
+                    objects.push_back(it->object);
+                    contexts.push_back("/NodeList/" + std::to_string(it->node) + "/" +
+                                       segments[2] + "/" + std::to_string(it->index) + "/" +
+                                       typeSegment);
+                }
+            }
+        }
+        else
+        {
+            uint32_t begin = allNodes ? 0 : nodeId;
+            uint32_t end = allNodes ? NodeList::GetNNodes() : nodeId + 1;
+            for (uint32_t n = begin; n < end; ++n)
+            {
+                objects.push_back(NodeList::GetNode(n));
+                contexts.push_back("/NodeList/" + std::to_string(n) + "/");
+            }
+            next = 2;
+        }
+    }
+    else if (segments.size() >= 2 && segments[0] == "Names")
+    {
+        Ptr<Object> object = Names::Find<Object>("/Names/" + segments[1]);
+        if (!object)
+        {
+            return false;
+        }
+        objects.push_back(object);
+        contexts.push_back("/Names/" + segments[1] + "/");
+        next = 2;
+    }
+    else
+    {
+        return false;
+    }
+
+    // The rest of the path goes from each match to a "$" type, a named child or the
+    // object held by a pointer attribute
+    for (; next < segments.size(); ++next)
+    {
+        const std::string& segment = segments[next];
+        std::vector<Ptr<Object>> children;
+        std::vector<std::string> childContexts;
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            Ptr<Object> child;
+            if (segment[0] == '$')
+            {
+                TypeId tid;
+                if (!TypeId::LookupByNameFailSafe(segment.substr(1), &tid))
+                {
+                    return false;
+                }
+                child = objects[i]->GetObject<Object>(tid);
+            }
+            else
+            {
+                child = Names::Find<Object>(objects[i], segment);
+                if (!child)
+                {
+                    PointerValue pointer;
+                    if (!objects[i]->GetAttributeFailSafe(segment, pointer))
+                    {
+                        return false;
+                    }
+                    child = pointer.Get<Object>();
+                }
+            }
+            if (child)
+            {
+                children.push_back(child);
+                childContexts.push_back(contexts[i] + segment + "/");
+            }
+        }
+        objects.swap(children);
+        contexts.swap(childContexts);
+    }
+    return true;
+}
+
+Config::MatchContainer
+ConfigIndex::LookupMatches(const std::string& path)
+{
+    auto cached = m_cache.find(path);
+    if (cached != m_cache.end())
+    {
+        return cached->second;
+    }
+    std::vector<Ptr<Object>> objects;
+    std::vector<std::string> contexts;
+    Config::MatchContainer matches = Resolve(path, objects, contexts)
+                                         ? Config::MatchContainer(objects, contexts, path)
+                                         : Config::LookupMatches(path);
+    m_cache.emplace(path, matches);
+    return matches;
+}
+
+Config::MatchContainer
+ConfigIndex::LookupParent(const std::string& path, std::string& name)
+{
+    std::size_t slash = path.rfind('/');
+    NS_ABORT_MSG_IF(slash == std::string::npos, "Invalid Config path " << path);
+    name = path.substr(slash + 1);
+    Config::MatchContainer matches = LookupMatches(path.substr(0, slash));
+    NS_ABORT_MSG_IF(matches.GetN() == 0, "No object matches " << path);
+    return matches;
+}
+
+void
+ConfigIndex::Set(const std::string& path, const AttributeValue& value)
+{
+    std::string name;
+    LookupParent(path, name).Set(name, value);
+}
+
+void
+ConfigIndex::Connect(const std::string& path, const CallbackBase& cb)
+{
+    std::string name;
+    LookupParent(path, name).Connect(name, cb);
+}
+
+void
+ConfigIndex::ConnectWithoutContext(const std::string& path, const CallbackBase& cb)
+{
+    std::string name;
+    LookupParent(path, name).ConnectWithoutContext(name, cb);
+}
+
 /// Counter of the received bytes.
 uint32_t bytesReceived = 0;
 
@@ -91,6 +436,15 @@ main(int argc, char* argv[])
     Names::Add("/Names/client/eth0", d.Get(0));
     Names::Add("server/eth0", d.Get(1));
 
+    //
+    // The paths below go through a ConfigIndex, which resolves them like the Config
+    // system does but against an index of the nodes' devices built once here, and
+    // caches every path it resolved. With thousands of nodes this keeps the cost of a
+    // path proportional to what it matches.
+    //
+    ConfigIndex config;
+    config.Build();
+
     //
     // You can use the object names that you've assigned in calls to the Config
     // system to set Object Attributes.  For example, you can set the Mtu
@@ -104,7 +458,7 @@ main(int argc, char* argv[])
     csmaNetDevice->GetAttribute("Mtu", val);
     std::cout << "MTU on device 0 before configuration is " << val.Get() << std::endl;
 
-    Config::Set("/Names/client/eth0/Mtu", UintegerValue(1234));
+    config.Set("/Names/client/eth0/Mtu", UintegerValue(1234));
 
     // Check the attribute again
     csmaNetDevice->GetAttribute("Mtu", val);
@@ -125,7 +479,7 @@ main(int argc, char* argv[])
     // Note that the config path now begins with a path in the "/NodeList"
     // namespace.
     //
-    Config::Set("/NodeList/1/eth0/Mtu", UintegerValue(1234));
+    config.Set("/NodeList/1/eth0/Mtu", UintegerValue(1234));
 
     Ipv4AddressHelper ipv4;
     ipv4.SetBase("10.1.1.0", "255.255.255.0");
@@ -162,7 +516,7 @@ main(int argc, char* argv[])
     // prefix is always required since the _Config_ system always expects to
     // see a fully qualified path name
     //
-    Config::Connect("/Names/client/eth0/MacRx", MakeCallback(&RxEvent));
+    config.Connect("/Names/client/eth0/MacRx", MakeCallback(&RxEvent));
 
     //
     // Set up some pcap tracing on the CSMA devices.  The names of the trace
@@ -46,14 +46,399 @@
 #include "ns3/olsr-module.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 using namespace ns3;
 using namespace dsr;
 
 NS_LOG_COMPONENT_DEFINE("manet-routing-compare");
 
+/**
+ * Positions and velocities of all nodes, kept in contiguous arrays indexed by node id.
+ *
+ * Attach() reads each node's mobility model once and then follows its CourseChange
+ * trace, so the arrays hold every node's position and velocity as of its last course
+ * change. ns-3 mobility models move in straight lines at constant velocity between
+ * course changes, so SnapshotPositions(t) brings all nodes to time t in one pass over
+ * the arrays, with no aggregate lookup or model update per node. Nodes without a
+ * mobility model stay at the origin.
+ */
+class MobilitySnapshot
+{
+  public:
+    /// Track the nodes of the NodeList not tracked yet; call again after creating more.
+    void Attach();
+
+    /**
+     * Compute the positions of all nodes at a time.
+     * \param t the time, not before the current simulation time; a later time assumes
+     *          no course change until then
+     */
+    void SnapshotPositions(Time t);
+
+    /**
+     * Write the last snapshot, one "<time> <node id> <x> <y> <z>" line per node.
+     * \param os the output stream
+     */
+    void Print(std::ostream& os) const;
+
+    /// \return the number of nodes tracked
+    uint32_t GetN() const
+    {
+        return m_x.size();
+    }
+
+    /**
+     * \param nodeId the node id
+     * \return the position of the node at the last snapshot
+     */
+    Vector GetPosition(uint32_t nodeId) const
+    {
+        return Vector(m_x[nodeId], m_y[nodeId], m_z[nodeId]);
+    }
+
+    /// \return the x coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetX() const
+    {
+        return m_x;
+    }
+
+    /// \return the y coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetY() const
+    {
+        return m_y;
+    }
+
+    /// \return the z coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetZ() const
+    {
+        return m_z;
+    }
+
+  private:
+    /**
+     * CourseChange trace sink; records the new position and velocity of a node.
+     * \param snapshot the snapshot
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    static void CourseChanged(MobilitySnapshot* snapshot,
+                              uint32_t nodeId,
+                              Ptr<const MobilityModel> model);
+
+    /**
+     * Record the current position and velocity of a node.
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    void Update(uint32_t nodeId, Ptr<const MobilityModel> model);
+
+    std::vector<double> m_time;  //!< Time of the last course change, in seconds.
+    std::vector<double> m_baseX; //!< x coordinate at the last course change.
+    std::vector<double> m_baseY; //!< y coordinate at the last course change.
+    std::vector<double> m_baseZ; //!< z coordinate at the last course change.
+    std::vector<double> m_velX;  //!< x velocity since the last course change.
+    std::vector<double> m_velY;  //!< y velocity since the last course change.
+    std::vector<double> m_velZ;  //!< z velocity since the last course change.
+    std::vector<double> m_x;     //!< x coordinate at the last snapshot.
+    std::vector<double> m_y;     //!< y coordinate at the last snapshot.
+    std::vector<double> m_z;     //!< z coordinate at the last snapshot.
+    Time m_snapshotTime;         //!< Time of the last snapshot.
+};
+
+void
+MobilitySnapshot::Attach()
+{
+    uint32_t first = m_x.size();
+    uint32_t n = NodeList::GetNNodes();
+    m_time.resize(n, 0.0);
+    m_baseX.resize(n, 0.0);
+    m_baseY.resize(n, 0.0);
+    m_baseZ.resize(n, 0.0);
+    m_velX.resize(n, 0.0);
+    m_velY.resize(n, 0.0);
+    m_velZ.resize(n, 0.0);
+    m_x.resize(n, 0.0);
+    m_y.resize(n, 0.0);
+    m_z.resize(n, 0.0);
+    for (uint32_t i = first; i < n; ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!model)
+        {
+            continue;
+        }
+        Update(i, model);
+        model->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&MobilitySnapshot::CourseChanged, this, i));
+    }
+    SnapshotPositions(Simulator::Now());
+}
+
+void
+MobilitySnapshot::CourseChanged(MobilitySnapshot* snapshot,
+                                uint32_t nodeId,
+                                Ptr<const MobilityModel> model)
+{
+    snapshot->Update(nodeId, model);
+}
+
+void
+MobilitySnapshot::Update(uint32_t nodeId, Ptr<const MobilityModel> model)
+{
+    Vector position = model->GetPosition();
+    Vector velocity = model->GetVelocity();
+    m_time[nodeId] = Simulator::Now().GetSeconds();
+    m_baseX[nodeId] = position.x;
+    m_baseY[nodeId] = position.y;
+    m_baseZ[nodeId] = position.z;
+    m_velX[nodeId] = velocity.x;
+    m_velY[nodeId] = velocity.y;
+    m_velZ[nodeId] = velocity.z;
+}
+
+void
+MobilitySnapshot::SnapshotPositions(Time t)
+{
+    const double now = t.GetSeconds();
+    const std::size_t n = m_x.size();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        double elapsed = now - m_time[i];
+        m_x[i] = m_baseX[i] + m_velX[i] * elapsed;
+        m_y[i] = m_baseY[i] + m_velY[i] * elapsed;
+        m_z[i] = m_baseZ[i] + m_velZ[i] * elapsed;
+    }
+    m_snapshotTime = t;
+}
+
+void
+MobilitySnapshot::Print(std::ostream& os) const
+{
+    double time = m_snapshotTime.GetSeconds();
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        os << time << " " << i << " " << m_x[i] << " " << m_y[i] << " " << m_z[i] << "\n";
+    }
+}
+
+/**
+ * Records the course changes of all nodes to a compact binary file.
+ *
+ * Each record holds the time, the node id, and the position and velocity right after
+ * the change. Records are packed into a buffer that is written in large blocks, and
+ * Close() adds one record per node at the end of the run so the last leg of every
+ * trajectory is known. MobilityTraceReplay drives the nodes from the file.
+ *
+ * File layout: the magic "NS3MOBT1", then RECORD_SIZE byte records of an int64 time in
+ * nanoseconds, a uint32 node id and six doubles (position x, y, z and velocity x, y, z),
+ * packed without padding. Numbers are in host byte order.
+ */
+class MobilityTraceRecorder
+{
+  public:
+    static const std::size_t RECORD_SIZE = 8 + 4 + 6 * 8; //!< Bytes per record.
+
+    /**
+     * Record the current position of every node, then every course change.
+     * \param fileName the output file
+     */
+    void Open(const std::string& fileName);
+
+    /// Record the current position of every node, write the buffer and close the file.
+    void Close();
+
+  private:
+    static const std::size_t BUFFER_RECORDS = 4096; //!< Records buffered before a write.
+
+    /**
+     * CourseChange trace sink.
+     * \param recorder the recorder
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    static void CourseChanged(MobilityTraceRecorder* recorder,
+                              uint32_t nodeId,
+                              Ptr<const MobilityModel> model);
+
+    /**
+     * Append a record of the current position and velocity of a node.
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    void Write(uint32_t nodeId, Ptr<const MobilityModel> model);
+
+    /// Write the buffered records to the file.
+    void Flush();
+
+    FILE* m_file{nullptr};      //!< Output file, null when closed.
+    std::vector<char> m_buffer; //!< Packed records not written yet.
+};
+
+void
+MobilityTraceRecorder::Open(const std::string& fileName)
+{
+    m_file = fopen(fileName.c_str(), "wb");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open mobility trace " << fileName);
+    fwrite("NS3MOBT1", 8, 1, m_file);
+    m_buffer.reserve(BUFFER_RECORDS * RECORD_SIZE);
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!model)
+        {
+            continue;
+        }
+        Write(i, model);
+        model->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&MobilityTraceRecorder::CourseChanged, this, i));
+    }
+}
+
+void
+MobilityTraceRecorder::CourseChanged(MobilityTraceRecorder* recorder,
+                                     uint32_t nodeId,
+                                     Ptr<const MobilityModel> model)
+{
+    recorder->Write(nodeId, model);
+}
+
+void
+MobilityTraceRecorder::Write(uint32_t nodeId, Ptr<const MobilityModel> model)
+{
+    if (!m_file)
+    {
+        return;
+    }
+    int64_t timeNs = Simulator::Now().GetNanoSeconds();
+    Vector position = model->GetPosition();
+    Vector velocity = model->GetVelocity();
+    double values[6] = {position.x, position.y, position.z, velocity.x, velocity.y, velocity.z};
+
+    std::size_t offset = m_buffer.size();
+    m_buffer.resize(offset + RECORD_SIZE);
+    char* record = m_buffer.data() + offset;
+    memcpy(record, &timeNs, sizeof(timeNs));
+    memcpy(record + 8, &nodeId, sizeof(nodeId));
+    memcpy(record + 12, values, sizeof(values));
+    if (m_buffer.size() == BUFFER_RECORDS * RECORD_SIZE)
+    {
+        Flush();
+    }
+}
+
+void
+MobilityTraceRecorder::Flush()
+{
+    if (!m_buffer.empty())
+    {
+        fwrite(m_buffer.data(), m_buffer.size(), 1, m_file);
+        m_buffer.clear();
+    }
+}
+
+void
+MobilityTraceRecorder::Close()
+{
+    if (!m_file)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (model)
+        {
+            Write(i, model);
+        }
+    }
+    Flush();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+/**
+ * Drives the nodes along the trajectories of a MobilityTraceRecorder file.
+ *
+ * Between course changes nodes move in straight lines at constant velocity, so the
+ * recorded positions are the waypoints of a WaypointMobilityModel that reproduces the
+ * recorded movement without the random draws and model logic of the original run.
+ */
+class MobilityTraceReplay
+{
+  public:
+    /**
+     * Aggregate a WaypointMobilityModel following the trace to each recorded node.
+     * The nodes must exist and have no mobility model yet.
+     * \param fileName the mobility trace
+     * \return the number of nodes driven
+     */
+    static uint32_t Install(const std::string& fileName);
+};
+
+uint32_t
+MobilityTraceReplay::Install(const std::string& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    NS_ABORT_MSG_IF(!file, "Cannot open mobility trace " << fileName);
+    char magic[8];
+    NS_ABORT_MSG_IF(fread(magic, 8, 1, file) != 1 || std::string(magic, 8) != "NS3MOBT1",
+                    fileName << " is not a mobility trace");
+
+    std::vector<std::vector<Waypoint>> waypoints;
+    char record[MobilityTraceRecorder::RECORD_SIZE];
+    while (fread(record, sizeof(record), 1, file) == 1)
+    {
+        int64_t timeNs;
+        uint32_t nodeId;
+        double values[6];
+        memcpy(&timeNs, record, sizeof(timeNs));
+        memcpy(&nodeId, record + 8, sizeof(nodeId));
+        memcpy(values, record + 12, sizeof(values));
+        if (nodeId >= waypoints.size())
+        {
+            waypoints.resize(nodeId + 1);
+        }
+        Waypoint waypoint(NanoSeconds(timeNs), Vector(values[0], values[1], values[2]));
+        // Waypoint times must increase, so the last change at a given time wins
+        std::vector<Waypoint>& path = waypoints[nodeId];
+        if (!path.empty() && path.back().time == waypoint.time)
+        {
+            path.back() = waypoint;
+        }
+        else
+        {
+            path.push_back(waypoint);
+        }
+    }
+    fclose(file);
+
+    uint32_t driven = 0;
+    for (uint32_t i = 0; i < waypoints.size(); ++i)
+    {
+        if (waypoints[i].empty())
+        {
+            continue;
+        }
+        NS_ABORT_MSG_IF(i >= NodeList::GetNNodes(),
+                        fileName << " records node " << i << ", which does not exist");
+        Ptr<WaypointMobilityModel> model = CreateObject<WaypointMobilityModel>();
+        for (const Waypoint& waypoint : waypoints[i])
+        {
+            model->AddWaypoint(waypoint);
+        }
+        NodeList::GetNode(i)->AggregateObject(model);
+        ++driven;
+    }
+    return driven;
+}
+
 /**
  * Routing experiment class.
  *
@@ -92,6 +477,10 @@ class RoutingExperiment
      * Compute the throughput.
      */
     void CheckThroughput();
+    /**
+     * Write the positions of all nodes and schedule the next sample.
+     */
+    void SamplePositions();
 
     uint32_t port{9};            //!< Receiving port number.
     uint32_t bytesTotal{0};      //!< Total received bytes.
@@ -103,6 +492,13 @@ class RoutingExperiment
     double m_txp{7.5};                                     //!< Tx power.
     bool m_traceMobility{false};                           //!< Enable mobility tracing.
     bool m_flowMonitor{false};                             //!< Enable FlowMonitor.
+    double m_positionInterval{0};                          //!< Position sample interval (s).
+    std::string m_mobilityRecord;                          //!< Mobility trace to record.
+    std::string m_mobilityReplay;                          //!< Mobility trace to replay.
+
+    MobilitySnapshot m_positions;             //!< Positions of all nodes.
+    std::ofstream m_positionsFile;            //!< Position samples output file.
+    MobilityTraceRecorder m_mobilityRecorder; //!< Course change recorder.
 };
 
 RoutingExperiment::RoutingExperiment()
@@ -157,6 +553,14 @@ RoutingExperiment::CheckThroughput()
     Simulator::Schedule(Seconds(1.0), &RoutingExperiment::CheckThroughput, this);
 }
 
+void
+RoutingExperiment::SamplePositions()
+{
+    m_positions.SnapshotPositions(Simulator::Now());
+    m_positions.Print(m_positionsFile);
+    Simulator::Schedule(Seconds(m_positionInterval), &RoutingExperiment::SamplePositions, this);
+}
+
 Ptr<Socket>
 RoutingExperiment::SetupPacketReceive(Ipv4Address addr, Ptr<Node> node)
 {
@@ -177,6 +581,15 @@ RoutingExperiment::CommandSetup(int argc, char** argv)
     cmd.AddValue("traceMobility", "Enable mobility tracing", m_traceMobility);
     cmd.AddValue("protocol", "Routing protocol (OLSR, AODV, DSDV, DSR)", m_protocolName);
     cmd.AddValue("flowMonitor", "enable FlowMonitor", m_flowMonitor);
+    cmd.AddValue("positionInterval",
+                 "seconds between samples of all node positions, 0 to disable",
+                 m_positionInterval);
+    cmd.AddValue("mobilityRecord",
+                 "binary file to record the course changes of all nodes to",
+                 m_mobilityRecord);
+    cmd.AddValue("mobilityReplay",
+                 "binary file of recorded course changes to move all nodes by instead",
+                 m_mobilityReplay);
     cmd.Parse(argc, argv);
 
     std::vector<std::string> allowedProtocols{"OLSR", "AODV", "DSDV", "DSR"};
@@ -188,6 +601,199 @@ RoutingExperiment::CommandSetup(int argc, char** argv)
     }
 }
 
+/**
+ * Uniform random variates drawn in bulk, for start time and placement loops.
+ *
+ * This is the MRG32k3a generator behind ns-3's RngStream, seeded the same way from
+ * the global seed and run number: a stream advances the initial state by 2^127 steps
+ * per stream index and the run selects a substream 2^76 steps apart. For the same seed,
+ * run and stream the values are the ones a UniformRandomVariable would return, but Fill
+ * draws a whole array in one inlined loop instead of one virtual call per value, and
+ * one object serves every draw of a loop.
+ */
+class BatchUniformStream
+{
+  public:
+    /// Use the next automatically assigned stream, as a new UniformRandomVariable does.
+    BatchUniformStream();
+
+    /**
+     * Use a fixed stream, like RandomVariableStream::SetStream.
+     * \param stream first stream index to use
+     * \return the number of streams used
+     */
+    int64_t AssignStreams(int64_t stream);
+
+    /**
+     * Fill an array with uniform values in [min, max).
+     * \param values the array
+     * \param count its size
+     * \param min lower bound
+     * \param max upper bound
+     */
+    void Fill(double* values, std::size_t count, double min, double max);
+
+    /// Fill a vector with uniform values in [min, max).
+    void Fill(std::vector<double>& values, double min, double max)
+    {
+        Fill(values.data(), values.size(), min, max);
+    }
+
+  private:
+    static constexpr double M1 = 4294967087.0;
+    static constexpr double M2 = 4294944443.0;
+
+    /// Seed the generator for a stream index as RngStream does, with the current run
+    void Seed(uint64_t stream);
+
+    /// Advance one component by n * 2^e steps
+    static void Advance(const uint64_t a[3][3], uint64_t m, uint64_t n, uint32_t e, uint64_t s[3]);
+
+    /// r = a * b mod m, r may alias a or b
+    static void Multiply(const uint64_t a[3][3],
+                         const uint64_t b[3][3],
+                         uint64_t m,
+                         uint64_t r[3][3]);
+
+    double m_state[6];
+};
+
+BatchUniformStream::BatchUniformStream()
+{
+    // As RandomVariableStream::SetStream(-1): the first 2^63 streams are automatic
+    Seed(RngSeedManager::GetNextStreamIndex());
+}
+
+int64_t
+BatchUniformStream::AssignStreams(int64_t stream)
+{
+    Seed((1ULL << 63) + stream);
+    return 1;
+}
+
+void
+BatchUniformStream::Seed(uint64_t stream)
+{
+    static const uint64_t a1[3][3] = {{0, 1, 0}, {0, 0, 1}, {4294967087ULL - 810728, 1403580, 0}};
+    static const uint64_t a2[3][3] = {{0, 1, 0}, {0, 0, 1}, {4294944443ULL - 1370589, 0, 527612}};
+
+    uint64_t s1[3];
+    uint64_t s2[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        s1[i] = s2[i] = RngSeedManager::GetSeed();
+    }
+    Advance(a1, 4294967087ULL, stream, 127, s1);
+    Advance(a2, 4294944443ULL, stream, 127, s2);
+    Advance(a1, 4294967087ULL, RngSeedManager::GetRun(), 76, s1);
+    Advance(a2, 4294944443ULL, RngSeedManager::GetRun(), 76, s2);
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        m_state[i] = static_cast<double>(s1[i]);
+        m_state[i + 3] = static_cast<double>(s2[i]);
+    }
+}
+
+void
+BatchUniformStream::Multiply(const uint64_t a[3][3],
+                             const uint64_t b[3][3],
+                             uint64_t m,
+                             uint64_t r[3][3])
+{
+    uint64_t product[3][3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            uint64_t sum = 0;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                // Both factors are below 2^32, so the product fits
+                sum = (sum + a[i][k] * b[k][j] % m) % m;
+            }
+            product[i][j] = sum;
+        }
+    }
+    memcpy(r, product, sizeof(product));
+}
+
+void
+BatchUniformStream::Advance(const uint64_t a[3][3],
+                            uint64_t m,
+                            uint64_t n,
+                            uint32_t e,
+                            uint64_t s[3])
+{
+    uint64_t power[3][3];
+    memcpy(power, a, sizeof(power));
+    for (uint32_t i = 0; i < e; ++i)
+    {
+        Multiply(power, power, m, power);
+    }
+    for (; n != 0; n >>= 1)
+    {
+        if (n & 1)
+        {
+            uint64_t next[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                next[i] = 0;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    next[i] = (next[i] + power[i][k] * s[k] % m) % m;
+                }
+            }
+            memcpy(s, next, sizeof(next));
+        }
+        Multiply(power, power, m, power);
+    }
+}
+
+void
+BatchUniformStream::Fill(double* values, std::size_t count, double min, double max)
+{
+    // The recurrence of RngStream::RandU01, with the state kept in locals
+    const double norm = 1.0 / (M1 + 1.0);
+    const double range = max - min;
+    double s0 = m_state[0];
+    double s1 = m_state[1];
+    double s2 = m_state[2];
+    double s3 = m_state[3];
+    double s4 = m_state[4];
+    double s5 = m_state[5];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double p1 = 1403580.0 * s1 - 810728.0 * s0;
+        p1 -= static_cast<int32_t>(p1 / M1) * M1;
+        if (p1 < 0.0)
+        {
+            p1 += M1;
+        }
+        s0 = s1;
+        s1 = s2;
+        s2 = p1;
+
+        double p2 = 527612.0 * s5 - 1370589.0 * s3;
+        p2 -= static_cast<int32_t>(p2 / M2) * M2;
+        if (p2 < 0.0)
+        {
+            p2 += M2;
+        }
+        s3 = s4;
+        s4 = s5;
+        s5 = p2;
+
+        double u = (p1 > p2 ? p1 - p2 : p1 - p2 + M1) * norm;
+        values[i] = min + u * range;
+    }
+    m_state[0] = s0;
+    m_state[1] = s1;
+    m_state[2] = s2;
+    m_state[3] = s3;
+    m_state[4] = s4;
+    m_state[5] = s5;
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -278,8 +884,23 @@ RoutingExperiment::Run()
                                    "PositionAllocator",
                                    PointerValue(taPositionAlloc));
     mobilityAdhoc.SetPositionAllocator(taPositionAlloc);
-    mobilityAdhoc.Install(adhocNodes);
-    streamIndex += mobilityAdhoc.AssignStreams(adhocNodes, streamIndex);
+    if (m_mobilityReplay.empty())
+    {
+        mobilityAdhoc.Install(adhocNodes);
+        streamIndex += mobilityAdhoc.AssignStreams(adhocNodes, streamIndex);
+    }
+    else
+    {
+        // Recorded trajectories instead of random waypoints. The streams the random
+        // waypoint models would take are skipped all the same, so the start times are
+        // drawn from the streams of the recording run.
+        MobilityTraceReplay::Install(m_mobilityReplay);
+        ObjectFactory waypoint;
+        waypoint.SetTypeId("ns3::RandomWaypointMobilityModel");
+        waypoint.Set("PositionAllocator", PointerValue(taPositionAlloc));
+        Ptr<MobilityModel> probe = waypoint.Create<MobilityModel>();
+        streamIndex += probe->AssignStreams(streamIndex) * adhocNodes.GetN();
+    }
 
     AodvHelper aodv;
     OlsrHelper olsr;
@@ -332,6 +953,12 @@ RoutingExperiment::Run()
     onoff1.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1.0]"));
     onoff1.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0.0]"));
 
+    // Source start times, drawn at once from a stream numbered after the mobility ones
+    std::vector<double> startTimes(m_nSinks);
+    BatchUniformStream startTimeStream;
+    streamIndex += startTimeStream.AssignStreams(streamIndex);
+    startTimeStream.Fill(startTimes, 100.0, 101.0);
+
     for (int i = 0; i < m_nSinks; i++)
     {
         Ptr<Socket> sink = SetupPacketReceive(adhocInterfaces.GetAddress(i), adhocNodes.Get(i));
@@ -339,9 +966,8 @@ RoutingExperiment::Run()
         AddressValue remoteAddress(InetSocketAddress(adhocInterfaces.GetAddress(i), port));
         onoff1.SetAttribute("Remote", remoteAddress);
 
-        Ptr<UniformRandomVariable> var = CreateObject<UniformRandomVariable>();
         ApplicationContainer temp = onoff1.Install(adhocNodes.Get(i + m_nSinks));
-        temp.Start(Seconds(var->GetValue(100.0, 101.0)));
+        temp.Start(Seconds(startTimes[i]));
         temp.Stop(Seconds(TotalTime));
     }
 
@@ -371,6 +997,18 @@ RoutingExperiment::Run()
     AsciiTraceHelper ascii;
     MobilityHelper::EnableAsciiAll(ascii.CreateFileStream(tr_name + ".mob"));
 
+    if (m_positionInterval > 0)
+    {
+        m_positionsFile.open(tr_name + ".positions");
+        m_positions.Attach();
+        SamplePositions();
+    }
+
+    if (!m_mobilityRecord.empty())
+    {
+        m_mobilityRecorder.Open(m_mobilityRecord);
+    }
+
     FlowMonitorHelper flowmonHelper;
     Ptr<FlowMonitor> flowmon;
     if (m_flowMonitor)
@@ -384,6 +1022,7 @@ RoutingExperiment::Run()
 
     Simulator::Stop(Seconds(TotalTime));
     Simulator::Run();
+    m_mobilityRecorder.Close();
 
     if (m_flowMonitor)
     {
@@ -3,12 +3,306 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("PacketCaptureExample");
 
+/**
+ * Asynchronous pcap / pcapng writer.
+ *
+ * The simulation thread only copies the first SnapLen bytes of every captured frame,
+ * with its timestamp, into a per-device single-producer ring buffer; a writer thread
+ * drains the rings, formats the records and does all the file I/O. A full ring blocks
+ * the simulation until the writer catches up, so no frame is ever dropped.
+ *
+ * In pcap mode every device gets its own <prefix>-<node>-<device>.pcap file, as with
+ * the helpers' EnablePcap. In pcapng mode all devices share <prefix>.pcapng, one
+ * interface per device. With compression the output is piped through "gzip -1" (and
+ * gets a .gz suffix, which Wireshark opens directly). Timestamps have nanosecond
+ * resolution.
+ */
+class AsyncPcapWriter : public SimpleRefCount<AsyncPcapWriter> {
+  public:
+    /**
+     * \param prefix file name prefix
+     * \param pcapng write a single pcapng file instead of one pcap file per device
+     * \param snapLen maximum number of bytes kept from each frame
+     * \param compress compress the output with gzip
+     * \param ringBytes size of each device's ring buffer, rounded up to a power of two
+     */
+    AsyncPcapWriter(const std::string& prefix,
+                    bool pcapng,
+                    uint32_t snapLen,
+                    bool compress,
+                    uint32_t ringBytes);
+    ~AsyncPcapWriter();
+
+    /**
+     * Capture every frame a device sends or receives, through its PromiscSniffer trace
+     * source; must be called before the simulation starts.
+     * \param device a CSMA or point-to-point device
+     * \param dataLinkType the pcap link type of the device's frames
+     */
+    void Attach(Ptr<NetDevice> device, uint32_t dataLinkType);
+
+    /// Drain the rings, stop the writer thread and close the files.
+    void Close();
+
+  private:
+    /// Single-producer, single-consumer byte ring holding one device's records.
+    struct Ring {
+        std::vector<uint8_t> data;
+        std::atomic<uint64_t> head{0}; //!< bytes ever written, updated by the simulation
+        std::atomic<uint64_t> tail{0}; //!< bytes ever read, updated by the writer
+        FILE* file{nullptr}; //!< pcap mode only
+    };
+
+    /// Record header in a ring, followed by capturedLength bytes of frame
+    struct RecordHeader {
+        uint64_t timeNs;
+        uint32_t capturedLength;
+        uint32_t originalLength;
+    };
+
+    static void Capture(AsyncPcapWriter* writer, uint32_t interface, Ptr<const Packet> packet);
+    void Push(Ring& ring, const uint8_t* bytes, uint64_t size);
+    void Pop(Ring& ring, uint8_t* bytes, uint64_t size);
+    FILE* Open(const std::string& name);
+    void CloseFile(FILE*& file);
+    void WriteFileHeader(FILE* file, uint32_t dataLinkType);
+    void WriteInterfaceDescription(uint32_t dataLinkType);
+    bool DrainOnce();
+    void Run();
+
+    std::string m_prefix;
+    bool m_pcapng;
+    uint32_t m_snapLen;
+    bool m_compress;
+    uint64_t m_ringBytes;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    std::vector<uint8_t> m_frame; //!< scratch buffer, simulation thread
+    std::vector<uint8_t> m_out;   //!< scratch buffer, writer thread
+    FILE* m_file{nullptr};        //!< pcapng mode only
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::atomic<bool> m_stop{false};
+};
+
+AsyncPcapWriter::AsyncPcapWriter(const std::string& prefix,
+                                 bool pcapng,
+                                 uint32_t snapLen,
+                                 bool compress,
+                                 uint32_t ringBytes)
+    : m_prefix(prefix),
+      m_pcapng(pcapng),
+      m_snapLen(snapLen),
+      m_compress(compress),
+      m_ringBytes(1),
+      m_frame(snapLen) {
+    while (m_ringBytes < std::max<uint64_t>(ringBytes, sizeof(RecordHeader) + snapLen)) {
+        m_ringBytes <<= 1;
+    }
+    if (m_pcapng) {
+        m_file = Open(m_prefix + ".pcapng");
+        // Section header block: byte-order magic, version 1.0, unknown section length
+        uint32_t shb[7] = {0x0A0D0D0A, 28, 0x1A2B3C4D, 1, 0xffffffff, 0xffffffff, 28};
+        fwrite(shb, sizeof(shb), 1, m_file);
+    }
+}
+
+AsyncPcapWriter::~AsyncPcapWriter() {
+    Close();
+}
+
+FILE* AsyncPcapWriter::Open(const std::string& name) {
+    FILE* file = m_compress ? popen(("gzip -1 > '" + name + ".gz'").c_str(), "w")
+                            : fopen(name.c_str(), "wb");
+    NS_ABORT_MSG_IF(!file, "Cannot open capture file " << name);
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    return file;
+}
+
+void AsyncPcapWriter::WriteFileHeader(FILE* file, uint32_t dataLinkType) {
+    // Nanosecond-resolution pcap, version 2.4
+    uint32_t header[6] = {0xa1b23c4d, 2 | (4 << 16), 0, 0, m_snapLen, dataLinkType};
+    fwrite(header, sizeof(header), 1, file);
+}
+
+void AsyncPcapWriter::WriteInterfaceDescription(uint32_t dataLinkType) {
+    // Interface description block with an if_tsresol option of 10^-9 s
+    uint32_t idb[8] = {1, 32, dataLinkType, m_snapLen, 9 | (1 << 16), 9, 0, 32};
+    fwrite(idb, sizeof(idb), 1, m_file);
+}
+
+void AsyncPcapWriter::Attach(Ptr<NetDevice> device, uint32_t dataLinkType) {
+    NS_ABORT_MSG_IF(m_writer.joinable(), "Devices must be attached before the simulation");
+    auto ring = std::make_unique<Ring>();
+    ring->data.resize(m_ringBytes);
+    if (m_pcapng) {
+        WriteInterfaceDescription(dataLinkType);
+    } else {
+        std::ostringstream name;
+        name << m_prefix << "-" << device->GetNode()->GetId() << "-" << device->GetIfIndex()
+             << ".pcap";
+        ring->file = Open(name.str());
+        WriteFileHeader(ring->file, dataLinkType);
+    }
+    device->TraceConnectWithoutContext(
+        "PromiscSniffer",
+        MakeBoundCallback(&AsyncPcapWriter::Capture, this, static_cast<uint32_t>(m_rings.size())));
+    m_rings.push_back(std::move(ring));
+}
+
+void AsyncPcapWriter::Capture(AsyncPcapWriter* writer, uint32_t interface, Ptr<const Packet> packet) {
+    if (!writer->m_writer.joinable()) {
+        writer->m_writer = std::thread(&AsyncPcapWriter::Run, writer);
+    }
+    RecordHeader header;
+    header.timeNs = Simulator::Now().GetNanoSeconds();
+    header.originalLength = packet->GetSize();
+    header.capturedLength = std::min(header.originalLength, writer->m_snapLen);
+    packet->CopyData(writer->m_frame.data(), header.capturedLength);
+
+    Ring& ring = *writer->m_rings[interface];
+    writer->Push(ring, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    writer->Push(ring, writer->m_frame.data(), header.capturedLength);
+}
+
+void AsyncPcapWriter::Push(Ring& ring, const uint8_t* bytes, uint64_t size) {
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    while (head + size - ring.tail.load(std::memory_order_acquire) > m_ringBytes) {
+        m_wakeUp.notify_one(); // ring full: let the writer catch up
+        std::this_thread::yield();
+    }
+    uint64_t offset = head & (m_ringBytes - 1);
+    uint64_t first = std::min(size, m_ringBytes - offset);
+    memcpy(ring.data.data() + offset, bytes, first);
+    memcpy(ring.data.data(), bytes + first, size - first);
+    ring.head.store(head + size, std::memory_order_release);
+}
+
+void AsyncPcapWriter::Pop(Ring& ring, uint8_t* bytes, uint64_t size) {
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t offset = tail & (m_ringBytes - 1);
+    uint64_t first = std::min(size, m_ringBytes - offset);
+    memcpy(bytes, ring.data.data() + offset, first);
+    memcpy(bytes + first, ring.data.data(), size - first);
+    ring.tail.store(tail + size, std::memory_order_release);
+}
+
+bool AsyncPcapWriter::DrainOnce() {
+    bool drained = false;
+    for (uint32_t interface = 0; interface < m_rings.size(); ++interface) {
+        Ring& ring = *m_rings[interface];
+        // A record is only complete once head has moved past its frame bytes
+        while (true) {
+            uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+            uint64_t available = ring.head.load(std::memory_order_acquire) - tail;
+            if (available < sizeof(RecordHeader)) {
+                break;
+            }
+            RecordHeader header;
+            uint64_t offset = tail & (m_ringBytes - 1);
+            uint64_t first = std::min<uint64_t>(sizeof(header), m_ringBytes - offset);
+            memcpy(&header, ring.data.data() + offset, first);
+            memcpy(reinterpret_cast<uint8_t*>(&header) + first,
+                   ring.data.data(),
+                   sizeof(header) - first);
+            if (available < sizeof(header) + header.capturedLength) {
+                break;
+            }
+            ring.tail.store(tail + sizeof(header), std::memory_order_relaxed);
+
+            uint32_t padded = (header.capturedLength + 3) & ~3u;
+            m_out.assign(padded + 32, 0);
+            if (m_pcapng) {
+                // Enhanced packet block
+                uint32_t blockLength = 32 + padded;
+                uint32_t epb[7] = {6,
+                                   blockLength,
+                                   interface,
+                                   static_cast<uint32_t>(header.timeNs >> 32),
+                                   static_cast<uint32_t>(header.timeNs),
+                                   header.capturedLength,
+                                   header.originalLength};
+                memcpy(m_out.data(), epb, sizeof(epb));
+                Pop(ring, m_out.data() + sizeof(epb), header.capturedLength);
+                memcpy(m_out.data() + sizeof(epb) + padded, &blockLength, 4);
+                fwrite(m_out.data(), blockLength, 1, m_file);
+            } else {
+                uint32_t record[4] = {static_cast<uint32_t>(header.timeNs / 1000000000),
+                                      static_cast<uint32_t>(header.timeNs % 1000000000),
+                                      header.capturedLength,
+                                      header.originalLength};
+                memcpy(m_out.data(), record, sizeof(record));
+                Pop(ring, m_out.data() + sizeof(record), header.capturedLength);
+                fwrite(m_out.data(), sizeof(record) + header.capturedLength, 1, ring.file);
+            }
+            drained = true;
+        }
+    }
+    return drained;
+}
+
+void AsyncPcapWriter::Run() {
+    while (!m_stop.load()) {
+        if (!DrainOnce()) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+    DrainOnce();
+}
+
+void AsyncPcapWriter::Close() {
+    if (m_writer.joinable()) {
+        m_stop.store(true);
+        m_wakeUp.notify_one();
+        m_writer.join();
+    } else {
+        DrainOnce();
+    }
+    for (auto& ring : m_rings) {
+        CloseFile(ring->file);
+    }
+    CloseFile(m_file);
+}
+
+void AsyncPcapWriter::CloseFile(FILE*& file) {
+    if (file) {
+        if (m_compress) {
+            pclose(file);
+        } else {
+            fclose(file);
+        }
+        file = nullptr;
+    }
+}
+
 int main(int argc, char *argv[]) {
+    bool asyncPcap = false;
+    uint32_t snapLen = 65535;
+    bool pcapng = false;
+    bool compressPcap = false;
+
     CommandLine cmd;
+    cmd.AddValue("asyncPcap", "Write the capture from a separate thread", asyncPcap);
+    cmd.AddValue("snapLen", "Bytes kept from each captured frame with --asyncPcap", snapLen);
+    cmd.AddValue("pcapng", "Write a single pcapng file with --asyncPcap", pcapng);
+    cmd.AddValue("compressPcap", "Gzip the capture written with --asyncPcap", compressPcap);
     cmd.Parse(argc, argv);
 
     // Create two nodes
@@ -34,10 +328,21 @@ int main(int argc, char *argv[]) {
     Ipv4InterfaceContainer interfaces = address.Assign(devices);
 
     // Enable packet capture
-    pointToPoint.EnablePcapAll("simple-point-to-point");
+    Ptr<AsyncPcapWriter> pcapWriter;
+    if (asyncPcap) {
+        pcapWriter = Create<AsyncPcapWriter>("simple-point-to-point", pcapng, snapLen, compressPcap, 1 << 20);
+        for (uint32_t i = 0; i < devices.GetN(); ++i) {
+            pcapWriter->Attach(devices.Get(i), 9); // DLT_PPP
+        }
+    } else {
+        pointToPoint.EnablePcapAll("simple-point-to-point");
+    }
 
     // Run the simulation
     Simulator::Run();
+    if (pcapWriter) {
+        pcapWriter->Close();
+    }
     Simulator::Destroy();
 
     return 0;
@@ -21,24 +21,633 @@
 #include "ns3/network-module.h"
 #include "ns3/point-to-point-module.h"
 
+#include <arpa/inet.h>
+
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("MixedGlobalRoutingExample");
 
+/**
+ * Asynchronous, filterable ASCII trace of point-to-point and CSMA devices.
+ *
+ * Stands in for the helpers' EnableAsciiAll on busy links. Event types ('+' enqueue,
+ * '-' dequeue, 'd' drop, 'r' receive) and nodes that are filtered out are never
+ * connected, so they cost nothing. A kept event copies only the time, the packet size
+ * and the first bytes of the packet (enough for its headers) into a block, and a
+ * formatter thread turns the blocks into text. Lines keep the helpers' layout,
+ * "<event> <time> <context> <headers>", but the headers are decoded from the packet
+ * bytes instead of being printed from packet metadata: Ethernet, ARP, PPP, IPv4, IPv6
+ * and its extension headers, ICMP, ICMPv6, UDP and TCP are shown, the rest as payload.
+ */
+class AsyncAsciiTrace
+{
+  public:
+    /**
+     * \param fileName output file
+     * \param events the event types to keep, e.g. "+-dr" for all of them
+     * \param nodes comma-separated ids of the nodes to keep; all nodes if empty
+     */
+    AsyncAsciiTrace(const std::string& fileName,
+                    const std::string& events,
+                    const std::string& nodes);
+    ~AsyncAsciiTrace();
+
+    /// Trace every point-to-point and CSMA device of the kept nodes.
+    void AttachAll();
+
+    /// Format the pending events, stop the formatter thread and close the file.
+    void Close();
+
+  private:
+    static const uint32_t CAPTURE_BYTES = 128;
+    static const uint32_t BLOCK_BYTES = 1 << 16;
+    static const uint32_t MAX_PENDING_BLOCKS = 64;
+
+    /// What the captured bytes start with
+    enum Framing
+    {
+        PPP,
+        ETHERNET,
+        NETWORK //!< received packets, whose link header has been removed
+    };
+
+    /// One connected trace source
+    struct Source
+    {
+        char event;
+        Framing framing;
+        std::string context; //!< configuration path printed on every line
+    };
+
+    /// Event header in a block, followed by 'captured' packet bytes
+    struct Event
+    {
+        int64_t timeNs;
+        uint32_t source;
+        uint32_t size;
+        uint32_t captured;
+    };
+
+    void Connect(Ptr<Object> object,
+                 const std::string& traceSource,
+                 char event,
+                 Framing framing,
+                 const std::string& context);
+    static void Capture(AsyncAsciiTrace* trace, uint32_t source, Ptr<const Packet> packet);
+    void Flush();
+    void Run();
+    void Format(const Event& event, const uint8_t* bytes);
+    void FormatNetwork(uint16_t etherType, const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatIpv4(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatIpv6(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatArp(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatTransport(uint8_t protocol, const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatPayload(uint32_t size);
+    void FormatMac(const uint8_t* p);
+    void FormatAddress(int family, const uint8_t* p);
+
+    static uint16_t Read16(const uint8_t* p)
+    {
+        return (p[0] << 8) | p[1];
+    }
+
+    static uint32_t Read32(const uint8_t* p)
+    {
+        return (static_cast<uint32_t>(Read16(p)) << 16) | Read16(p + 2);
+    }
+
+    FILE* m_file;
+    std::string m_events;
+    std::set<uint32_t> m_nodes;
+    std::vector<Source> m_sources;
+    std::vector<uint8_t> m_block;             //!< block being filled, simulation thread
+    std::deque<std::vector<uint8_t>> m_queue; //!< blocks waiting for the formatter
+    std::ostringstream m_line;                //!< formatter thread
+    std::thread m_formatter;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_drained;
+    bool m_stop;
+};
+
+AsyncAsciiTrace::AsyncAsciiTrace(const std::string& fileName,
+                                 const std::string& events,
+                                 const std::string& nodes)
+    : m_events(events),
+      m_stop(false)
+{
+    std::istringstream list(nodes);
+    std::string id;
+    while (std::getline(list, id, ','))
+    {
+        m_nodes.insert(std::stoul(id));
+    }
+    m_file = fopen(fileName.c_str(), "w");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open ASCII trace " << fileName);
+    setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+    m_block.reserve(BLOCK_BYTES + sizeof(Event) + CAPTURE_BYTES);
+    m_line << std::setprecision(9);
+    m_formatter = std::thread(&AsyncAsciiTrace::Run, this);
+}
+
+AsyncAsciiTrace::~AsyncAsciiTrace()
+{
+    Close();
+}
+
+void
+AsyncAsciiTrace::AttachAll()
+{
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        if (!m_nodes.empty() && m_nodes.find(i) == m_nodes.end())
+        {
+            continue;
+        }
+        Ptr<Node> node = NodeList::GetNode(i);
+        for (uint32_t j = 0; j < node->GetNDevices(); ++j)
+        {
+            Ptr<NetDevice> device = node->GetDevice(j);
+            Ptr<Object> queue;
+            Framing framing;
+            std::ostringstream context;
+            context << "/NodeList/" << i << "/DeviceList/" << j << "/";
+            if (Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice>(device))
+            {
+                queue = p2p->GetQueue();
+                framing = PPP;
+                context << "$ns3::PointToPointNetDevice/";
+            }
+            else if (Ptr<CsmaNetDevice> csma = DynamicCast<CsmaNetDevice>(device))
+            {
+                queue = csma->GetQueue();
+                framing = ETHERNET;
+                context << "$ns3::CsmaNetDevice/";
+            }
+            else
+            {
+                continue;
+            }
+            Connect(queue, "Enqueue", '+', framing, context.str() + "TxQueue/Enqueue");
+            Connect(queue, "Dequeue", '-', framing, context.str() + "TxQueue/Dequeue");
+            Connect(queue, "Drop", 'd', framing, context.str() + "TxQueue/Drop");
+            Connect(device, "PhyRxDrop", 'd', framing, context.str() + "PhyRxDrop");
+            Connect(device, "MacRx", 'r', NETWORK, context.str() + "MacRx");
+        }
+    }
+}
+
+void
+AsyncAsciiTrace::Connect(Ptr<Object> object,
+                         const std::string& traceSource,
+                         char event,
+                         Framing framing,
+                         const std::string& context)
+{
+    if (m_events.find(event) == std::string::npos)
+    {
+        return;
+    }
+    uint32_t source = m_sources.size();
+    m_sources.push_back(Source{event, framing, context});
+    object->TraceConnectWithoutContext(traceSource,
+                                       MakeBoundCallback(&AsyncAsciiTrace::Capture, this, source));
+}
+
+void
+AsyncAsciiTrace::Capture(AsyncAsciiTrace* trace, uint32_t source, Ptr<const Packet> packet)
+{
+    Event event;
+    event.timeNs = Simulator::Now().GetNanoSeconds();
+    event.source = source;
+    event.size = packet->GetSize();
+    event.captured = event.size < CAPTURE_BYTES ? event.size : CAPTURE_BYTES;
+
+    std::vector<uint8_t>& block = trace->m_block;
+    std::size_t offset = block.size();
+    block.resize(offset + sizeof(Event) + event.captured);
+    memcpy(block.data() + offset, &event, sizeof(Event));
+    packet->CopyData(block.data() + offset + sizeof(Event), event.captured);
+    if (block.size() >= BLOCK_BYTES)
+    {
+        trace->Flush();
+    }
+}
+
+void
+AsyncAsciiTrace::Flush()
+{
+    if (m_block.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A formatter that cannot keep up holds the simulation back instead of using up memory
+    while (m_queue.size() >= MAX_PENDING_BLOCKS)
+    {
+        m_drained.wait(lock);
+    }
+    m_queue.push_back(std::move(m_block));
+    m_block = std::vector<uint8_t>();
+    m_block.reserve(BLOCK_BYTES + sizeof(Event) + CAPTURE_BYTES);
+    m_wakeUp.notify_one();
+}
+
+void
+AsyncAsciiTrace::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        while (!m_stop && m_queue.empty())
+        {
+            m_wakeUp.wait(lock);
+        }
+        if (m_queue.empty())
+        {
+            break;
+        }
+        std::vector<uint8_t> block = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_drained.notify_one();
+        lock.unlock();
+        for (std::size_t offset = 0; offset < block.size();)
+        {
+            Event event;
+            memcpy(&event, block.data() + offset, sizeof(Event));
+            Format(event, block.data() + offset + sizeof(Event));
+            offset += sizeof(Event) + event.captured;
+        }
+        lock.lock();
+    }
+}
+
+void
+AsyncAsciiTrace::Close()
+{
+    if (!m_formatter.joinable())
+    {
+        return;
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_formatter.join();
+    fclose(m_file);
+}
+
+void
+AsyncAsciiTrace::Format(const Event& event, const uint8_t* bytes)
+{
+    const Source& source = m_sources[event.source];
+    m_line.str("");
+    m_line << source.event << " " << event.timeNs / 1e9 << " " << source.context << " ";
+    switch (source.framing)
+    {
+    case PPP:
+        if (event.captured < 2)
+        {
+            FormatPayload(event.size);
+            break;
+        }
+        m_line << "ns3::PppHeader (Point-to-Point Protocol: ";
+        switch (Read16(bytes))
+        {
+        case 0x0021:
+            m_line << "IP (0x0021)) ";
+            FormatNetwork(0x0800, bytes + 2, event.captured - 2, event.size - 2);
+            break;
+        case 0x0057:
+            m_line << "IPv6 (0x0057)) ";
+            FormatNetwork(0x86dd, bytes + 2, event.captured - 2, event.size - 2);
+            break;
+        default:
+            m_line << "UNKNOWN (0x" << std::hex << Read16(bytes) << std::dec << ")) ";
+            FormatPayload(event.size - 2);
+        }
+        break;
+    case ETHERNET: {
+        if (event.captured < 14)
+        {
+            FormatPayload(event.size);
+            break;
+        }
+        uint16_t lengthType = Read16(bytes + 12);
+        m_line << "ns3::EthernetHeader ( length/type=0x" << std::hex << lengthType << std::dec
+               << ", source=";
+        FormatMac(bytes + 6);
+        m_line << ", destination=";
+        FormatMac(bytes);
+        m_line << ") ";
+        if (lengthType <= 1500 && event.captured >= 22)
+        {
+            // LLC/SNAP encapsulation
+            m_line << "ns3::LlcSnapHeader (type 0x" << std::hex << Read16(bytes + 20) << std::dec
+                   << ") ";
+            FormatNetwork(Read16(bytes + 20), bytes + 22, event.captured - 22, lengthType - 8);
+        }
+        else
+        {
+            FormatNetwork(lengthType, bytes + 14, event.captured - 14, event.size - 14);
+        }
+        break;
+    }
+    case NETWORK: {
+        uint16_t etherType = 0;
+        if (event.captured >= 4 && Read16(bytes) == 1 && Read16(bytes + 2) == 0x0800)
+        {
+            etherType = 0x0806;
+        }
+        else if (event.captured >= 1 && bytes[0] >> 4 == 4)
+        {
+            etherType = 0x0800;
+        }
+        else if (event.captured >= 1 && bytes[0] >> 4 == 6)
+        {
+            etherType = 0x86dd;
+        }
+        FormatNetwork(etherType, bytes, event.captured, event.size);
+        break;
+    }
+    }
+    m_line << "\n";
+    const std::string line = m_line.str();
+    fwrite(line.data(), line.size(), 1, m_file);
+}
+
+void
+AsyncAsciiTrace::FormatNetwork(uint16_t etherType,
+                               const uint8_t* p,
+                               uint32_t captured,
+                               uint32_t size)
+{
+    switch (etherType)
+    {
+    case 0x0800:
+        FormatIpv4(p, captured, size);
+        break;
+    case 0x86dd:
+        FormatIpv6(p, captured, size);
+        break;
+    case 0x0806:
+        FormatArp(p, captured, size);
+        break;
+    default:
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatIpv4(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    uint32_t headerLength = (p[0] & 0x0f) * 4;
+    if (captured < 20 || captured < headerLength)
+    {
+        FormatPayload(size);
+        return;
+    }
+    uint16_t totalLength = Read16(p + 2);
+    uint16_t fragment = Read16(p + 6);
+    uint32_t offset = (fragment & 0x1fff) * 8;
+    m_line << "ns3::Ipv4Header (tos 0x" << std::hex << static_cast<uint32_t>(p[1]) << std::dec
+           << " ttl " << static_cast<uint32_t>(p[8]) << " id " << Read16(p + 4) << " protocol "
+           << static_cast<uint32_t>(p[9]) << " offset (bytes) " << offset << " flags [";
+    if (fragment & 0x4000)
+    {
+        m_line << (fragment & 0x2000 ? "DF|MF" : "DF");
+    }
+    else
+    {
+        m_line << (fragment & 0x2000 ? "MF" : "none");
+    }
+    m_line << "] length: " << totalLength << " ";
+    FormatAddress(AF_INET, p + 12);
+    m_line << " > ";
+    FormatAddress(AF_INET, p + 16);
+    m_line << ") ";
+    // The IP length leaves out any Ethernet padding and trailer
+    size = std::min<uint32_t>(size, totalLength) - headerLength;
+    if (offset == 0)
+    {
+        FormatTransport(p[9], p + headerLength, captured - headerLength, size);
+    }
+    else
+    {
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatIpv6(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    if (captured < 40)
+    {
+        FormatPayload(size);
+        return;
+    }
+    uint32_t versionClassFlow = Read32(p);
+    uint16_t payloadLength = Read16(p + 4);
+    uint8_t nextHeader = p[6];
+    m_line << "ns3::Ipv6Header (Version 6 Traffic class: 0x" << std::hex
+           << ((versionClassFlow >> 20) & 0xff) << " Flow Label: 0x" << (versionClassFlow & 0xfffff)
+           << std::dec << " Payload Length: " << payloadLength << " Next Header: "
+           << static_cast<uint32_t>(nextHeader) << " Hop Limit: " << static_cast<uint32_t>(p[7])
+           << " ) ";
+    FormatAddress(AF_INET6, p + 8);
+    m_line << " > ";
+    FormatAddress(AF_INET6, p + 24);
+    m_line << ") ";
+    p += 40;
+    captured -= 40;
+    size = std::min<uint32_t>(size - 40, payloadLength);
+
+    // Extension headers, up to the transport header or a non-first fragment
+    while (true)
+    {
+        if ((nextHeader == 0 || nextHeader == 43 || nextHeader == 60) && captured >= 8)
+        {
+            uint32_t length = (p[1] + 1) * 8;
+            m_line << (nextHeader == 0    ? "ns3::Ipv6ExtensionHopByHopHeader"
+                       : nextHeader == 43 ? "ns3::Ipv6ExtensionRoutingHeader"
+                                          : "ns3::Ipv6ExtensionDestinationHeader")
+                   << " (Next header: " << static_cast<uint32_t>(p[0]) << " length: " << length
+                   << ") ";
+            if (length > captured || length > size)
+            {
+                FormatPayload(size);
+                return;
+            }
+            nextHeader = p[0];
+            p += length;
+            captured -= length;
+            size -= length;
+        }
+        else if (nextHeader == 44 && captured >= 8 && size >= 8)
+        {
+            uint16_t offsetFlags = Read16(p + 2);
+            m_line << "ns3::Ipv6ExtensionFragmentHeader (Next header: "
+                   << static_cast<uint32_t>(p[0]) << " Fragment offset: " << (offsetFlags & 0xfff8)
+                   << " More fragments: " << (offsetFlags & 1) << " Identification: "
+                   << Read32(p + 4) << ") ";
+            nextHeader = p[0];
+            p += 8;
+            captured -= 8;
+            size -= 8;
+            if ((offsetFlags & 0xfff8) != 0)
+            {
+                FormatPayload(size);
+                return;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    FormatTransport(nextHeader, p, captured, size);
+}
+
+void
+AsyncAsciiTrace::FormatArp(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    if (captured < 28 || p[4] != 6 || p[5] != 4)
+    {
+        FormatPayload(size);
+        return;
+    }
+    bool request = Read16(p + 6) == 1;
+    m_line << "ns3::ArpHeader (" << (request ? "request" : "reply") << " source mac: ";
+    FormatMac(p + 8);
+    m_line << " source ipv4: ";
+    FormatAddress(AF_INET, p + 14);
+    if (!request)
+    {
+        m_line << " dest mac: ";
+        FormatMac(p + 18);
+    }
+    m_line << " dest ipv4: ";
+    FormatAddress(AF_INET, p + 24);
+    m_line << ") ";
+    FormatPayload(size - 28);
+}
+
+void
+AsyncAsciiTrace::FormatTransport(uint8_t protocol,
+                                 const uint8_t* p,
+                                 uint32_t captured,
+                                 uint32_t size)
+{
+    if (protocol == 17 && captured >= 8 && size >= 8)
+    {
+        m_line << "ns3::UdpHeader (length: " << Read16(p + 4) << " " << Read16(p) << " > "
+               << Read16(p + 2) << ") ";
+        FormatPayload(size - 8);
+    }
+    else if (protocol == 6 && captured >= 20 && size >= (p[12] >> 4) * 4u)
+    {
+        static const char* names[] = {"FIN", "SYN", "RST", "PSH", "ACK", "URG", "ECE", "CWR"};
+        uint32_t headerLength = (p[12] >> 4) * 4;
+        m_line << "ns3::TcpHeader (" << Read16(p) << " > " << Read16(p + 2);
+        if (p[13] != 0)
+        {
+            m_line << " [";
+            const char* separator = "";
+            for (uint32_t bit = 0; bit < 8; ++bit)
+            {
+                if (p[13] & (1 << bit))
+                {
+                    m_line << separator << names[bit];
+                    separator = "|";
+                }
+            }
+            m_line << "]";
+        }
+        m_line << " Seq=" << Read32(p + 4) << " Ack=" << Read32(p + 8) << " Win=" << Read16(p + 14)
+               << ") ";
+        FormatPayload(size - headerLength);
+    }
+    else if ((protocol == 1 || protocol == 58) && captured >= 4 && size >= 4)
+    {
+        m_line << (protocol == 1 ? "ns3::Icmpv4Header (type=" : "ns3::Icmpv6Header (type=")
+               << static_cast<uint32_t>(p[0]) << ", code=" << static_cast<uint32_t>(p[1]) << ") ";
+        FormatPayload(size - 4);
+    }
+    else
+    {
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatPayload(uint32_t size)
+{
+    if (size > 0)
+    {
+        m_line << "Payload (size=" << size << ")";
+    }
+}
+
+void
+AsyncAsciiTrace::FormatMac(const uint8_t* p)
+{
+    char text[18];
+    snprintf(text,
+             sizeof(text),
+             "%02x:%02x:%02x:%02x:%02x:%02x",
+             p[0],
+             p[1],
+             p[2],
+             p[3],
+             p[4],
+             p[5]);
+    m_line << text;
+}
+
+void
+AsyncAsciiTrace::FormatAddress(int family, const uint8_t* p)
+{
+    char text[INET6_ADDRSTRLEN];
+    m_line << inet_ntop(family, p, text, sizeof(text));
+}
+
 int
 main(int argc, char* argv[])
 {
     Config::SetDefault("ns3::OnOffApplication::PacketSize", UintegerValue(210));
     Config::SetDefault("ns3::OnOffApplication::DataRate", StringValue("448kb/s"));
 
+    bool asyncAscii = false;
+    std::string asciiEvents = "+-dr";
+    std::string asciiNodes;
+
     // Allow the user to override any of the defaults and the above
     // Bind ()s at run-time, via command-line arguments
     CommandLine cmd(__FILE__);
+    cmd.AddValue("asyncAscii", "Format the ASCII trace on a separate thread", asyncAscii);
+    cmd.AddValue("asciiEvents", "Events kept with --asyncAscii: any of + - d r", asciiEvents);
+    cmd.AddValue("asciiNodes",
+                 "Comma-separated ids of the nodes traced with --asyncAscii, all if empty",
+                 asciiNodes);
     cmd.Parse(argc, argv);
 
     NS_LOG_INFO("Create nodes.");
@@ -102,16 +711,30 @@ main(int argc, char* argv[])
     apps.Start(Seconds(1.0));
     apps.Stop(Seconds(10.0));
 
-    AsciiTraceHelper ascii;
-    Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream("mixed-global-routing.tr");
-    p2p.EnableAsciiAll(stream);
-    csma.EnableAsciiAll(stream);
+    std::unique_ptr<AsyncAsciiTrace> asyncAsciiTrace;
+    if (asyncAscii)
+    {
+        asyncAsciiTrace =
+            std::make_unique<AsyncAsciiTrace>("mixed-global-routing.tr", asciiEvents, asciiNodes);
+        asyncAsciiTrace->AttachAll();
+    }
+    else
+    {
+        AsciiTraceHelper ascii;
+        Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream("mixed-global-routing.tr");
+        p2p.EnableAsciiAll(stream);
+        csma.EnableAsciiAll(stream);
+    }
 
     p2p.EnablePcapAll("mixed-global-routing");
     csma.EnablePcapAll("mixed-global-routing", false);
 
     NS_LOG_INFO("Run Simulation.");
     Simulator::Run();
+    if (asyncAsciiTrace)
+    {
+        asyncAsciiTrace->Close();
+    }
     Simulator::Destroy();
     NS_LOG_INFO("Done.");
 
@@ -6,43 +6,760 @@
 #include "ns3/applications-module.h"
 #include "ns3/netanim-module.h"
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("VANETExample");
 
+// Timer wheel driving the periodic sends of all nodes from a single scheduler
+// event per occupied slot, instead of one self-rescheduling event per node.
+// Senders keep their own phase offset: the slot is (first send time mod period).
+class PeriodicSenderWheel
+{
+public:
+    PeriodicSenderWheel(Time period, Time slot)
+        : m_slotTs(slot.GetTimeStep()),
+          m_numSlots(static_cast<uint32_t>(period.GetTimeStep() / slot.GetTimeStep())),
+          m_slots(m_numSlots),
+          m_nextId(0),
+          m_tick(0),
+          m_nextTick(0)
+    {
+    }
+
+    // Register a sender whose first transmission happens after 'delay'; returns
+    // an id that can be passed to Remove().
+    uint32_t Add(Time delay, Callback<void> send)
+    {
+        int64_t tick = (Simulator::Now() + delay).GetTimeStep() / m_slotTs;
+        uint32_t slot = static_cast<uint32_t>(tick % m_numSlots);
+        uint32_t id = m_nextId++;
+        m_slots[slot].push_back(Entry{id, tick, send});
+        m_slotOf[id] = slot;
+        m_occupied.insert(slot);
+        if (!m_event.IsRunning() || tick < m_nextTick)
+        {
+            ScheduleAt(tick);
+        }
+        return id;
+    }
+
+    Time GetPeriod() const
+    {
+        return TimeStep(m_slotTs * m_numSlots);
+    }
+
+    void Remove(uint32_t id)
+    {
+        auto it = m_slotOf.find(id);
+        if (it == m_slotOf.end())
+        {
+            return;
+        }
+        // Entries are only nulled here and compacted on the next visit of the
+        // slot, so Remove() is safe to call from within a send callback.
+        for (Entry &e : m_slots[it->second])
+        {
+            if (e.id == id)
+            {
+                e.send.Nullify();
+            }
+        }
+        m_slotOf.erase(it);
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t id;
+        int64_t firstTick;
+        Callback<void> send;
+    };
+
+    void ScheduleAt(int64_t tick)
+    {
+        Simulator::Cancel(m_event);
+        m_nextTick = tick;
+        m_event = Simulator::Schedule(TimeStep(tick * m_slotTs) - Simulator::Now(),
+                                      &PeriodicSenderWheel::Tick, this);
+    }
+
+    void Tick()
+    {
+        m_tick = m_nextTick;
+        uint32_t slot = static_cast<uint32_t>(m_tick % m_numSlots);
+        std::vector<Entry> &entries = m_slots[slot];
+        for (std::size_t i = 0; i < entries.size(); i++)
+        {
+            if (!entries[i].send.IsNull() && entries[i].firstTick <= m_tick)
+            {
+                entries[i].send();
+            }
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const Entry &e) { return e.send.IsNull(); }),
+                      entries.end());
+        if (entries.empty())
+        {
+            m_occupied.erase(slot);
+        }
+        if (m_occupied.empty())
+        {
+            return;
+        }
+        // Jump straight to the next occupied slot; empty slots cost nothing.
+        auto next = m_occupied.upper_bound(slot);
+        uint32_t delta = (next != m_occupied.end()) ? *next - slot
+                                                    : m_numSlots - slot + *m_occupied.begin();
+        ScheduleAt(m_tick + delta);
+    }
+
+    int64_t m_slotTs;
+    uint32_t m_numSlots;
+    std::vector<std::vector<Entry>> m_slots;
+    std::set<uint32_t> m_occupied;
+    std::map<uint32_t, uint32_t> m_slotOf;
+    uint32_t m_nextId;
+    int64_t m_tick;
+    int64_t m_nextTick;
+    EventId m_event;
+};
+
+// Broadcasts Basic Safety Messages of a configurable size on the beacon period of the
+// shared wheel, backing off when the channel gets crowded, and keeps per-sender PDR and
+// inter-packet-gap statistics for the BSMs it receives. Nothing is formatted or allocated
+// per beacon beyond the packet handle itself: the payload is a shared prototype and the
+// statistics are updated in place.
 class BsmApplication : public Application
 {
 public:
-    BsmApplication() {}
+    // Reception statistics for one neighbour, updated in place on every received BSM
+    struct PeerStats
+    {
+        uint32_t firstSeq;
+        uint32_t lastSeq;
+        uint64_t received;
+        Time lastRx;
+        uint32_t lastWindow;
+        double ipgMean; // seconds, running mean
+        double ipgM2;   // running sum of squared deviations (Welford)
+        Time ipgMax;
+    };
+
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("BsmApplication")
+                                .SetParent<Application>()
+                                .AddConstructor<BsmApplication>()
+                                .AddAttribute("PacketSize",
+                                              "Size of the BSM payload in bytes.",
+                                              UintegerValue(200),
+                                              MakeUintegerAccessor(&BsmApplication::m_packetSize),
+                                              MakeUintegerChecker<uint32_t>(12))
+                                .AddAttribute("Port",
+                                              "UDP port BSMs are broadcast to and received on.",
+                                              UintegerValue(2000),
+                                              MakeUintegerAccessor(&BsmApplication::m_port),
+                                              MakeUintegerChecker<uint16_t>())
+                                .AddAttribute("DensityThreshold",
+                                              "Neighbours heard per second above which the "
+                                              "beacon interval is stretched.",
+                                              UintegerValue(25),
+                                              MakeUintegerAccessor(&BsmApplication::m_densityThreshold),
+                                              MakeUintegerChecker<uint32_t>(1))
+                                .AddAttribute("MaxInterval",
+                                              "Upper bound of the congestion-adapted beacon interval; "
+                                              "zero for five beacon periods.",
+                                              TimeValue(Seconds(0)),
+                                              MakeTimeAccessor(&BsmApplication::m_maxInterval),
+                                              MakeTimeChecker())
+                                .AddTraceSource("Tx",
+                                                "A BSM is broadcast",
+                                                MakeTraceSourceAccessor(&BsmApplication::m_txTrace),
+                                                "ns3::Packet::TracedCallback")
+                                .AddTraceSource("Rx",
+                                                "A BSM is received",
+                                                MakeTraceSourceAccessor(&BsmApplication::m_rxTrace),
+                                                "ns3::Packet::TracedCallback");
+        return tid;
+    }
+
+    BsmApplication()
+        : m_wheel(nullptr),
+          m_wheelId(0),
+          m_seq(0),
+          m_skip(0),
+          m_window(0),
+          m_windowNeighbours(0),
+          m_density(0),
+          m_densityWindow(Seconds(1.0))
+    {
+        m_phase = CreateObject<UniformRandomVariable>();
+    }
+
     virtual ~BsmApplication() {}
 
+    // All vehicles share one wheel so a beacon period costs one event per slot, not per vehicle
+    void SetWheel(PeriodicSenderWheel *wheel)
+    {
+        m_wheel = wheel;
+    }
+
+    // Fix the stream of the random beacon phase; returns the number of streams used
+    int64_t AssignStreams(int64_t stream)
+    {
+        m_phase->SetStream(stream);
+        return 1;
+    }
+
+    const std::unordered_map<uint32_t, PeerStats> &GetPeerStats() const
+    {
+        return m_peers;
+    }
+
+    uint32_t GetSent() const
+    {
+        return m_seq;
+    }
+
+    // Packet delivery ratio over all neighbours: received / sequence numbers spanned
+    double GetPdr() const
+    {
+        uint64_t received = 0;
+        uint64_t expected = 0;
+        for (const auto &peer : m_peers)
+        {
+            received += peer.second.received;
+            expected += peer.second.lastSeq - peer.second.firstSeq + 1;
+        }
+        return expected ? static_cast<double>(received) / expected : 0.0;
+    }
+
+    // Number of distinct neighbours heard during the last complete density window
+    uint32_t GetDensity() const
+    {
+        return m_density;
+    }
+
 protected:
+    virtual void DoDispose()
+    {
+        m_socket = nullptr;
+        m_prototype = nullptr;
+        Application::DoDispose();
+    }
+
     virtual void StartApplication()
     {
-        m_sendEvent = Simulator::Schedule(Seconds(1.0), &BsmApplication::SendBsm, this);
+        if (!m_socket)
+        {
+            m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+            m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_port));
+            m_socket->SetAllowBroadcast(true);
+            m_socket->SetRecvCallback(MakeCallback(&BsmApplication::HandleRead, this));
+        }
+        // The header carries the per-beacon sequence number; the rest of the payload is shared
+        SeqTsHeader header;
+        m_prototype = Create<Packet>(m_packetSize - header.GetSerializedSize());
+        m_windowEnd = Simulator::Now() + m_densityWindow;
+        // A random phase within the period spreads the vehicles over the wheel slots;
+        // vehicles started together would otherwise all beacon in the same instant.
+        Time phase = TimeStep(static_cast<int64_t>(m_phase->GetValue(0, 1) *
+                                                   m_wheel->GetPeriod().GetTimeStep()));
+        m_wheelId = m_wheel->Add(phase, MakeCallback(&BsmApplication::SendBsm, this));
     }
 
     virtual void StopApplication()
     {
-        Simulator::Cancel(m_sendEvent);
+        m_wheel->Remove(m_wheelId);
     }
 
     void SendBsm()
     {
-        NS_LOG_INFO("Sending BSM (Basic Safety Message)");
-        // Here we could add code to actually send a packet, but for now, it's just a log message
-        m_sendEvent = Simulator::Schedule(Seconds(1.0), &BsmApplication::SendBsm, this);
+        RollDensityWindow();
+        if (m_skip > 0)
+        {
+            m_skip--;
+            return;
+        }
+        // Congestion control: stretch the interval in proportion to the neighbour density,
+        // expressed as a number of wheel periods to skip so beacons stay batched.
+        Time period = m_wheel->GetPeriod();
+        Time interval = period;
+        Time maxInterval =
+            m_maxInterval.IsZero() ? TimeStep(period.GetTimeStep() * MAX_INTERVAL_PERIODS)
+                                   : m_maxInterval;
+        if (m_density > m_densityThreshold)
+        {
+            interval = Min(maxInterval,
+                           TimeStep(period.GetTimeStep() * m_density / m_densityThreshold));
+        }
+        m_skip = static_cast<uint32_t>(
+            std::max<int64_t>(1, interval.GetTimeStep() / period.GetTimeStep()) - 1);
+
+        SeqTsHeader header;
+        header.SetSeq(m_seq++);
+        Ptr<Packet> packet = m_prototype->Copy();
+        packet->AddHeader(header);
+        m_socket->SendTo(packet, 0, InetSocketAddress(Ipv4Address::GetBroadcast(), m_port));
+        m_txTrace(packet);
+    }
+
+    void HandleRead(Ptr<Socket> socket)
+    {
+        Ptr<Packet> packet;
+        Address from;
+        while ((packet = socket->RecvFrom(from)))
+        {
+            m_rxTrace(packet);
+            SeqTsHeader header;
+            packet->RemoveHeader(header);
+            uint32_t sender = InetSocketAddress::ConvertFrom(from).GetIpv4().Get();
+            Time now = Simulator::Now();
+
+            auto it = m_peers.find(sender);
+            if (it == m_peers.end())
+            {
+                PeerStats stats = {header.GetSeq(), header.GetSeq(), 0, now, m_window, 0.0, 0.0, Seconds(0)};
+                it = m_peers.emplace(sender, stats).first;
+                m_windowNeighbours++;
+            }
+            else
+            {
+                PeerStats &stats = it->second;
+                double gap = (now - stats.lastRx).GetSeconds();
+                uint64_t n = stats.received; // gaps seen so far, including this one
+                double delta = gap - stats.ipgMean;
+                stats.ipgMean += delta / n;
+                stats.ipgM2 += delta * (gap - stats.ipgMean);
+                stats.ipgMax = Max(stats.ipgMax, now - stats.lastRx);
+                stats.lastSeq = std::max(stats.lastSeq, header.GetSeq());
+                stats.lastRx = now;
+                if (stats.lastWindow != m_window)
+                {
+                    stats.lastWindow = m_window;
+                    m_windowNeighbours++;
+                }
+            }
+            it->second.received++;
+        }
     }
 
 private:
-    EventId m_sendEvent;
+    // Default bound of the adapted interval, in beacon periods
+    static const int64_t MAX_INTERVAL_PERIODS = 5;
+
+    // Close the density window lazily on the send path instead of with its own event
+    void RollDensityWindow()
+    {
+        Time now = Simulator::Now();
+        if (now < m_windowEnd)
+        {
+            return;
+        }
+        m_density = m_windowNeighbours;
+        m_windowNeighbours = 0;
+        m_window++;
+        m_windowEnd = now + m_densityWindow;
+    }
+
+    PeriodicSenderWheel *m_wheel;
+    uint32_t m_wheelId;
+    Ptr<Socket> m_socket;
+    Ptr<Packet> m_prototype;
+    Ptr<UniformRandomVariable> m_phase;
+    uint32_t m_packetSize;
+    uint16_t m_port;
+    uint32_t m_densityThreshold;
+    Time m_maxInterval;
+    uint32_t m_seq;
+    uint32_t m_skip;
+    uint32_t m_window;
+    uint32_t m_windowNeighbours;
+    uint32_t m_density;
+    Time m_densityWindow;
+    Time m_windowEnd;
+    std::unordered_map<uint32_t, PeerStats> m_peers;
+    TracedCallback<Ptr<const Packet>> m_txTrace;
+    TracedCallback<Ptr<const Packet>> m_rxTrace;
+};
+
+/**
+ * Compact binary NetAnim trace, for runs too large for AnimationInterface's XML.
+ *
+ * Records are varint encoded on the simulation thread and handed over in 64 KiB blocks
+ * to a writer thread that does the file I/O. Node positions are polled, but only when
+ * some node can move, and a node only gets a record when it has moved; the record holds
+ * the change since its last written position, in centimetres. Packet events can be
+ * sampled: a packet is kept when a hash of its uid falls below the sampling ratio, so
+ * all events of a kept packet are kept together. Packet metadata is off by default and
+ * can be limited to one in N kept packets. Examples/netanim-binary-to-xml.cc converts
+ * the file to NetAnim XML.
+ *
+ * The file is the magic "NS3ANIM1" followed by records. A record is a type byte, the
+ * time since the previous record in nanoseconds and its fields; integers are LEB128
+ * varints, signed ones zigzag encoded, and strings a length followed by the bytes.
+ *   1 NODE:  node, x, y                        initial position
+ *   2 MOVE:  node, dx, dy                      position change
+ *   3 LINK:  fromNode, toNode                  point-to-point link
+ *   4 WIRED: uid, from, to, txTime, rxTime, meta
+ *            first bit sent now, last bit sent after txTime, last bit received
+ *            after rxTime, first bit received after rxTime - txTime
+ *   5 WTX:   uid, from, meta                   wireless transmission starts now
+ *   6 WRX:   uid, to                           wireless reception ends now
+ */
+class BinaryAnimTrace
+{
+public:
+    /**
+     * \param fileName output file
+     * \param pollInterval interval between two polls of the mobility models
+     */
+    BinaryAnimTrace(const std::string &fileName, Time pollInterval);
+    ~BinaryAnimTrace();
+
+    /// Keep only this fraction of the packets, chosen by uid.
+    void SetPacketSampling(double ratio);
+
+    /// Record the metadata of one in 'every' kept packets; 0 disables metadata.
+    void EnablePacketMetadata(uint32_t every);
+
+    /// Flush the last records, stop the writer thread and close the file.
+    void Close();
+
+private:
+    static const uint32_t BLOCK_BYTES = 1 << 16;
+    static const uint32_t MAX_PENDING_BLOCKS = 64;
+
+    void Start();
+    void Poll();
+    static void WifiTx(BinaryAnimTrace *trace,
+                       uint32_t node,
+                       Ptr<const Packet> packet,
+                       double txPowerW);
+    static void WifiRx(BinaryAnimTrace *trace, uint32_t node, Ptr<const Packet> packet);
+    bool IsSampled(Ptr<const Packet> packet) const;
+    void PutMetadata(Ptr<const Packet> packet);
+    void BeginRecord(uint8_t type);
+    void EndRecord();
+    void PutVarint(uint64_t value);
+    void PutSigned(int64_t value);
+    void Flush();
+    void Run();
+
+    FILE *m_file;
+    Time m_pollInterval;
+    double m_sampleRatio;
+    uint32_t m_metadataEvery;
+    uint32_t m_metadataCount;
+    int64_t m_lastNs;
+    std::vector<int64_t> m_x; //!< last written position per node, cm
+    std::vector<int64_t> m_y;
+    std::vector<uint8_t> m_block;             //!< block being filled, simulation thread
+    std::deque<std::vector<uint8_t>> m_queue; //!< blocks waiting for the writer
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_drained;
+    bool m_stop;
 };
 
+BinaryAnimTrace::BinaryAnimTrace(const std::string &fileName, Time pollInterval)
+    : m_pollInterval(pollInterval),
+      m_sampleRatio(1.0),
+      m_metadataEvery(0),
+      m_metadataCount(0),
+      m_lastNs(0),
+      m_stop(false)
+{
+    m_file = fopen(fileName.c_str(), "wb");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open animation trace " << fileName);
+    fwrite("NS3ANIM1", 8, 1, m_file);
+    m_block.reserve(BLOCK_BYTES + 256);
+    m_writer = std::thread(&BinaryAnimTrace::Run, this);
+    Simulator::Schedule(Seconds(0), &BinaryAnimTrace::Start, this);
+}
+
+BinaryAnimTrace::~BinaryAnimTrace()
+{
+    Close();
+}
+
+void
+BinaryAnimTrace::SetPacketSampling(double ratio)
+{
+    m_sampleRatio = ratio;
+}
+
+void
+BinaryAnimTrace::EnablePacketMetadata(uint32_t every)
+{
+    m_metadataEvery = every;
+    if (every > 0)
+    {
+        Packet::EnablePrinting();
+    }
+}
+
+void
+BinaryAnimTrace::Start()
+{
+    // Initial positions; nodes without a mobility model sit at the origin
+    bool mobile = false;
+    m_x.assign(NodeList::GetNNodes(), 0);
+    m_y.assign(NodeList::GetNNodes(), 0);
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<MobilityModel> mobility = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (mobility)
+        {
+            Vector position = mobility->GetPosition();
+            m_x[i] = std::llround(position.x * 100);
+            m_y[i] = std::llround(position.y * 100);
+            mobile |= !DynamicCast<ConstantPositionMobilityModel>(mobility);
+        }
+        BeginRecord(1);
+        PutVarint(i);
+        PutSigned(m_x[i]);
+        PutSigned(m_y[i]);
+        EndRecord();
+    }
+
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<Node> node = NodeList::GetNode(i);
+        for (uint32_t d = 0; d < node->GetNDevices(); ++d)
+        {
+            Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(node->GetDevice(d));
+            if (!device)
+            {
+                continue;
+            }
+            device->GetPhy()->TraceConnectWithoutContext(
+                "PhyTxBegin", MakeBoundCallback(&BinaryAnimTrace::WifiTx, this, i));
+            device->GetPhy()->TraceConnectWithoutContext(
+                "PhyRxEnd", MakeBoundCallback(&BinaryAnimTrace::WifiRx, this, i));
+        }
+    }
+
+    if (mobile)
+    {
+        Simulator::Schedule(m_pollInterval, &BinaryAnimTrace::Poll, this);
+    }
+}
+
+void
+BinaryAnimTrace::Poll()
+{
+    for (uint32_t i = 0; i < m_x.size(); ++i)
+    {
+        Ptr<MobilityModel> mobility = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!mobility)
+        {
+            continue;
+        }
+        Vector position = mobility->GetPosition();
+        int64_t x = std::llround(position.x * 100);
+        int64_t y = std::llround(position.y * 100);
+        if (x != m_x[i] || y != m_y[i])
+        {
+            BeginRecord(2);
+            PutVarint(i);
+            PutSigned(x - m_x[i]);
+            PutSigned(y - m_y[i]);
+            EndRecord();
+            m_x[i] = x;
+            m_y[i] = y;
+        }
+    }
+    Simulator::Schedule(m_pollInterval, &BinaryAnimTrace::Poll, this);
+}
+
+void
+BinaryAnimTrace::WifiTx(BinaryAnimTrace *trace,
+                        uint32_t node,
+                        Ptr<const Packet> packet,
+                        double txPowerW)
+{
+    if (!trace->IsSampled(packet))
+    {
+        return;
+    }
+    trace->BeginRecord(5);
+    trace->PutVarint(packet->GetUid());
+    trace->PutVarint(node);
+    trace->PutMetadata(packet);
+    trace->EndRecord();
+}
+
+void
+BinaryAnimTrace::WifiRx(BinaryAnimTrace *trace, uint32_t node, Ptr<const Packet> packet)
+{
+    if (!trace->IsSampled(packet))
+    {
+        return;
+    }
+    trace->BeginRecord(6);
+    trace->PutVarint(packet->GetUid());
+    trace->PutVarint(node);
+    trace->EndRecord();
+}
+
+bool
+BinaryAnimTrace::IsSampled(Ptr<const Packet> packet) const
+{
+    // Fibonacci hashing spreads consecutive uids evenly over [0, 1)
+    uint64_t hash = packet->GetUid() * 0x9e3779b97f4a7c15ULL;
+    return (hash >> 11) * (1.0 / 9007199254740992.0) < m_sampleRatio;
+}
+
+void
+BinaryAnimTrace::PutMetadata(Ptr<const Packet> packet)
+{
+    if (m_metadataEvery == 0 || m_metadataCount++ % m_metadataEvery != 0)
+    {
+        PutVarint(0);
+        return;
+    }
+    std::ostringstream oss;
+    packet->Print(oss);
+    std::string meta = oss.str();
+    PutVarint(meta.size());
+    m_block.insert(m_block.end(), meta.begin(), meta.end());
+}
+
+void
+BinaryAnimTrace::BeginRecord(uint8_t type)
+{
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    m_block.push_back(type);
+    PutVarint(now - m_lastNs);
+    m_lastNs = now;
+}
+
+void
+BinaryAnimTrace::EndRecord()
+{
+    if (m_block.size() >= BLOCK_BYTES)
+    {
+        Flush();
+    }
+}
+
+void
+BinaryAnimTrace::PutVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        m_block.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    m_block.push_back(static_cast<uint8_t>(value));
+}
+
+void
+BinaryAnimTrace::PutSigned(int64_t value)
+{
+    PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void
+BinaryAnimTrace::Flush()
+{
+    if (m_block.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A slow disk holds the simulation back rather than letting the queue grow unbounded
+    while (m_queue.size() >= MAX_PENDING_BLOCKS)
+    {
+        m_drained.wait(lock);
+    }
+    m_queue.push_back(std::move(m_block));
+    m_block = std::vector<uint8_t>();
+    m_block.reserve(BLOCK_BYTES + 256);
+    m_wakeUp.notify_one();
+}
+
+void
+BinaryAnimTrace::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        while (!m_stop && m_queue.empty())
+        {
+            m_wakeUp.wait(lock);
+        }
+        if (m_queue.empty())
+        {
+            break;
+        }
+        std::vector<uint8_t> block = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_drained.notify_one();
+        lock.unlock();
+        fwrite(block.data(), block.size(), 1, m_file);
+        lock.lock();
+    }
+}
+
+void
+BinaryAnimTrace::Close()
+{
+    if (!m_writer.joinable())
+    {
+        return;
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_writer.join();
+    fclose(m_file);
+}
+
 int main(int argc, char *argv[])
 {
+    uint32_t numVehicles = 5;
+    uint32_t bsmSize = 200;
+    double bsmInterval = 1.0;
+    bool binaryAnim = false;
+    double animSampling = 1.0;
+    uint32_t animMetadata = 0;
+
+    CommandLine cmd;
+    cmd.AddValue("numVehicles", "Number of vehicles on the road", numVehicles);
+    cmd.AddValue("bsmSize", "BSM payload size in bytes", bsmSize);
+    cmd.AddValue("bsmInterval", "Base BSM interval in seconds (0.1 for 10 Hz)", bsmInterval);
+    cmd.AddValue("binaryAnim", "Write a binary animation trace instead of NetAnim XML", binaryAnim);
+    cmd.AddValue("animSampling", "Fraction of packets kept in the binary trace", animSampling);
+    cmd.AddValue("animMetadata", "Binary trace: metadata of one in N kept packets, 0 for none", animMetadata);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(numVehicles < 1 || numVehicles > 65534, "numVehicles must be in [1, 65534]");
+    // The wheel has one 1 ms slot per millisecond of the beacon period
+    NS_ABORT_MSG_IF(bsmInterval < 0.001, "bsmInterval must be at least 0.001 s");
+
     // Create nodes for the vehicles
     NodeContainer vehicleNodes;
-    vehicleNodes.Create(5); // 5 vehicles
+    vehicleNodes.Create(numVehicles);
 
     // Set up the mobility model for vehicle movement
     MobilityHelper mobility;
@@ -53,7 +770,7 @@ int main(int argc, char *argv[])
                                   "MinX", DoubleValue(0.0),
                                   "MinY", DoubleValue(0.0),
                                   "DeltaX", DoubleValue(50.0),
-                                  "GridWidth", UintegerValue(5),
+                                  "GridWidth", UintegerValue(numVehicles),
                                   "LayoutType", StringValue("RowFirst"));
     mobility.Install(vehicleNodes);
 
@@ -79,31 +796,78 @@ int main(int argc, char *argv[])
     InternetStackHelper internet;
     internet.Install(vehicleNodes);
 
-    // Assign IP addresses
+    // Assign IP addresses; a /24 holds 254 vehicles, larger fleets get a /16
     Ipv4AddressHelper ipv4;
-    ipv4.SetBase("10.1.1.0", "255.255.255.0");
+    if (numVehicles < 255)
+    {
+        ipv4.SetBase("10.1.1.0", "255.255.255.0");
+    }
+    else
+    {
+        ipv4.SetBase("10.1.0.0", "255.255.0.0");
+    }
     Ipv4InterfaceContainer vehicleInterfaces = ipv4.Assign(vehicleDevices);
 
     // Install BSM application on vehicles
+    PeriodicSenderWheel bsmWheel(Seconds(bsmInterval), MilliSeconds(1));
+    std::vector<Ptr<BsmApplication>> bsmApps;
+    int64_t stream = 1000;
     for (uint32_t i = 0; i < vehicleNodes.GetN(); ++i)
     {
         Ptr<BsmApplication> app = CreateObject<BsmApplication>();
+        app->SetAttribute("PacketSize", UintegerValue(bsmSize));
+        app->SetWheel(&bsmWheel);
+        stream += app->AssignStreams(stream);
+        bsmApps.push_back(app);
         vehicleNodes.Get(i)->AddApplication(app);
         app->SetStartTime(Seconds(1.0));
         app->SetStopTime(Seconds(10.0));
     }
 
-    // Enable NetAnim tracing
-    AnimationInterface anim("vanet_netanim.xml");
-    anim.SetConstantPosition(vehicleNodes.Get(0), 0.0, 0.0);
-    anim.SetConstantPosition(vehicleNodes.Get(1), 50.0, 0.0);
-    anim.SetConstantPosition(vehicleNodes.Get(2), 100.0, 0.0);
-    anim.SetConstantPosition(vehicleNodes.Get(3), 150.0, 0.0);
-    anim.SetConstantPosition(vehicleNodes.Get(4), 200.0, 0.0);
+    // Enable NetAnim tracing, or the binary trace for long or dense runs
+    std::unique_ptr<AnimationInterface> anim;
+    std::unique_ptr<BinaryAnimTrace> binaryAnimTrace;
+    if (binaryAnim)
+    {
+        binaryAnimTrace = std::make_unique<BinaryAnimTrace>("vanet_netanim.bin", MilliSeconds(250));
+        binaryAnimTrace->SetPacketSampling(animSampling);
+        binaryAnimTrace->EnablePacketMetadata(animMetadata);
+    }
+    else
+    {
+        anim = std::make_unique<AnimationInterface>("vanet_netanim.xml");
+    }
+    for (uint32_t i = 0; i < vehicleNodes.GetN(); ++i)
+    {
+        AnimationInterface::SetConstantPosition(vehicleNodes.Get(i), 50.0 * i, 0.0);
+    }
 
     // Run the simulation
     Simulator::Stop(Seconds(10.0));
     Simulator::Run();
+
+    // Per-vehicle BSM reception summary
+    for (uint32_t i = 0; i < bsmApps.size(); ++i)
+    {
+        double ipgMean = 0.0;
+        double ipgStdDev = 0.0;
+        Time ipgMax = Seconds(0);
+        for (const auto &peer : bsmApps[i]->GetPeerStats())
+        {
+            // A peer heard n times yields n - 1 gaps
+            uint64_t gaps = peer.second.received - 1;
+            double stdDev = gaps > 0 ? std::sqrt(peer.second.ipgM2 / gaps) : 0.0;
+            ipgMean += peer.second.ipgMean / bsmApps[i]->GetPeerStats().size();
+            ipgStdDev += stdDev / bsmApps[i]->GetPeerStats().size();
+            ipgMax = Max(ipgMax, peer.second.ipgMax);
+        }
+        std::cout << "Vehicle " << i << ": sent " << bsmApps[i]->GetSent()
+                  << " BSMs, heard " << bsmApps[i]->GetPeerStats().size() << " neighbours ("
+                  << bsmApps[i]->GetDensity() << " in the last second), PDR "
+                  << bsmApps[i]->GetPdr() << ", mean IPG " << ipgMean << " s, IPG std dev "
+                  << ipgStdDev << " s, max IPG " << ipgMax.GetSeconds() << " s" << std::endl;
+    }
+
     Simulator::Destroy();
 
     return 0;
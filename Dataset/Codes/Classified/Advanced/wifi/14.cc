@@ -15,6 +15,10 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 // This is an example that illustrates 802.11 QoS for different Access Categories.
 // It defines 4 independent Wi-Fi networks (working on different logical channels
 // on the same "ns3::YansWifiPhy" channel object).
@@ -48,7 +52,87 @@ using namespace ns3;
 NS_LOG_COMPONENT_DEFINE("80211eTxop");
 
 /**
- * Keeps the maximum duration among all TXOPs
+ * Fixed-memory histogram with log-linear buckets: values below 8 get one bucket
+ * each, and every power of two above that is split into 8 equal buckets, so any
+ * recorded value is known to within 12.5%. Values of 2^41 and more share the top
+ * bucket. Recording a value is a shift and an increment; no memory is allocated.
+ */
+class LogLinearHistogram
+{
+  public:
+    /// Record one sample.
+    void Add(uint64_t value)
+    {
+        m_counts[Index(value)]++;
+        m_count++;
+        m_max = std::max(m_max, value);
+    }
+
+    /// \return the number of recorded samples
+    uint64_t GetCount() const
+    {
+        return m_count;
+    }
+
+    /// \return the largest recorded sample, 0 if none
+    uint64_t GetMax() const
+    {
+        return m_max;
+    }
+
+    /// \return the upper bound of the bucket holding the q-quantile (0 < q <= 1)
+    uint64_t GetQuantile(double q) const
+    {
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * m_count));
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank && seen > 0)
+            {
+                return i + 1 < NUM_BUCKETS ? std::min(m_max, Lower(i + 1) - 1) : m_max;
+            }
+        }
+        return 0;
+    }
+
+  private:
+    static constexpr uint32_t SUB_BITS = 3;
+    static constexpr uint32_t SUB = 1 << SUB_BITS;
+    static constexpr uint32_t MAX_EXP = 40;
+    static constexpr uint32_t NUM_BUCKETS = SUB + (MAX_EXP - SUB_BITS + 1) * SUB;
+
+    static uint32_t Index(uint64_t value)
+    {
+        if (value < SUB)
+        {
+            return value;
+        }
+        uint32_t exp = 63 - __builtin_clzll(value);
+        if (exp > MAX_EXP)
+        {
+            return NUM_BUCKETS - 1;
+        }
+        return SUB + (exp - SUB_BITS) * SUB + ((value >> (exp - SUB_BITS)) & (SUB - 1));
+    }
+
+    static uint64_t Lower(uint32_t index)
+    {
+        if (index < SUB)
+        {
+            return index;
+        }
+        uint32_t exp = (index - SUB) / SUB + SUB_BITS;
+        return (uint64_t{1} << exp) + (uint64_t{(index - SUB) % SUB} << (exp - SUB_BITS));
+    }
+
+    std::array<uint32_t, NUM_BUCKETS> m_counts{};
+    uint64_t m_count{0};
+    uint64_t m_max{0};
+};
+
+/**
+ * Keeps the maximum duration among all TXOPs and the distribution of their durations
  */
 struct TxopDurationTracer
 {
@@ -60,7 +144,14 @@ struct TxopDurationTracer
      * \param linkId the ID of the link
      */
     void Trace(Time startTime, Time duration, uint8_t linkId);
-    Time m_max{Seconds(0)}; //!< maximum TXOP duration
+    /**
+     * Print the number of TXOPs and the median and 99th percentile of their durations.
+     *
+     * \param os the output stream
+     */
+    void PrintPercentiles(std::ostream& os) const;
+    Time m_max{Seconds(0)};          //!< maximum TXOP duration
+    LogLinearHistogram m_durationsUs; //!< TXOP durations in microseconds
 };
 
 void
@@ -70,6 +161,15 @@ TxopDurationTracer::Trace(Time startTime, Time duration, uint8_t linkId)
     {
         m_max = duration;
     }
+    m_durationsUs.Add(duration.GetMicroSeconds());
+}
+
+void
+TxopDurationTracer::PrintPercentiles(std::ostream& os) const
+{
+    os << "  TXOP duration p50/p99 = " << m_durationsUs.GetQuantile(0.5) << "/"
+       << m_durationsUs.GetQuantile(0.99) << " us over " << m_durationsUs.GetCount() << " TXOPs"
+       << '\n';
 }
 
 int
@@ -388,6 +488,7 @@ main(int argc, char* argv[])
     }
     std::cout << "  Maximum TXOP duration = " << beTxopTracer.m_max.GetMicroSeconds() << " us"
               << '\n';
+    beTxopTracer.PrintPercentiles(std::cout);
     if (verifyResults &&
         (beTxopTracer.m_max < MicroSeconds(3008) || beTxopTracer.m_max > txopLimit))
     {
@@ -406,6 +507,7 @@ main(int argc, char* argv[])
     }
     std::cout << "  Maximum TXOP duration = " << viTxopTracer.m_max.GetMicroSeconds() << " us"
               << '\n';
+    viTxopTracer.PrintPercentiles(std::cout);
     if (verifyResults &&
         (viTxopTracer.m_max < MicroSeconds(3008) || viTxopTracer.m_max > txopLimit))
     {
@@ -21,35 +21,441 @@
  *    - the recipient receives a block ack request or a MPDU with ack policy Block Ack.
  */
 
+#include "ns3/abort.h"
+#include "ns3/block-ack-manager.h"
 #include "ns3/boolean.h"
 #include "ns3/command-line.h"
 #include "ns3/double.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-address.h"
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/log.h"
+#include "ns3/mac48-address.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/mobility-model.h"
+#include "ns3/nstime.h"
 #include "ns3/on-off-helper.h"
+#include "ns3/originator-block-ack-agreement.h"
+#include "ns3/pointer.h"
+#include "ns3/qos-txop.h"
 #include "ns3/rectangle.h"
+#include "ns3/simulator.h"
 #include "ns3/ssid.h"
 #include "ns3/string.h"
 #include "ns3/uinteger.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("Test-block-ack");
 
+#ifndef BINARY_LOG_COMPILED_LEVELS
+/// Levels of the BINARY_LOG statements kept by the compiler, e.g. LOG_LEVEL_WARN
+#define BINARY_LOG_COMPILED_LEVELS LOG_LEVEL_ALL
+#endif
+
+/**
+ * Log a message with up to four arguments; "{}" in the format marks where each goes.
+ * Statements whose level is not in BINARY_LOG_COMPILED_LEVELS are removed by the
+ * compiler, the others cost one test while their level is disabled.
+ */
+#define BINARY_LOG(level, format, ...)                                                        \
+    do                                                                                        \
+    {                                                                                         \
+        if ((BINARY_LOG_COMPILED_LEVELS & (level)) != 0 && BinaryLog::IsEnabled(level))       \
+        {                                                                                     \
+            static const uint16_t binaryLogFormatId = BinaryLog::Register(level, format);     \
+            BinaryLog::Write(binaryLogFormatId, ##__VA_ARGS__);                               \
+        }                                                                                     \
+    } while (false)
+
+/**
+ * Log sink that defers all formatting.
+ *
+ * A BINARY_LOG statement stores its format id, the simulation time and its raw
+ * arguments in a fixed-size slot of the calling thread's ring buffer. By default a
+ * ring keeps the newest records, like a flight recorder; with spilling, a full ring
+ * is appended to the file instead and nothing is lost. Close() writes what the rings
+ * hold, then the format strings, and Examples/binary-log-decode.cc turns the file
+ * back into text. In text mode statements are formatted and printed right away, as
+ * NS_LOG does.
+ *
+ * File layout: the magic "NS3BLOG1"; blocks of a uint32 thread index, a uint32 record
+ * count and that many Record structs; the format table as a uint32 count and, per
+ * format, a uint32 level and a uint32 length followed by the characters; and last the
+ * uint64 file offset of the format table. Integers are in host byte order.
+ */
+class BinaryLog
+{
+  public:
+    static const uint32_t MAX_ARGS = 4;
+
+    /**
+     * Record to a file from now on.
+     * \param fileName output file
+     * \param levels levels to record, e.g. LOG_LEVEL_INFO
+     * \param ringRecords number of records each thread's ring holds
+     * \param spill append full rings to the file instead of overwriting their oldest records
+     */
+    static void Open(const std::string& fileName,
+                     uint32_t levels,
+                     uint32_t ringRecords,
+                     bool spill);
+
+    /// Print the statements of these levels as text right away instead.
+    static void EnableText(uint32_t levels);
+
+    /// Write the records left in the rings and the format table, then close the file.
+    static void Close();
+
+    static bool IsEnabled(uint32_t level)
+    {
+        return (GetState().levels & level) != 0;
+    }
+
+    /// \return the id of a new format; called once per BINARY_LOG statement
+    static uint16_t Register(uint32_t level, const char* format);
+
+    template <typename... Args>
+    static void Write(uint16_t formatId, Args... args)
+    {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "BINARY_LOG takes at most four arguments");
+        Record record;
+        record.timeNs = Simulator::Now().GetNanoSeconds();
+        record.formatId = formatId;
+        record.numArgs = sizeof...(Args);
+        uint32_t i = 0;
+        int expand[] = {0, (Encode(record, i++, args), 0)...};
+        (void)expand;
+        if (GetState().text)
+        {
+            std::clog << Format(record) << std::endl;
+            return;
+        }
+        Ring& ring = GetRing();
+        ring.records[ring.written++ % ring.records.size()] = record;
+        if (GetState().spill && ring.written % ring.records.size() == 0)
+        {
+            WriteBlock(ring.thread, ring.records.data(), ring.records.size());
+        }
+    }
+
+  private:
+    struct Record
+    {
+        int64_t timeNs;
+        uint16_t formatId;
+        uint8_t numArgs;
+        char tags[MAX_ARGS]; //!< 'u', 'i', 'f', 't' (ns), 'a' (IPv4) or 'm' (MAC) per argument
+        uint64_t args[MAX_ARGS];
+    };
+
+    struct Ring
+    {
+        uint32_t thread;
+        std::vector<Record> records;
+        uint64_t written; //!< records ever written
+    };
+
+    struct State
+    {
+        uint32_t levels = 0;
+        bool text = false;
+        bool spill = false;
+        uint32_t ringRecords = 0;
+        FILE* file = nullptr;
+        std::mutex mutex; //!< guards the format table, the ring list and the file
+        std::vector<std::pair<uint32_t, std::string>> formats;
+        std::vector<std::unique_ptr<Ring>> rings;
+    };
+
+    static State& GetState()
+    {
+        static State state;
+        return state;
+    }
+
+    static Ring& GetRing()
+    {
+        thread_local Ring* ring = nullptr;
+        if (!ring)
+        {
+            State& state = GetState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.rings.push_back(std::make_unique<Ring>());
+            ring = state.rings.back().get();
+            ring->thread = state.rings.size() - 1;
+            ring->records.resize(state.ringRecords);
+            ring->written = 0;
+        }
+        return *ring;
+    }
+
+    static void Encode(Record& record, uint32_t i, uint64_t value)
+    {
+        record.tags[i] = 'u';
+        record.args[i] = value;
+    }
+
+    static void Encode(Record& record, uint32_t i, uint32_t value)
+    {
+        Encode(record, i, static_cast<uint64_t>(value));
+    }
+
+    static void Encode(Record& record, uint32_t i, int64_t value)
+    {
+        record.tags[i] = 'i';
+        record.args[i] = static_cast<uint64_t>(value);
+    }
+
+    static void Encode(Record& record, uint32_t i, int32_t value)
+    {
+        Encode(record, i, static_cast<int64_t>(value));
+    }
+
+    static void Encode(Record& record, uint32_t i, double value)
+    {
+        record.tags[i] = 'f';
+        memcpy(&record.args[i], &value, sizeof(value));
+    }
+
+    static void Encode(Record& record, uint32_t i, Time value)
+    {
+        record.tags[i] = 't';
+        record.args[i] = static_cast<uint64_t>(value.GetNanoSeconds());
+    }
+
+    static void Encode(Record& record, uint32_t i, Ipv4Address value)
+    {
+        record.tags[i] = 'a';
+        record.args[i] = value.Get();
+    }
+
+    static void Encode(Record& record, uint32_t i, Mac48Address value)
+    {
+        uint8_t bytes[6];
+        value.CopyTo(bytes);
+        record.tags[i] = 'm';
+        record.args[i] = 0;
+        for (uint32_t b = 0; b < 6; ++b)
+        {
+            record.args[i] = (record.args[i] << 8) | bytes[b];
+        }
+    }
+
+    static std::string Format(const Record& record);
+    static void WriteBlock(uint32_t thread, const Record* records, uint32_t count);
+};
+
+void
+BinaryLog::Open(const std::string& fileName, uint32_t levels, uint32_t ringRecords, bool spill)
+{
+    State& state = GetState();
+    NS_ABORT_MSG_IF(ringRecords == 0, "The binary log rings need at least one record");
+    state.file = fopen(fileName.c_str(), "wb");
+    NS_ABORT_MSG_IF(!state.file, "Cannot open binary log " << fileName);
+    fwrite("NS3BLOG1", 8, 1, state.file);
+    state.ringRecords = ringRecords;
+    state.spill = spill;
+    state.text = false;
+    state.levels = levels;
+}
+
+void
+BinaryLog::EnableText(uint32_t levels)
+{
+    GetState().text = true;
+    GetState().levels = levels;
+}
+
+uint16_t
+BinaryLog::Register(uint32_t level, const char* format)
+{
+    State& state = GetState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    NS_ABORT_MSG_IF(state.formats.size() > 0xffff, "Too many binary log formats");
+    state.formats.emplace_back(level, format);
+    return state.formats.size() - 1;
+}
+
+std::string
+BinaryLog::Format(const Record& record)
+{
+    std::string format;
+    {
+        std::lock_guard<std::mutex> lock(GetState().mutex);
+        format = GetState().formats[record.formatId].second;
+    }
+    std::ostringstream oss;
+    uint32_t arg = 0;
+    for (std::size_t pos = 0; pos < format.size(); ++pos)
+    {
+        if (format.compare(pos, 2, "{}") != 0 || arg == record.numArgs)
+        {
+            oss << format[pos];
+            continue;
+        }
+        uint64_t value = record.args[arg];
+        switch (record.tags[arg++])
+        {
+        case 'u':
+            oss << value;
+            break;
+        case 'i':
+            oss << static_cast<int64_t>(value);
+            break;
+        case 'f': {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            oss << d;
+            break;
+        }
+        case 't':
+            oss << static_cast<int64_t>(value) << "ns";
+            break;
+        case 'a':
+            oss << Ipv4Address(static_cast<uint32_t>(value));
+            break;
+        case 'm':
+            for (int shift = 40; shift >= 0; shift -= 8)
+            {
+                oss << std::hex << std::setw(2) << std::setfill('0') << ((value >> shift) & 0xff)
+                    << std::dec << (shift > 0 ? ":" : "");
+            }
+            break;
+        }
+        pos++;
+    }
+    return oss.str();
+}
+
+void
+BinaryLog::WriteBlock(uint32_t thread, const Record* records, uint32_t count)
+{
+    State& state = GetState();
+    if (count == 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(state.mutex);
+    uint32_t header[2] = {thread, count};
+    fwrite(header, sizeof(header), 1, state.file);
+    fwrite(records, sizeof(Record), count, state.file);
+}
+
+void
+BinaryLog::Close()
+{
+    State& state = GetState();
+    if (!state.file)
+    {
+        return;
+    }
+    state.levels = 0;
+    for (const auto& ring : state.rings)
+    {
+        uint64_t size = ring->records.size();
+        uint64_t next = ring->written % size;
+        if (!state.spill && ring->written >= size)
+        {
+            // Full: the oldest record kept is the one to be overwritten next
+            WriteBlock(ring->thread, ring->records.data() + next, size - next);
+        }
+        WriteBlock(ring->thread, ring->records.data(), next);
+    }
+    uint64_t formatsOffset = ftell(state.file);
+    uint32_t numFormats = state.formats.size();
+    fwrite(&numFormats, sizeof(numFormats), 1, state.file);
+    for (const auto& format : state.formats)
+    {
+        uint32_t header[2] = {format.first, static_cast<uint32_t>(format.second.size())};
+        fwrite(header, sizeof(header), 1, state.file);
+        fwrite(format.second.data(), format.second.size(), 1, state.file);
+    }
+    fwrite(&formatsOffset, sizeof(formatsOffset), 1, state.file);
+    fclose(state.file);
+    state.file = nullptr;
+}
+
+/**
+ * TXOP trace sink for --binaryLog, standing in for the QosTxop debug log.
+ *
+ * \param startTime TXOP start time
+ * \param duration TXOP duration
+ * \param linkId the ID of the link
+ */
+static void
+LogTxop(Time startTime, Time duration, uint8_t linkId)
+{
+    BINARY_LOG(LOG_DEBUG, "TXOP of {} started at {} on link {}", duration, startTime, linkId);
+}
+
+/**
+ * Agreement state trace sink for --binaryLog, standing in for the BlockAckManager log.
+ *
+ * \param now the time of the change
+ * \param recipient the recipient of the agreement
+ * \param tid the TID of the agreement
+ * \param state the new state of the agreement
+ */
+static void
+LogAgreementState(Time now,
+                  const Mac48Address& recipient,
+                  uint8_t tid,
+                  OriginatorBlockAckAgreement::State state)
+{
+    BINARY_LOG(LOG_INFO,
+               "Block ack agreement with {} for TID {} now in state {}",
+               recipient,
+               tid,
+               state);
+}
+
 int
 main(int argc, char* argv[])
 {
+    std::string binaryLog;
+    uint32_t binaryLogRecords = 65536;
+    bool binaryLogSpill = false;
+
     CommandLine cmd(__FILE__);
+    cmd.AddValue("binaryLog",
+                 "Record TXOPs and block ack agreement changes in this binary log instead of "
+                 "enabling the QosTxop and BlockAckManager text logs",
+                 binaryLog);
+    cmd.AddValue("binaryLogRecords", "Binary log records kept per thread", binaryLogRecords);
+    cmd.AddValue("binaryLogSpill",
+                 "Write full binary log rings to the file instead of overwriting them",
+                 binaryLogSpill);
     cmd.Parse(argc, argv);
 
-    LogComponentEnable("QosTxop", LOG_LEVEL_DEBUG);
-    LogComponentEnable("BlockAckManager", LOG_LEVEL_INFO);
+    if (binaryLog.empty())
+    {
+        LogComponentEnable("QosTxop", LOG_LEVEL_DEBUG);
+        LogComponentEnable("BlockAckManager", LOG_LEVEL_INFO);
+    }
+    else
+    {
+        // The levels of the text path: TXOPs are logged at DEBUG, agreements at INFO
+        BinaryLog::Open(binaryLog,
+                        LOG_LEVEL_DEBUG | LOG_LEVEL_INFO,
+                        binaryLogRecords,
+                        binaryLogSpill);
+    }
 
     Ptr<Node> sta = CreateObject<Node>();
     Ptr<Node> ap = CreateObject<Node>();
@@ -91,6 +497,20 @@ main(int argc, char* argv[])
                 UintegerValue(0));
     NetDeviceContainer apDevice = wifi.Install(phy, mac, ap);
 
+    if (!binaryLog.empty())
+    {
+        NetDeviceContainer devices(staDevice, apDevice);
+        for (uint32_t i = 0; i < devices.GetN(); ++i)
+        {
+            PointerValue ptr;
+            DynamicCast<WifiNetDevice>(devices.Get(i))->GetMac()->GetAttribute("BE_Txop", ptr);
+            Ptr<QosTxop> edca = ptr.Get<QosTxop>();
+            edca->TraceConnectWithoutContext("TxopTrace", MakeCallback(&LogTxop));
+            edca->GetBaManager()->TraceConnectWithoutContext("AgreementState",
+                                                             MakeCallback(&LogAgreementState));
+        }
+    }
+
     /* Setting mobility model */
     MobilityHelper mobility;
 
@@ -151,6 +571,7 @@ main(int argc, char* argv[])
 
     phy.EnablePcap("test-blockack", ap->GetId(), 0);
     Simulator::Run();
+    BinaryLog::Close();
     Simulator::Destroy();
 
     return 0;
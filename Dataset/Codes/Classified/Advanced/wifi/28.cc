@@ -1,3 +1,5 @@
+#include "ns3/abort.h"
+#include "ns3/callback.h"
 #include "ns3/command-line.h"
 #include "ns3/config.h"
 #include "ns3/ht-configuration.h"
@@ -10,15 +12,25 @@
 #include "ns3/packet-sink.h"
 #include "ns3/pointer.h"
 #include "ns3/qos-txop.h"
+#include "ns3/simulator.h"
 #include "ns3/ssid.h"
 #include "ns3/string.h"
 #include "ns3/udp-client-server-helper.h"
 #include "ns3/udp-server.h"
 #include "ns3/wifi-mac.h"
 #include "ns3/wifi-net-device.h"
+#include "ns3/wifi-remote-station-manager.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
 // This example shows how to configure mixed networks (i.e. mixed b/g and HT/non-HT) and how are
 // performance in several scenarios.
 //
@@ -40,6 +52,13 @@
 //
 // The user can also select the payload size and can choose either an UDP or a TCP connection.
 // Example: ./ns3 run "wifi-mixed-network --isUdp=1"
+//
+// With --forkVariants, the mixed b/g runs that only differ in their ERP protection settings
+// share their warm-up: the network is built and simulated once up to the start of the traffic,
+// and one worker process per protection variant is forked from there (see ForkAfterWarmUp).
+// The AP announces the new protection settings in its next beacon, so the first ~100 ms of
+// traffic may still use the warm-up settings and throughputs can differ slightly from
+// sequential runs.
 
 using namespace ns3;
 
@@ -65,6 +84,76 @@ struct Parameters
     Time simulationTime;           //!< Simulation time
 };
 
+/**
+ * Fork-after-warm-up snapshot for parameter studies.
+ *
+ * The simulation is run once up to \p warmUp. The process is then forked once per
+ * variant: each worker applies its variant's attribute overrides at that simulated
+ * instant, runs until \p stop and sends \p measure back to the parent through a pipe.
+ * At most \p maxWorkers workers run at a time. The parent never simulates past the
+ * warm-up and returns the measured values in variant order.
+ *
+ * \param warmUp simulated time shared by all variants
+ * \param stop simulated time at which every worker stops
+ * \param variants one callback per variant, applying its overrides
+ * \param measure callback returning the value measured by a worker
+ * \param maxWorkers maximum number of concurrent worker processes
+ * \return the value measured by each variant
+ */
+static std::vector<double>
+ForkAfterWarmUp(Time warmUp,
+                Time stop,
+                const std::vector<Callback<void>>& variants,
+                Callback<double> measure,
+                uint32_t maxWorkers)
+{
+    Simulator::Stop(warmUp);
+    Simulator::Run();
+    std::cout.flush(); // otherwise every worker would print what is still buffered
+
+    std::vector<int> readFds(variants.size());
+    uint32_t running = 0;
+    for (std::size_t i = 0; i < variants.size(); ++i)
+    {
+        if (running > 0 && running >= maxWorkers)
+        {
+            NS_ABORT_MSG_IF(wait(nullptr) < 0, "Lost track of a worker");
+            running--;
+        }
+        int fds[2];
+        NS_ABORT_MSG_IF(pipe(fds) != 0, "Cannot create a pipe to the worker");
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "Cannot fork a worker");
+        if (pid == 0)
+        {
+            close(fds[0]);
+            variants[i]();
+            Simulator::Stop(stop - Simulator::Now());
+            Simulator::Run();
+            double result = measure();
+            std::cout.flush();
+            bool sent = write(fds[1], &result, sizeof(result)) == sizeof(result);
+            _exit(sent ? 0 : 1);
+        }
+        close(fds[1]);
+        readFds[i] = fds[0];
+        running++;
+    }
+    for (; running > 0; running--)
+    {
+        wait(nullptr);
+    }
+
+    std::vector<double> results(variants.size());
+    for (std::size_t i = 0; i < variants.size(); ++i)
+    {
+        bool received = read(readFds[i], &results[i], sizeof(double)) == sizeof(double);
+        NS_ABORT_MSG_IF(!received, "Worker for variant " << i << " failed");
+        close(readFds[i]);
+    }
+    return results;
+}
+
 class Experiment
 {
   public:
@@ -75,6 +164,42 @@ class Experiment
      * \return the throughput
      */
     double Run(Parameters params);
+    /**
+     * Run variants of an experiment that only differ in their ERP protection settings
+     * from a single warm-up, one forked worker per variant. Later calls to Run with the
+     * parameters of one of the variants return its result without simulating again.
+     * \param base the parameters the network is built with
+     * \param variants the parameters of each variant
+     * \param maxWorkers maximum number of concurrent worker processes
+     */
+    void RunForked(Parameters base, const std::vector<Parameters>& variants, uint32_t maxWorkers);
+
+  private:
+    /**
+     * Build the network, the applications and the traffic for the given parameters
+     * \param params the given parameters
+     */
+    void Setup(const Parameters& params);
+    /**
+     * \return the throughput measured by the server application
+     */
+    double GetThroughput();
+    /**
+     * Apply the ERP protection settings of a variant to the network built by Setup
+     * \param experiment the experiment
+     * \param params the parameters of the variant
+     */
+    static void ApplyErpProtection(Experiment* experiment, Parameters params);
+    /**
+     * \param params the given parameters
+     * \return a key identifying the parameters, test name excluded
+     */
+    static std::string GetKey(const Parameters& params);
+
+    Parameters m_params;                     //!< parameters of the network built by Setup
+    NetDeviceContainer m_devices;            //!< all Wi-Fi devices, AP last
+    ApplicationContainer m_serverApp;        //!< server application
+    std::map<std::string, double> m_results; //!< throughputs obtained by RunForked
 };
 
 Experiment::Experiment()
@@ -104,10 +229,90 @@ Experiment::Run(Parameters params)
               << "\n\t gHasTraffic=" << params.gHasTraffic << "\n\t nWifiN=" << params.nWifiN
               << "\n\t nHasTraffic=" << params.nHasTraffic << std::endl;
 
+    auto cached = m_results.find(GetKey(params));
+    if (cached != m_results.end())
+    {
+        return cached->second;
+    }
+
+    Setup(params);
+    Simulator::Stop(params.simulationTime + Seconds(1.0));
+    Simulator::Run();
+    double throughput = GetThroughput();
+    Simulator::Destroy();
+    return throughput;
+}
+
+void
+Experiment::RunForked(Parameters base,
+                      const std::vector<Parameters>& variants,
+                      uint32_t maxWorkers)
+{
+    Setup(base);
+    std::vector<Callback<void>> overrides;
+    for (const Parameters& variant : variants)
+    {
+        overrides.push_back(MakeBoundCallback(&Experiment::ApplyErpProtection, this, variant));
+    }
+    // Traffic starts at 1 s; association is complete by then
+    std::vector<double> results = ForkAfterWarmUp(Seconds(1.0),
+                                                  base.simulationTime + Seconds(1.0),
+                                                  overrides,
+                                                  MakeCallback(&Experiment::GetThroughput, this),
+                                                  maxWorkers);
+    Simulator::Destroy();
+    for (std::size_t i = 0; i < variants.size(); ++i)
+    {
+        m_results[GetKey(variants[i])] = results[i];
+    }
+}
+
+void
+Experiment::ApplyErpProtection(Experiment* experiment, Parameters params)
+{
+    for (auto it = experiment->m_devices.Begin(); it != experiment->m_devices.End(); ++it)
+    {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(*it);
+        device->GetRemoteStationManager()->SetAttribute("ErpProtectionMode",
+                                                        StringValue(params.erpProtectionMode));
+    }
+    Ptr<NetDevice> apDevice = experiment->m_devices.Get(experiment->m_devices.GetN() - 1);
+    DynamicCast<WifiNetDevice>(apDevice)->GetMac()->SetAttribute(
+        "EnableNonErpProtection",
+        BooleanValue(params.enableErpProtection));
+}
+
+std::string
+Experiment::GetKey(const Parameters& params)
+{
+    std::ostringstream oss;
+    oss << params.enableErpProtection << params.erpProtectionMode << params.enableShortSlotTime
+        << params.enableShortPhyPreamble << params.apType << params.nWifiB << params.bHasTraffic
+        << params.nWifiG << params.gHasTraffic << params.nWifiN << params.nHasTraffic
+        << params.isUdp << params.payloadSize << params.simulationTime;
+    return oss.str();
+}
+
+double
+Experiment::GetThroughput()
+{
+    if (m_params.isUdp)
+    {
+        double totalPacketsThrough = DynamicCast<UdpServer>(m_serverApp.Get(0))->GetReceived();
+        return totalPacketsThrough * m_params.payloadSize * 8 /
+               m_params.simulationTime.GetMicroSeconds();
+    }
+    double totalPacketsThrough = DynamicCast<PacketSink>(m_serverApp.Get(0))->GetTotalRx();
+    return totalPacketsThrough * 8 / m_params.simulationTime.GetMicroSeconds();
+}
+
+void
+Experiment::Setup(const Parameters& params)
+{
+    m_params = params;
     Config::SetDefault("ns3::WifiRemoteStationManager::ErpProtectionMode",
                        StringValue(params.erpProtectionMode));
 
-    double throughput = 0;
     uint32_t nWifiB = params.nWifiB;
     uint32_t nWifiG = params.nWifiG;
     uint32_t nWifiN = params.nWifiN;
@@ -182,6 +387,9 @@ Experiment::Run(Parameters params)
                 "ShortSlotTimeSupported",
                 BooleanValue(params.enableShortSlotTime));
     apDevice = wifi.Install(phy, mac, wifiApNode);
+    m_devices = NetDeviceContainer(bStaDevice, gStaDevice);
+    m_devices.Add(nStaDevice);
+    m_devices.Add(apDevice);
 
     // Set TXOP limit
     if (params.apType == WIFI_STANDARD_80211n)
@@ -256,9 +464,9 @@ Experiment::Run(Parameters params)
     {
         uint16_t port = 9;
         UdpServerHelper server(port);
-        ApplicationContainer serverApp = server.Install(wifiApNode);
-        serverApp.Start(Seconds(0.0));
-        serverApp.Stop(simulationTime + Seconds(1.0));
+        m_serverApp = server.Install(wifiApNode);
+        m_serverApp.Start(Seconds(0.0));
+        m_serverApp.Stop(simulationTime + Seconds(1.0));
 
         UdpClientHelper client(ApInterface.GetAddress(0), port);
         client.SetAttribute("MaxPackets", UintegerValue(4294967295U));
@@ -280,12 +488,6 @@ Experiment::Run(Parameters params)
         }
         clientApps.Start(Seconds(1.0));
         clientApps.Stop(simulationTime + Seconds(1.0));
-
-        Simulator::Stop(simulationTime + Seconds(1.0));
-        Simulator::Run();
-
-        double totalPacketsThrough = DynamicCast<UdpServer>(serverApp.Get(0))->GetReceived();
-        throughput = totalPacketsThrough * payloadSize * 8 / simulationTime.GetMicroSeconds();
     }
     else
     {
@@ -293,9 +495,9 @@ Experiment::Run(Parameters params)
         Address localAddress(InetSocketAddress(Ipv4Address::GetAny(), port));
         PacketSinkHelper packetSinkHelper("ns3::TcpSocketFactory", localAddress);
 
-        ApplicationContainer serverApp = packetSinkHelper.Install(wifiApNode.Get(0));
-        serverApp.Start(Seconds(0.0));
-        serverApp.Stop(simulationTime + Seconds(1.0));
+        m_serverApp = packetSinkHelper.Install(wifiApNode.Get(0));
+        m_serverApp.Start(Seconds(0.0));
+        m_serverApp.Stop(simulationTime + Seconds(1.0));
 
         OnOffHelper onoff("ns3::TcpSocketFactory", Ipv4Address::GetAny());
         onoff.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1]"));
@@ -321,15 +523,7 @@ Experiment::Run(Parameters params)
         }
         clientApps.Start(Seconds(1.0));
         clientApps.Stop(simulationTime + Seconds(1.0));
-
-        Simulator::Stop(simulationTime + Seconds(1.0));
-        Simulator::Run();
-
-        double totalPacketsThrough = DynamicCast<PacketSink>(serverApp.Get(0))->GetTotalRx();
-        throughput += totalPacketsThrough * 8 / simulationTime.GetMicroSeconds();
     }
-    Simulator::Destroy();
-    return throughput;
 }
 
 int
@@ -353,6 +547,8 @@ main(int argc, char* argv[])
     params.simulationTime = Seconds(10);
 
     bool verifyResults = false; // used for regression
+    bool forkVariants = false;
+    uint32_t maxWorkers = sysconf(_SC_NPROCESSORS_ONLN);
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("payloadSize", "Payload size in bytes", params.payloadSize);
@@ -361,9 +557,30 @@ main(int argc, char* argv[])
     cmd.AddValue("verifyResults",
                  "Enable/disable results verification at the end of the simulation",
                  verifyResults);
+    cmd.AddValue("forkVariants",
+                 "Fork the ERP protection variants from a shared warm-up",
+                 forkVariants);
+    cmd.AddValue("maxWorkers", "Maximum number of concurrent forked workers", maxWorkers);
     cmd.Parse(argc, argv);
 
     Experiment experiment;
+    if (forkVariants)
+    {
+        // Mixed b/g networks with long, then short PHY preamble: no protection, RTS/CTS
+        // protection and CTS-to-self protection share one network and warm-up each
+        Parameters mixed = params;
+        mixed.nWifiB = 1;
+        for (bool shortPhyPreamble : {false, true})
+        {
+            mixed.enableShortPhyPreamble = shortPhyPreamble;
+            std::vector<Parameters> variants(3, mixed);
+            variants[1].enableErpProtection = true;
+            variants[1].erpProtectionMode = "Rts-Cts";
+            variants[2].enableErpProtection = true;
+            variants[2].erpProtectionMode = "Cts-To-Self";
+            experiment.RunForked(mixed, variants, maxWorkers);
+        }
+    }
     double throughput = 0;
 
     params.testName = "g only with all g features disabled";
@@ -3,7 +3,6 @@
 #include "ns3/config.h"
 #include "ns3/double.h"
 #include "ns3/flow-monitor-helper.h"
-#include "ns3/gnuplot.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/ipv4-list-routing-helper.h"
@@ -11,18 +10,547 @@
 #include "ns3/log.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/mobility-model.h"
+#include "ns3/node-list.h"
 #include "ns3/olsr-helper.h"
 #include "ns3/on-off-helper.h"
 #include "ns3/rectangle.h"
+#include "ns3/rng-seed-manager.h"
 #include "ns3/string.h"
 #include "ns3/uinteger.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("multirate");
 
+/**
+ * Append-only (x, y) series of a Gnuplot plot, kept as two columns.
+ *
+ * Gnuplot2dDataset holds every point until the plot is generated. A series given a
+ * data file instead appends its points to that file every CHUNK_POINTS points, so a
+ * long run keeps a bounded number of points in memory, and its plot script reads the
+ * points back from the file. Series are move-only and handed out by reference.
+ */
+class PlotSeries
+{
+  public:
+    /**
+     * \brief Construct a new PlotSeries object
+     *
+     * \param title The title shown in the plot legend.
+     */
+    explicit PlotSeries(const std::string& title = "");
+
+    PlotSeries(PlotSeries&&) = default;
+    PlotSeries& operator=(PlotSeries&&) = default;
+    PlotSeries(const PlotSeries&) = delete;
+    PlotSeries& operator=(const PlotSeries&) = delete;
+
+    /**
+     * \brief Set the title shown in the plot legend.
+     *
+     * \param title The title.
+     */
+    void SetTitle(const std::string& title);
+    /**
+     * \brief Stream the points to a data file from now on.
+     *
+     * \param fileName The data file.
+     */
+    void StreamTo(const std::string& fileName);
+    /**
+     * \brief Append a point.
+     *
+     * \param x The x coordinate.
+     * \param y The y coordinate.
+     */
+    void Add(double x, double y);
+    /**
+     * \brief Write a Gnuplot script drawing the series with lines, in one pass.
+     *
+     * \param os The script.
+     * \param epsFileName The EPS file the script renders to; the terminal is left alone if
+     *                    empty.
+     * \param title The plot title.
+     * \param xLegend The x axis legend.
+     * \param yLegend The y axis legend.
+     */
+    void WritePlot(std::ostream& os,
+                   const std::string& epsFileName,
+                   const std::string& title,
+                   const std::string& xLegend,
+                   const std::string& yLegend);
+
+  private:
+    static const std::size_t CHUNK_POINTS = 4096; //!< Points buffered before streaming.
+
+    /// Write the buffered points to the data file.
+    void Flush();
+
+    std::string m_title;        //!< Legend title.
+    std::string m_dataFileName; //!< Data file, empty if not streaming.
+    std::ofstream m_data;       //!< Data file stream.
+    std::vector<double> m_x;    //!< Buffered x coordinates.
+    std::vector<double> m_y;    //!< Buffered y coordinates.
+};
+
+PlotSeries::PlotSeries(const std::string& title)
+    : m_title(title)
+{
+}
+
+void
+PlotSeries::SetTitle(const std::string& title)
+{
+    m_title = title;
+}
+
+void
+PlotSeries::StreamTo(const std::string& fileName)
+{
+    m_dataFileName = fileName;
+    m_data.open(fileName);
+    NS_ABORT_MSG_IF(!m_data, "Cannot open plot data file " << fileName);
+    m_x.reserve(CHUNK_POINTS);
+    m_y.reserve(CHUNK_POINTS);
+    Flush();
+}
+
+void
+PlotSeries::Add(double x, double y)
+{
+    m_x.push_back(x);
+    m_y.push_back(y);
+    if (m_data.is_open() && m_x.size() == CHUNK_POINTS)
+    {
+        Flush();
+    }
+}
+
+void
+PlotSeries::Flush()
+{
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        m_data << m_x[i] << " " << m_y[i] << "\n";
+    }
+    m_data.flush();
+    m_x.clear();
+    m_y.clear();
+}
+
+void
+PlotSeries::WritePlot(std::ostream& os,
+                      const std::string& epsFileName,
+                      const std::string& title,
+                      const std::string& xLegend,
+                      const std::string& yLegend)
+{
+    if (!epsFileName.empty())
+    {
+        os << "set terminal post eps color enhanced\n";
+        os << "set output \"" << epsFileName << "\"\n";
+    }
+    if (!title.empty())
+    {
+        os << "set title \"" << title << "\"\n";
+    }
+    if (!xLegend.empty())
+    {
+        os << "set xlabel \"" << xLegend << "\"\n";
+    }
+    if (!yLegend.empty())
+    {
+        os << "set ylabel \"" << yLegend << "\"\n";
+    }
+
+    os << "plot \"" << (m_data.is_open() ? m_dataFileName : "-") << "\"";
+    if (!m_title.empty())
+    {
+        os << " title \"" << m_title << "\"";
+    }
+    os << " with lines\n";
+    if (m_data.is_open())
+    {
+        Flush();
+        return;
+    }
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        os << m_x[i] << " " << m_y[i] << "\n";
+    }
+    os << "e\n";
+}
+
+/**
+ * Uniform random variates drawn in bulk, for start time and placement loops.
+ *
+ * This is the MRG32k3a generator behind ns-3's RngStream, seeded the same way from
+ * the global seed and run number: a stream advances the initial state by 2^127 steps
+ * per stream index and the run selects a substream 2^76 steps apart. For the same seed,
+ * run and stream the values are the ones a UniformRandomVariable would return, but Fill
+ * draws a whole array in one inlined loop instead of one virtual call per value, and
+ * one object serves every draw of a loop.
+ */
+class BatchUniformStream
+{
+  public:
+    /// Use the next automatically assigned stream, as a new UniformRandomVariable does.
+    BatchUniformStream();
+
+    /**
+     * Use a fixed stream, like RandomVariableStream::SetStream.
+     * \param stream first stream index to use
+     * \return the number of streams used
+     */
+    int64_t AssignStreams(int64_t stream);
+
+    /**
+     * Fill an array with uniform values in [min, max).
+     * \param values the array
+     * \param count its size
+     * \param min lower bound
+     * \param max upper bound
+     */
+    void Fill(double* values, std::size_t count, double min, double max);
+
+    /// Fill a vector with uniform values in [min, max).
+    void Fill(std::vector<double>& values, double min, double max)
+    {
+        Fill(values.data(), values.size(), min, max);
+    }
+
+  private:
+    static constexpr double M1 = 4294967087.0;
+    static constexpr double M2 = 4294944443.0;
+
+    /// Seed the generator for a stream index as RngStream does, with the current run
+    void Seed(uint64_t stream);
+
+    /// Advance one component by n * 2^e steps
+    static void Advance(const uint64_t a[3][3], uint64_t m, uint64_t n, uint32_t e, uint64_t s[3]);
+
+    /// r = a * b mod m, r may alias a or b
+    static void Multiply(const uint64_t a[3][3],
+                         const uint64_t b[3][3],
+                         uint64_t m,
+                         uint64_t r[3][3]);
+
+    double m_state[6];
+};
+
+BatchUniformStream::BatchUniformStream()
+{
+    // As RandomVariableStream::SetStream(-1): the first 2^63 streams are automatic
+    Seed(RngSeedManager::GetNextStreamIndex());
+}
+
+int64_t
+BatchUniformStream::AssignStreams(int64_t stream)
+{
+    Seed((1ULL << 63) + stream);
+    return 1;
+}
+
+void
+BatchUniformStream::Seed(uint64_t stream)
+{
+    static const uint64_t a1[3][3] = {{0, 1, 0}, {0, 0, 1}, {4294967087ULL - 810728, 1403580, 0}};
+    static const uint64_t a2[3][3] = {{0, 1, 0}, {0, 0, 1}, {4294944443ULL - 1370589, 0, 527612}};
+
+    uint64_t s1[3];
+    uint64_t s2[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        s1[i] = s2[i] = RngSeedManager::GetSeed();
+    }
+    Advance(a1, 4294967087ULL, stream, 127, s1);
+    Advance(a2, 4294944443ULL, stream, 127, s2);
+    Advance(a1, 4294967087ULL, RngSeedManager::GetRun(), 76, s1);
+    Advance(a2, 4294944443ULL, RngSeedManager::GetRun(), 76, s2);
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        m_state[i] = static_cast<double>(s1[i]);
+        m_state[i + 3] = static_cast<double>(s2[i]);
+    }
+}
+
+void
+BatchUniformStream::Multiply(const uint64_t a[3][3],
+                             const uint64_t b[3][3],
+                             uint64_t m,
+                             uint64_t r[3][3])
+{
+    uint64_t product[3][3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            uint64_t sum = 0;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                // Both factors are below 2^32, so the product fits
+                sum = (sum + a[i][k] * b[k][j] % m) % m;
+            }
+            product[i][j] = sum;
+        }
+    }
+    memcpy(r, product, sizeof(product));
+}
+
+void
+BatchUniformStream::Advance(const uint64_t a[3][3],
+                            uint64_t m,
+                            uint64_t n,
+                            uint32_t e,
+                            uint64_t s[3])
+{
+    uint64_t power[3][3];
+    memcpy(power, a, sizeof(power));
+    for (uint32_t i = 0; i < e; ++i)
+    {
+        Multiply(power, power, m, power);
+    }
+    for (; n != 0; n >>= 1)
+    {
+        if (n & 1)
+        {
+            uint64_t next[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                next[i] = 0;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    next[i] = (next[i] + power[i][k] * s[k] % m) % m;
+                }
+            }
+            memcpy(s, next, sizeof(next));
+        }
+        Multiply(power, power, m, power);
+    }
+}
+
+void
+BatchUniformStream::Fill(double* values, std::size_t count, double min, double max)
+{
+    // The recurrence of RngStream::RandU01, with the state kept in locals
+    const double norm = 1.0 / (M1 + 1.0);
+    const double range = max - min;
+    double s0 = m_state[0];
+    double s1 = m_state[1];
+    double s2 = m_state[2];
+    double s3 = m_state[3];
+    double s4 = m_state[4];
+    double s5 = m_state[5];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double p1 = 1403580.0 * s1 - 810728.0 * s0;
+        p1 -= static_cast<int32_t>(p1 / M1) * M1;
+        if (p1 < 0.0)
+        {
+            p1 += M1;
+        }
+        s0 = s1;
+        s1 = s2;
+        s2 = p1;
+
+        double p2 = 527612.0 * s5 - 1370589.0 * s3;
+        p2 -= static_cast<int32_t>(p2 / M2) * M2;
+        if (p2 < 0.0)
+        {
+            p2 += M2;
+        }
+        s3 = s4;
+        s4 = s5;
+        s5 = p2;
+
+        double u = (p1 > p2 ? p1 - p2 : p1 - p2 + M1) * norm;
+        values[i] = min + u * range;
+    }
+    m_state[0] = s0;
+    m_state[1] = s1;
+    m_state[2] = s2;
+    m_state[3] = s3;
+    m_state[4] = s4;
+    m_state[5] = s5;
+}
+
+/**
+ * Positions and velocities of all nodes, kept in contiguous arrays indexed by node id.
+ *
+ * Attach() reads each node's mobility model once and then follows its CourseChange
+ * trace, so the arrays hold every node's position and velocity as of its last course
+ * change. ns-3 mobility models move in straight lines at constant velocity between
+ * course changes, so SnapshotPositions(t) brings all nodes to time t in one pass over
+ * the arrays, with no aggregate lookup or model update per node. Nodes without a
+ * mobility model stay at the origin.
+ */
+class MobilitySnapshot
+{
+  public:
+    /// Track the nodes of the NodeList not tracked yet; call again after creating more.
+    void Attach();
+
+    /**
+     * Compute the positions of all nodes at a time.
+     * \param t the time, not before the current simulation time; a later time assumes
+     *          no course change until then
+     */
+    void SnapshotPositions(Time t);
+
+    /**
+     * Write the last snapshot, one "<time> <node id> <x> <y> <z>" line per node.
+     * \param os the output stream
+     */
+    void Print(std::ostream& os) const;
+
+    /// \return the number of nodes tracked
+    uint32_t GetN() const
+    {
+        return m_x.size();
+    }
+
+    /**
+     * \param nodeId the node id
+     * \return the position of the node at the last snapshot
+     */
+    Vector GetPosition(uint32_t nodeId) const
+    {
+        return Vector(m_x[nodeId], m_y[nodeId], m_z[nodeId]);
+    }
+
+    /// \return the x coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetX() const
+    {
+        return m_x;
+    }
+
+    /// \return the y coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetY() const
+    {
+        return m_y;
+    }
+
+    /// \return the z coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetZ() const
+    {
+        return m_z;
+    }
+
+  private:
+    /**
+     * CourseChange trace sink; records the new position and velocity of a node.
+     * \param snapshot the snapshot
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    static void CourseChanged(MobilitySnapshot* snapshot,
+                              uint32_t nodeId,
+                              Ptr<const MobilityModel> model);
+
+    /**
+     * Record the current position and velocity of a node.
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    void Update(uint32_t nodeId, Ptr<const MobilityModel> model);
+
+    std::vector<double> m_time;  //!< Time of the last course change, in seconds.
+    std::vector<double> m_baseX; //!< x coordinate at the last course change.
+    std::vector<double> m_baseY; //!< y coordinate at the last course change.
+    std::vector<double> m_baseZ; //!< z coordinate at the last course change.
+    std::vector<double> m_velX;  //!< x velocity since the last course change.
+    std::vector<double> m_velY;  //!< y velocity since the last course change.
+    std::vector<double> m_velZ;  //!< z velocity since the last course change.
+    std::vector<double> m_x;     //!< x coordinate at the last snapshot.
+    std::vector<double> m_y;     //!< y coordinate at the last snapshot.
+    std::vector<double> m_z;     //!< z coordinate at the last snapshot.
+    Time m_snapshotTime;         //!< Time of the last snapshot.
+};
+
+void
+MobilitySnapshot::Attach()
+{
+    uint32_t first = m_x.size();
+    uint32_t n = NodeList::GetNNodes();
+    m_time.resize(n, 0.0);
+    m_baseX.resize(n, 0.0);
+    m_baseY.resize(n, 0.0);
+    m_baseZ.resize(n, 0.0);
+    m_velX.resize(n, 0.0);
+    m_velY.resize(n, 0.0);
+    m_velZ.resize(n, 0.0);
+    m_x.resize(n, 0.0);
+    m_y.resize(n, 0.0);
+    m_z.resize(n, 0.0);
+    for (uint32_t i = first; i < n; ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!model)
+        {
+            continue;
+        }
+        Update(i, model);
+        model->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&MobilitySnapshot::CourseChanged, this, i));
+    }
+    SnapshotPositions(Simulator::Now());
+}
+
+void
+MobilitySnapshot::CourseChanged(MobilitySnapshot* snapshot,
+                                uint32_t nodeId,
+                                Ptr<const MobilityModel> model)
+{
+    snapshot->Update(nodeId, model);
+}
+
+void
+MobilitySnapshot::Update(uint32_t nodeId, Ptr<const MobilityModel> model)
+{
+    Vector position = model->GetPosition();
+    Vector velocity = model->GetVelocity();
+    m_time[nodeId] = Simulator::Now().GetSeconds();
+    m_baseX[nodeId] = position.x;
+    m_baseY[nodeId] = position.y;
+    m_baseZ[nodeId] = position.z;
+    m_velX[nodeId] = velocity.x;
+    m_velY[nodeId] = velocity.y;
+    m_velZ[nodeId] = velocity.z;
+}
+
+void
+MobilitySnapshot::SnapshotPositions(Time t)
+{
+    const double now = t.GetSeconds();
+    const std::size_t n = m_x.size();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        double elapsed = now - m_time[i];
+        m_x[i] = m_baseX[i] + m_velX[i] * elapsed;
+        m_y[i] = m_baseY[i] + m_velY[i] * elapsed;
+        m_z[i] = m_baseZ[i] + m_velZ[i] * elapsed;
+    }
+    m_snapshotTime = t;
+}
+
+void
+MobilitySnapshot::Print(std::ostream& os) const
+{
+    double time = m_snapshotTime.GetSeconds();
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        os << time << " " << i << " " << m_x[i] << " " << m_y[i] << " " << m_z[i] << "\n";
+    }
+}
+
 /**
  * WiFi multirate experiment class.
  *
@@ -75,13 +603,13 @@ class Experiment
      * \param wifiMac The WifiMacHelper class.
      * \param wifiChannel The YansWifiChannelHelper class.
      * \param mobility The MobilityHelper class.
-     * \return a 2D dataset of the experiment data.
+     * \return the throughput series of the experiment.
      */
-    Gnuplot2dDataset Run(const WifiHelper& wifi,
-                         const YansWifiPhyHelper& wifiPhy,
-                         const WifiMacHelper& wifiMac,
-                         const YansWifiChannelHelper& wifiChannel,
-                         const MobilityHelper& mobility);
+    PlotSeries& Run(const WifiHelper& wifi,
+                    const YansWifiPhyHelper& wifiPhy,
+                    const WifiMacHelper& wifiMac,
+                    const YansWifiChannelHelper& wifiChannel,
+                    const MobilityHelper& mobility);
 
     /**
      * \brief Setup the experiment from the command line arguments.
@@ -211,7 +739,7 @@ class Experiment
      */
     void SendMultiDestinations(Ptr<Node> sender, NodeContainer c);
 
-    Gnuplot2dDataset m_output; //!< Output dataset.
+    PlotSeries m_output; //!< Output dataset.
 
     double m_totalTime;      //!< Total experiment time.
     double m_expMean;        //!< Exponential parameter for sending packets.
@@ -229,6 +757,9 @@ class Experiment
     bool m_enableFlowMon;  //!< True if FlowMon is enabled.
     bool m_enableRouting;  //!< True if routing is enabled.
     bool m_enableMobility; //!< True if mobility is enabled.
+    bool m_streamPlot;     //!< True if the output is streamed to a data file.
+
+    MobilitySnapshot m_positions; //!< Positions of all nodes.
 
     /**
      * Node containers for each quadrant.
@@ -266,12 +797,12 @@ Experiment::Experiment(std::string name)
       m_enableFlowMon(false),
       m_enableRouting(false),
       m_enableMobility(false),
+      m_streamPlot(false),
       m_rtsThreshold("2200"),
       // 0 for enabling rts/cts
       m_rateManager("ns3::MinstrelWifiManager"),
       m_outputFileName("minstrel")
 {
-    m_output.SetStyle(Gnuplot2dDataset::LINES);
 }
 
 Ptr<Socket>
@@ -365,26 +896,43 @@ void
 Experiment::SelectSrcDest(NodeContainer c)
 {
     uint32_t totalNodes = c.GetN();
-    Ptr<UniformRandomVariable> uvSrc = CreateObject<UniformRandomVariable>();
-    uvSrc->SetAttribute("Min", DoubleValue(0));
-    uvSrc->SetAttribute("Max", DoubleValue(totalNodes / 2 - 1));
-    Ptr<UniformRandomVariable> uvDest = CreateObject<UniformRandomVariable>();
-    uvDest->SetAttribute("Min", DoubleValue(totalNodes / 2));
-    uvDest->SetAttribute("Max", DoubleValue(totalNodes));
+    uint32_t flows = totalNodes / 3;
 
-    for (uint32_t i = 0; i < totalNodes / 3; i++)
+    // Sources in the first half of the nodes, destinations in the second half
+    std::vector<double> sources(flows);
+    std::vector<double> destinations(flows);
+    BatchUniformStream uv;
+    uv.Fill(sources, 0, totalNodes / 2);
+    uv.Fill(destinations, totalNodes / 2, totalNodes);
+
+    for (uint32_t i = 0; i < flows; i++)
     {
-        ApplicationSetup(c.Get(uvSrc->GetInteger()), c.Get(uvDest->GetInteger()), 0, m_totalTime);
+        ApplicationSetup(c.Get(static_cast<uint32_t>(sources[i])),
+                         c.Get(static_cast<uint32_t>(destinations[i])),
+                         0,
+                         m_totalTime);
     }
 }
 
 void
 Experiment::SendMultiDestinations(Ptr<Node> sender, NodeContainer c)
 {
-    // UniformRandomVariable params: (Xrange, Yrange)
-    Ptr<UniformRandomVariable> uv = CreateObject<UniformRandomVariable>();
-    uv->SetAttribute("Min", DoubleValue(0));
-    uv->SetAttribute("Max", DoubleValue(c.GetN()));
+    // Destinations are drawn among the other nodes, so no draw is spent on the sender
+    std::vector<Ptr<Node>> destinations;
+    for (uint32_t i = 0; i < c.GetN(); i++)
+    {
+        if (c.Get(i)->GetId() != sender->GetId())
+        {
+            destinations.push_back(c.Get(i));
+        }
+    }
+    if (destinations.empty())
+    {
+        return;
+    }
+    std::vector<double> destIndices(c.GetN());
+    BatchUniformStream uv;
+    uv.Fill(destIndices, 0, destinations.size());
 
     // ExponentialRandomVariable params: (mean, upperbound)
     Ptr<ExponentialRandomVariable> ev = CreateObject<ExponentialRandomVariable>();
@@ -393,19 +941,13 @@ Experiment::SendMultiDestinations(Ptr<Node> sender, NodeContainer c)
 
     double start = 0.0;
     double stop;
-    uint32_t destIndex;
 
     for (uint32_t i = 0; i < c.GetN(); i++)
     {
         stop = start + ev->GetValue();
         NS_LOG_DEBUG("Start=" << start << " Stop=" << stop);
 
-        do
-        {
-            destIndex = (uint32_t)uv->GetValue();
-        } while ((c.Get(destIndex))->GetId() == sender->GetId());
-
-        ApplicationSetup(sender, c.Get(destIndex), start, stop);
+        ApplicationSetup(sender, destinations[static_cast<uint32_t>(destIndices[i])], start, stop);
 
         start = stop;
 
@@ -421,13 +963,14 @@ Experiment::SendMultiDestinations(Ptr<Node> sender, NodeContainer c)
  *
  * \param client Client node.
  * \param server Server node.
+ * \param positions Positions of all nodes.
  * \return a string with the nodes data and positions
  */
 static inline std::string
-PrintPosition(Ptr<Node> client, Ptr<Node> server)
+PrintPosition(Ptr<Node> client, Ptr<Node> server, const MobilitySnapshot& positions)
 {
-    Vector serverPos = server->GetObject<MobilityModel>()->GetPosition();
-    Vector clientPos = client->GetObject<MobilityModel>()->GetPosition();
+    Vector serverPos = positions.GetPosition(server->GetId());
+    Vector clientPos = positions.GetPosition(client->GetId());
 
     Ptr<Ipv4> ipv4Server = server->GetObject<Ipv4>();
     Ptr<Ipv4> ipv4Client = client->GetObject<Ipv4>();
@@ -458,7 +1001,7 @@ Experiment::ApplicationSetup(Ptr<Node> client, Ptr<Node> server, double start, d
     Ipv4InterfaceAddress iaddrServer = ipv4Server->GetAddress(1, 0);
     Ipv4Address ipv4AddrServer = iaddrServer.GetLocal();
 
-    NS_LOG_DEBUG(PrintPosition(client, server));
+    NS_LOG_DEBUG(PrintPosition(client, server, m_positions));
 
     // Equipping the source  node with OnOff Application used for sending
     OnOffHelper onoff("ns3::UdpSocketFactory",
@@ -474,13 +1017,18 @@ Experiment::ApplicationSetup(Ptr<Node> client, Ptr<Node> server, double start, d
     Ptr<Socket> sink = SetupPacketReceive(server);
 }
 
-Gnuplot2dDataset
+PlotSeries&
 Experiment::Run(const WifiHelper& wifi,
                 const YansWifiPhyHelper& wifiPhy,
                 const WifiMacHelper& wifiMac,
                 const YansWifiChannelHelper& wifiChannel,
                 const MobilityHelper& mobility)
 {
+    if (m_streamPlot)
+    {
+        m_output.StreamTo(GetOutputFileName() + ".dat");
+    }
+
     uint32_t nodeSize = m_gridSize * m_gridSize;
     NodeContainer c;
     c.Create(nodeSize);
@@ -544,6 +1092,7 @@ Experiment::Run(const WifiHelper& wifi,
                                StringValue("ns3::ConstantRandomVariable[Constant=0.2]"));
     }
     mobil.Install(c);
+    m_positions.Attach();
 
     if (m_scenario == 1 && m_enableRouting)
     {
@@ -669,6 +1218,7 @@ Experiment::CommandSetup(int argc, char** argv)
     cmd.AddValue("enableRouting", "enable Routing", m_enableRouting);
     cmd.AddValue("enableMobility", "enable Mobility", m_enableMobility);
     cmd.AddValue("scenario", "scenario ", m_scenario);
+    cmd.AddValue("streamPlot", "stream the plot data to a .dat file during the run", m_streamPlot);
 
     cmd.Parse(argc, argv);
     return true;
@@ -686,8 +1236,6 @@ main(int argc, char* argv[])
     std::ofstream outfile(experiment.GetOutputFileName() + ".plt");
 
     MobilityHelper mobility;
-    Gnuplot gnuplot;
-    Gnuplot2dDataset dataset;
 
     WifiHelper wifi;
     WifiMacHelper wifiMac;
@@ -705,10 +1253,9 @@ main(int argc, char* argv[])
     NS_LOG_INFO("Routing: " << experiment.IsRouting());
     NS_LOG_INFO("Mobility: " << experiment.IsMobility());
 
-    dataset = experiment.Run(wifi, wifiPhy, wifiMac, wifiChannel, mobility);
+    PlotSeries& throughput = experiment.Run(wifi, wifiPhy, wifiMac, wifiChannel, mobility);
 
-    gnuplot.AddDataset(dataset);
-    gnuplot.GenerateOutput(outfile);
+    throughput.WritePlot(outfile, "", "", "", "");
 
     return 0;
 }
@@ -6,25 +6,566 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/log.h"
 #include "ns3/mobility-helper.h"
+#include "ns3/names.h"
+#include "ns3/node-list.h"
 #include "ns3/on-off-helper.h"
 #include "ns3/packet-sink-helper.h"
 #include "ns3/packet-sink.h"
+#include "ns3/pointer.h"
+#include "ns3/qos-txop.h"
+#include "ns3/qos-utils.h"
+#include "ns3/simulator.h"
 #include "ns3/ssid.h"
 #include "ns3/string.h"
 #include "ns3/uinteger.h"
+#include "ns3/wifi-mac-queue.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/wifi-ppdu.h"
+#include "ns3/wifi-psdu.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
 // This is a simple example in order to show how to configure an IEEE 802.11n Wi-Fi network
 // with multiple TOS. It outputs the aggregated UDP throughput, which depends on the number of
 // stations, the HT MCS value (0 to 7), the channel width (20 or 40 MHz) and the guard interval
 // (long or short). The user can also specify the distance between the access point and the
 // stations (in meters), and can specify whether RTS/CTS is used or not.
+//
+// With --allTids every station runs one flow per TID (two per AC) instead of one per AC,
+// and --edcaStats prints per-TID queueing delay and A-MPDU size distributions and
+// per-AC TXOP duration distributions collected over all stations and the AP.
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("WifiMultiTos");
 
+/**
+ * Index of the devices and applications of all nodes, for resolving Config paths
+ * without walking every node and device for every path.
+ *
+ * Build() walks the NodeList once and files each device and application under its
+ * TypeId and all parent TypeIds. "/NodeList/<n or *>/DeviceList/<i or *>/$ns3::Type"
+ * is then one lookup in the list of objects of that type, a single node or list index
+ * is an array access, and named objects, "$" types and pointer attributes after that
+ * are followed one segment at a time from the matches. Resolved paths are cached, so
+ * setting several attributes below the same object path resolves it once. The cost
+ * of a path follows the number of objects it matches, not the number of nodes times
+ * path segments. Paths the index cannot resolve (other namespaces, "|" and "[a-b]"
+ * selectors, object vector attributes, types only reachable through aggregation) go
+ * to Config::LookupMatches and are cached the same way.
+ *
+ * The index is a snapshot: call Build() again after creating nodes, devices,
+ * applications or names.
+ */
+class ConfigIndex
+{
+  public:
+    /// Index the devices and applications of all nodes and drop the cached paths.
+    void Build();
+
+    /**
+     * \param path a Config path to objects, e.g. "/NodeList/1/DeviceList/0/Phy"
+     * \return the matching objects and their paths, as Config::LookupMatches returns them
+     */
+    Config::MatchContainer LookupMatches(const std::string& path);
+
+    /**
+     * Set an attribute of every object matching a path, like Config::Set.
+     * \param path the path to the objects, followed by the attribute name
+     * \param value the attribute value
+     */
+    void Set(const std::string& path, const AttributeValue& value);
+
+    /**
+     * Connect a trace sink to every object matching a path, like Config::Connect.
+     * \param path the path to the objects, followed by the trace source name
+     * \param cb the sink, receiving the resolved path as its context
+     */
+    void Connect(const std::string& path, const CallbackBase& cb);
+
+    /**
+     * Connect a trace sink to every object matching a path, like
+     * Config::ConnectWithoutContext.
+     * \param path the path to the objects, followed by the trace source name
+     * \param cb the sink
+     */
+    void ConnectWithoutContext(const std::string& path, const CallbackBase& cb);
+
+  private:
+    /// A device or application and its place in the NodeList
+    struct Entry
+    {
+        uint32_t node;      //!< Node id.
+        uint32_t index;     //!< Position in the node's DeviceList or ApplicationList.
+        Ptr<Object> object; //!< The device or application.
+    };
+
+    /// Entries by the name of their TypeId and of every parent TypeId, in NodeList order
+    using TypeIndex = std::map<std::string, std::vector<Entry>>;
+
+    /**
+     * File an entry under its TypeId and all parent TypeIds.
+     * \param index the index
+     * \param entry the entry
+     */
+    static void AddByType(TypeIndex& index, const Entry& entry);
+
+    /**
+     * Match a path to objects without the cache.
+     * \param path the path to the objects
+     * \param objects the matching objects
+     * \param contexts the resolved path of each match, ending with '/'
+     * \return false if the path has to be resolved by Config itself
+     */
+    bool Resolve(const std::string& path,
+                 std::vector<Ptr<Object>>& objects,
+                 std::vector<std::string>& contexts) const;
+
+    /**
+     * Resolve all but the last segment of a path, which names an attribute or a
+     * trace source.
+     * \param path the path
+     * \param name set to the last segment
+     * \return the objects matching the rest
+     */
+    Config::MatchContainer LookupParent(const std::string& path, std::string& name);
+
+    TypeIndex m_devices;                                   //!< Devices of all nodes.
+    TypeIndex m_applications;                              //!< Applications of all nodes.
+    std::map<std::string, Config::MatchContainer> m_cache; //!< Resolved paths.
+};
+
+void
+ConfigIndex::Build()
+{
+    m_devices.clear();
+    m_applications.clear();
+    m_cache.clear();
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); ++n)
+    {
+        Ptr<Node> node = NodeList::GetNode(n);
+        for (uint32_t i = 0; i < node->GetNDevices(); ++i)
+        {
+            AddByType(m_devices, Entry{n, i, node->GetDevice(i)});
+        }
+        for (uint32_t i = 0; i < node->GetNApplications(); ++i)
+        {
+            AddByType(m_applications, Entry{n, i, node->GetApplication(i)});
+        }
+    }
+}
+
+void
+ConfigIndex::AddByType(TypeIndex& index, const Entry& entry)
+{
+    // "$ns3::NetDevice" matches every device, so an entry is filed under each ancestor
+    // too; "ns3::Object" then lists them all
+    TypeId tid = entry.object->GetInstanceTypeId();
+    while (true)
+    {
+        index[tid.GetName()].push_back(entry);
+        if (tid == Object::GetTypeId())
+        {
+            break;
+        }
+        tid = tid.GetParent();
+    }
+}
+
+bool
+ConfigIndex::Resolve(const std::string& path,
+                     std::vector<Ptr<Object>>& objects,
+                     std::vector<std::string>& contexts) const
+{
+    std::vector<std::string> segments;
+    std::istringstream iss(path);
+    for (std::string segment; std::getline(iss, segment, '/');)
+    {
+        if (!segment.empty())
+        {
+            segments.push_back(segment);
+        }
+    }
+
+    // "*" or a single index; anything else is left to Config
+    auto parseIndex = [](const std::string& text, bool& all, uint32_t& index) {
+        all = text == "*";
+        char* end = nullptr;
+        index = std::strtoul(text.c_str(), &end, 10);
+        return all || (end != text.c_str() && *end == '\0');
+    };
+
+    std::size_t next = 0;
+    if (segments.size() >= 2 && segments[0] == "NodeList")
+    {
+        bool allNodes;
+        uint32_t nodeId;
+        if (!parseIndex(segments[1], allNodes, nodeId))
+        {
+            return false;
+        }
+        if (!allNodes && nodeId >= NodeList::GetNNodes())
+        {
+            return true;
+        }
+        bool devices = segments.size() >= 4 && segments[2] == "DeviceList";
+        bool applications = segments.size() >= 4 && segments[2] == "ApplicationList";
+        if (devices || applications)
+        {
+            bool allEntries;
+            uint32_t entry;
+            if (!parseIndex(segments[3], allEntries, entry))
+            {
+                return false;
+            }
+            std::string type = "ns3::Object";
+            std::string typeSegment;
+            next = 4;
+            if (segments.size() > 4 && segments[4][0] == '$')
+            {
+                typeSegment = segments[4] + "/";
+                type = segments[4].substr(1);
+                next = 5;
+            }
+            const TypeIndex& index = devices ? m_devices : m_applications;
+            auto matches = index.find(type);
+            if (matches == index.end())
+            {
+                return false;
+            }
+            auto first = matches->second.begin();
+            auto last = matches->second.end();
+            if (!allNodes)
+            {
+                // Entries are in node order, so one node's entries are a contiguous range
+                first = std::lower_bound(first, last, nodeId, [](const Entry& e, uint32_t id) {
+                    return e.node < id;
+                });
+                last = std::upper_bound(first, last, nodeId, [](uint32_t id, const Entry& e) {
+                    return id < e.node;
+                });
+            }
+            for (auto it = first; it != last; ++it)
+            {
+                if (allEntries || it->index == entry)
+                {
+                    objects.push_back(it->object);
+                    contexts.push_back("/NodeList/" + std::to_string(it->node) + "/" +
+                                       segments[2] + "/" + std::to_string(it->index) + "/" +
+                                       typeSegment);
+                }
+            }
+        }
+        else
+        {
+            uint32_t begin = allNodes ? 0 : nodeId;
+            uint32_t end = allNodes ? NodeList::GetNNodes() : nodeId + 1;
+            for (uint32_t n = begin; n < end; ++n)
+            {
+                objects.push_back(NodeList::GetNode(n));
+                contexts.push_back("/NodeList/" + std::to_string(n) + "/");
+            }
+            next = 2;
+        }
+    }
+    else if (segments.size() >= 2 && segments[0] == "Names")
+    {
+        Ptr<Object> object = Names::Find<Object>("/Names/" + segments[1]);
+        if (!object)
+        {
+            return false;
+        }
+        objects.push_back(object);
+        contexts.push_back("/Names/" + segments[1] + "/");
+        next = 2;
+    }
+    else
+    {
+        return false;
+    }
+
+    // The rest of the path goes from each match to a "$" type, a named child or the
+    // object held by a pointer attribute
+    for (; next < segments.size(); ++next)
+    {
+        const std::string& segment = segments[next];
+        std::vector<Ptr<Object>> children;
+        std::vector<std::string> childContexts;
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            Ptr<Object> child;
+            if (segment[0] == '$')
+            {
+                TypeId tid;
+                if (!TypeId::LookupByNameFailSafe(segment.substr(1), &tid))
+                {
+                    return false;
+                }
+                child = objects[i]->GetObject<Object>(tid);
+            }
+            else
+            {
+                child = Names::Find<Object>(objects[i], segment);
+                if (!child)
+                {
+                    PointerValue pointer;
+                    if (!objects[i]->GetAttributeFailSafe(segment, pointer))
+                    {
+                        return false;
+                    }
+                    child = pointer.Get<Object>();
+                }
+            }
+            if (child)
+            {
+                children.push_back(child);
+                childContexts.push_back(contexts[i] + segment + "/");
+            }
+        }
+        objects.swap(children);
+        contexts.swap(childContexts);
+    }
+    return true;
+}
+
+Config::MatchContainer
+ConfigIndex::LookupMatches(const std::string& path)
+{
+    auto cached = m_cache.find(path);
+    if (cached != m_cache.end())
+    {
+        return cached->second;
+    }
+    std::vector<Ptr<Object>> objects;
+    std::vector<std::string> contexts;
+    Config::MatchContainer matches = Resolve(path, objects, contexts)
+                                         ? Config::MatchContainer(objects, contexts, path)
+                                         : Config::LookupMatches(path);
+    m_cache.emplace(path, matches);
+    return matches;
+}
+
+Config::MatchContainer
+ConfigIndex::LookupParent(const std::string& path, std::string& name)
+{
+    std::size_t slash = path.rfind('/');
+    NS_ABORT_MSG_IF(slash == std::string::npos, "Invalid Config path " << path);
+    name = path.substr(slash + 1);
+    Config::MatchContainer matches = LookupMatches(path.substr(0, slash));
+    NS_ABORT_MSG_IF(matches.GetN() == 0, "No object matches " << path);
+    return matches;
+}
+
+void
+ConfigIndex::Set(const std::string& path, const AttributeValue& value)
+{
+    std::string name;
+    LookupParent(path, name).Set(name, value);
+}
+
+void
+ConfigIndex::Connect(const std::string& path, const CallbackBase& cb)
+{
+    std::string name;
+    LookupParent(path, name).Connect(name, cb);
+}
+
+void
+ConfigIndex::ConnectWithoutContext(const std::string& path, const CallbackBase& cb)
+{
+    std::string name;
+    LookupParent(path, name).ConnectWithoutContext(name, cb);
+}
+
+/**
+ * Fixed-memory histogram with log-linear buckets: values below 8 get one bucket
+ * each, and every power of two above that is split into 8 equal buckets, so any
+ * recorded value is known to within 12.5%. Values of 2^41 and more share the top
+ * bucket. Recording a value is a shift and an increment; no memory is allocated.
+ */
+class LogLinearHistogram
+{
+  public:
+    /// Record one sample.
+    void Add(uint64_t value)
+    {
+        m_counts[Index(value)]++;
+        m_count++;
+        m_max = std::max(m_max, value);
+    }
+
+    /// \return the number of recorded samples
+    uint64_t GetCount() const
+    {
+        return m_count;
+    }
+
+    /// \return the largest recorded sample, 0 if none
+    uint64_t GetMax() const
+    {
+        return m_max;
+    }
+
+    /// \return the upper bound of the bucket holding the q-quantile (0 < q <= 1)
+    uint64_t GetQuantile(double q) const
+    {
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * m_count));
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank && seen > 0)
+            {
+                return i + 1 < NUM_BUCKETS ? std::min(m_max, Lower(i + 1) - 1) : m_max;
+            }
+        }
+        return 0;
+    }
+
+  private:
+    static constexpr uint32_t SUB_BITS = 3;
+    static constexpr uint32_t SUB = 1 << SUB_BITS;
+    static constexpr uint32_t MAX_EXP = 40;
+    static constexpr uint32_t NUM_BUCKETS = SUB + (MAX_EXP - SUB_BITS + 1) * SUB;
+
+    static uint32_t Index(uint64_t value)
+    {
+        if (value < SUB)
+        {
+            return value;
+        }
+        uint32_t exp = 63 - __builtin_clzll(value);
+        if (exp > MAX_EXP)
+        {
+            return NUM_BUCKETS - 1;
+        }
+        return SUB + (exp - SUB_BITS) * SUB + ((value >> (exp - SUB_BITS)) & (SUB - 1));
+    }
+
+    static uint64_t Lower(uint32_t index)
+    {
+        if (index < SUB)
+        {
+            return index;
+        }
+        uint32_t exp = (index - SUB) / SUB + SUB_BITS;
+        return (uint64_t{1} << exp) + (uint64_t{(index - SUB) % SUB} << (exp - SUB_BITS));
+    }
+
+    std::array<uint32_t, NUM_BUCKETS> m_counts{};
+    uint64_t m_count{0};
+    uint64_t m_max{0};
+};
+
+/**
+ * EDCA instrumentation that can be attached to any number of WifiNetDevices. All
+ * attached devices feed the same fixed-memory histograms, so the footprint does not
+ * grow with the number of stations:
+ * - per TID, the MAC queueing delay of QoS data MPDUs (from enqueue until the MPDU
+ *   leaves the queue, i.e. once it is acknowledged or dropped);
+ * - per AC, the duration of every TXOP;
+ * - per TID, the number of MPDUs in every transmitted PSDU (1 for a single MPDU).
+ */
+class EdcaStats
+{
+  public:
+    /// Connect to the EDCA queues, EDCA functions and PHY of a device.
+    void Attach(Ptr<WifiNetDevice> device)
+    {
+        Ptr<WifiMac> mac = device->GetMac();
+        for (AcIndex ac : {AC_BE, AC_BK, AC_VI, AC_VO})
+        {
+            Ptr<QosTxop> edca = mac->GetQosTxop(ac);
+            edca->GetWifiMacQueue()->TraceConnectWithoutContext(
+                "Dequeue",
+                MakeCallback(&EdcaStats::MpduDequeued, this));
+            edca->TraceConnectWithoutContext("TxopTrace",
+                                             MakeBoundCallback(&EdcaStats::TxopEnded, this, ac));
+        }
+        device->GetPhy()->TraceConnectWithoutContext(
+            "PhyTxPsduBegin",
+            MakeCallback(&EdcaStats::PsduTxBegin, this));
+    }
+
+    /// Print one line per TID and per AC that saw any traffic.
+    void Print(std::ostream& os) const
+    {
+        const char* acNames[] = {"AC_BE", "AC_BK", "AC_VI", "AC_VO"};
+        for (uint8_t tid = 0; tid < 8; ++tid)
+        {
+            const LogLinearHistogram& delay = m_queueDelayUs[tid];
+            if (delay.GetCount() == 0)
+            {
+                continue;
+            }
+            const LogLinearHistogram& ampdu = m_ampduMpdus[tid];
+            os << "TID " << +tid << " (" << acNames[QosUtilsMapTidToAc(tid)] << "): "
+               << delay.GetCount() << " MPDUs, queueing delay p50/p99/max = "
+               << delay.GetQuantile(0.5) << "/" << delay.GetQuantile(0.99) << "/"
+               << delay.GetMax() << " us, A-MPDU size p50/p99/max = " << ampdu.GetQuantile(0.5)
+               << "/" << ampdu.GetQuantile(0.99) << "/" << ampdu.GetMax() << " MPDUs"
+               << std::endl;
+        }
+        for (uint8_t ac = 0; ac < 4; ++ac)
+        {
+            const LogLinearHistogram& txop = m_txopUs[ac];
+            if (txop.GetCount() == 0)
+            {
+                continue;
+            }
+            os << acNames[ac] << ": " << txop.GetCount() << " TXOPs, duration p50/p99/max = "
+               << txop.GetQuantile(0.5) << "/" << txop.GetQuantile(0.99) << "/" << txop.GetMax()
+               << " us" << std::endl;
+        }
+    }
+
+  private:
+    void MpduDequeued(Ptr<const WifiMpdu> mpdu)
+    {
+        const WifiMacHeader& header = mpdu->GetHeader();
+        if (header.IsQosData())
+        {
+            m_queueDelayUs[header.GetQosTid()].Add(
+                (Simulator::Now() - mpdu->GetTimestamp()).GetMicroSeconds());
+        }
+    }
+
+    static void TxopEnded(EdcaStats* stats,
+                          AcIndex ac,
+                          Time startTime,
+                          Time duration,
+                          uint8_t linkId)
+    {
+        stats->m_txopUs[ac].Add(duration.GetMicroSeconds());
+    }
+
+    void PsduTxBegin(WifiConstPsduMap psduMap, WifiTxVector txVector, double txPowerW)
+    {
+        for (const auto& [staId, psdu] : psduMap)
+        {
+            for (uint8_t tid : psdu->GetTids())
+            {
+                m_ampduMpdus[tid].Add(psdu->GetNMpdus());
+            }
+        }
+    }
+
+    std::array<LogLinearHistogram, 8> m_queueDelayUs; //!< per TID
+    std::array<LogLinearHistogram, 4> m_txopUs;       //!< per AC, indexed by AcIndex
+    std::array<LogLinearHistogram, 8> m_ampduMpdus;   //!< per TID
+};
+
 int
 main(int argc, char* argv[])
 {
@@ -35,6 +576,8 @@ main(int argc, char* argv[])
     uint8_t channelWidth{20}; // MHz
     bool useShortGuardInterval{false};
     bool useRts{false};
+    bool allTids{false};
+    bool edcaStats{false};
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("nWifi", "Number of stations", nWifi);
@@ -48,6 +591,8 @@ main(int argc, char* argv[])
     cmd.AddValue("useShortGuardInterval",
                  "Enable/disable short guard interval",
                  useShortGuardInterval);
+    cmd.AddValue("allTids", "Run one flow per TID instead of one per AC", allTids);
+    cmd.AddValue("edcaStats", "Print per-TID and per-AC EDCA distributions", edcaStats);
     cmd.Parse(argc, argv);
 
     NodeContainer wifiStaNodes;
@@ -85,15 +630,27 @@ main(int argc, char* argv[])
     NetDeviceContainer apDevice;
     apDevice = wifi.Install(phy, mac, wifiApNode);
 
-    // Set channel width
-    Config::Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/ChannelSettings",
-                StringValue("{0, " + std::to_string(channelWidth) + ", BAND_2_4GHZ, 0}"));
-
-    // Set guard interval
-    Config::Set(
+    // Set channel width and guard interval. The paths are resolved against an index of
+    // the installed devices rather than by walking every node and device per setting.
+    ConfigIndex config;
+    config.Build();
+    config.Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/ChannelSettings",
+               StringValue("{0, " + std::to_string(channelWidth) + ", BAND_2_4GHZ, 0}"));
+    config.Set(
         "/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/HtConfiguration/ShortGuardIntervalSupported",
         BooleanValue(useShortGuardInterval));
 
+    NetDeviceContainer wifiDevices(staDevices, apDevice);
+
+    EdcaStats stats;
+    if (edcaStats)
+    {
+        for (auto it = wifiDevices.Begin(); it != wifiDevices.End(); ++it)
+        {
+            stats.Attach(DynamicCast<WifiNetDevice>(*it));
+        }
+    }
+
     // mobility
     MobilityHelper mobility;
     Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator>();
@@ -124,6 +681,11 @@ main(int argc, char* argv[])
     ApplicationContainer sourceApplications;
     ApplicationContainer sinkApplications;
     std::vector<uint8_t> tosValues = {0x70, 0x28, 0xb8, 0xc0}; // AC_BE, AC_BK, AC_VI, AC_VO
+    if (allTids)
+    {
+        // The TID is the IP precedence (top three bits of the TOS byte): TIDs 0 to 7
+        tosValues = {0x00, 0x20, 0x40, 0x60, 0x80, 0xa0, 0xc0, 0xe0};
+    }
     uint32_t portNumber = 9;
     for (uint32_t index = 0; index < nWifi; ++index)
     {
@@ -137,7 +699,7 @@ main(int argc, char* argv[])
                                      StringValue("ns3::ConstantRandomVariable[Constant=1]"));
             onOffHelper.SetAttribute("OffTime",
                                      StringValue("ns3::ConstantRandomVariable[Constant=0]"));
-            onOffHelper.SetAttribute("DataRate", DataRateValue(50000000 / nWifi));
+            onOffHelper.SetAttribute("DataRate", DataRateValue(200000000 / nWifi / tosValues.size()));
             onOffHelper.SetAttribute("PacketSize", UintegerValue(1472)); // bytes
             onOffHelper.SetAttribute("Tos", UintegerValue(tosValue));
             sourceApplications.Add(onOffHelper.Install(wifiStaNodes.Get(index)));
@@ -164,6 +726,11 @@ main(int argc, char* argv[])
         throughput += ((totalPacketsThrough * 8) / simulationTime.GetMicroSeconds()); // Mbit/s
     }
 
+    if (edcaStats)
+    {
+        stats.Print(std::cout);
+    }
+
     Simulator::Destroy();
 
     if (throughput > 0)
@@ -13,6 +13,12 @@
 //
 // the layout is affected by the parameters given to GridPositionAllocator;
 // by default, GridWidth is 5 (nodes per row) and numNodes is 25..
+// Larger grids are laid out with --gridWidth, e.g.
+//
+// ./ns3 run "wifi-simple-adhoc-grid --numNodes=1024 --gridWidth=32"
+//
+// Examples/olsr-grid-scaling-benchmark.cc measures the OLSR control plane
+// on such grids.
 //
 // There are a number of command-line options available to control
 // the default behavior.  The list of available command-line options
@@ -135,6 +141,7 @@ main(int argc, char* argv[])
     uint32_t packetSize{1000}; // bytes
     uint32_t numPackets{1};
     uint32_t numNodes{25}; // by default, 5x5
+    uint32_t gridWidth{5};
     uint32_t sinkNode{0};
     uint32_t sourceNode{24};
     Time interPacketInterval{"1s"};
@@ -150,6 +157,7 @@ main(int argc, char* argv[])
     cmd.AddValue("verbose", "turn on all WifiNetDevice log components", verbose);
     cmd.AddValue("tracing", "turn on ascii and pcap tracing", tracing);
     cmd.AddValue("numNodes", "number of nodes", numNodes);
+    cmd.AddValue("gridWidth", "number of nodes per grid row", gridWidth);
     cmd.AddValue("sinkNode", "Receiver node number", sinkNode);
     cmd.AddValue("sourceNode", "Sender node number", sourceNode);
     cmd.Parse(argc, argv);
@@ -201,7 +209,7 @@ main(int argc, char* argv[])
                                   "DeltaY",
                                   DoubleValue(distance),
                                   "GridWidth",
-                                  UintegerValue(5),
+                                  UintegerValue(gridWidth),
                                   "LayoutType",
                                   StringValue("RowFirst"));
     mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
@@ -221,7 +229,15 @@ main(int argc, char* argv[])
 
     Ipv4AddressHelper ipv4;
     NS_LOG_INFO("Assign IP Addresses.");
-    ipv4.SetBase("10.1.1.0", "255.255.255.0");
+    if (numNodes < 255)
+    {
+        ipv4.SetBase("10.1.1.0", "255.255.255.0");
+    }
+    else
+    {
+        // A /24 holds 254 nodes; larger grids share a /16, from the same first address
+        ipv4.SetBase("10.1.0.0", "255.255.0.0", "0.0.1.1");
+    }
     Ipv4InterfaceContainer i = ipv4.Assign(devices);
 
     TypeId tid = TypeId::LookupByName("ns3::UdpSocketFactory");
@@ -7,29 +7,423 @@
 #include "ns3/applications-module.h"
 #include "ns3/energy-module.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("UdpWSNExample");
 
-// Function to send UDP packets from sensors to the sink
-void SendPacket(Ptr<Socket> socket, Ipv4Address sinkAddr, uint16_t port) {
-    Ptr<Packet> packet = Create<Packet>(256); // 256-byte packet
-    socket->SendTo(packet, 0, InetSocketAddress(sinkAddr, port));
-    Simulator::Schedule(Seconds(2.0), &SendPacket, socket, sinkAddr, port); // Schedule next packet
+// Timer wheel driving the periodic sends of all nodes from a single scheduler
+// event per occupied slot, instead of one self-rescheduling event per node.
+// Senders keep their own phase offset: the slot is (first send time mod period).
+class PeriodicSenderWheel {
+public:
+    PeriodicSenderWheel(Time period, Time slot)
+        : m_slotTs(slot.GetTimeStep()),
+          m_numSlots(static_cast<uint32_t>(period.GetTimeStep() / slot.GetTimeStep())),
+          m_slots(m_numSlots),
+          m_nextId(0),
+          m_tick(0),
+          m_nextTick(0) {}
+
+    // Register a sender whose first transmission happens after 'delay'; returns
+    // an id that can be passed to Remove().
+    uint32_t Add(Time delay, Callback<void> send) {
+        int64_t tick = (Simulator::Now() + delay).GetTimeStep() / m_slotTs;
+        uint32_t slot = static_cast<uint32_t>(tick % m_numSlots);
+        uint32_t id = m_nextId++;
+        m_slots[slot].push_back(Entry{id, tick, send});
+        m_slotOf[id] = slot;
+        m_occupied.insert(slot);
+        if (!m_event.IsRunning() || tick < m_nextTick) {
+            ScheduleAt(tick);
+        }
+        return id;
+    }
+
+    void Remove(uint32_t id) {
+        auto it = m_slotOf.find(id);
+        if (it == m_slotOf.end()) {
+            return;
+        }
+        // Entries are only nulled here and compacted on the next visit of the
+        // slot, so Remove() is safe to call from within a send callback.
+        for (Entry &e : m_slots[it->second]) {
+            if (e.id == id) {
+                e.send.Nullify();
+            }
+        }
+        m_slotOf.erase(it);
+    }
+
+private:
+    struct Entry {
+        uint32_t id;
+        int64_t firstTick;
+        Callback<void> send;
+    };
+
+    void ScheduleAt(int64_t tick) {
+        Simulator::Cancel(m_event);
+        m_nextTick = tick;
+        m_event = Simulator::Schedule(TimeStep(tick * m_slotTs) - Simulator::Now(),
+                                      &PeriodicSenderWheel::Tick, this);
+    }
+
+    void Tick() {
+        m_tick = m_nextTick;
+        uint32_t slot = static_cast<uint32_t>(m_tick % m_numSlots);
+        std::vector<Entry> &entries = m_slots[slot];
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i].send.IsNull() && entries[i].firstTick <= m_tick) {
+                entries[i].send();
+            }
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const Entry &e) { return e.send.IsNull(); }),
+                      entries.end());
+        if (entries.empty()) {
+            m_occupied.erase(slot);
+        }
+        if (m_occupied.empty()) {
+            return;
+        }
+        // Jump straight to the next occupied slot; empty slots cost nothing.
+        auto next = m_occupied.upper_bound(slot);
+        uint32_t delta = (next != m_occupied.end()) ? *next - slot
+                                                    : m_numSlots - slot + *m_occupied.begin();
+        ScheduleAt(m_tick + delta);
+    }
+
+    int64_t m_slotTs;
+    uint32_t m_numSlots;
+    std::vector<std::vector<Entry>> m_slots;
+    std::set<uint32_t> m_occupied;
+    std::map<uint32_t, uint32_t> m_slotOf;
+    uint32_t m_nextId;
+    int64_t m_tick;
+    int64_t m_nextTick;
+    EventId m_event;
+};
+
+#ifndef BINARY_LOG_COMPILED_LEVELS
+// Levels of the BINARY_LOG statements kept by the compiler, e.g. LOG_LEVEL_WARN
+#define BINARY_LOG_COMPILED_LEVELS LOG_LEVEL_ALL
+#endif
+
+// Log a message with up to four arguments; "{}" in the format marks where each goes.
+// Statements whose level is not in BINARY_LOG_COMPILED_LEVELS are removed by the
+// compiler, the others cost one test while their level is disabled.
+#define BINARY_LOG(level, format, ...)                                                    \
+    do {                                                                                  \
+        if ((BINARY_LOG_COMPILED_LEVELS & (level)) != 0 && BinaryLog::IsEnabled(level)) { \
+            static const uint16_t binaryLogFormatId = BinaryLog::Register(level, format); \
+            BinaryLog::Write(binaryLogFormatId, ##__VA_ARGS__);                           \
+        }                                                                                 \
+    } while (false)
+
+// Log sink that defers all formatting.
+//
+// A BINARY_LOG statement stores its format id, the simulation time and its raw
+// arguments in a fixed-size slot of the calling thread's ring buffer. By default a
+// ring keeps the newest records, like a flight recorder; with spilling, a full ring
+// is appended to the file instead and nothing is lost. Close() writes what the rings
+// hold, then the format strings, and Examples/binary-log-decode.cc turns the file
+// back into text. In text mode statements are formatted and printed right away, as
+// NS_LOG does.
+//
+// File layout: the magic "NS3BLOG1"; blocks of a uint32 thread index, a uint32 record
+// count and that many Record structs; the format table as a uint32 count and, per
+// format, a uint32 level and a uint32 length followed by the characters; and last the
+// uint64 file offset of the format table. Integers are in host byte order.
+class BinaryLog {
+public:
+    static const uint32_t MAX_ARGS = 4;
+
+    // Record the given levels (e.g. LOG_LEVEL_INFO) to a file from now on. Each thread's
+    // ring holds ringRecords records; with 'spill' full rings are appended to the file
+    // instead of having their oldest records overwritten.
+    static void Open(const std::string &fileName, uint32_t levels, uint32_t ringRecords, bool spill);
+
+    // Print the statements of these levels as text right away instead.
+    static void EnableText(uint32_t levels);
+
+    // Write the records left in the rings and the format table, then close the file.
+    static void Close();
+
+    static bool IsEnabled(uint32_t level) {
+        return (GetState().levels & level) != 0;
+    }
+
+    // Returns the id of a new format; called once per BINARY_LOG statement
+    static uint16_t Register(uint32_t level, const char *format);
+
+    template <typename... Args>
+    static void Write(uint16_t formatId, Args... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "BINARY_LOG takes at most four arguments");
+        Record record;
+        record.timeNs = Simulator::Now().GetNanoSeconds();
+        record.formatId = formatId;
+        record.numArgs = sizeof...(Args);
+        uint32_t i = 0;
+        int expand[] = {0, (Encode(record, i++, args), 0)...};
+        (void)expand;
+        if (GetState().text) {
+            std::clog << Format(record) << std::endl;
+            return;
+        }
+        Ring &ring = GetRing();
+        ring.records[ring.written++ % ring.records.size()] = record;
+        if (GetState().spill && ring.written % ring.records.size() == 0) {
+            WriteBlock(ring.thread, ring.records.data(), ring.records.size());
+        }
+    }
+
+private:
+    struct Record {
+        int64_t timeNs;
+        uint16_t formatId;
+        uint8_t numArgs;
+        char tags[MAX_ARGS]; // 'u', 'i', 'f', 't' (ns), 'a' (IPv4) or 'm' (MAC) per argument
+        uint64_t args[MAX_ARGS];
+    };
+
+    struct Ring {
+        uint32_t thread;
+        std::vector<Record> records;
+        uint64_t written; // records ever written
+    };
+
+    struct State {
+        uint32_t levels = 0;
+        bool text = false;
+        bool spill = false;
+        uint32_t ringRecords = 0;
+        FILE *file = nullptr;
+        std::mutex mutex; // guards the format table, the ring list and the file
+        std::vector<std::pair<uint32_t, std::string>> formats;
+        std::vector<std::unique_ptr<Ring>> rings;
+    };
+
+    static State &GetState() {
+        static State state;
+        return state;
+    }
+
+    static Ring &GetRing() {
+        thread_local Ring *ring = nullptr;
+        if (!ring) {
+            State &state = GetState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.rings.push_back(std::make_unique<Ring>());
+            ring = state.rings.back().get();
+            ring->thread = state.rings.size() - 1;
+            ring->records.resize(state.ringRecords);
+            ring->written = 0;
+        }
+        return *ring;
+    }
+
+    static void Encode(Record &record, uint32_t i, uint64_t value) {
+        record.tags[i] = 'u';
+        record.args[i] = value;
+    }
+
+    static void Encode(Record &record, uint32_t i, uint32_t value) {
+        Encode(record, i, static_cast<uint64_t>(value));
+    }
+
+    static void Encode(Record &record, uint32_t i, int64_t value) {
+        record.tags[i] = 'i';
+        record.args[i] = static_cast<uint64_t>(value);
+    }
+
+    static void Encode(Record &record, uint32_t i, int32_t value) {
+        Encode(record, i, static_cast<int64_t>(value));
+    }
+
+    static void Encode(Record &record, uint32_t i, double value) {
+        record.tags[i] = 'f';
+        memcpy(&record.args[i], &value, sizeof(value));
+    }
+
+    static void Encode(Record &record, uint32_t i, Time value) {
+        record.tags[i] = 't';
+        record.args[i] = static_cast<uint64_t>(value.GetNanoSeconds());
+    }
+
+    static void Encode(Record &record, uint32_t i, Ipv4Address value) {
+        record.tags[i] = 'a';
+        record.args[i] = value.Get();
+    }
+
+    static void Encode(Record &record, uint32_t i, Mac48Address value) {
+        uint8_t bytes[6];
+        value.CopyTo(bytes);
+        record.tags[i] = 'm';
+        record.args[i] = 0;
+        for (uint32_t b = 0; b < 6; ++b) {
+            record.args[i] = (record.args[i] << 8) | bytes[b];
+        }
+    }
+
+    static std::string Format(const Record &record);
+    static void WriteBlock(uint32_t thread, const Record *records, uint32_t count);
+};
+
+void BinaryLog::Open(const std::string &fileName, uint32_t levels, uint32_t ringRecords, bool spill) {
+    State &state = GetState();
+    NS_ABORT_MSG_IF(ringRecords == 0, "The binary log rings need at least one record");
+    state.file = fopen(fileName.c_str(), "wb");
+    NS_ABORT_MSG_IF(!state.file, "Cannot open binary log " << fileName);
+    fwrite("NS3BLOG1", 8, 1, state.file);
+    state.ringRecords = ringRecords;
+    state.spill = spill;
+    state.text = false;
+    state.levels = levels;
+}
+
+void BinaryLog::EnableText(uint32_t levels) {
+    GetState().text = true;
+    GetState().levels = levels;
+}
+
+uint16_t BinaryLog::Register(uint32_t level, const char *format) {
+    State &state = GetState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    NS_ABORT_MSG_IF(state.formats.size() > 0xffff, "Too many binary log formats");
+    state.formats.emplace_back(level, format);
+    return state.formats.size() - 1;
+}
+
+std::string BinaryLog::Format(const Record &record) {
+    std::unique_lock<std::mutex> lock(GetState().mutex);
+    std::string format = GetState().formats[record.formatId].second;
+    lock.unlock();
+    std::ostringstream oss;
+    uint32_t arg = 0;
+    for (std::size_t pos = 0; pos < format.size(); ++pos) {
+        if (format.compare(pos, 2, "{}") != 0 || arg == record.numArgs) {
+            oss << format[pos];
+            continue;
+        }
+        uint64_t value = record.args[arg];
+        switch (record.tags[arg++]) {
+        case 'u':
+            oss << value;
+            break;
+        case 'i':
+            oss << static_cast<int64_t>(value);
+            break;
+        case 'f': {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            oss << d;
+            break;
+        }
+        case 't':
+            oss << static_cast<int64_t>(value) << "ns";
+            break;
+        case 'a':
+            oss << Ipv4Address(static_cast<uint32_t>(value));
+            break;
+        case 'm':
+            for (int shift = 40; shift >= 0; shift -= 8) {
+                oss << std::hex << std::setw(2) << std::setfill('0') << ((value >> shift) & 0xff)
+                    << std::dec << (shift > 0 ? ":" : "");
+            }
+            break;
+        }
+        pos++;
+    }
+    return oss.str();
+}
+
+void BinaryLog::WriteBlock(uint32_t thread, const Record *records, uint32_t count) {
+    State &state = GetState();
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(state.mutex);
+    uint32_t header[2] = {thread, count};
+    fwrite(header, sizeof(header), 1, state.file);
+    fwrite(records, sizeof(Record), count, state.file);
+}
+
+void BinaryLog::Close() {
+    State &state = GetState();
+    if (!state.file) {
+        return;
+    }
+    state.levels = 0;
+    for (const auto &ring : state.rings) {
+        uint64_t size = ring->records.size();
+        uint64_t next = ring->written % size;
+        if (!state.spill && ring->written >= size) {
+            // Full: the oldest record kept is the one to be overwritten next
+            WriteBlock(ring->thread, ring->records.data() + next, size - next);
+        }
+        WriteBlock(ring->thread, ring->records.data(), next);
+    }
+    uint64_t formatsOffset = ftell(state.file);
+    uint32_t numFormats = state.formats.size();
+    fwrite(&numFormats, sizeof(numFormats), 1, state.file);
+    for (const auto &format : state.formats) {
+        uint32_t header[2] = {format.first, static_cast<uint32_t>(format.second.size())};
+        fwrite(header, sizeof(header), 1, state.file);
+        fwrite(format.second.data(), format.second.size(), 1, state.file);
+    }
+    fwrite(&formatsOffset, sizeof(formatsOffset), 1, state.file);
+    fclose(state.file);
+    state.file = nullptr;
+}
+
+// Function to send UDP packets from sensors to the sink; rescheduling is done by the wheel
+void SendPacket(Ptr<Socket> socket, Address sinkAddr, Ptr<Packet> prototype) {
+    socket->SendTo(prototype->Copy(), 0, sinkAddr); // Copy-on-write, no per-report payload allocation
 }
 
 // Function to receive packets at the sink node
 void ReceivePacket(Ptr<Socket> socket) {
-    while (socket->Recv()) {
-        NS_LOG_INFO("Sink node received a packet from a sensor!");
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = socket->RecvFrom(from))) {
+        BINARY_LOG(LOG_INFO, "Sink node received a {}-byte packet from sensor {}",
+                   packet->GetSize(), InetSocketAddress::ConvertFrom(from).GetIpv4());
     }
 }
 
 int main(int argc, char *argv[]) {
-    LogComponentEnable("UdpWSNExample", LOG_LEVEL_INFO);
-
     int numSensors = 20;
     double simTime = 50.0;
+    std::string binaryLog;
+    uint32_t binaryLogRecords = 65536;
+    bool binaryLogSpill = false;
+
+    CommandLine cmd;
+    cmd.AddValue("numSensors", "Number of sensor nodes", numSensors);
+    cmd.AddValue("simTime", "Simulation time in seconds", simTime);
+    cmd.AddValue("binaryLog", "Record the log in this binary file instead of printing it", binaryLog);
+    cmd.AddValue("binaryLogRecords", "Binary log records kept per thread", binaryLogRecords);
+    cmd.AddValue("binaryLogSpill", "Write full binary log rings to the file instead of overwriting them", binaryLogSpill);
+    cmd.Parse(argc, argv);
+
+    if (binaryLog.empty()) {
+        BinaryLog::EnableText(LOG_LEVEL_INFO);
+    } else {
+        BinaryLog::Open(binaryLog, LOG_LEVEL_INFO, binaryLogRecords, binaryLogSpill);
+    }
 
     // Create nodes (sensor nodes + 1 sink)
     NodeContainer sensors;
@@ -93,15 +487,19 @@ int main(int argc, char *argv[]) {
     sinkSocket->Bind(InetSocketAddress(Ipv4Address::GetAny(), port));
     sinkSocket->SetRecvCallback(MakeCallback(&ReceivePacket));
 
-    // Setup UDP Clients in Sensor Nodes
+    // Setup UDP Clients in Sensor Nodes, all driven every 2 s by one timer wheel
+    PeriodicSenderWheel wheel(Seconds(2.0), MilliSeconds(10));
+    Ptr<Packet> prototype = Create<Packet>(256); // 256-byte packet shared by all sensors
+    Address sinkAddr = InetSocketAddress(sinkInterface.GetAddress(0), port);
     for (int i = 0; i < numSensors; i++) {
         Ptr<Socket> sensorSocket = Socket::CreateSocket(sensors.Get(i), UdpSocketFactory::GetTypeId());
-        Simulator::Schedule(Seconds(2.0 + i * 0.5), &SendPacket, sensorSocket, sinkInterface.GetAddress(0), port);
+        wheel.Add(Seconds(2.0 + i * 0.5), MakeBoundCallback(&SendPacket, sensorSocket, sinkAddr, prototype));
     }
 
     // Run the simulation
     Simulator::Stop(Seconds(simTime));
     Simulator::Run();
+    BinaryLog::Close();
     Simulator::Destroy();
 
     return 0;
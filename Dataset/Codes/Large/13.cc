@@ -53,9 +53,15 @@
 #include "ns3/qos-txop.h"
 #include "ns3/ssid.h"
 #include "ns3/string.h"
+#include "ns3/waypoint-mobility-model.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
 using namespace ns3;
 
 //
@@ -63,6 +69,388 @@ using namespace ns3;
 //
 NS_LOG_COMPONENT_DEFINE("MixedWireless");
 
+/**
+ * Positions and velocities of all nodes, kept in contiguous arrays indexed by node id.
+ *
+ * Attach() reads each node's mobility model once and then follows its CourseChange
+ * trace, so the arrays hold every node's position and velocity as of its last course
+ * change. ns-3 mobility models move in straight lines at constant velocity between
+ * course changes, so SnapshotPositions(t) brings all nodes to time t in one pass over
+ * the arrays, with no aggregate lookup or model update per node. Nodes without a
+ * mobility model stay at the origin.
+ */
+class MobilitySnapshot
+{
+  public:
+    /// Track the nodes of the NodeList not tracked yet; call again after creating more.
+    void Attach();
+
+    /**
+     * Compute the positions of all nodes at a time.
+     * \param t the time, not before the current simulation time; a later time assumes
+     *          no course change until then
+     */
+    void SnapshotPositions(Time t);
+
+    /**
+     * Write the last snapshot, one "<time> <node id> <x> <y> <z>" line per node.
+     * \param os the output stream
+     */
+    void Print(std::ostream& os) const;
+
+    /// \return the number of nodes tracked
+    uint32_t GetN() const
+    {
+        return m_x.size();
+    }
+
+    /**
+     * \param nodeId the node id
+     * \return the position of the node at the last snapshot
+     */
+    Vector GetPosition(uint32_t nodeId) const
+    {
+        return Vector(m_x[nodeId], m_y[nodeId], m_z[nodeId]);
+    }
+
+    /// \return the x coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetX() const
+    {
+        return m_x;
+    }
+
+    /// \return the y coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetY() const
+    {
+        return m_y;
+    }
+
+    /// \return the z coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetZ() const
+    {
+        return m_z;
+    }
+
+  private:
+    /**
+     * CourseChange trace sink; records the new position and velocity of a node.
+     * \param snapshot the snapshot
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    static void CourseChanged(MobilitySnapshot* snapshot,
+                              uint32_t nodeId,
+                              Ptr<const MobilityModel> model);
+
+    /**
+     * Record the current position and velocity of a node.
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    void Update(uint32_t nodeId, Ptr<const MobilityModel> model);
+
+    std::vector<double> m_time;  //!< Time of the last course change, in seconds.
+    std::vector<double> m_baseX; //!< x coordinate at the last course change.
+    std::vector<double> m_baseY; //!< y coordinate at the last course change.
+    std::vector<double> m_baseZ; //!< z coordinate at the last course change.
+    std::vector<double> m_velX;  //!< x velocity since the last course change.
+    std::vector<double> m_velY;  //!< y velocity since the last course change.
+    std::vector<double> m_velZ;  //!< z velocity since the last course change.
+    std::vector<double> m_x;     //!< x coordinate at the last snapshot.
+    std::vector<double> m_y;     //!< y coordinate at the last snapshot.
+    std::vector<double> m_z;     //!< z coordinate at the last snapshot.
+    Time m_snapshotTime;         //!< Time of the last snapshot.
+};
+
+void
+MobilitySnapshot::Attach()
+{
+    uint32_t first = m_x.size();
+    uint32_t n = NodeList::GetNNodes();
+    m_time.resize(n, 0.0);
+    m_baseX.resize(n, 0.0);
+    m_baseY.resize(n, 0.0);
+    m_baseZ.resize(n, 0.0);
+    m_velX.resize(n, 0.0);
+    m_velY.resize(n, 0.0);
+    m_velZ.resize(n, 0.0);
+    m_x.resize(n, 0.0);
+    m_y.resize(n, 0.0);
+    m_z.resize(n, 0.0);
+    for (uint32_t i = first; i < n; ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!model)
+        {
+            continue;
+        }
+        Update(i, model);
+        model->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&MobilitySnapshot::CourseChanged, this, i));
+    }
+    SnapshotPositions(Simulator::Now());
+}
+
+void
+MobilitySnapshot::CourseChanged(MobilitySnapshot* snapshot,
+                                uint32_t nodeId,
+                                Ptr<const MobilityModel> model)
+{
+    snapshot->Update(nodeId, model);
+}
+
+void
+MobilitySnapshot::Update(uint32_t nodeId, Ptr<const MobilityModel> model)
+{
+    Vector position = model->GetPosition();
+    Vector velocity = model->GetVelocity();
+    m_time[nodeId] = Simulator::Now().GetSeconds();
+    m_baseX[nodeId] = position.x;
+    m_baseY[nodeId] = position.y;
+    m_baseZ[nodeId] = position.z;
+    m_velX[nodeId] = velocity.x;
+    m_velY[nodeId] = velocity.y;
+    m_velZ[nodeId] = velocity.z;
+}
+
+void
+MobilitySnapshot::SnapshotPositions(Time t)
+{
+    const double now = t.GetSeconds();
+    const std::size_t n = m_x.size();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        double elapsed = now - m_time[i];
+        m_x[i] = m_baseX[i] + m_velX[i] * elapsed;
+        m_y[i] = m_baseY[i] + m_velY[i] * elapsed;
+        m_z[i] = m_baseZ[i] + m_velZ[i] * elapsed;
+    }
+    m_snapshotTime = t;
+}
+
+void
+MobilitySnapshot::Print(std::ostream& os) const
+{
+    double time = m_snapshotTime.GetSeconds();
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        os << time << " " << i << " " << m_x[i] << " " << m_y[i] << " " << m_z[i] << "\n";
+    }
+}
+
+/**
+ * Records the course changes of all nodes to a compact binary file.
+ *
+ * Each record holds the time, the node id, and the position and velocity right after
+ * the change. Records are packed into a buffer that is written in large blocks, and
+ * Close() adds one record per node at the end of the run so the last leg of every
+ * trajectory is known. MobilityTraceReplay drives the nodes from the file.
+ *
+ * File layout: the magic "NS3MOBT1", then RECORD_SIZE byte records of an int64 time in
+ * nanoseconds, a uint32 node id and six doubles (position x, y, z and velocity x, y, z),
+ * packed without padding. Numbers are in host byte order.
+ */
+class MobilityTraceRecorder
+{
+  public:
+    static const std::size_t RECORD_SIZE = 8 + 4 + 6 * 8; //!< Bytes per record.
+
+    /**
+     * Record the current position of every node, then every course change.
+     * \param fileName the output file
+     */
+    void Open(const std::string& fileName);
+
+    /// Record the current position of every node, write the buffer and close the file.
+    void Close();
+
+  private:
+    static const std::size_t BUFFER_RECORDS = 4096; //!< Records buffered before a write.
+
+    /**
+     * CourseChange trace sink.
+     * \param recorder the recorder
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    static void CourseChanged(MobilityTraceRecorder* recorder,
+                              uint32_t nodeId,
+                              Ptr<const MobilityModel> model);
+
+    /**
+     * Append a record of the current position and velocity of a node.
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    void Write(uint32_t nodeId, Ptr<const MobilityModel> model);
+
+    /// Write the buffered records to the file.
+    void Flush();
+
+    FILE* m_file{nullptr};      //!< Output file, null when closed.
+    std::vector<char> m_buffer; //!< Packed records not written yet.
+};
+
+void
+MobilityTraceRecorder::Open(const std::string& fileName)
+{
+    m_file = fopen(fileName.c_str(), "wb");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open mobility trace " << fileName);
+    fwrite("NS3MOBT1", 8, 1, m_file);
+    m_buffer.reserve(BUFFER_RECORDS * RECORD_SIZE);
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!model)
+        {
+            continue;
+        }
+        Write(i, model);
+        model->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&MobilityTraceRecorder::CourseChanged, this, i));
+    }
+}
+
+void
+MobilityTraceRecorder::CourseChanged(MobilityTraceRecorder* recorder,
+                                     uint32_t nodeId,
+                                     Ptr<const MobilityModel> model)
+{
+    recorder->Write(nodeId, model);
+}
+
+void
+MobilityTraceRecorder::Write(uint32_t nodeId, Ptr<const MobilityModel> model)
+{
+    if (!m_file)
+    {
+        return;
+    }
+    int64_t timeNs = Simulator::Now().GetNanoSeconds();
+    Vector position = model->GetPosition();
+    Vector velocity = model->GetVelocity();
+    double values[6] = {position.x, position.y, position.z, velocity.x, velocity.y, velocity.z};
+
+    std::size_t offset = m_buffer.size();
+    m_buffer.resize(offset + RECORD_SIZE);
+    char* record = m_buffer.data() + offset;
+    memcpy(record, &timeNs, sizeof(timeNs));
+    memcpy(record + 8, &nodeId, sizeof(nodeId));
+    memcpy(record + 12, values, sizeof(values));
+    if (m_buffer.size() == BUFFER_RECORDS * RECORD_SIZE)
+    {
+        Flush();
+    }
+}
+
+void
+MobilityTraceRecorder::Flush()
+{
+    if (!m_buffer.empty())
+    {
+        fwrite(m_buffer.data(), m_buffer.size(), 1, m_file);
+        m_buffer.clear();
+    }
+}
+
+void
+MobilityTraceRecorder::Close()
+{
+    if (!m_file)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (model)
+        {
+            Write(i, model);
+        }
+    }
+    Flush();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+/**
+ * Drives the nodes along the trajectories of a MobilityTraceRecorder file.
+ *
+ * Between course changes nodes move in straight lines at constant velocity, so the
+ * recorded positions are the waypoints of a WaypointMobilityModel that reproduces the
+ * recorded movement without the random draws and model logic of the original run.
+ */
+class MobilityTraceReplay
+{
+  public:
+    /**
+     * Aggregate a WaypointMobilityModel following the trace to each recorded node.
+     * The nodes must exist and have no mobility model yet.
+     * \param fileName the mobility trace
+     * \return the number of nodes driven
+     */
+    static uint32_t Install(const std::string& fileName);
+};
+
+uint32_t
+MobilityTraceReplay::Install(const std::string& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    NS_ABORT_MSG_IF(!file, "Cannot open mobility trace " << fileName);
+    char magic[8];
+    NS_ABORT_MSG_IF(fread(magic, 8, 1, file) != 1 || std::string(magic, 8) != "NS3MOBT1",
+                    fileName << " is not a mobility trace");
+
+    std::vector<std::vector<Waypoint>> waypoints;
+    char record[MobilityTraceRecorder::RECORD_SIZE];
+    while (fread(record, sizeof(record), 1, file) == 1)
+    {
+        int64_t timeNs;
+        uint32_t nodeId;
+        double values[6];
+        memcpy(&timeNs, record, sizeof(timeNs));
+        memcpy(&nodeId, record + 8, sizeof(nodeId));
+        memcpy(values, record + 12, sizeof(values));
+        if (nodeId >= waypoints.size())
+        {
+            waypoints.resize(nodeId + 1);
+        }
+        Waypoint waypoint(NanoSeconds(timeNs), Vector(values[0], values[1], values[2]));
+        // Waypoint times must increase, so the last change at a given time wins
+        std::vector<Waypoint>& path = waypoints[nodeId];
+        if (!path.empty() && path.back().time == waypoint.time)
+        {
+            path.back() = waypoint;
+        }
+        else
+        {
+            path.push_back(waypoint);
+        }
+    }
+    fclose(file);
+
+    uint32_t driven = 0;
+    for (uint32_t i = 0; i < waypoints.size(); ++i)
+    {
+        if (waypoints[i].empty())
+        {
+            continue;
+        }
+        NS_ABORT_MSG_IF(i >= NodeList::GetNNodes(),
+                        fileName << " records node " << i << ", which does not exist");
+        Ptr<WaypointMobilityModel> model = CreateObject<WaypointMobilityModel>();
+        for (const Waypoint& waypoint : waypoints[i])
+        {
+            model->AddWaypoint(waypoint);
+        }
+        NodeList::GetNode(i)->AggregateObject(model);
+        ++driven;
+    }
+    return driven;
+}
+
 /**
  * This function will be used below as a trace sink, if the command-line
  * argument or default value "useCourseChangeCallback" is set to true
@@ -78,6 +466,22 @@ CourseChangeCallback(std::string path, Ptr<const MobilityModel> model)
               << ", z=" << position.z << std::endl;
 }
 
+/**
+ * This function samples the positions of all nodes and reschedules itself, if the
+ * command-line argument "positionInterval" is set
+ *
+ * \param positions The position snapshot.
+ * \param os The output stream.
+ * \param interval The time between samples.
+ */
+static void
+SamplePositions(MobilitySnapshot* positions, std::ofstream* os, Time interval)
+{
+    positions->SnapshotPositions(Simulator::Now());
+    positions->Print(*os);
+    Simulator::Schedule(interval, &SamplePositions, positions, os, interval);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -90,6 +494,9 @@ main(int argc, char* argv[])
     uint32_t lanNodes = 2;
     uint32_t stopTime = 20;
     bool useCourseChangeCallback = false;
+    double positionInterval = 0;
+    std::string mobilityRecord;
+    std::string mobilityReplay;
 
     //
     // Simulation defaults are typically set next, before command line
@@ -111,6 +518,15 @@ main(int argc, char* argv[])
     cmd.AddValue("useCourseChangeCallback",
                  "whether to enable course change tracing",
                  useCourseChangeCallback);
+    cmd.AddValue("positionInterval",
+                 "seconds between samples of all node positions, 0 to disable",
+                 positionInterval);
+    cmd.AddValue("mobilityRecord",
+                 "binary file to record the course changes of all nodes to",
+                 mobilityRecord);
+    cmd.AddValue("mobilityReplay",
+                 "binary file of recorded course changes to move all nodes by instead",
+                 mobilityReplay);
 
     //
     // The system global variables and the local values added to the argument
@@ -195,7 +611,10 @@ main(int argc, char* argv[])
                               StringValue("ns3::ConstantRandomVariable[Constant=2]"),
                               "Pause",
                               StringValue("ns3::ConstantRandomVariable[Constant=0.2]"));
-    mobility.Install(backbone);
+    if (mobilityReplay.empty())
+    {
+        mobility.Install(backbone);
+    }
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -251,10 +670,13 @@ main(int argc, char* argv[])
         {
             subnetAlloc->Add(Vector(0.0, j * 10 + 10, 0.0));
         }
-        mobilityLan.PushReferenceMobilityModel(backbone.Get(i));
-        mobilityLan.SetPositionAllocator(subnetAlloc);
-        mobilityLan.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-        mobilityLan.Install(newLanNodes);
+        if (mobilityReplay.empty())
+        {
+            mobilityLan.PushReferenceMobilityModel(backbone.Get(i));
+            mobilityLan.SetPositionAllocator(subnetAlloc);
+            mobilityLan.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+            mobilityLan.Install(newLanNodes);
+        }
     }
 
     ///////////////////////////////////////////////////////////////////////////
@@ -322,16 +744,28 @@ main(int argc, char* argv[])
         {
             subnetAlloc->Add(Vector(0.0, j, 0.0));
         }
-        mobility.PushReferenceMobilityModel(backbone.Get(i));
-        mobility.SetPositionAllocator(subnetAlloc);
-        mobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
-                                  "Bounds",
-                                  RectangleValue(Rectangle(-10, 10, -10, 10)),
-                                  "Speed",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=3]"),
-                                  "Pause",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=0.4]"));
-        mobility.Install(stas);
+        if (mobilityReplay.empty())
+        {
+            mobility.PushReferenceMobilityModel(backbone.Get(i));
+            mobility.SetPositionAllocator(subnetAlloc);
+            mobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
+                                      "Bounds",
+                                      RectangleValue(Rectangle(-10, 10, -10, 10)),
+                                      "Speed",
+                                      StringValue("ns3::ConstantRandomVariable[Constant=3]"),
+                                      "Pause",
+                                      StringValue("ns3::ConstantRandomVariable[Constant=0.4]"));
+            mobility.Install(stas);
+        }
+    }
+
+    //
+    // When replaying, every node follows its recorded trajectory instead of the models
+    // above
+    //
+    if (!mobilityReplay.empty())
+    {
+        MobilityTraceReplay::Install(mobilityReplay);
     }
 
     ///////////////////////////////////////////////////////////////////////////
@@ -404,6 +838,28 @@ main(int argc, char* argv[])
                         MakeCallback(&CourseChangeCallback));
     }
 
+    //
+    // Sample all node positions from one snapshot instead of querying each model
+    //
+    MobilitySnapshot positions;
+    std::ofstream positionsFile;
+    if (positionInterval > 0)
+    {
+        positionsFile.open("mixed-wireless.positions");
+        positions.Attach();
+        Simulator::Schedule(Seconds(0),
+                            &SamplePositions,
+                            &positions,
+                            &positionsFile,
+                            Seconds(positionInterval));
+    }
+
+    MobilityTraceRecorder mobilityRecorder;
+    if (!mobilityRecord.empty())
+    {
+        mobilityRecorder.Open(mobilityRecord);
+    }
+
     AnimationInterface anim("mixed-wireless.xml");
 
     ///////////////////////////////////////////////////////////////////////////
@@ -415,6 +871,7 @@ main(int argc, char* argv[])
     NS_LOG_INFO("Run Simulation.");
     Simulator::Stop(Seconds(stopTime));
     Simulator::Run();
+    mobilityRecorder.Close();
     Simulator::Destroy();
 
     return 0;
@@ -14,17 +14,48 @@ int main(int argc, char *argv[])
 {
     // Set simulation time
     double simulationTime = 10.0;
+    uint32_t numEnbs = 1;
+    uint32_t numUes = 2;
+    bool fastPhy = false;
+
+    CommandLine cmd;
+    cmd.AddValue("numEnbs", "Number of eNodeBs, 500 m apart on a line", numEnbs);
+    cmd.AddValue("numUes", "Number of UEs, spread round-robin over the eNodeBs", numUes);
+    cmd.AddValue("fastPhy", "Turn off the per-TB error models and per-RB CQI", fastPhy);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(numEnbs < 1 || numUes < 1, "numEnbs and numUes must be at least 1");
+
+    // Cheaper LTE PHY settings for many UEs: no per-TB MIESM error models, wideband
+    // instead of per-RB PDSCH CQI, the closed-form PiroEW2010 AMC and no uplink power
+    // control. Interference and SINR are still computed per RB on the spectrum channel,
+    // so this trims per-TB work rather than abstracting the PHY. RRC, EPC and bearer
+    // setup are unchanged. Config defaults only reach objects created afterwards, so
+    // this comes before the helpers.
+    if (fastPhy)
+    {
+        Config::SetDefault("ns3::LteSpectrumPhy::CtrlErrorModelEnabled", BooleanValue(false));
+        Config::SetDefault("ns3::LteSpectrumPhy::DataErrorModelEnabled", BooleanValue(false));
+        Config::SetDefault("ns3::LteHelper::UsePdschForCqiGeneration", BooleanValue(false));
+        Config::SetDefault("ns3::LteAmc::AmcModel", EnumValue(LteAmc::PiroEW2010));
+        Config::SetDefault("ns3::LteUePhy::EnableUplinkPowerControl", BooleanValue(false));
+    }
+    // The default SRS periodicity of 40 admits at most 40 UEs per eNodeB
+    if ((numUes + numEnbs - 1) / numEnbs > 40)
+    {
+        Config::SetDefault("ns3::LteEnbRrc::SrsPeriodicity", UintegerValue(320));
+    }
 
     // Create LTE Helper and EPC Helper for LTE core
     Ptr<LteHelper> lteHelper = CreateObject<LteHelper>();
     Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper>();
     lteHelper->SetEpcHelper(epcHelper);
 
-    // Create nodes: 1 eNodeB, 2 UEs (User Equipments), and 1 Remote Host
+    // Create nodes: numEnbs eNodeBs, numUes UEs (User Equipments), and 1 Remote Host
     NodeContainer ueNodes;
-    ueNodes.Create(2);
+    ueNodes.Create(numUes);
     NodeContainer enbNodes;
-    enbNodes.Create(1);
+    enbNodes.Create(numEnbs);
 
     Ptr<Node> pgw = epcHelper->GetPgwNode();
 
@@ -62,6 +93,18 @@ int main(int argc, char *argv[])
     mobility.Install(enbNodes);
     mobility.Install(ueNodes);
 
+    // eNodeB i at 500 * i m on the x axis; UE j is served by eNodeB j % numEnbs and
+    // sits 10 m further out than the previous UE of that eNodeB
+    for (uint32_t i = 0; i < numEnbs; ++i)
+    {
+        enbNodes.Get(i)->GetObject<MobilityModel>()->SetPosition(Vector(500.0 * i, 0.0, 0.0));
+    }
+    for (uint32_t j = 0; j < numUes; ++j)
+    {
+        double x = 500.0 * (j % numEnbs) + 10.0 * (j / numEnbs + 1);
+        ueNodes.Get(j)->GetObject<MobilityModel>()->SetPosition(Vector(x, 0.0, 0.0));
+    }
+
     // Install the IP stack on UEs
     internet.Install(ueNodes);
     Ipv4InterfaceContainer ueIpIfaces = epcHelper->AssignUeIpv4Address(NetDeviceContainer(ueLteDevs));
@@ -73,8 +116,11 @@ int main(int argc, char *argv[])
         ueStaticRouting->SetDefaultRoute(epcHelper->GetUeDefaultGatewayAddress(), 1);
     }
 
-    // Attach UEs to the eNodeB
-    lteHelper->Attach(ueLteDevs, enbLteDevs.Get(0));
+    // Attach every UE to its eNodeB
+    for (uint32_t j = 0; j < numUes; ++j)
+    {
+        lteHelper->Attach(ueLteDevs.Get(j), enbLteDevs.Get(j % numEnbs));
+    }
 
     // Install UDP traffic applications on UEs
     uint16_t dlPort = 1234;
@@ -85,9 +131,7 @@ int main(int argc, char *argv[])
     dlClient.SetAttribute("MaxPackets", UintegerValue(1000000));
     dlClient.SetAttribute("PacketSize", UintegerValue(1024));
 
-    ApplicationContainer clientApps;
-    clientApps.Add(dlClient.Install(ueNodes.Get(0)));
-    clientApps.Add(dlClient.Install(ueNodes.Get(1)));
+    ApplicationContainer clientApps = dlClient.Install(ueNodes);
 
     UdpServerHelper ulServer(ulPort);
     ApplicationContainer serverApps = ulServer.Install(remoteHost);
@@ -100,9 +144,12 @@ int main(int argc, char *argv[])
 
     // Enable NetAnim for visualization
     AnimationInterface anim("lte_netanim.xml");
-    anim.SetConstantPosition(enbNodes.Get(0), 50.0, 50.0); // eNodeB
-    anim.SetConstantPosition(ueNodes.Get(0), 60.0, 50.0);  // UE 1
-    anim.SetConstantPosition(ueNodes.Get(1), 70.0, 50.0);  // UE 2
+    NodeContainer radioNodes(enbNodes, ueNodes);
+    for (uint32_t i = 0; i < radioNodes.GetN(); ++i)
+    {
+        Vector position = radioNodes.Get(i)->GetObject<MobilityModel>()->GetPosition();
+        anim.SetConstantPosition(radioNodes.Get(i), 50.0 + position.x, 50.0 + position.y);
+    }
     anim.EnablePacketMetadata(true);                       // Enable packet tracking
 
     // Run simulation
@@ -3,17 +3,367 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/mobility-module.h"
 #include "ns3/netanim-module.h"
 
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("FatTreeDataCenter");
 
+/**
+ * Compact binary NetAnim trace, for runs too large for AnimationInterface's XML.
+ *
+ * Records are varint encoded on the simulation thread and handed over in 64 KiB blocks
+ * to a writer thread that does the file I/O. Node positions are polled, but only when
+ * some node can move, and a node only gets a record when it has moved; the record holds
+ * the change since its last written position, in centimetres. Packet events can be
+ * sampled: a packet is kept when a hash of its uid falls below the sampling ratio, so
+ * all events of a kept packet are kept together. Packet metadata is off by default and
+ * can be limited to one in N kept packets. Examples/netanim-binary-to-xml.cc converts
+ * the file to NetAnim XML.
+ *
+ * The file is the magic "NS3ANIM1" followed by records. A record is a type byte, the
+ * time since the previous record in nanoseconds and its fields; integers are LEB128
+ * varints, signed ones zigzag encoded, and strings a length followed by the bytes.
+ *   1 NODE:  node, x, y                        initial position
+ *   2 MOVE:  node, dx, dy                      position change
+ *   3 LINK:  fromNode, toNode                  point-to-point link
+ *   4 WIRED: uid, from, to, txTime, rxTime, meta
+ *            first bit sent now, last bit sent after txTime, last bit received
+ *            after rxTime, first bit received after rxTime - txTime
+ *   5 WTX:   uid, from, meta                   wireless transmission starts now
+ *   6 WRX:   uid, to                           wireless reception ends now
+ */
+class BinaryAnimTrace
+{
+  public:
+    /**
+     * \param fileName output file
+     * \param pollInterval interval between two polls of the mobility models
+     */
+    BinaryAnimTrace(const std::string& fileName, Time pollInterval);
+    ~BinaryAnimTrace();
+
+    /// Keep only this fraction of the packets, chosen by uid.
+    void SetPacketSampling(double ratio);
+
+    /// Record the metadata of one in 'every' kept packets; 0 disables metadata.
+    void EnablePacketMetadata(uint32_t every);
+
+    /// Flush the last records, stop the writer thread and close the file.
+    void Close();
+
+  private:
+    static const uint32_t BLOCK_BYTES = 1 << 16;
+    static const uint32_t MAX_PENDING_BLOCKS = 64;
+
+    void Start();
+    void Poll();
+    void WiredTx(Ptr<const Packet> packet,
+                 Ptr<NetDevice> txDevice,
+                 Ptr<NetDevice> rxDevice,
+                 Time txTime,
+                 Time rxTime);
+    bool IsSampled(Ptr<const Packet> packet) const;
+    void PutMetadata(Ptr<const Packet> packet);
+    void BeginRecord(uint8_t type);
+    void EndRecord();
+    void PutVarint(uint64_t value);
+    void PutSigned(int64_t value);
+    void Flush();
+    void Run();
+
+    FILE* m_file;
+    Time m_pollInterval;
+    double m_sampleRatio;
+    uint32_t m_metadataEvery;
+    uint32_t m_metadataCount;
+    int64_t m_lastNs;
+    std::vector<int64_t> m_x; //!< last written position per node, cm
+    std::vector<int64_t> m_y;
+    std::vector<uint8_t> m_block;             //!< block being filled, simulation thread
+    std::deque<std::vector<uint8_t>> m_queue; //!< blocks waiting for the writer
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_drained;
+    bool m_stop;
+};
+
+BinaryAnimTrace::BinaryAnimTrace(const std::string& fileName, Time pollInterval)
+    : m_pollInterval(pollInterval),
+      m_sampleRatio(1.0),
+      m_metadataEvery(0),
+      m_metadataCount(0),
+      m_lastNs(0),
+      m_stop(false)
+{
+    m_file = fopen(fileName.c_str(), "wb");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open animation trace " << fileName);
+    fwrite("NS3ANIM1", 8, 1, m_file);
+    m_block.reserve(BLOCK_BYTES + 256);
+    m_writer = std::thread(&BinaryAnimTrace::Run, this);
+    Simulator::Schedule(Seconds(0), &BinaryAnimTrace::Start, this);
+}
+
+BinaryAnimTrace::~BinaryAnimTrace()
+{
+    Close();
+}
+
+void
+BinaryAnimTrace::SetPacketSampling(double ratio)
+{
+    m_sampleRatio = ratio;
+}
+
+void
+BinaryAnimTrace::EnablePacketMetadata(uint32_t every)
+{
+    m_metadataEvery = every;
+    if (every > 0)
+    {
+        Packet::EnablePrinting();
+    }
+}
+
+void
+BinaryAnimTrace::Start()
+{
+    // Initial positions; nodes without a mobility model sit at the origin
+    bool mobile = false;
+    m_x.assign(NodeList::GetNNodes(), 0);
+    m_y.assign(NodeList::GetNNodes(), 0);
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<MobilityModel> mobility = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (mobility)
+        {
+            Vector position = mobility->GetPosition();
+            m_x[i] = std::llround(position.x * 100);
+            m_y[i] = std::llround(position.y * 100);
+            mobile |= !DynamicCast<ConstantPositionMobilityModel>(mobility);
+        }
+        BeginRecord(1);
+        PutVarint(i);
+        PutSigned(m_x[i]);
+        PutSigned(m_y[i]);
+        EndRecord();
+    }
+
+    for (uint32_t i = 0; i < ChannelList::GetNChannels(); ++i)
+    {
+        Ptr<PointToPointChannel> channel =
+            DynamicCast<PointToPointChannel>(ChannelList::GetChannel(i));
+        if (!channel || channel->GetNDevices() != 2)
+        {
+            continue;
+        }
+        BeginRecord(3);
+        PutVarint(channel->GetDevice(0)->GetNode()->GetId());
+        PutVarint(channel->GetDevice(1)->GetNode()->GetId());
+        EndRecord();
+        channel->TraceConnectWithoutContext("TxRxPointToPoint",
+                                            MakeCallback(&BinaryAnimTrace::WiredTx, this));
+    }
+
+    if (mobile)
+    {
+        Simulator::Schedule(m_pollInterval, &BinaryAnimTrace::Poll, this);
+    }
+}
+
+void
+BinaryAnimTrace::Poll()
+{
+    for (uint32_t i = 0; i < m_x.size(); ++i)
+    {
+        Ptr<MobilityModel> mobility = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!mobility)
+        {
+            continue;
+        }
+        Vector position = mobility->GetPosition();
+        int64_t x = std::llround(position.x * 100);
+        int64_t y = std::llround(position.y * 100);
+        if (x != m_x[i] || y != m_y[i])
+        {
+            BeginRecord(2);
+            PutVarint(i);
+            PutSigned(x - m_x[i]);
+            PutSigned(y - m_y[i]);
+            EndRecord();
+            m_x[i] = x;
+            m_y[i] = y;
+        }
+    }
+    Simulator::Schedule(m_pollInterval, &BinaryAnimTrace::Poll, this);
+}
+
+void
+BinaryAnimTrace::WiredTx(Ptr<const Packet> packet,
+                         Ptr<NetDevice> txDevice,
+                         Ptr<NetDevice> rxDevice,
+                         Time txTime,
+                         Time rxTime)
+{
+    if (!IsSampled(packet))
+    {
+        return;
+    }
+    BeginRecord(4);
+    PutVarint(packet->GetUid());
+    PutVarint(txDevice->GetNode()->GetId());
+    PutVarint(rxDevice->GetNode()->GetId());
+    PutVarint(txTime.GetNanoSeconds());
+    PutVarint(rxTime.GetNanoSeconds());
+    PutMetadata(packet);
+    EndRecord();
+}
+
+bool
+BinaryAnimTrace::IsSampled(Ptr<const Packet> packet) const
+{
+    // Fibonacci hashing spreads consecutive uids evenly over [0, 1)
+    uint64_t hash = packet->GetUid() * 0x9e3779b97f4a7c15ULL;
+    return (hash >> 11) * (1.0 / 9007199254740992.0) < m_sampleRatio;
+}
+
+void
+BinaryAnimTrace::PutMetadata(Ptr<const Packet> packet)
+{
+    if (m_metadataEvery == 0 || m_metadataCount++ % m_metadataEvery != 0)
+    {
+        PutVarint(0);
+        return;
+    }
+    std::ostringstream oss;
+    packet->Print(oss);
+    std::string meta = oss.str();
+    PutVarint(meta.size());
+    m_block.insert(m_block.end(), meta.begin(), meta.end());
+}
+
+void
+BinaryAnimTrace::BeginRecord(uint8_t type)
+{
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    m_block.push_back(type);
+    PutVarint(now - m_lastNs);
+    m_lastNs = now;
+}
+
+void
+BinaryAnimTrace::EndRecord()
+{
+    if (m_block.size() >= BLOCK_BYTES)
+    {
+        Flush();
+    }
+}
+
+void
+BinaryAnimTrace::PutVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        m_block.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    m_block.push_back(static_cast<uint8_t>(value));
+}
+
+void
+BinaryAnimTrace::PutSigned(int64_t value)
+{
+    PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void
+BinaryAnimTrace::Flush()
+{
+    if (m_block.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A slow disk holds the simulation back rather than letting the queue grow unbounded
+    while (m_queue.size() >= MAX_PENDING_BLOCKS)
+    {
+        m_drained.wait(lock);
+    }
+    m_queue.push_back(std::move(m_block));
+    m_block = std::vector<uint8_t>();
+    m_block.reserve(BLOCK_BYTES + 256);
+    m_wakeUp.notify_one();
+}
+
+void
+BinaryAnimTrace::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        while (!m_stop && m_queue.empty())
+        {
+            m_wakeUp.wait(lock);
+        }
+        if (m_queue.empty())
+        {
+            break;
+        }
+        std::vector<uint8_t> block = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_drained.notify_one();
+        lock.unlock();
+        fwrite(block.data(), block.size(), 1, m_file);
+        lock.lock();
+    }
+}
+
+void
+BinaryAnimTrace::Close()
+{
+    if (!m_writer.joinable())
+    {
+        return;
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_writer.join();
+    fclose(m_file);
+}
+
 int main(int argc, char *argv[])
 {
     // Simulation parameters
     uint32_t numServers = 4;
     double simulationTime = 10.0; // seconds
+    bool binaryAnim = false;
+    double animSampling = 1.0;
+    uint32_t animMetadata = 0;
+
+    CommandLine cmd;
+    cmd.AddValue("binaryAnim", "Write a binary animation trace instead of NetAnim XML", binaryAnim);
+    cmd.AddValue("animSampling", "Fraction of packets kept in the binary trace", animSampling);
+    cmd.AddValue("animMetadata",
+                 "Binary trace: metadata of one in N kept packets, 0 for none",
+                 animMetadata);
+    cmd.Parse(argc, argv);
 
     // Create nodes
     NodeContainer coreSwitch;
@@ -97,16 +447,28 @@ int main(int argc, char *argv[])
     clientApps.Stop(Seconds(simulationTime));
 
     // Enable NetAnim visualization
-    AnimationInterface anim("fat_tree_datacenter.xml");
-    anim.SetConstantPosition(coreSwitch.Get(0), 50.0, 50.0);
-    anim.SetConstantPosition(aggregationSwitches.Get(0), 30.0, 30.0);
-    anim.SetConstantPosition(aggregationSwitches.Get(1), 70.0, 30.0);
-    anim.SetConstantPosition(edgeSwitches.Get(0), 20.0, 10.0);
-    anim.SetConstantPosition(edgeSwitches.Get(1), 80.0, 10.0);
-    anim.SetConstantPosition(servers.Get(0), 10.0, 0.0);
-    anim.SetConstantPosition(servers.Get(1), 30.0, 0.0);
-    anim.SetConstantPosition(servers.Get(2), 70.0, 0.0);
-    anim.SetConstantPosition(servers.Get(3), 90.0, 0.0);
+    std::unique_ptr<AnimationInterface> anim;
+    std::unique_ptr<BinaryAnimTrace> binaryAnimTrace;
+    if (binaryAnim)
+    {
+        binaryAnimTrace =
+            std::make_unique<BinaryAnimTrace>("fat_tree_datacenter.anim.bin", MilliSeconds(250));
+        binaryAnimTrace->SetPacketSampling(animSampling);
+        binaryAnimTrace->EnablePacketMetadata(animMetadata);
+    }
+    else
+    {
+        anim = std::make_unique<AnimationInterface>("fat_tree_datacenter.xml");
+    }
+    AnimationInterface::SetConstantPosition(coreSwitch.Get(0), 50.0, 50.0);
+    AnimationInterface::SetConstantPosition(aggregationSwitches.Get(0), 30.0, 30.0);
+    AnimationInterface::SetConstantPosition(aggregationSwitches.Get(1), 70.0, 30.0);
+    AnimationInterface::SetConstantPosition(edgeSwitches.Get(0), 20.0, 10.0);
+    AnimationInterface::SetConstantPosition(edgeSwitches.Get(1), 80.0, 10.0);
+    AnimationInterface::SetConstantPosition(servers.Get(0), 10.0, 0.0);
+    AnimationInterface::SetConstantPosition(servers.Get(1), 30.0, 0.0);
+    AnimationInterface::SetConstantPosition(servers.Get(2), 70.0, 0.0);
+    AnimationInterface::SetConstantPosition(servers.Get(3), 90.0, 0.0);
 
     // Run simulation
     Simulator::Stop(Seconds(simulationTime));
@@ -68,7 +68,6 @@
 #include "ns3/command-line.h"
 #include "ns3/config.h"
 #include "ns3/double.h"
-#include "ns3/gnuplot.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/log.h"
@@ -84,6 +83,10 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <fstream>
+#include <string>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("PowerAdaptationDistance");
@@ -91,6 +94,165 @@ NS_LOG_COMPONENT_DEFINE("PowerAdaptationDistance");
 /// Packet size generated at the AP
 static const uint32_t packetSize = 1420;
 
+/**
+ * Append-only (x, y) series of a Gnuplot plot, kept as two columns.
+ *
+ * Gnuplot2dDataset holds every point until the plot is generated. A series given a
+ * data file instead appends its points to that file every CHUNK_POINTS points, so a
+ * long run keeps a bounded number of points in memory, and its plot script reads the
+ * points back from the file. Series are move-only and handed out by reference.
+ */
+class PlotSeries
+{
+  public:
+    /**
+     * \brief Construct a new PlotSeries object
+     *
+     * \param title The title shown in the plot legend.
+     */
+    explicit PlotSeries(const std::string& title = "");
+
+    PlotSeries(PlotSeries&&) = default;
+    PlotSeries& operator=(PlotSeries&&) = default;
+    PlotSeries(const PlotSeries&) = delete;
+    PlotSeries& operator=(const PlotSeries&) = delete;
+
+    /**
+     * \brief Set the title shown in the plot legend.
+     *
+     * \param title The title.
+     */
+    void SetTitle(const std::string& title);
+    /**
+     * \brief Stream the points to a data file from now on.
+     *
+     * \param fileName The data file.
+     */
+    void StreamTo(const std::string& fileName);
+    /**
+     * \brief Append a point.
+     *
+     * \param x The x coordinate.
+     * \param y The y coordinate.
+     */
+    void Add(double x, double y);
+    /**
+     * \brief Write a Gnuplot script drawing the series with lines, in one pass.
+     *
+     * \param os The script.
+     * \param epsFileName The EPS file the script renders to; the terminal is left alone if
+     *                    empty.
+     * \param title The plot title.
+     * \param xLegend The x axis legend.
+     * \param yLegend The y axis legend.
+     */
+    void WritePlot(std::ostream& os,
+                   const std::string& epsFileName,
+                   const std::string& title,
+                   const std::string& xLegend,
+                   const std::string& yLegend);
+
+  private:
+    static const std::size_t CHUNK_POINTS = 4096; //!< Points buffered before streaming.
+
+    /// Write the buffered points to the data file.
+    void Flush();
+
+    std::string m_title;        //!< Legend title.
+    std::string m_dataFileName; //!< Data file, empty if not streaming.
+    std::ofstream m_data;       //!< Data file stream.
+    std::vector<double> m_x;    //!< Buffered x coordinates.
+    std::vector<double> m_y;    //!< Buffered y coordinates.
+};
+
+PlotSeries::PlotSeries(const std::string& title)
+    : m_title(title)
+{
+}
+
+void
+PlotSeries::SetTitle(const std::string& title)
+{
+    m_title = title;
+}
+
+void
+PlotSeries::StreamTo(const std::string& fileName)
+{
+    m_dataFileName = fileName;
+    m_data.open(fileName);
+    NS_ABORT_MSG_IF(!m_data, "Cannot open plot data file " << fileName);
+    m_x.reserve(CHUNK_POINTS);
+    m_y.reserve(CHUNK_POINTS);
+    Flush();
+}
+
+void
+PlotSeries::Add(double x, double y)
+{
+    m_x.push_back(x);
+    m_y.push_back(y);
+    if (m_data.is_open() && m_x.size() == CHUNK_POINTS)
+    {
+        Flush();
+    }
+}
+
+void
+PlotSeries::Flush()
+{
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        m_data << m_x[i] << " " << m_y[i] << "\n";
+    }
+    m_data.flush();
+    m_x.clear();
+    m_y.clear();
+}
+
+void
+PlotSeries::WritePlot(std::ostream& os,
+                      const std::string& epsFileName,
+                      const std::string& title,
+                      const std::string& xLegend,
+                      const std::string& yLegend)
+{
+    if (!epsFileName.empty())
+    {
+        os << "set terminal post eps color enhanced\n";
+        os << "set output \"" << epsFileName << "\"\n";
+    }
+    if (!title.empty())
+    {
+        os << "set title \"" << title << "\"\n";
+    }
+    if (!xLegend.empty())
+    {
+        os << "set xlabel \"" << xLegend << "\"\n";
+    }
+    if (!yLegend.empty())
+    {
+        os << "set ylabel \"" << yLegend << "\"\n";
+    }
+
+    os << "plot \"" << (m_data.is_open() ? m_dataFileName : "-") << "\"";
+    if (!m_title.empty())
+    {
+        os << " title \"" << m_title << "\"";
+    }
+    os << " with lines\n";
+    if (m_data.is_open())
+    {
+        Flush();
+        return;
+    }
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        os << m_x[i] << " " << m_y[i] << "\n";
+    }
+    os << "e\n";
+}
+
 /**
  * \brief Class to collect node statistics.
  */
@@ -166,13 +328,19 @@ class NodeStatistics
      *
      * \return the Throughput output data.
      */
-    Gnuplot2dDataset GetDatafile();
+    PlotSeries& GetDatafile();
     /**
      * \brief Get the Power output data.
      *
      * \return the Power output data.
      */
-    Gnuplot2dDataset GetPowerDatafile();
+    PlotSeries& GetPowerDatafile();
+    /**
+     * \brief Stream the output data to files named <kind>-<name>.dat during the run.
+     *
+     * \param name The name shared by the data files.
+     */
+    void StreamPlotData(const std::string& name);
 
   private:
     /// Time, DataRate pair vector.
@@ -197,8 +365,8 @@ class NodeStatistics
     double m_totalEnergy;                           //!< Energy used on a given state.
     double m_totalTime;                             //!< Time spent on a given state.
     TxTime m_timeTable;                             //!< Time, DataRate table.
-    Gnuplot2dDataset m_output;                      //!< Throughput output data.
-    Gnuplot2dDataset m_output_power;                //!< Power output data.
+    PlotSeries m_output;                            //!< Throughput output data.
+    PlotSeries m_output_power;                      //!< Power output data.
 };
 
 NodeStatistics::NodeStatistics(NetDeviceContainer aps, NetDeviceContainer stas)
@@ -328,18 +496,25 @@ NodeStatistics::AdvancePosition(Ptr<Node> node, int stepsSize, Time stepsTime)
                         stepsTime);
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetDatafile()
 {
     return m_output;
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetPowerDatafile()
 {
     return m_output_power;
 }
 
+void
+NodeStatistics::StreamPlotData(const std::string& name)
+{
+    m_output.StreamTo("throughput-" + name + ".dat");
+    m_output_power.StreamTo("power-" + name + ".dat");
+}
+
 /**
  * Callback called by WifiNetDevice/RemoteStationManager/x/PowerChange.
  *
@@ -387,6 +562,7 @@ main(int argc, char* argv[])
     uint32_t steps{200};
     meter_u stepsSize{1};
     Time stepsTime{"1s"};
+    bool streamPlots{false};
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("manager", "PRC Manager", manager);
@@ -405,6 +581,7 @@ main(int argc, char* argv[])
     cmd.AddValue("AP1_y", "Position of AP1 in y coordinate", ap1_y);
     cmd.AddValue("STA1_x", "Position of STA1 in x coordinate", sta1_x);
     cmd.AddValue("STA1_y", "Position of STA1 in y coordinate", sta1_y);
+    cmd.AddValue("streamPlots", "Stream the plot data to .dat files during the run", streamPlots);
     cmd.Parse(argc, argv);
 
     if (steps == 0)
@@ -477,6 +654,10 @@ main(int argc, char* argv[])
 
     // Statistics counter
     NodeStatistics statistics = NodeStatistics(wifiApDevices, wifiStaDevices);
+    if (streamPlots)
+    {
+        statistics.StreamPlotData(outputFileName);
+    }
 
     // Move the STA by stepsSize meters every stepsTime seconds
     Simulator::Schedule(Seconds(0.5) + stepsTime,
@@ -540,23 +721,21 @@ main(int argc, char* argv[])
     Simulator::Run();
 
     std::ofstream outfile("throughput-" + outputFileName + ".plt");
-    Gnuplot gnuplot = Gnuplot("throughput-" + outputFileName + ".eps", "Throughput");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Throughput (Mb/s)");
-    gnuplot.SetTitle("Throughput (AP to STA) vs time");
-    gnuplot.AddDataset(statistics.GetDatafile());
-    gnuplot.GenerateOutput(outfile);
+    statistics.GetDatafile().WritePlot(outfile,
+                                       "throughput-" + outputFileName + ".eps",
+                                       "Throughput (AP to STA) vs time",
+                                       "Time (seconds)",
+                                       "Throughput (Mb/s)");
 
     if (manager == "ns3::ParfWifiManager" || manager == "ns3::AparfWifiManager" ||
         manager == "ns3::RrpaaWifiManager")
     {
         std::ofstream outfile2("power-" + outputFileName + ".plt");
-        gnuplot = Gnuplot("power-" + outputFileName + ".eps", "Average Transmit Power");
-        gnuplot.SetTerminal("post eps color enhanced");
-        gnuplot.SetLegend("Time (seconds)", "Power (mW)");
-        gnuplot.SetTitle("Average transmit power (AP to STA) vs time");
-        gnuplot.AddDataset(statistics.GetPowerDatafile());
-        gnuplot.GenerateOutput(outfile2);
+        statistics.GetPowerDatafile().WritePlot(outfile2,
+                                                "power-" + outputFileName + ".eps",
+                                                "Average transmit power (AP to STA) vs time",
+                                                "Time (seconds)",
+                                                "Power (mW)");
     }
 
     Simulator::Destroy();
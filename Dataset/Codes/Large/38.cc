@@ -40,7 +40,6 @@
 #include "ns3/config.h"
 #include "ns3/double.h"
 #include "ns3/flow-monitor-helper.h"
-#include "ns3/gnuplot.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/ipv4-flow-classifier.h"
@@ -56,6 +55,10 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <fstream>
+#include <string>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("PowerAdaptationInterference");
@@ -63,6 +66,165 @@ NS_LOG_COMPONENT_DEFINE("PowerAdaptationInterference");
 /// Packet size generated at the AP.
 static const uint32_t packetSize = 1420;
 
+/**
+ * Append-only (x, y) series of a Gnuplot plot, kept as two columns.
+ *
+ * Gnuplot2dDataset holds every point until the plot is generated. A series given a
+ * data file instead appends its points to that file every CHUNK_POINTS points, so a
+ * long run keeps a bounded number of points in memory, and its plot script reads the
+ * points back from the file. Series are move-only and handed out by reference.
+ */
+class PlotSeries
+{
+  public:
+    /**
+     * \brief Construct a new PlotSeries object
+     *
+     * \param title The title shown in the plot legend.
+     */
+    explicit PlotSeries(const std::string& title = "");
+
+    PlotSeries(PlotSeries&&) = default;
+    PlotSeries& operator=(PlotSeries&&) = default;
+    PlotSeries(const PlotSeries&) = delete;
+    PlotSeries& operator=(const PlotSeries&) = delete;
+
+    /**
+     * \brief Set the title shown in the plot legend.
+     *
+     * \param title The title.
+     */
+    void SetTitle(const std::string& title);
+    /**
+     * \brief Stream the points to a data file from now on.
+     *
+     * \param fileName The data file.
+     */
+    void StreamTo(const std::string& fileName);
+    /**
+     * \brief Append a point.
+     *
+     * \param x The x coordinate.
+     * \param y The y coordinate.
+     */
+    void Add(double x, double y);
+    /**
+     * \brief Write a Gnuplot script drawing the series with lines, in one pass.
+     *
+     * \param os The script.
+     * \param epsFileName The EPS file the script renders to; the terminal is left alone if
+     *                    empty.
+     * \param title The plot title.
+     * \param xLegend The x axis legend.
+     * \param yLegend The y axis legend.
+     */
+    void WritePlot(std::ostream& os,
+                   const std::string& epsFileName,
+                   const std::string& title,
+                   const std::string& xLegend,
+                   const std::string& yLegend);
+
+  private:
+    static const std::size_t CHUNK_POINTS = 4096; //!< Points buffered before streaming.
+
+    /// Write the buffered points to the data file.
+    void Flush();
+
+    std::string m_title;        //!< Legend title.
+    std::string m_dataFileName; //!< Data file, empty if not streaming.
+    std::ofstream m_data;       //!< Data file stream.
+    std::vector<double> m_x;    //!< Buffered x coordinates.
+    std::vector<double> m_y;    //!< Buffered y coordinates.
+};
+
+PlotSeries::PlotSeries(const std::string& title)
+    : m_title(title)
+{
+}
+
+void
+PlotSeries::SetTitle(const std::string& title)
+{
+    m_title = title;
+}
+
+void
+PlotSeries::StreamTo(const std::string& fileName)
+{
+    m_dataFileName = fileName;
+    m_data.open(fileName);
+    NS_ABORT_MSG_IF(!m_data, "Cannot open plot data file " << fileName);
+    m_x.reserve(CHUNK_POINTS);
+    m_y.reserve(CHUNK_POINTS);
+    Flush();
+}
+
+void
+PlotSeries::Add(double x, double y)
+{
+    m_x.push_back(x);
+    m_y.push_back(y);
+    if (m_data.is_open() && m_x.size() == CHUNK_POINTS)
+    {
+        Flush();
+    }
+}
+
+void
+PlotSeries::Flush()
+{
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        m_data << m_x[i] << " " << m_y[i] << "\n";
+    }
+    m_data.flush();
+    m_x.clear();
+    m_y.clear();
+}
+
+void
+PlotSeries::WritePlot(std::ostream& os,
+                      const std::string& epsFileName,
+                      const std::string& title,
+                      const std::string& xLegend,
+                      const std::string& yLegend)
+{
+    if (!epsFileName.empty())
+    {
+        os << "set terminal post eps color enhanced\n";
+        os << "set output \"" << epsFileName << "\"\n";
+    }
+    if (!title.empty())
+    {
+        os << "set title \"" << title << "\"\n";
+    }
+    if (!xLegend.empty())
+    {
+        os << "set xlabel \"" << xLegend << "\"\n";
+    }
+    if (!yLegend.empty())
+    {
+        os << "set ylabel \"" << yLegend << "\"\n";
+    }
+
+    os << "plot \"" << (m_data.is_open() ? m_dataFileName : "-") << "\"";
+    if (!m_title.empty())
+    {
+        os << " title \"" << m_title << "\"";
+    }
+    os << " with lines\n";
+    if (m_data.is_open())
+    {
+        Flush();
+        return;
+    }
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        os << m_x[i] << " " << m_y[i] << "\n";
+    }
+    os << "e\n";
+}
+
 /**
  * \brief Class to collect node statistics.
  */
@@ -133,37 +295,43 @@ class NodeStatistics
      *
      * \return the Throughput output data.
      */
-    Gnuplot2dDataset GetDatafile();
+    PlotSeries& GetDatafile();
     /**
      * \brief Get the Power output data.
      *
      * \return the Power output data.
      */
-    Gnuplot2dDataset GetPowerDatafile();
+    PlotSeries& GetPowerDatafile();
     /**
      * \brief Get the IDLE state output data.
      *
      * \return the IDLE state output data.
      */
-    Gnuplot2dDataset GetIdleDatafile();
+    PlotSeries& GetIdleDatafile();
     /**
      * \brief Get the BUSY state output data.
      *
      * \return the BUSY state output data.
      */
-    Gnuplot2dDataset GetBusyDatafile();
+    PlotSeries& GetBusyDatafile();
     /**
      * \brief Get the TX state output data.
      *
      * \return the TX state output data.
      */
-    Gnuplot2dDataset GetTxDatafile();
+    PlotSeries& GetTxDatafile();
     /**
      * \brief Get the RX state output data.
      *
      * \return the RX state output data.
      */
-    Gnuplot2dDataset GetRxDatafile();
+    PlotSeries& GetRxDatafile();
+    /**
+     * \brief Stream the output data to files named <kind>-<name>.dat during the run.
+     *
+     * \param name The name shared by the data files.
+     */
+    void StreamPlotData(const std::string& name);
 
     /**
      * \brief Get the Busy time.
@@ -203,12 +371,12 @@ class NodeStatistics
     double m_totalTxTime;                           //!< Total time in TX state.
     double m_totalRxTime;                           //!< Total time in RX state.
     TxTime m_timeTable;                             //!< Time, DataRate table.
-    Gnuplot2dDataset m_output;                      //!< Throughput output data.
-    Gnuplot2dDataset m_output_power;                //!< Power output data.
-    Gnuplot2dDataset m_output_idle;                 //!< IDLE output data.
-    Gnuplot2dDataset m_output_busy;                 //!< BUSY output data.
-    Gnuplot2dDataset m_output_rx;                   //!< RX output data.
-    Gnuplot2dDataset m_output_tx;                   //!< TX output data.
+    PlotSeries m_output;                            //!< Throughput output data.
+    PlotSeries m_output_power;                      //!< Power output data.
+    PlotSeries m_output_idle;                       //!< IDLE output data.
+    PlotSeries m_output_busy;                       //!< BUSY output data.
+    PlotSeries m_output_rx;                         //!< RX output data.
+    PlotSeries m_output_tx;                         //!< TX output data.
 };
 
 NodeStatistics::NodeStatistics(NetDeviceContainer aps, NetDeviceContainer stas)
@@ -360,42 +528,53 @@ NodeStatistics::CheckStatistics(double time)
     Simulator::Schedule(Seconds(time), &NodeStatistics::CheckStatistics, this, time);
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetDatafile()
 {
     return m_output;
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetPowerDatafile()
 {
     return m_output_power;
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetIdleDatafile()
 {
     return m_output_idle;
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetBusyDatafile()
 {
     return m_output_busy;
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetRxDatafile()
 {
     return m_output_rx;
 }
 
-Gnuplot2dDataset
+PlotSeries&
 NodeStatistics::GetTxDatafile()
 {
     return m_output_tx;
 }
 
+void
+NodeStatistics::StreamPlotData(const std::string& name)
+{
+    m_output.StreamTo("throughput-" + name + ".dat");
+    m_output_power.StreamTo("power-" + name + ".dat");
+    m_output_idle.StreamTo("idle-" + name + ".dat");
+    m_output_busy.StreamTo("busy-" + name + ".dat");
+    m_output_tx.StreamTo("tx-" + name + ".dat");
+    m_output_rx.StreamTo("rx-" + name + ".dat");
+}
+
 double
 NodeStatistics::GetBusyTime() const
 {
@@ -453,6 +632,7 @@ main(int argc, char* argv[])
     int sta2_x{180};
     int sta2_y{0};
     Time simuTime{"100s"};
+    bool streamPlots{false};
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("manager", "PRC Manager", manager);
@@ -473,6 +653,7 @@ main(int argc, char* argv[])
     cmd.AddValue("AP2_y", "Position of AP2 in y coordinate", ap2_y);
     cmd.AddValue("STA2_x", "Position of STA2 in x coordinate", sta2_x);
     cmd.AddValue("STA2_y", "Position of STA2 in y coordinate", sta2_y);
+    cmd.AddValue("streamPlots", "Stream the plot data to .dat files during the run", streamPlots);
     cmd.Parse(argc, argv);
 
     // Define the APs
@@ -593,6 +774,11 @@ main(int argc, char* argv[])
     // Statistics counters
     NodeStatistics statisticsAp0 = NodeStatistics(wifiApDevices, wifiStaDevices);
     NodeStatistics statisticsAp1 = NodeStatistics(wifiApDevices, wifiStaDevices);
+    if (streamPlots)
+    {
+        statisticsAp0.StreamPlotData(outputFileName + "-0");
+        statisticsAp1.StreamPlotData(outputFileName + "-1");
+    }
 
     // Register packet receptions to calculate throughput
     Config::Connect("/NodeList/2/ApplicationList/*/$ns3::PacketSink/Rx",
@@ -691,109 +877,97 @@ main(int argc, char* argv[])
 
     // Plots for AP0
     std::ofstream outfileTh0("throughput-" + outputFileName + "-0.plt");
-    Gnuplot gnuplot = Gnuplot("throughput-" + outputFileName + "-0.eps", "Throughput");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Throughput (Mb/s)");
-    gnuplot.SetTitle("Throughput (AP0 to STA) vs time");
-    gnuplot.AddDataset(statisticsAp0.GetDatafile());
-    gnuplot.GenerateOutput(outfileTh0);
+    statisticsAp0.GetDatafile().WritePlot(outfileTh0,
+                                          "throughput-" + outputFileName + "-0.eps",
+                                          "Throughput (AP0 to STA) vs time",
+                                          "Time (seconds)",
+                                          "Throughput (Mb/s)");
 
     if (manager == "ns3::ParfWifiManager" || manager == "ns3::AparfWifiManager" ||
         manager == "ns3::RrpaaWifiManager")
     {
         std::ofstream outfilePower0("power-" + outputFileName + "-0.plt");
-        gnuplot = Gnuplot("power-" + outputFileName + "-0.eps", "Average Transmit Power");
-        gnuplot.SetTerminal("post eps color enhanced");
-        gnuplot.SetLegend("Time (seconds)", "Power (mW)");
-        gnuplot.SetTitle("Average transmit power (AP0 to STA) vs time");
-        gnuplot.AddDataset(statisticsAp0.GetPowerDatafile());
-        gnuplot.GenerateOutput(outfilePower0);
+        statisticsAp0.GetPowerDatafile().WritePlot(outfilePower0,
+                                                   "power-" + outputFileName + "-0.eps",
+                                                   "Average transmit power (AP0 to STA) vs time",
+                                                   "Time (seconds)",
+                                                   "Power (mW)");
     }
 
     std::ofstream outfileTx0("tx-" + outputFileName + "-0.plt");
-    gnuplot = Gnuplot("tx-" + outputFileName + "-0.eps", "Time in TX State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP0 in TX state vs time");
-    gnuplot.AddDataset(statisticsAp0.GetTxDatafile());
-    gnuplot.GenerateOutput(outfileTx0);
+    statisticsAp0.GetTxDatafile().WritePlot(outfileTx0,
+                                            "tx-" + outputFileName + "-0.eps",
+                                            "Percentage time AP0 in TX state vs time",
+                                            "Time (seconds)",
+                                            "Percent");
 
     std::ofstream outfileRx0("rx-" + outputFileName + "-0.plt");
-    gnuplot = Gnuplot("rx-" + outputFileName + "-0.eps", "Time in RX State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP0 in RX state vs time");
-    gnuplot.AddDataset(statisticsAp0.GetRxDatafile());
-    gnuplot.GenerateOutput(outfileRx0);
+    statisticsAp0.GetRxDatafile().WritePlot(outfileRx0,
+                                            "rx-" + outputFileName + "-0.eps",
+                                            "Percentage time AP0 in RX state vs time",
+                                            "Time (seconds)",
+                                            "Percent");
 
     std::ofstream outfileBusy0("busy-" + outputFileName + "-0.plt");
-    gnuplot = Gnuplot("busy-" + outputFileName + "-0.eps", "Time in Busy State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP0 in Busy state vs time");
-    gnuplot.AddDataset(statisticsAp0.GetBusyDatafile());
-    gnuplot.GenerateOutput(outfileBusy0);
+    statisticsAp0.GetBusyDatafile().WritePlot(outfileBusy0,
+                                              "busy-" + outputFileName + "-0.eps",
+                                              "Percentage time AP0 in Busy state vs time",
+                                              "Time (seconds)",
+                                              "Percent");
 
     std::ofstream outfileIdle0("idle-" + outputFileName + "-0.plt");
-    gnuplot = Gnuplot("idle-" + outputFileName + "-0.eps", "Time in Idle State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP0 in Idle state vs time");
-    gnuplot.AddDataset(statisticsAp0.GetIdleDatafile());
-    gnuplot.GenerateOutput(outfileIdle0);
+    statisticsAp0.GetIdleDatafile().WritePlot(outfileIdle0,
+                                              "idle-" + outputFileName + "-0.eps",
+                                              "Percentage time AP0 in Idle state vs time",
+                                              "Time (seconds)",
+                                              "Percent");
 
     // Plots for AP1
     std::ofstream outfileTh1("throughput-" + outputFileName + "-1.plt");
-    gnuplot = Gnuplot("throughput-" + outputFileName + "-1.eps", "Throughput");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Throughput (Mb/s)");
-    gnuplot.SetTitle("Throughput (AP1 to STA) vs time");
-    gnuplot.AddDataset(statisticsAp1.GetDatafile());
-    gnuplot.GenerateOutput(outfileTh1);
+    statisticsAp1.GetDatafile().WritePlot(outfileTh1,
+                                          "throughput-" + outputFileName + "-1.eps",
+                                          "Throughput (AP1 to STA) vs time",
+                                          "Time (seconds)",
+                                          "Throughput (Mb/s)");
 
     if (manager == "ns3::ParfWifiManager" || manager == "ns3::AparfWifiManager" ||
         manager == "ns3::RrpaaWifiManager")
     {
         std::ofstream outfilePower1("power-" + outputFileName + "-1.plt");
-        gnuplot = Gnuplot("power-" + outputFileName + "-1.eps", "Average Transmit Power");
-        gnuplot.SetTerminal("post eps color enhanced");
-        gnuplot.SetLegend("Time (seconds)", "Power (mW)");
-        gnuplot.SetTitle("Average transmit power (AP1 to STA) vs time");
-        gnuplot.AddDataset(statisticsAp1.GetPowerDatafile());
-        gnuplot.GenerateOutput(outfilePower1);
+        statisticsAp1.GetPowerDatafile().WritePlot(outfilePower1,
+                                                   "power-" + outputFileName + "-1.eps",
+                                                   "Average transmit power (AP1 to STA) vs time",
+                                                   "Time (seconds)",
+                                                   "Power (mW)");
     }
 
     std::ofstream outfileTx1("tx-" + outputFileName + "-1.plt");
-    gnuplot = Gnuplot("tx-" + outputFileName + "-1.eps", "Time in TX State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP1 in TX state vs time");
-    gnuplot.AddDataset(statisticsAp1.GetTxDatafile());
-    gnuplot.GenerateOutput(outfileTx1);
+    statisticsAp1.GetTxDatafile().WritePlot(outfileTx1,
+                                            "tx-" + outputFileName + "-1.eps",
+                                            "Percentage time AP1 in TX state vs time",
+                                            "Time (seconds)",
+                                            "Percent");
 
     std::ofstream outfileRx1("rx-" + outputFileName + "-1.plt");
-    gnuplot = Gnuplot("rx-" + outputFileName + "-1.eps", "Time in RX State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP1 in RX state vs time");
-    gnuplot.AddDataset(statisticsAp1.GetRxDatafile());
-    gnuplot.GenerateOutput(outfileRx1);
+    statisticsAp1.GetRxDatafile().WritePlot(outfileRx1,
+                                            "rx-" + outputFileName + "-1.eps",
+                                            "Percentage time AP1 in RX state vs time",
+                                            "Time (seconds)",
+                                            "Percent");
 
     std::ofstream outfileBusy1("busy-" + outputFileName + "-1.plt");
-    gnuplot = Gnuplot("busy-" + outputFileName + "-1.eps", "Time in Busy State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP1 in Busy state vs time");
-    gnuplot.AddDataset(statisticsAp1.GetBusyDatafile());
-    gnuplot.GenerateOutput(outfileBusy1);
+    statisticsAp1.GetBusyDatafile().WritePlot(outfileBusy1,
+                                              "busy-" + outputFileName + "-1.eps",
+                                              "Percentage time AP1 in Busy state vs time",
+                                              "Time (seconds)",
+                                              "Percent");
 
     std::ofstream outfileIdle1("idle-" + outputFileName + "-1.plt");
-    gnuplot = Gnuplot("idle-" + outputFileName + "-1.eps", "Time in Idle State");
-    gnuplot.SetTerminal("post eps color enhanced");
-    gnuplot.SetLegend("Time (seconds)", "Percent");
-    gnuplot.SetTitle("Percentage time AP1 in Idle state vs time");
-    gnuplot.AddDataset(statisticsAp1.GetIdleDatafile());
-    gnuplot.GenerateOutput(outfileIdle1);
+    statisticsAp1.GetIdleDatafile().WritePlot(outfileIdle1,
+                                              "idle-" + outputFileName + "-1.eps",
+                                              "Percentage time AP1 in Idle state vs time",
+                                              "Time (seconds)",
+                                              "Percent");
 
     Simulator::Destroy();
 
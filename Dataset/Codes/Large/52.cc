@@ -1,3 +1,5 @@
+#include "ns3/abort.h"
+#include "ns3/callback.h"
 #include "ns3/command-line.h"
 #include "ns3/config.h"
 #include "ns3/double.h"
@@ -7,6 +9,10 @@
 #include "ns3/log.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/mobility-model.h"
+#include "ns3/names.h"
+#include "ns3/node-list.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
 #include "ns3/ssid.h"
 #include "ns3/string.h"
 #include "ns3/udp-client-server-helper.h"
@@ -15,6 +21,17 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
 // This example shows how to set Wi-Fi timing parameters through WifiMac attributes.
 //
 // Example: set slot time to 20 microseconds, while keeping other values as defined in the
@@ -22,6 +39,11 @@
 //
 //          ./ns3 run "wifi-timing-attributes --slot=20us"
 //
+// Several slot times can be compared from a single warm-up: the network is simulated once up
+// to the start of the traffic, then one worker process per slot time is forked from there:
+//
+//          ./ns3 run "wifi-timing-attributes --slotSweep=9us,20us,50us"
+//
 // Network topology:
 //
 //  Wifi 192.168.1.0
@@ -35,6 +57,438 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("wifi-timing-attributes");
 
+/**
+ * Index of the devices and applications of all nodes, for resolving Config paths
+ * without walking every node and device for every path.
+ *
+ * Build() walks the NodeList once and files each device and application under its
+ * TypeId and all parent TypeIds. "/NodeList/<n or *>/DeviceList/<i or *>/$ns3::Type"
+ * is then one lookup in the list of objects of that type, a single node or list index
+ * is an array access, and named objects, "$" types and pointer attributes after that
+ * are followed one segment at a time from the matches. Resolved paths are cached, so
+ * setting several attributes below the same object path resolves it once. The cost
+ * of a path follows the number of objects it matches, not the number of nodes times
+ * path segments. Paths the index cannot resolve (other namespaces, "|" and "[a-b]"
+ * selectors, object vector attributes, types only reachable through aggregation) go
+ * to Config::LookupMatches and are cached the same way.
+ *
+ * The index is a snapshot: call Build() again after creating nodes, devices,
+ * applications or names.
+ */
+class ConfigIndex
+{
+  public:
+    /// Index the devices and applications of all nodes and drop the cached paths.
+    void Build();
+
+    /**
+     * \param path a Config path to objects, e.g. "/NodeList/1/DeviceList/0/Phy"
+     * \return the matching objects and their paths, as Config::LookupMatches returns them
+     */
+    Config::MatchContainer LookupMatches(const std::string& path);
+
+    /**
+     * Set an attribute of every object matching a path, like Config::Set.
+     * \param path the path to the objects, followed by the attribute name
+     * \param value the attribute value
+     */
+    void Set(const std::string& path, const AttributeValue& value);
+
+    /**
+     * Connect a trace sink to every object matching a path, like Config::Connect.
+     * \param path the path to the objects, followed by the trace source name
+     * \param cb the sink, receiving the resolved path as its context
+     */
+    void Connect(const std::string& path, const CallbackBase& cb);
+
+    /**
+     * Connect a trace sink to every object matching a path, like
+     * Config::ConnectWithoutContext.
+     * \param path the path to the objects, followed by the trace source name
+     * \param cb the sink
+     */
+    void ConnectWithoutContext(const std::string& path, const CallbackBase& cb);
+
+  private:
+    /// A device or application and its place in the NodeList
+    struct Entry
+    {
+        uint32_t node;      //!< Node id.
+        uint32_t index;     //!< Position in the node's DeviceList or ApplicationList.
+        Ptr<Object> object; //!< The device or application.
+    };
+
+    /// Entries by the name of their TypeId and of every parent TypeId, in NodeList order
+    using TypeIndex = std::map<std::string, std::vector<Entry>>;
+
+    /**
+     * File an entry under its TypeId and all parent TypeIds.
+     * \param index the index
+     * \param entry the entry
+     */
+    static void AddByType(TypeIndex& index, const Entry& entry);
+
+    /**
+     * Match a path to objects without the cache.
+     * \param path the path to the objects
+     * \param objects the matching objects
+     * \param contexts the resolved path of each match, ending with '/'
+     * \return false if the path has to be resolved by Config itself
+     */
+    bool Resolve(const std::string& path,
+                 std::vector<Ptr<Object>>& objects,
+                 std::vector<std::string>& contexts) const;
+
+    /**
+     * Resolve all but the last segment of a path, which names an attribute or a
+     * trace source.
+     * \param path the path
+     * \param name set to the last segment
+     * \return the objects matching the rest
+     */
+    Config::MatchContainer LookupParent(const std::string& path, std::string& name);
+
+    TypeIndex m_devices;                                   //!< Devices of all nodes.
+    TypeIndex m_applications;                              //!< Applications of all nodes.
+    std::map<std::string, Config::MatchContainer> m_cache; //!< Resolved paths.
+};
+
+void
+ConfigIndex::Build()
+{
+    m_devices.clear();
+    m_applications.clear();
+    m_cache.clear();
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); ++n)
+    {
+        Ptr<Node> node = NodeList::GetNode(n);
+        for (uint32_t i = 0; i < node->GetNDevices(); ++i)
+        {
+            AddByType(m_devices, Entry{n, i, node->GetDevice(i)});
+        }
+        for (uint32_t i = 0; i < node->GetNApplications(); ++i)
+        {
+            AddByType(m_applications, Entry{n, i, node->GetApplication(i)});
+        }
+    }
+}
+
+void
+ConfigIndex::AddByType(TypeIndex& index, const Entry& entry)
+{
+    // "$ns3::NetDevice" matches every device, so an entry is filed under each ancestor
+    // too; "ns3::Object" then lists them all
+    TypeId tid = entry.object->GetInstanceTypeId();
+    while (true)
+    {
+        index[tid.GetName()].push_back(entry);
+        if (tid == Object::GetTypeId())
+        {
+            break;
+        }
+        tid = tid.GetParent();
+    }
+}
+
+bool
+ConfigIndex::Resolve(const std::string& path,
+                     std::vector<Ptr<Object>>& objects,
+                     std::vector<std::string>& contexts) const
+{
+    std::vector<std::string> segments;
+    std::istringstream iss(path);
+    for (std::string segment; std::getline(iss, segment, '/');)
+    {
+        if (!segment.empty())
+        {
+            segments.push_back(segment);
+        }
+    }
+
+    // "*" or a single index; anything else is left to Config
+    auto parseIndex = [](const std::string& text, bool& all, uint32_t& index) {
+        all = text == "*";
+        char* end = nullptr;
+        index = std::strtoul(text.c_str(), &end, 10);
+        return all || (end != text.c_str() && *end == '\0');
+    };
+
+    std::size_t next = 0;
+    if (segments.size() >= 2 && segments[0] == "NodeList")
+    {
+        bool allNodes;
+        uint32_t nodeId;
+        if (!parseIndex(segments[1], allNodes, nodeId))
+        {
+            return false;
+        }
+        if (!allNodes && nodeId >= NodeList::GetNNodes())
+        {
+            return true;
+        }
+        bool devices = segments.size() >= 4 && segments[2] == "DeviceList";
+        bool applications = segments.size() >= 4 && segments[2] == "ApplicationList";
+        if (devices || applications)
+        {
+            bool allEntries;
+            uint32_t entry;
+            if (!parseIndex(segments[3], allEntries, entry))
+            {
+                return false;
+            }
+            std::string type = "ns3::Object";
+            std::string typeSegment;
+            next = 4;
+            if (segments.size() > 4 && segments[4][0] == '$')
+            {
+                typeSegment = segments[4] + "/";
+                type = segments[4].substr(1);
+                next = 5;
+            }
+            const TypeIndex& index = devices ? m_devices : m_applications;
+            auto matches = index.find(type);
+            if (matches == index.end())
+            {
+                return false;
+            }
+            auto first = matches->second.begin();
+            auto last = matches->second.end();
+            if (!allNodes)
+            {
+                // Entries are in node order, so one node's entries are a contiguous range
+                first = std::lower_bound(first, last, nodeId, [](const Entry& e, uint32_t id) {
+                    return e.node < id;
+                });
+                last = std::upper_bound(first, last, nodeId, [](uint32_t id, const Entry& e) {
+                    return id < e.node;
+                });
+            }
+            for (auto it = first; it != last; ++it)
+            {
+                if (allEntries || it->index == entry)
+                {
+                    objects.push_back(it->object);
+                    contexts.push_back("/NodeList/" + std::to_string(it->node) + "/" +
+                                       segments[2] + "/" + std::to_string(it->index) + "/" +
+                                       typeSegment);
+                }
+            }
+        }
+        else
+        {
+            uint32_t begin = allNodes ? 0 : nodeId;
+            uint32_t end = allNodes ? NodeList::GetNNodes() : nodeId + 1;
+            for (uint32_t n = begin; n < end; ++n)
+            {
+                objects.push_back(NodeList::GetNode(n));
+                contexts.push_back("/NodeList/" + std::to_string(n) + "/");
+            }
+            next = 2;
+        }
+    }
+    else if (segments.size() >= 2 && segments[0] == "Names")
+    {
+        Ptr<Object> object = Names::Find<Object>("/Names/" + segments[1]);
+        if (!object)
+        {
+            return false;
+        }
+        objects.push_back(object);
+        contexts.push_back("/Names/" + segments[1] + "/");
+        next = 2;
+    }
+    else
+    {
+        return false;
+    }
+
+    // The rest of the path goes from each match to a "$" type, a named child or the
+    // object held by a pointer attribute
+    for (; next < segments.size(); ++next)
+    {
+        const std::string& segment = segments[next];
+        std::vector<Ptr<Object>> children;
+        std::vector<std::string> childContexts;
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            Ptr<Object> child;
+            if (segment[0] == '$')
+            {
+                TypeId tid;
+                if (!TypeId::LookupByNameFailSafe(segment.substr(1), &tid))
+                {
+                    return false;
+                }
+                child = objects[i]->GetObject<Object>(tid);
+            }
+            else
+            {
+                child = Names::Find<Object>(objects[i], segment);
+                if (!child)
+                {
+                    PointerValue pointer;
+                    if (!objects[i]->GetAttributeFailSafe(segment, pointer))
+                    {
+                        return false;
+                    }
+                    child = pointer.Get<Object>();
+                }
+            }
+            if (child)
+            {
+                children.push_back(child);
+                childContexts.push_back(contexts[i] + segment + "/");
+            }
+        }
+        objects.swap(children);
+        contexts.swap(childContexts);
+    }
+    return true;
+}
+
+Config::MatchContainer
+ConfigIndex::LookupMatches(const std::string& path)
+{
+    auto cached = m_cache.find(path);
+    if (cached != m_cache.end())
+    {
+        return cached->second;
+    }
+    std::vector<Ptr<Object>> objects;
+    std::vector<std::string> contexts;
+    Config::MatchContainer matches = Resolve(path, objects, contexts)
+                                         ? Config::MatchContainer(objects, contexts, path)
+                                         : Config::LookupMatches(path);
+    m_cache.emplace(path, matches);
+    return matches;
+}
+
+Config::MatchContainer
+ConfigIndex::LookupParent(const std::string& path, std::string& name)
+{
+    std::size_t slash = path.rfind('/');
+    NS_ABORT_MSG_IF(slash == std::string::npos, "Invalid Config path " << path);
+    name = path.substr(slash + 1);
+    Config::MatchContainer matches = LookupMatches(path.substr(0, slash));
+    NS_ABORT_MSG_IF(matches.GetN() == 0, "No object matches " << path);
+    return matches;
+}
+
+void
+ConfigIndex::Set(const std::string& path, const AttributeValue& value)
+{
+    std::string name;
+    LookupParent(path, name).Set(name, value);
+}
+
+void
+ConfigIndex::Connect(const std::string& path, const CallbackBase& cb)
+{
+    std::string name;
+    LookupParent(path, name).Connect(name, cb);
+}
+
+void
+ConfigIndex::ConnectWithoutContext(const std::string& path, const CallbackBase& cb)
+{
+    std::string name;
+    LookupParent(path, name).ConnectWithoutContext(name, cb);
+}
+
+/**
+ * Fork-after-warm-up snapshot for parameter studies.
+ *
+ * The simulation is run once up to \p warmUp. The process is then forked once per
+ * variant: each worker applies its variant's attribute overrides at that simulated
+ * instant, runs until \p stop and sends \p measure back to the parent through a pipe.
+ * At most \p maxWorkers workers run at a time. The parent never simulates past the
+ * warm-up and returns the measured values in variant order.
+ *
+ * \param warmUp simulated time shared by all variants
+ * \param stop simulated time at which every worker stops
+ * \param variants one callback per variant, applying its overrides
+ * \param measure callback returning the value measured by a worker
+ * \param maxWorkers maximum number of concurrent worker processes
+ * \return the value measured by each variant
+ */
+static std::vector<double>
+ForkAfterWarmUp(Time warmUp,
+                Time stop,
+                const std::vector<Callback<void>>& variants,
+                Callback<double> measure,
+                uint32_t maxWorkers)
+{
+    Simulator::Stop(warmUp);
+    Simulator::Run();
+    std::cout.flush(); // otherwise every worker would print what is still buffered
+
+    std::vector<int> readFds(variants.size());
+    uint32_t running = 0;
+    for (std::size_t i = 0; i < variants.size(); ++i)
+    {
+        if (running > 0 && running >= maxWorkers)
+        {
+            NS_ABORT_MSG_IF(wait(nullptr) < 0, "Lost track of a worker");
+            running--;
+        }
+        int fds[2];
+        NS_ABORT_MSG_IF(pipe(fds) != 0, "Cannot create a pipe to the worker");
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "Cannot fork a worker");
+        if (pid == 0)
+        {
+            close(fds[0]);
+            variants[i]();
+            Simulator::Stop(stop - Simulator::Now());
+            Simulator::Run();
+            double result = measure();
+            std::cout.flush();
+            bool sent = write(fds[1], &result, sizeof(result)) == sizeof(result);
+            _exit(sent ? 0 : 1);
+        }
+        close(fds[1]);
+        readFds[i] = fds[0];
+        running++;
+    }
+    for (; running > 0; running--)
+    {
+        wait(nullptr);
+    }
+
+    std::vector<double> results(variants.size());
+    for (std::size_t i = 0; i < variants.size(); ++i)
+    {
+        bool received = read(readFds[i], &results[i], sizeof(double)) == sizeof(double);
+        NS_ABORT_MSG_IF(!received, "Worker for variant " << i << " failed");
+        close(readFds[i]);
+    }
+    return results;
+}
+
+/**
+ * Set the slot time of all the given PHYs
+ *
+ * \param phys the PHYs
+ * \param slot the slot time
+ */
+static void
+SetSlot(Config::MatchContainer phys, Time slot)
+{
+    phys.Set("Slot", TimeValue(slot));
+}
+
+/**
+ * \param serverApp the UDP server application
+ * \param simulationTime the duration of the traffic
+ * \return the throughput received by the server, in Mbit/s
+ */
+static double
+GetThroughput(ApplicationContainer serverApp, Time simulationTime)
+{
+    double totalPacketsThrough = DynamicCast<UdpServer>(serverApp.Get(0))->GetReceived();
+    return totalPacketsThrough * 1472 * 8 / simulationTime.GetMicroSeconds(); // Mbit/s
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -42,12 +496,18 @@ main(int argc, char* argv[])
     Time sifs{"10us"};          // SIFS duration
     Time pifs{"19us"};          // PIFS duration
     Time simulationTime{"10s"}; // Simulation time
+    std::string slotSweep;      // comma-separated slot times forked from one warm-up
+    uint32_t maxWorkers = sysconf(_SC_NPROCESSORS_ONLN);
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("slot", "Slot time", slot);
     cmd.AddValue("sifs", "SIFS duration", sifs);
     cmd.AddValue("pifs", "PIFS duration", pifs);
     cmd.AddValue("simulationTime", "Simulation time", simulationTime);
+    cmd.AddValue("slotSweep",
+                 "Comma-separated slot times to fork from a shared warm-up (e.g. 9us,20us)",
+                 slotSweep);
+    cmd.AddValue("maxWorkers", "Maximum number of concurrent forked workers", maxWorkers);
     cmd.Parse(argc, argv);
 
     // Since default reference loss is defined for 5 GHz, it needs to be changed when operating
@@ -87,10 +547,15 @@ main(int argc, char* argv[])
     NetDeviceContainer apDevice;
     apDevice = wifi.Install(phy, mac, wifiApNode);
 
-    // Once install is done, we overwrite the standard timing values
-    Config::Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/Slot", TimeValue(slot));
-    Config::Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/Sifs", TimeValue(sifs));
-    Config::Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/Pifs", TimeValue(pifs));
+    // Once install is done, we overwrite the standard timing values. The index resolves
+    // the Phy path once; the second and third settings hit its cache.
+    ConfigIndex config;
+    config.Build();
+    config.Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/Slot", TimeValue(slot));
+    config.Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/Sifs", TimeValue(sifs));
+    config.Set("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/Pifs", TimeValue(pifs));
+    Config::MatchContainer phys =
+        config.LookupMatches("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy");
 
     // Mobility
     MobilityHelper mobility;
@@ -138,13 +603,38 @@ main(int argc, char* argv[])
     // Populate routing table
     Ipv4GlobalRoutingHelper::PopulateRoutingTables();
 
+    if (!slotSweep.empty())
+    {
+        // Traffic starts at 1 s: everything up to there is shared by all slot times
+        std::vector<Time> slots;
+        std::vector<Callback<void>> variants;
+        std::istringstream iss(slotSweep);
+        for (std::string value; std::getline(iss, value, ',');)
+        {
+            slots.emplace_back(value);
+            variants.push_back(MakeBoundCallback(&SetSlot, phys, slots.back()));
+        }
+        std::vector<double> throughputs =
+            ForkAfterWarmUp(Seconds(1.0),
+                            simulationTime + Seconds(1.0),
+                            variants,
+                            MakeBoundCallback(&GetThroughput, serverApp, simulationTime),
+                            maxWorkers);
+        for (std::size_t i = 0; i < slots.size(); ++i)
+        {
+            std::cout << "Slot " << slots[i].As(Time::US) << ": Throughput: " << throughputs[i]
+                      << " Mbit/s" << std::endl;
+        }
+        Simulator::Destroy();
+        return 0;
+    }
+
     // Set simulation time and launch simulation
     Simulator::Stop(simulationTime + Seconds(1.0));
     Simulator::Run();
 
     // Get and print results
-    double totalPacketsThrough = DynamicCast<UdpServer>(serverApp.Get(0))->GetReceived();
-    auto throughput = totalPacketsThrough * 1472 * 8 / simulationTime.GetMicroSeconds(); // Mbit/s
+    auto throughput = GetThroughput(serverApp, simulationTime);
     std::cout << "Throughput: " << throughput << " Mbit/s" << std::endl;
 
     Simulator::Destroy();
@@ -28,16 +28,188 @@
 #include "ns3/uniform-planar-array.h"
 
 #include <fstream>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("ThreeGppV2vChannelExample");
 
+/**
+ * Positions and velocities of all nodes, kept in contiguous arrays indexed by node id.
+ *
+ * Attach() reads each node's mobility model once and then follows its CourseChange
+ * trace, so the arrays hold every node's position and velocity as of its last course
+ * change. ns-3 mobility models move in straight lines at constant velocity between
+ * course changes, so SnapshotPositions(t) brings all nodes to time t in one pass over
+ * the arrays, with no aggregate lookup or model update per node. Nodes without a
+ * mobility model stay at the origin.
+ */
+class MobilitySnapshot
+{
+  public:
+    /// Track the nodes of the NodeList not tracked yet; call again after creating more.
+    void Attach();
+
+    /**
+     * Compute the positions of all nodes at a time.
+     * \param t the time, not before the current simulation time; a later time assumes
+     *          no course change until then
+     */
+    void SnapshotPositions(Time t);
+
+    /**
+     * Write the last snapshot, one "<time> <node id> <x> <y> <z>" line per node.
+     * \param os the output stream
+     */
+    void Print(std::ostream& os) const;
+
+    /// \return the number of nodes tracked
+    uint32_t GetN() const
+    {
+        return m_x.size();
+    }
+
+    /**
+     * \param nodeId the node id
+     * \return the position of the node at the last snapshot
+     */
+    Vector GetPosition(uint32_t nodeId) const
+    {
+        return Vector(m_x[nodeId], m_y[nodeId], m_z[nodeId]);
+    }
+
+    /// \return the x coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetX() const
+    {
+        return m_x;
+    }
+
+    /// \return the y coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetY() const
+    {
+        return m_y;
+    }
+
+    /// \return the z coordinates of the last snapshot, indexed by node id
+    const std::vector<double>& GetZ() const
+    {
+        return m_z;
+    }
+
+  private:
+    /**
+     * CourseChange trace sink; records the new position and velocity of a node.
+     * \param snapshot the snapshot
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    static void CourseChanged(MobilitySnapshot* snapshot,
+                              uint32_t nodeId,
+                              Ptr<const MobilityModel> model);
+
+    /**
+     * Record the current position and velocity of a node.
+     * \param nodeId the node id
+     * \param model the mobility model of the node
+     */
+    void Update(uint32_t nodeId, Ptr<const MobilityModel> model);
+
+    std::vector<double> m_time;  //!< Time of the last course change, in seconds.
+    std::vector<double> m_baseX; //!< x coordinate at the last course change.
+    std::vector<double> m_baseY; //!< y coordinate at the last course change.
+    std::vector<double> m_baseZ; //!< z coordinate at the last course change.
+    std::vector<double> m_velX;  //!< x velocity since the last course change.
+    std::vector<double> m_velY;  //!< y velocity since the last course change.
+    std::vector<double> m_velZ;  //!< z velocity since the last course change.
+    std::vector<double> m_x;     //!< x coordinate at the last snapshot.
+    std::vector<double> m_y;     //!< y coordinate at the last snapshot.
+    std::vector<double> m_z;     //!< z coordinate at the last snapshot.
+    Time m_snapshotTime;         //!< Time of the last snapshot.
+};
+
+void
+MobilitySnapshot::Attach()
+{
+    uint32_t first = m_x.size();
+    uint32_t n = NodeList::GetNNodes();
+    m_time.resize(n, 0.0);
+    m_baseX.resize(n, 0.0);
+    m_baseY.resize(n, 0.0);
+    m_baseZ.resize(n, 0.0);
+    m_velX.resize(n, 0.0);
+    m_velY.resize(n, 0.0);
+    m_velZ.resize(n, 0.0);
+    m_x.resize(n, 0.0);
+    m_y.resize(n, 0.0);
+    m_z.resize(n, 0.0);
+    for (uint32_t i = first; i < n; ++i)
+    {
+        Ptr<MobilityModel> model = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!model)
+        {
+            continue;
+        }
+        Update(i, model);
+        model->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&MobilitySnapshot::CourseChanged, this, i));
+    }
+    SnapshotPositions(Simulator::Now());
+}
+
+void
+MobilitySnapshot::CourseChanged(MobilitySnapshot* snapshot,
+                                uint32_t nodeId,
+                                Ptr<const MobilityModel> model)
+{
+    snapshot->Update(nodeId, model);
+}
+
+void
+MobilitySnapshot::Update(uint32_t nodeId, Ptr<const MobilityModel> model)
+{
+    Vector position = model->GetPosition();
+    Vector velocity = model->GetVelocity();
+    m_time[nodeId] = Simulator::Now().GetSeconds();
+    m_baseX[nodeId] = position.x;
+    m_baseY[nodeId] = position.y;
+    m_baseZ[nodeId] = position.z;
+    m_velX[nodeId] = velocity.x;
+    m_velY[nodeId] = velocity.y;
+    m_velZ[nodeId] = velocity.z;
+}
+
+void
+MobilitySnapshot::SnapshotPositions(Time t)
+{
+    const double now = t.GetSeconds();
+    const std::size_t n = m_x.size();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        double elapsed = now - m_time[i];
+        m_x[i] = m_baseX[i] + m_velX[i] * elapsed;
+        m_y[i] = m_baseY[i] + m_velY[i] * elapsed;
+        m_z[i] = m_baseZ[i] + m_velZ[i] * elapsed;
+    }
+    m_snapshotTime = t;
+}
+
+void
+MobilitySnapshot::Print(std::ostream& os) const
+{
+    double time = m_snapshotTime.GetSeconds();
+    for (std::size_t i = 0; i < m_x.size(); ++i)
+    {
+        os << time << " " << i << " " << m_x[i] << " " << m_y[i] << " " << m_z[i] << "\n";
+    }
+}
+
 static Ptr<ThreeGppPropagationLossModel>
     m_propagationLossModel; //!< the PropagationLossModel object
 static Ptr<ThreeGppSpectrumPropagationLossModel>
     m_spectrumLossModel;                       //!< the SpectrumPropagationLossModel object
 static Ptr<ChannelConditionModel> m_condModel; //!< the ChannelConditionModel object
+static MobilitySnapshot m_positions;           //!< the positions of the vehicles
 
 /*
  * \brief A structure that holds the parameters for the ComputeSnr
@@ -52,6 +224,8 @@ struct ComputeSnrParams
     double noiseFigure;                     //!< the noise figure in dB
     Ptr<PhasedArrayModel> txAntenna;        //!< the tx antenna array
     Ptr<PhasedArrayModel> rxAntenna;        //!< the rx antenna array
+    uint32_t txNodeId;                      //!< the id of the tx node
+    uint32_t rxNodeId;                      //!< the id of the rx node
 };
 
 /**
@@ -68,8 +242,8 @@ DoBeamforming(Ptr<NetDevice> thisDevice,
     PhasedArrayModel::ComplexVector antennaWeights;
 
     // retrieve the position of the two devices
-    Vector aPos = thisDevice->GetNode()->GetObject<MobilityModel>()->GetPosition();
-    Vector bPos = otherDevice->GetNode()->GetObject<MobilityModel>()->GetPosition();
+    Vector aPos = m_positions.GetPosition(thisDevice->GetNode()->GetId());
+    Vector bPos = m_positions.GetPosition(otherDevice->GetNode()->GetId());
 
     // compute the azimuth and the elevation angles
     Angles completeAngle(bPos, aPos);
@@ -117,11 +291,13 @@ ComputeSnr(const ComputeSnrParams& params)
     NS_LOG_DEBUG("Average SNR " << 10 * log10(Sum(*rxPsd) / Sum(*noisePsd)) << " dB");
 
     // print the SNR and pathloss values in the snr-trace.txt file
+    m_positions.SnapshotPositions(Simulator::Now());
+    Vector txPos = m_positions.GetPosition(params.txNodeId);
+    Vector rxPos = m_positions.GetPosition(params.rxNodeId);
     std::ofstream f;
     f.open("example-output.txt", std::ios::out | std::ios::app);
     f << Simulator::Now().GetSeconds() << " " // time [s]
-      << params.txMob->GetPosition().x << " " << params.txMob->GetPosition().y << " "
-      << params.rxMob->GetPosition().x << " " << params.rxMob->GetPosition().y << " "
+      << txPos.x << " " << txPos.y << " " << rxPos.x << " " << rxPos.y << " "
       << cond->GetLosCondition() << " "                  // channel state
       << 10 * log10(Sum(*rxPsd) / Sum(*noisePsd)) << " " // SNR [dB]
       << -propagationGainDb << std::endl;                // pathloss [dB]
@@ -323,6 +499,7 @@ main(int argc, char* argv[])
         PointerValue(channelModel));
 
     BuildingsHelper::Install(nodes);
+    m_positions.Attach();
 
     // set the beamforming vectors
     DoBeamforming(txDev, txAntenna, rxDev);
@@ -351,7 +528,14 @@ main(int argc, char* argv[])
 
     for (int i = 0; i < simTime / timeRes; i++)
     {
-        ComputeSnrParams params{txMob, rxMob, txParams, noiseFigure, txAntenna, rxAntenna};
+        ComputeSnrParams params{txMob,
+                                rxMob,
+                                txParams,
+                                noiseFigure,
+                                txAntenna,
+                                rxAntenna,
+                                nodes.Get(0)->GetId(),
+                                nodes.Get(1)->GetId()};
         Simulator::Schedule(timeRes * i, &ComputeSnr, params);
     }
 
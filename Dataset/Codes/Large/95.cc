@@ -17,11 +17,24 @@
 #include "ns3/network-module.h"
 #include "ns3/point-to-point-module.h"
 
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace ns3;
@@ -35,6 +48,1107 @@ void printMatrix(const char* description, std::vector<std::vector<bool>> array);
 
 NS_LOG_COMPONENT_DEFINE("GenericTopologyCreation");
 
+/**
+ * Compact binary NetAnim trace, for runs too large for AnimationInterface's XML.
+ *
+ * Records are varint encoded on the simulation thread and handed over in 64 KiB blocks
+ * to a writer thread that does the file I/O. Node positions are polled, but only when
+ * some node can move, and a node only gets a record when it has moved; the record holds
+ * the change since its last written position, in centimetres. Packet events can be
+ * sampled: a packet is kept when a hash of its uid falls below the sampling ratio, so
+ * all events of a kept packet are kept together. Packet metadata is off by default and
+ * can be limited to one in N kept packets. Examples/netanim-binary-to-xml.cc converts
+ * the file to NetAnim XML.
+ *
+ * The file is the magic "NS3ANIM1" followed by records. A record is a type byte, the
+ * time since the previous record in nanoseconds and its fields; integers are LEB128
+ * varints, signed ones zigzag encoded, and strings a length followed by the bytes.
+ *   1 NODE:  node, x, y                        initial position
+ *   2 MOVE:  node, dx, dy                      position change
+ *   3 LINK:  fromNode, toNode                  point-to-point link
+ *   4 WIRED: uid, from, to, txTime, rxTime, meta
+ *            first bit sent now, last bit sent after txTime, last bit received
+ *            after rxTime, first bit received after rxTime - txTime
+ *   5 WTX:   uid, from, meta                   wireless transmission starts now
+ *   6 WRX:   uid, to                           wireless reception ends now
+ */
+class BinaryAnimTrace
+{
+  public:
+    /**
+     * \param fileName output file
+     * \param pollInterval interval between two polls of the mobility models
+     */
+    BinaryAnimTrace(const std::string& fileName, Time pollInterval);
+    ~BinaryAnimTrace();
+
+    /// Keep only this fraction of the packets, chosen by uid.
+    void SetPacketSampling(double ratio);
+
+    /// Record the metadata of one in 'every' kept packets; 0 disables metadata.
+    void EnablePacketMetadata(uint32_t every);
+
+    /// Flush the last records, stop the writer thread and close the file.
+    void Close();
+
+  private:
+    static const uint32_t BLOCK_BYTES = 1 << 16;
+    static const uint32_t MAX_PENDING_BLOCKS = 64;
+
+    void Start();
+    void Poll();
+    void WiredTx(Ptr<const Packet> packet,
+                 Ptr<NetDevice> txDevice,
+                 Ptr<NetDevice> rxDevice,
+                 Time txTime,
+                 Time rxTime);
+    bool IsSampled(Ptr<const Packet> packet) const;
+    void PutMetadata(Ptr<const Packet> packet);
+    void BeginRecord(uint8_t type);
+    void EndRecord();
+    void PutVarint(uint64_t value);
+    void PutSigned(int64_t value);
+    void Flush();
+    void Run();
+
+    FILE* m_file;
+    Time m_pollInterval;
+    double m_sampleRatio;
+    uint32_t m_metadataEvery;
+    uint32_t m_metadataCount;
+    int64_t m_lastNs;
+    std::vector<int64_t> m_x; //!< last written position per node, cm
+    std::vector<int64_t> m_y;
+    std::vector<uint8_t> m_block;             //!< block being filled, simulation thread
+    std::deque<std::vector<uint8_t>> m_queue; //!< blocks waiting for the writer
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_drained;
+    bool m_stop;
+};
+
+BinaryAnimTrace::BinaryAnimTrace(const std::string& fileName, Time pollInterval)
+    : m_pollInterval(pollInterval),
+      m_sampleRatio(1.0),
+      m_metadataEvery(0),
+      m_metadataCount(0),
+      m_lastNs(0),
+      m_stop(false)
+{
+    m_file = fopen(fileName.c_str(), "wb");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open animation trace " << fileName);
+    fwrite("NS3ANIM1", 8, 1, m_file);
+    m_block.reserve(BLOCK_BYTES + 256);
+    m_writer = std::thread(&BinaryAnimTrace::Run, this);
+    Simulator::Schedule(Seconds(0), &BinaryAnimTrace::Start, this);
+}
+
+BinaryAnimTrace::~BinaryAnimTrace()
+{
+    Close();
+}
+
+void
+BinaryAnimTrace::SetPacketSampling(double ratio)
+{
+    m_sampleRatio = ratio;
+}
+
+void
+BinaryAnimTrace::EnablePacketMetadata(uint32_t every)
+{
+    m_metadataEvery = every;
+    if (every > 0)
+    {
+        Packet::EnablePrinting();
+    }
+}
+
+void
+BinaryAnimTrace::Start()
+{
+    // Initial positions; nodes without a mobility model sit at the origin
+    bool mobile = false;
+    m_x.assign(NodeList::GetNNodes(), 0);
+    m_y.assign(NodeList::GetNNodes(), 0);
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        Ptr<MobilityModel> mobility = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (mobility)
+        {
+            Vector position = mobility->GetPosition();
+            m_x[i] = std::llround(position.x * 100);
+            m_y[i] = std::llround(position.y * 100);
+            mobile |= !DynamicCast<ConstantPositionMobilityModel>(mobility);
+        }
+        BeginRecord(1);
+        PutVarint(i);
+        PutSigned(m_x[i]);
+        PutSigned(m_y[i]);
+        EndRecord();
+    }
+
+    for (uint32_t i = 0; i < ChannelList::GetNChannels(); ++i)
+    {
+        Ptr<PointToPointChannel> channel =
+            DynamicCast<PointToPointChannel>(ChannelList::GetChannel(i));
+        if (!channel || channel->GetNDevices() != 2)
+        {
+            continue;
+        }
+        BeginRecord(3);
+        PutVarint(channel->GetDevice(0)->GetNode()->GetId());
+        PutVarint(channel->GetDevice(1)->GetNode()->GetId());
+        EndRecord();
+        channel->TraceConnectWithoutContext("TxRxPointToPoint",
+                                            MakeCallback(&BinaryAnimTrace::WiredTx, this));
+    }
+
+    if (mobile)
+    {
+        Simulator::Schedule(m_pollInterval, &BinaryAnimTrace::Poll, this);
+    }
+}
+
+void
+BinaryAnimTrace::Poll()
+{
+    for (uint32_t i = 0; i < m_x.size(); ++i)
+    {
+        Ptr<MobilityModel> mobility = NodeList::GetNode(i)->GetObject<MobilityModel>();
+        if (!mobility)
+        {
+            continue;
+        }
+        Vector position = mobility->GetPosition();
+        int64_t x = std::llround(position.x * 100);
+        int64_t y = std::llround(position.y * 100);
+        if (x != m_x[i] || y != m_y[i])
+        {
+            BeginRecord(2);
+            PutVarint(i);
+            PutSigned(x - m_x[i]);
+            PutSigned(y - m_y[i]);
+            EndRecord();
+            m_x[i] = x;
+            m_y[i] = y;
+        }
+    }
+    Simulator::Schedule(m_pollInterval, &BinaryAnimTrace::Poll, this);
+}
+
+void
+BinaryAnimTrace::WiredTx(Ptr<const Packet> packet,
+                         Ptr<NetDevice> txDevice,
+                         Ptr<NetDevice> rxDevice,
+                         Time txTime,
+                         Time rxTime)
+{
+    if (!IsSampled(packet))
+    {
+        return;
+    }
+    BeginRecord(4);
+    PutVarint(packet->GetUid());
+    PutVarint(txDevice->GetNode()->GetId());
+    PutVarint(rxDevice->GetNode()->GetId());
+    PutVarint(txTime.GetNanoSeconds());
+    PutVarint(rxTime.GetNanoSeconds());
+    PutMetadata(packet);
+    EndRecord();
+}
+
+bool
+BinaryAnimTrace::IsSampled(Ptr<const Packet> packet) const
+{
+    // Fibonacci hashing spreads consecutive uids evenly over [0, 1)
+    uint64_t hash = packet->GetUid() * 0x9e3779b97f4a7c15ULL;
+    return (hash >> 11) * (1.0 / 9007199254740992.0) < m_sampleRatio;
+}
+
+void
+BinaryAnimTrace::PutMetadata(Ptr<const Packet> packet)
+{
+    if (m_metadataEvery == 0 || m_metadataCount++ % m_metadataEvery != 0)
+    {
+        PutVarint(0);
+        return;
+    }
+    std::ostringstream oss;
+    packet->Print(oss);
+    std::string meta = oss.str();
+    PutVarint(meta.size());
+    m_block.insert(m_block.end(), meta.begin(), meta.end());
+}
+
+void
+BinaryAnimTrace::BeginRecord(uint8_t type)
+{
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    m_block.push_back(type);
+    PutVarint(now - m_lastNs);
+    m_lastNs = now;
+}
+
+void
+BinaryAnimTrace::EndRecord()
+{
+    if (m_block.size() >= BLOCK_BYTES)
+    {
+        Flush();
+    }
+}
+
+void
+BinaryAnimTrace::PutVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        m_block.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    m_block.push_back(static_cast<uint8_t>(value));
+}
+
+void
+BinaryAnimTrace::PutSigned(int64_t value)
+{
+    PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void
+BinaryAnimTrace::Flush()
+{
+    if (m_block.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A slow disk holds the simulation back rather than letting the queue grow unbounded
+    while (m_queue.size() >= MAX_PENDING_BLOCKS)
+    {
+        m_drained.wait(lock);
+    }
+    m_queue.push_back(std::move(m_block));
+    m_block = std::vector<uint8_t>();
+    m_block.reserve(BLOCK_BYTES + 256);
+    m_wakeUp.notify_one();
+}
+
+void
+BinaryAnimTrace::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        while (!m_stop && m_queue.empty())
+        {
+            m_wakeUp.wait(lock);
+        }
+        if (m_queue.empty())
+        {
+            break;
+        }
+        std::vector<uint8_t> block = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_drained.notify_one();
+        lock.unlock();
+        fwrite(block.data(), block.size(), 1, m_file);
+        lock.lock();
+    }
+}
+
+void
+BinaryAnimTrace::Close()
+{
+    if (!m_writer.joinable())
+    {
+        return;
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_writer.join();
+    fclose(m_file);
+}
+
+/**
+ * Asynchronous, filterable ASCII trace of point-to-point devices.
+ *
+ * Stands in for the helpers' EnableAsciiAll on busy links. Event types ('+' enqueue,
+ * '-' dequeue, 'd' drop, 'r' receive) and nodes that are filtered out are never
+ * connected, so they cost nothing. A kept event copies only the time, the packet size
+ * and the first bytes of the packet (enough for its headers) into a block, and a
+ * formatter thread turns the blocks into text. Lines keep the helpers' layout,
+ * "<event> <time> <context> <headers>", but the headers are decoded from the packet
+ * bytes instead of being printed from packet metadata: Ethernet, ARP, PPP, IPv4, IPv6
+ * and its extension headers, ICMP, ICMPv6, UDP and TCP are shown, the rest as payload.
+ */
+class AsyncAsciiTrace
+{
+  public:
+    /**
+     * \param fileName output file
+     * \param events the event types to keep, e.g. "+-dr" for all of them
+     * \param nodes comma-separated ids of the nodes to keep; all nodes if empty
+     */
+    AsyncAsciiTrace(const std::string& fileName,
+                    const std::string& events,
+                    const std::string& nodes);
+    ~AsyncAsciiTrace();
+
+    /// Trace every point-to-point device of the kept nodes.
+    void AttachAll();
+
+    /// Format the pending events, stop the formatter thread and close the file.
+    void Close();
+
+  private:
+    static const uint32_t CAPTURE_BYTES = 128;
+    static const uint32_t BLOCK_BYTES = 1 << 16;
+    static const uint32_t MAX_PENDING_BLOCKS = 64;
+
+    /// What the captured bytes start with
+    enum Framing
+    {
+        PPP,
+        ETHERNET,
+        NETWORK //!< received packets, whose link header has been removed
+    };
+
+    /// One connected trace source
+    struct Source
+    {
+        char event;
+        Framing framing;
+        std::string context; //!< configuration path printed on every line
+    };
+
+    /// Event header in a block, followed by 'captured' packet bytes
+    struct Event
+    {
+        int64_t timeNs;
+        uint32_t source;
+        uint32_t size;
+        uint32_t captured;
+    };
+
+    void Connect(Ptr<Object> object,
+                 const std::string& traceSource,
+                 char event,
+                 Framing framing,
+                 const std::string& context);
+    static void Capture(AsyncAsciiTrace* trace, uint32_t source, Ptr<const Packet> packet);
+    void Flush();
+    void Run();
+    void Format(const Event& event, const uint8_t* bytes);
+    void FormatNetwork(uint16_t etherType, const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatIpv4(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatIpv6(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatArp(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatTransport(uint8_t protocol, const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatPayload(uint32_t size);
+    void FormatMac(const uint8_t* p);
+    void FormatAddress(int family, const uint8_t* p);
+
+    static uint16_t Read16(const uint8_t* p)
+    {
+        return (p[0] << 8) | p[1];
+    }
+
+    static uint32_t Read32(const uint8_t* p)
+    {
+        return (static_cast<uint32_t>(Read16(p)) << 16) | Read16(p + 2);
+    }
+
+    FILE* m_file;
+    std::string m_events;
+    std::set<uint32_t> m_nodes;
+    std::vector<Source> m_sources;
+    std::vector<uint8_t> m_block;             //!< block being filled, simulation thread
+    std::deque<std::vector<uint8_t>> m_queue; //!< blocks waiting for the formatter
+    std::ostringstream m_line;                //!< formatter thread
+    std::thread m_formatter;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_drained;
+    bool m_stop;
+};
+
+AsyncAsciiTrace::AsyncAsciiTrace(const std::string& fileName,
+                                 const std::string& events,
+                                 const std::string& nodes)
+    : m_events(events),
+      m_stop(false)
+{
+    std::istringstream list(nodes);
+    std::string id;
+    while (std::getline(list, id, ','))
+    {
+        m_nodes.insert(std::stoul(id));
+    }
+    m_file = fopen(fileName.c_str(), "w");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open ASCII trace " << fileName);
+    setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+    m_block.reserve(BLOCK_BYTES + sizeof(Event) + CAPTURE_BYTES);
+    m_line << std::setprecision(9);
+    m_formatter = std::thread(&AsyncAsciiTrace::Run, this);
+}
+
+AsyncAsciiTrace::~AsyncAsciiTrace()
+{
+    Close();
+}
+
+void
+AsyncAsciiTrace::AttachAll()
+{
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        if (!m_nodes.empty() && m_nodes.find(i) == m_nodes.end())
+        {
+            continue;
+        }
+        Ptr<Node> node = NodeList::GetNode(i);
+        for (uint32_t j = 0; j < node->GetNDevices(); ++j)
+        {
+            Ptr<NetDevice> device = node->GetDevice(j);
+            Ptr<Object> queue;
+            Framing framing;
+            std::ostringstream context;
+            context << "/NodeList/" << i << "/DeviceList/" << j << "/";
+            if (Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice>(device))
+            {
+                queue = p2p->GetQueue();
+                framing = PPP;
+                context << "$ns3::PointToPointNetDevice/";
+            }
+            else
+            {
+                continue;
+            }
+            Connect(queue, "Enqueue", '+', framing, context.str() + "TxQueue/Enqueue");
+            Connect(queue, "Dequeue", '-', framing, context.str() + "TxQueue/Dequeue");
+            Connect(queue, "Drop", 'd', framing, context.str() + "TxQueue/Drop");
+            Connect(device, "PhyRxDrop", 'd', framing, context.str() + "PhyRxDrop");
+            Connect(device, "MacRx", 'r', NETWORK, context.str() + "MacRx");
+        }
+    }
+}
+
+void
+AsyncAsciiTrace::Connect(Ptr<Object> object,
+                         const std::string& traceSource,
+                         char event,
+                         Framing framing,
+                         const std::string& context)
+{
+    if (m_events.find(event) == std::string::npos)
+    {
+        return;
+    }
+    uint32_t source = m_sources.size();
+    m_sources.push_back(Source{event, framing, context});
+    object->TraceConnectWithoutContext(traceSource,
+                                       MakeBoundCallback(&AsyncAsciiTrace::Capture, this, source));
+}
+
+void
+AsyncAsciiTrace::Capture(AsyncAsciiTrace* trace, uint32_t source, Ptr<const Packet> packet)
+{
+    Event event;
+    event.timeNs = Simulator::Now().GetNanoSeconds();
+    event.source = source;
+    event.size = packet->GetSize();
+    event.captured = event.size < CAPTURE_BYTES ? event.size : CAPTURE_BYTES;
+
+    std::vector<uint8_t>& block = trace->m_block;
+    std::size_t offset = block.size();
+    block.resize(offset + sizeof(Event) + event.captured);
+    memcpy(block.data() + offset, &event, sizeof(Event));
+    packet->CopyData(block.data() + offset + sizeof(Event), event.captured);
+    if (block.size() >= BLOCK_BYTES)
+    {
+        trace->Flush();
+    }
+}
+
+void
+AsyncAsciiTrace::Flush()
+{
+    if (m_block.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A formatter that cannot keep up holds the simulation back instead of using up memory
+    while (m_queue.size() >= MAX_PENDING_BLOCKS)
+    {
+        m_drained.wait(lock);
+    }
+    m_queue.push_back(std::move(m_block));
+    m_block = std::vector<uint8_t>();
+    m_block.reserve(BLOCK_BYTES + sizeof(Event) + CAPTURE_BYTES);
+    m_wakeUp.notify_one();
+}
+
+void
+AsyncAsciiTrace::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        while (!m_stop && m_queue.empty())
+        {
+            m_wakeUp.wait(lock);
+        }
+        if (m_queue.empty())
+        {
+            break;
+        }
+        std::vector<uint8_t> block = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_drained.notify_one();
+        lock.unlock();
+        for (std::size_t offset = 0; offset < block.size();)
+        {
+            Event event;
+            memcpy(&event, block.data() + offset, sizeof(Event));
+            Format(event, block.data() + offset + sizeof(Event));
+            offset += sizeof(Event) + event.captured;
+        }
+        lock.lock();
+    }
+}
+
+void
+AsyncAsciiTrace::Close()
+{
+    if (!m_formatter.joinable())
+    {
+        return;
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_formatter.join();
+    fclose(m_file);
+}
+
+void
+AsyncAsciiTrace::Format(const Event& event, const uint8_t* bytes)
+{
+    const Source& source = m_sources[event.source];
+    m_line.str("");
+    m_line << source.event << " " << event.timeNs / 1e9 << " " << source.context << " ";
+    switch (source.framing)
+    {
+    case PPP:
+        if (event.captured < 2)
+        {
+            FormatPayload(event.size);
+            break;
+        }
+        m_line << "ns3::PppHeader (Point-to-Point Protocol: ";
+        switch (Read16(bytes))
+        {
+        case 0x0021:
+            m_line << "IP (0x0021)) ";
+            FormatNetwork(0x0800, bytes + 2, event.captured - 2, event.size - 2);
+            break;
+        case 0x0057:
+            m_line << "IPv6 (0x0057)) ";
+            FormatNetwork(0x86dd, bytes + 2, event.captured - 2, event.size - 2);
+            break;
+        default:
+            m_line << "UNKNOWN (0x" << std::hex << Read16(bytes) << std::dec << ")) ";
+            FormatPayload(event.size - 2);
+        }
+        break;
+    case ETHERNET: {
+        if (event.captured < 14)
+        {
+            FormatPayload(event.size);
+            break;
+        }
+        uint16_t lengthType = Read16(bytes + 12);
+        m_line << "ns3::EthernetHeader ( length/type=0x" << std::hex << lengthType << std::dec
+               << ", source=";
+        FormatMac(bytes + 6);
+        m_line << ", destination=";
+        FormatMac(bytes);
+        m_line << ") ";
+        if (lengthType <= 1500 && event.captured >= 22)
+        {
+            // LLC/SNAP encapsulation
+            m_line << "ns3::LlcSnapHeader (type 0x" << std::hex << Read16(bytes + 20) << std::dec
+                   << ") ";
+            FormatNetwork(Read16(bytes + 20), bytes + 22, event.captured - 22, lengthType - 8);
+        }
+        else
+        {
+            FormatNetwork(lengthType, bytes + 14, event.captured - 14, event.size - 14);
+        }
+        break;
+    }
+    case NETWORK: {
+        uint16_t etherType = 0;
+        if (event.captured >= 4 && Read16(bytes) == 1 && Read16(bytes + 2) == 0x0800)
+        {
+            etherType = 0x0806;
+        }
+        else if (event.captured >= 1 && bytes[0] >> 4 == 4)
+        {
+            etherType = 0x0800;
+        }
+        else if (event.captured >= 1 && bytes[0] >> 4 == 6)
+        {
+            etherType = 0x86dd;
+        }
+        FormatNetwork(etherType, bytes, event.captured, event.size);
+        break;
+    }
+    }
+    m_line << "\n";
+    const std::string line = m_line.str();
+    fwrite(line.data(), line.size(), 1, m_file);
+}
+
+void
+AsyncAsciiTrace::FormatNetwork(uint16_t etherType,
+                               const uint8_t* p,
+                               uint32_t captured,
+                               uint32_t size)
+{
+    switch (etherType)
+    {
+    case 0x0800:
+        FormatIpv4(p, captured, size);
+        break;
+    case 0x86dd:
+        FormatIpv6(p, captured, size);
+        break;
+    case 0x0806:
+        FormatArp(p, captured, size);
+        break;
+    default:
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatIpv4(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    uint32_t headerLength = (p[0] & 0x0f) * 4;
+    if (captured < 20 || captured < headerLength)
+    {
+        FormatPayload(size);
+        return;
+    }
+    uint16_t totalLength = Read16(p + 2);
+    uint16_t fragment = Read16(p + 6);
+    uint32_t offset = (fragment & 0x1fff) * 8;
+    m_line << "ns3::Ipv4Header (tos 0x" << std::hex << static_cast<uint32_t>(p[1]) << std::dec
+           << " ttl " << static_cast<uint32_t>(p[8]) << " id " << Read16(p + 4) << " protocol "
+           << static_cast<uint32_t>(p[9]) << " offset (bytes) " << offset << " flags [";
+    if (fragment & 0x4000)
+    {
+        m_line << (fragment & 0x2000 ? "DF|MF" : "DF");
+    }
+    else
+    {
+        m_line << (fragment & 0x2000 ? "MF" : "none");
+    }
+    m_line << "] length: " << totalLength << " ";
+    FormatAddress(AF_INET, p + 12);
+    m_line << " > ";
+    FormatAddress(AF_INET, p + 16);
+    m_line << ") ";
+    // The IP length leaves out any Ethernet padding and trailer
+    size = std::min<uint32_t>(size, totalLength) - headerLength;
+    if (offset == 0)
+    {
+        FormatTransport(p[9], p + headerLength, captured - headerLength, size);
+    }
+    else
+    {
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatIpv6(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    if (captured < 40)
+    {
+        FormatPayload(size);
+        return;
+    }
+    uint32_t versionClassFlow = Read32(p);
+    uint16_t payloadLength = Read16(p + 4);
+    uint8_t nextHeader = p[6];
+    m_line << "ns3::Ipv6Header (Version 6 Traffic class: 0x" << std::hex
+           << ((versionClassFlow >> 20) & 0xff) << " Flow Label: 0x" << (versionClassFlow & 0xfffff)
+           << std::dec << " Payload Length: " << payloadLength << " Next Header: "
+           << static_cast<uint32_t>(nextHeader) << " Hop Limit: " << static_cast<uint32_t>(p[7])
+           << " ) ";
+    FormatAddress(AF_INET6, p + 8);
+    m_line << " > ";
+    FormatAddress(AF_INET6, p + 24);
+    m_line << ") ";
+    p += 40;
+    captured -= 40;
+    size = std::min<uint32_t>(size - 40, payloadLength);
+
+    // Extension headers, up to the transport header or a non-first fragment
+    while (true)
+    {
+        if ((nextHeader == 0 || nextHeader == 43 || nextHeader == 60) && captured >= 8)
+        {
+            uint32_t length = (p[1] + 1) * 8;
+            m_line << (nextHeader == 0    ? "ns3::Ipv6ExtensionHopByHopHeader"
+                       : nextHeader == 43 ? "ns3::Ipv6ExtensionRoutingHeader"
+                                          : "ns3::Ipv6ExtensionDestinationHeader")
+                   << " (Next header: " << static_cast<uint32_t>(p[0]) << " length: " << length
+                   << ") ";
+            if (length > captured || length > size)
+            {
+                FormatPayload(size);
+                return;
+            }
+            nextHeader = p[0];
+            p += length;
+            captured -= length;
+            size -= length;
+        }
+        else if (nextHeader == 44 && captured >= 8 && size >= 8)
+        {
+            uint16_t offsetFlags = Read16(p + 2);
+            m_line << "ns3::Ipv6ExtensionFragmentHeader (Next header: "
+                   << static_cast<uint32_t>(p[0]) << " Fragment offset: " << (offsetFlags & 0xfff8)
+                   << " More fragments: " << (offsetFlags & 1) << " Identification: "
+                   << Read32(p + 4) << ") ";
+            nextHeader = p[0];
+            p += 8;
+            captured -= 8;
+            size -= 8;
+            if ((offsetFlags & 0xfff8) != 0)
+            {
+                FormatPayload(size);
+                return;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    FormatTransport(nextHeader, p, captured, size);
+}
+
+void
+AsyncAsciiTrace::FormatArp(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    if (captured < 28 || p[4] != 6 || p[5] != 4)
+    {
+        FormatPayload(size);
+        return;
+    }
+    bool request = Read16(p + 6) == 1;
+    m_line << "ns3::ArpHeader (" << (request ? "request" : "reply") << " source mac: ";
+    FormatMac(p + 8);
+    m_line << " source ipv4: ";
+    FormatAddress(AF_INET, p + 14);
+    if (!request)
+    {
+        m_line << " dest mac: ";
+        FormatMac(p + 18);
+    }
+    m_line << " dest ipv4: ";
+    FormatAddress(AF_INET, p + 24);
+    m_line << ") ";
+    FormatPayload(size - 28);
+}
+
+void
+AsyncAsciiTrace::FormatTransport(uint8_t protocol,
+                                 const uint8_t* p,
+                                 uint32_t captured,
+                                 uint32_t size)
+{
+    if (protocol == 17 && captured >= 8 && size >= 8)
+    {
+        m_line << "ns3::UdpHeader (length: " << Read16(p + 4) << " " << Read16(p) << " > "
+               << Read16(p + 2) << ") ";
+        FormatPayload(size - 8);
+    }
+    else if (protocol == 6 && captured >= 20 && size >= (p[12] >> 4) * 4u)
+    {
+        static const char* names[] = {"FIN", "SYN", "RST", "PSH", "ACK", "URG", "ECE", "CWR"};
+        uint32_t headerLength = (p[12] >> 4) * 4;
+        m_line << "ns3::TcpHeader (" << Read16(p) << " > " << Read16(p + 2);
+        if (p[13] != 0)
+        {
+            m_line << " [";
+            const char* separator = "";
+            for (uint32_t bit = 0; bit < 8; ++bit)
+            {
+                if (p[13] & (1 << bit))
+                {
+                    m_line << separator << names[bit];
+                    separator = "|";
+                }
+            }
+            m_line << "]";
+        }
+        m_line << " Seq=" << Read32(p + 4) << " Ack=" << Read32(p + 8) << " Win=" << Read16(p + 14)
+               << ") ";
+        FormatPayload(size - headerLength);
+    }
+    else if ((protocol == 1 || protocol == 58) && captured >= 4 && size >= 4)
+    {
+        m_line << (protocol == 1 ? "ns3::Icmpv4Header (type=" : "ns3::Icmpv6Header (type=")
+               << static_cast<uint32_t>(p[0]) << ", code=" << static_cast<uint32_t>(p[1]) << ") ";
+        FormatPayload(size - 4);
+    }
+    else
+    {
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatPayload(uint32_t size)
+{
+    if (size > 0)
+    {
+        m_line << "Payload (size=" << size << ")";
+    }
+}
+
+void
+AsyncAsciiTrace::FormatMac(const uint8_t* p)
+{
+    char text[18];
+    snprintf(text,
+             sizeof(text),
+             "%02x:%02x:%02x:%02x:%02x:%02x",
+             p[0],
+             p[1],
+             p[2],
+             p[3],
+             p[4],
+             p[5]);
+    m_line << text;
+}
+
+void
+AsyncAsciiTrace::FormatAddress(int family, const uint8_t* p)
+{
+    char text[INET6_ADDRSTRLEN];
+    m_line << inet_ntop(family, p, text, sizeof(text));
+}
+
+/**
+ * Uniform random variates drawn in bulk, for start time and placement loops.
+ *
+ * This is the MRG32k3a generator behind ns-3's RngStream, seeded the same way from
+ * the global seed and run number: a stream advances the initial state by 2^127 steps
+ * per stream index and the run selects a substream 2^76 steps apart. For the same seed,
+ * run and stream the values are the ones a UniformRandomVariable would return, but Fill
+ * draws a whole array in one inlined loop instead of one virtual call per value, and
+ * one object serves every draw of a loop.
+ */
+class BatchUniformStream
+{
+  public:
+    /// Use the next automatically assigned stream, as a new UniformRandomVariable does.
+    BatchUniformStream();
+
+    /**
+     * Use a fixed stream, like RandomVariableStream::SetStream.
+     * \param stream first stream index to use
+     * \return the number of streams used
+     */
+    int64_t AssignStreams(int64_t stream);
+
+    /**
+     * Fill an array with uniform values in [min, max).
+     * \param values the array
+     * \param count its size
+     * \param min lower bound
+     * \param max upper bound
+     */
+    void Fill(double* values, std::size_t count, double min, double max);
+
+    /// Fill a vector with uniform values in [min, max).
+    void Fill(std::vector<double>& values, double min, double max)
+    {
+        Fill(values.data(), values.size(), min, max);
+    }
+
+  private:
+    static constexpr double M1 = 4294967087.0;
+    static constexpr double M2 = 4294944443.0;
+
+    /// Seed the generator for a stream index as RngStream does, with the current run
+    void Seed(uint64_t stream);
+
+    /// Advance one component by n * 2^e steps
+    static void Advance(const uint64_t a[3][3], uint64_t m, uint64_t n, uint32_t e, uint64_t s[3]);
+
+    /// r = a * b mod m, r may alias a or b
+    static void Multiply(const uint64_t a[3][3],
+                         const uint64_t b[3][3],
+                         uint64_t m,
+                         uint64_t r[3][3]);
+
+    double m_state[6];
+};
+
+BatchUniformStream::BatchUniformStream()
+{
+    // As RandomVariableStream::SetStream(-1): the first 2^63 streams are automatic
+    Seed(RngSeedManager::GetNextStreamIndex());
+}
+
+int64_t
+BatchUniformStream::AssignStreams(int64_t stream)
+{
+    Seed((1ULL << 63) + stream);
+    return 1;
+}
+
+void
+BatchUniformStream::Seed(uint64_t stream)
+{
+    static const uint64_t a1[3][3] = {{0, 1, 0}, {0, 0, 1}, {4294967087ULL - 810728, 1403580, 0}};
+    static const uint64_t a2[3][3] = {{0, 1, 0}, {0, 0, 1}, {4294944443ULL - 1370589, 0, 527612}};
+
+    uint64_t s1[3];
+    uint64_t s2[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        s1[i] = s2[i] = RngSeedManager::GetSeed();
+    }
+    Advance(a1, 4294967087ULL, stream, 127, s1);
+    Advance(a2, 4294944443ULL, stream, 127, s2);
+    Advance(a1, 4294967087ULL, RngSeedManager::GetRun(), 76, s1);
+    Advance(a2, 4294944443ULL, RngSeedManager::GetRun(), 76, s2);
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        m_state[i] = static_cast<double>(s1[i]);
+        m_state[i + 3] = static_cast<double>(s2[i]);
+    }
+}
+
+void
+BatchUniformStream::Multiply(const uint64_t a[3][3],
+                             const uint64_t b[3][3],
+                             uint64_t m,
+                             uint64_t r[3][3])
+{
+    uint64_t product[3][3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            uint64_t sum = 0;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                // Both factors are below 2^32, so the product fits
+                sum = (sum + a[i][k] * b[k][j] % m) % m;
+            }
+            product[i][j] = sum;
+        }
+    }
+    memcpy(r, product, sizeof(product));
+}
+
+void
+BatchUniformStream::Advance(const uint64_t a[3][3],
+                            uint64_t m,
+                            uint64_t n,
+                            uint32_t e,
+                            uint64_t s[3])
+{
+    uint64_t power[3][3];
+    memcpy(power, a, sizeof(power));
+    for (uint32_t i = 0; i < e; ++i)
+    {
+        Multiply(power, power, m, power);
+    }
+    for (; n != 0; n >>= 1)
+    {
+        if (n & 1)
+        {
+            uint64_t next[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                next[i] = 0;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    next[i] = (next[i] + power[i][k] * s[k] % m) % m;
+                }
+            }
+            memcpy(s, next, sizeof(next));
+        }
+        Multiply(power, power, m, power);
+    }
+}
+
+void
+BatchUniformStream::Fill(double* values, std::size_t count, double min, double max)
+{
+    // The recurrence of RngStream::RandU01, with the state kept in locals
+    const double norm = 1.0 / (M1 + 1.0);
+    const double range = max - min;
+    double s0 = m_state[0];
+    double s1 = m_state[1];
+    double s2 = m_state[2];
+    double s3 = m_state[3];
+    double s4 = m_state[4];
+    double s5 = m_state[5];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double p1 = 1403580.0 * s1 - 810728.0 * s0;
+        p1 -= static_cast<int32_t>(p1 / M1) * M1;
+        if (p1 < 0.0)
+        {
+            p1 += M1;
+        }
+        s0 = s1;
+        s1 = s2;
+        s2 = p1;
+
+        double p2 = 527612.0 * s5 - 1370589.0 * s3;
+        p2 -= static_cast<int32_t>(p2 / M2) * M2;
+        if (p2 < 0.0)
+        {
+            p2 += M2;
+        }
+        s3 = s4;
+        s4 = s5;
+        s5 = p2;
+
+        double u = (p1 > p2 ? p1 - p2 : p1 - p2 + M1) * norm;
+        values[i] = min + u * range;
+    }
+    m_state[0] = s0;
+    m_state[1] = s1;
+    m_state[2] = s2;
+    m_state[3] = s3;
+    m_state[4] = s4;
+    m_state[5] = s5;
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -62,11 +1176,29 @@ main(int argc, char* argv[])
     std::string pcap_name("n-node-ppp");
     std::string flow_name("n-node-ppp.xml");
     std::string anim_name("n-node-ppp.anim.xml");
+    std::string anim_bin_name("n-node-ppp.anim.bin");
 
     std::string adj_mat_file_name("examples/matrix-topology/adjacency_matrix.txt");
     std::string node_coordinates_file_name("examples/matrix-topology/node_coordinates.txt");
 
+    bool binaryAnim = false;
+    double animSampling = 1.0;
+    uint32_t animMetadata = 0;
+    bool asyncAscii = false;
+    std::string asciiEvents = "+-dr";
+    std::string asciiNodes;
+
     CommandLine cmd(__FILE__);
+    cmd.AddValue("binaryAnim", "Write a binary animation trace instead of NetAnim XML", binaryAnim);
+    cmd.AddValue("animSampling", "Fraction of packets kept in the binary trace", animSampling);
+    cmd.AddValue("animMetadata",
+                 "Binary trace: metadata of one in N kept packets, 0 for none",
+                 animMetadata);
+    cmd.AddValue("asyncAscii", "Format the ASCII trace on a separate thread", asyncAscii);
+    cmd.AddValue("asciiEvents", "Events kept with --asyncAscii: any of + - d r", asciiEvents);
+    cmd.AddValue("asciiNodes",
+                 "Comma-separated ids of the nodes traced with --asyncAscii, all if empty",
+                 asciiNodes);
     cmd.Parse(argc, argv);
 
     // ---------- End of Simulation Variables ----------------------------------
@@ -202,21 +1334,23 @@ main(int argc, char* argv[])
 
     NS_LOG_INFO("Setup CBR Traffic Sources.");
 
+    // We needed to generate a random number (rn) to be used to eliminate
+    // the artificial congestion caused by sending the packets at the
+    // same time. This rn is added to AppStartTime to have the sources
+    // start at different time, however they will still send at the same rate.
+    // The numbers of all n*(n-1) flows are drawn at once.
+    std::vector<double> startOffsets(n_nodes * (n_nodes - 1));
+    BatchUniformStream startOffsetStream;
+    startOffsetStream.Fill(startOffsets, 0, 1);
+    std::size_t flow = 0;
+
     for (int i = 0; i < n_nodes; i++)
     {
         for (int j = 0; j < n_nodes; j++)
         {
             if (i != j)
             {
-                // We needed to generate a random number (rn) to be used to eliminate
-                // the artificial congestion caused by sending the packets at the
-                // same time. This rn is added to AppStartTime to have the sources
-                // start at different time, however they will still send at the same rate.
-
-                Ptr<UniformRandomVariable> x = CreateObject<UniformRandomVariable>();
-                x->SetAttribute("Min", DoubleValue(0));
-                x->SetAttribute("Max", DoubleValue(1));
-                double rn = x->GetValue();
+                double rn = startOffsets[flow++];
                 Ptr<Node> n = nodes.Get(j);
                 Ptr<Ipv4> ipv4 = n->GetObject<Ipv4>();
                 Ipv4InterfaceAddress ipv4_int_addr = ipv4->GetAddress(1, 0);
@@ -239,21 +1373,45 @@ main(int argc, char* argv[])
 
     NS_LOG_INFO("Configure Tracing.");
 
-    AsciiTraceHelper ascii;
-    p2p.EnableAsciiAll(ascii.CreateFileStream(tr_name));
+    std::unique_ptr<AsyncAsciiTrace> asyncAsciiTrace;
+    if (asyncAscii)
+    {
+        asyncAsciiTrace = std::make_unique<AsyncAsciiTrace>(tr_name, asciiEvents, asciiNodes);
+        asyncAsciiTrace->AttachAll();
+    }
+    else
+    {
+        AsciiTraceHelper ascii;
+        p2p.EnableAsciiAll(ascii.CreateFileStream(tr_name));
+    }
     // p2p.EnablePcapAll(pcap_name);
 
     // Ptr<FlowMonitor> flowmon;
     // FlowMonitorHelper flowmonHelper;
     // flowmon = flowmonHelper.InstallAll();
 
-    // Configure animator with default settings
+    // Configure animator with default settings, or the binary trace for large topologies
 
-    AnimationInterface anim(anim_name);
+    std::unique_ptr<AnimationInterface> anim;
+    std::unique_ptr<BinaryAnimTrace> binaryAnimTrace;
+    if (binaryAnim)
+    {
+        binaryAnimTrace = std::make_unique<BinaryAnimTrace>(anim_bin_name, MilliSeconds(250));
+        binaryAnimTrace->SetPacketSampling(animSampling);
+        binaryAnimTrace->EnablePacketMetadata(animMetadata);
+    }
+    else
+    {
+        anim = std::make_unique<AnimationInterface>(anim_name);
+    }
     NS_LOG_INFO("Run Simulation.");
 
     Simulator::Stop(Seconds(SimTime));
     Simulator::Run();
+    if (asyncAsciiTrace)
+    {
+        asyncAsciiTrace->Close();
+    }
     // flowmon->SerializeToXmlFile(flow_name, true, true);
     Simulator::Destroy();
 
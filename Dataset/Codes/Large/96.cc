@@ -8,18 +8,1164 @@
 // - UDP flows from n0 to n1 and back
 // - DropTail queues
 // - Tracing of queues and packet receptions to file "udp-echo.tr"
+//
+// Every event's lag behind its realtime deadline is measured and summarized at the end
+// of the run, with an alarm count for events later than --maxLag. With --hybrid the
+// waiting is done by HybridRealtimeScheduler (sleep, then spin for the last
+// --spinThreshold) instead of the realtime simulator's synchronizer, and --cpu / --fifo
+// pin the simulation to one core and run it under SCHED_FIFO.
+//
+// With --asyncPcap the capture is written by AsyncPcapWriter on a separate thread, with
+// --snapLen truncation, and optionally as a single pcapng file (--pcapng) and gzip
+// compressed (--compressPcap).
 
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
 
+#include <arpa/inet.h>
+#include <sched.h>
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("RealtimeUdpEchoExample");
 
+/**
+ * Fixed-memory histogram with log-linear buckets: values below 8 get one bucket
+ * each, and every power of two above that is split into 8 equal buckets, so any
+ * recorded value is known to within 12.5%. Values of 2^41 and more share the top
+ * bucket. Recording a value is a shift and an increment; no memory is allocated.
+ */
+class LogLinearHistogram
+{
+  public:
+    /// Record one sample.
+    void Add(uint64_t value)
+    {
+        m_counts[Index(value)]++;
+        m_count++;
+        m_max = std::max(m_max, value);
+    }
+
+    /// \return the number of recorded samples
+    uint64_t GetCount() const
+    {
+        return m_count;
+    }
+
+    /// \return the largest recorded sample, 0 if none
+    uint64_t GetMax() const
+    {
+        return m_max;
+    }
+
+    /// \return the upper bound of the bucket holding the q-quantile (0 < q <= 1)
+    uint64_t GetQuantile(double q) const
+    {
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * m_count));
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank && seen > 0)
+            {
+                return i + 1 < NUM_BUCKETS ? std::min(m_max, Lower(i + 1) - 1) : m_max;
+            }
+        }
+        return 0;
+    }
+
+  private:
+    static constexpr uint32_t SUB_BITS = 3;
+    static constexpr uint32_t SUB = 1 << SUB_BITS;
+    static constexpr uint32_t MAX_EXP = 40;
+    static constexpr uint32_t NUM_BUCKETS = SUB + (MAX_EXP - SUB_BITS + 1) * SUB;
+
+    static uint32_t Index(uint64_t value)
+    {
+        if (value < SUB)
+        {
+            return value;
+        }
+        uint32_t exp = 63 - __builtin_clzll(value);
+        if (exp > MAX_EXP)
+        {
+            return NUM_BUCKETS - 1;
+        }
+        return SUB + (exp - SUB_BITS) * SUB + ((value >> (exp - SUB_BITS)) & (SUB - 1));
+    }
+
+    static uint64_t Lower(uint32_t index)
+    {
+        if (index < SUB)
+        {
+            return index;
+        }
+        uint32_t exp = (index - SUB) / SUB + SUB_BITS;
+        return (uint64_t{1} << exp) + (uint64_t{(index - SUB) % SUB} << (exp - SUB_BITS));
+    }
+
+    std::array<uint32_t, NUM_BUCKETS> m_counts{};
+    uint64_t m_count{0};
+    uint64_t m_max{0};
+};
+
+/**
+ * Lag telemetry gathered by HybridRealtimeScheduler: how late, in wall-clock time,
+ * every event was handed to the simulator compared to its realtime deadline.
+ */
+struct LagTelemetry
+{
+    LogLinearHistogram lagNs;     //!< lag of every event
+    LogLinearHistogram jitterNs;  //!< change of lag between consecutive events
+    Time maxLag{MilliSeconds(1)}; //!< lag above which an alarm is raised
+    uint64_t alarms{0};           //!< number of events later than maxLag
+    Time firstAlarm;              //!< simulation time of the first alarm
+    bool running{false};          //!< Simulator::Run() is in progress
+};
+
+static LagTelemetry g_lagTelemetry;
+
+/**
+ * Map scheduler that measures, and optionally enforces, realtime deadlines.
+ *
+ * Every event removed from the scheduler is about to run; its lag is the wall-clock time
+ * elapsed since the run started minus its simulation timestamp. Under the realtime
+ * simulator the scheduler only measures. With Pace set, the default simulator can be
+ * used instead and the scheduler does the waiting itself: it sleeps until SpinThreshold
+ * before the deadline, then spins, which trades CPU for sub-millisecond accuracy.
+ * Outside Simulator::Run() events are only being discarded, as Simulator::Destroy()
+ * does with those left after Stop, so they are neither waited for nor measured.
+ */
+class HybridRealtimeScheduler : public MapScheduler
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    Event RemoveNext() override;
+
+  private:
+    /// \return the CLOCK_MONOTONIC time in nanoseconds
+    static int64_t WallNs();
+
+    bool m_pace;            //!< wait for the deadlines instead of only measuring
+    Time m_spinThreshold;   //!< how long before a deadline sleeping turns into spinning
+    int64_t m_originNs{-1}; //!< wall-clock time of simulation time zero
+    int64_t m_lastLagNs{0}; //!< lag of the previous event
+};
+
+NS_OBJECT_ENSURE_REGISTERED(HybridRealtimeScheduler);
+
+TypeId
+HybridRealtimeScheduler::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::HybridRealtimeScheduler")
+            .SetParent<MapScheduler>()
+            .AddConstructor<HybridRealtimeScheduler>()
+            .AddAttribute("Pace",
+                          "Wait for every event's realtime deadline",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&HybridRealtimeScheduler::m_pace),
+                          MakeBooleanChecker())
+            .AddAttribute("SpinThreshold",
+                          "Remaining time to a deadline below which the wait spins",
+                          TimeValue(MicroSeconds(200)),
+                          MakeTimeAccessor(&HybridRealtimeScheduler::m_spinThreshold),
+                          MakeTimeChecker());
+    return tid;
+}
+
+int64_t
+HybridRealtimeScheduler::WallNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+Scheduler::Event
+HybridRealtimeScheduler::RemoveNext()
+{
+    if (!g_lagTelemetry.running)
+    {
+        return MapScheduler::RemoveNext();
+    }
+
+    int64_t deadlineNs = TimeStep(PeekNext().key.m_ts).GetNanoSeconds();
+    if (m_originNs < 0)
+    {
+        m_originNs = WallNs() - deadlineNs;
+    }
+    deadlineNs += m_originNs;
+
+    if (m_pace)
+    {
+        int64_t sleepUntilNs = deadlineNs - m_spinThreshold.GetNanoSeconds();
+        if (WallNs() < sleepUntilNs)
+        {
+            struct timespec until;
+            until.tv_sec = sleepUntilNs / 1000000000;
+            until.tv_nsec = sleepUntilNs % 1000000000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR)
+            {
+            }
+        }
+        while (WallNs() < deadlineNs)
+        {
+        }
+    }
+
+    int64_t lagNs = std::max<int64_t>(WallNs() - deadlineNs, 0);
+    g_lagTelemetry.lagNs.Add(lagNs);
+    g_lagTelemetry.jitterNs.Add(std::abs(lagNs - m_lastLagNs));
+    m_lastLagNs = lagNs;
+
+    Event next = MapScheduler::RemoveNext();
+    if (lagNs > g_lagTelemetry.maxLag.GetNanoSeconds())
+    {
+        if (g_lagTelemetry.alarms++ == 0)
+        {
+            g_lagTelemetry.firstAlarm = TimeStep(next.key.m_ts);
+        }
+        NS_LOG_WARN("Event at " << TimeStep(next.key.m_ts).As(Time::S) << " ran "
+                                << NanoSeconds(lagNs).As(Time::US) << " late");
+    }
+    return next;
+}
+
+/**
+ * Asynchronous pcap / pcapng writer.
+ *
+ * The simulation thread only copies the first SnapLen bytes of every captured frame,
+ * with its timestamp, into a per-device single-producer ring buffer; a writer thread
+ * drains the rings, formats the records and does all the file I/O. A full ring blocks
+ * the simulation until the writer catches up, so no frame is ever dropped.
+ *
+ * In pcap mode every device gets its own <prefix>-<node>-<device>.pcap file, as with
+ * the helpers' EnablePcap. In pcapng mode all devices share <prefix>.pcapng, one
+ * interface per device. With compression the output is piped through "gzip -1" (and
+ * gets a .gz suffix, which Wireshark opens directly). Timestamps have nanosecond
+ * resolution.
+ */
+class AsyncPcapWriter : public SimpleRefCount<AsyncPcapWriter>
+{
+  public:
+    /**
+     * \param prefix file name prefix
+     * \param pcapng write a single pcapng file instead of one pcap file per device
+     * \param snapLen maximum number of bytes kept from each frame
+     * \param compress compress the output with gzip
+     * \param ringBytes size of each device's ring buffer, rounded up to a power of two
+     */
+    AsyncPcapWriter(const std::string& prefix,
+                    bool pcapng,
+                    uint32_t snapLen,
+                    bool compress,
+                    uint32_t ringBytes);
+    ~AsyncPcapWriter();
+
+    /**
+     * Capture every frame a device sends or receives, through its Sniffer or
+     * PromiscSniffer trace source; must be called before the simulation starts.
+     * \param device a CSMA or point-to-point device
+     * \param dataLinkType the pcap link type of the device's frames
+     * \param promiscuous also capture frames addressed to other devices
+     */
+    void Attach(Ptr<NetDevice> device, uint32_t dataLinkType, bool promiscuous);
+
+    /// Drain the rings, stop the writer thread and close the files.
+    void Close();
+
+  private:
+    /// Single-producer, single-consumer byte ring holding one device's records.
+    struct Ring
+    {
+        std::vector<uint8_t> data;
+        std::atomic<uint64_t> head{0}; //!< bytes ever written, updated by the simulation
+        std::atomic<uint64_t> tail{0}; //!< bytes ever read, updated by the writer
+        FILE* file{nullptr}; //!< pcap mode only
+    };
+
+    /// Record header in a ring, followed by capturedLength bytes of frame
+    struct RecordHeader
+    {
+        uint64_t timeNs;
+        uint32_t capturedLength;
+        uint32_t originalLength;
+    };
+
+    static void Capture(AsyncPcapWriter* writer, uint32_t interface, Ptr<const Packet> packet);
+    void Push(Ring& ring, const uint8_t* bytes, uint64_t size);
+    void Pop(Ring& ring, uint8_t* bytes, uint64_t size);
+    FILE* Open(const std::string& name);
+    void CloseFile(FILE*& file);
+    void WriteFileHeader(FILE* file, uint32_t dataLinkType);
+    void WriteInterfaceDescription(uint32_t dataLinkType);
+    bool DrainOnce();
+    void Run();
+
+    std::string m_prefix;
+    bool m_pcapng;
+    uint32_t m_snapLen;
+    bool m_compress;
+    uint64_t m_ringBytes;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    std::vector<uint8_t> m_frame; //!< scratch buffer, simulation thread
+    std::vector<uint8_t> m_out;   //!< scratch buffer, writer thread
+    FILE* m_file{nullptr};        //!< pcapng mode only
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::atomic<bool> m_stop{false};
+};
+
+AsyncPcapWriter::AsyncPcapWriter(const std::string& prefix,
+                                 bool pcapng,
+                                 uint32_t snapLen,
+                                 bool compress,
+                                 uint32_t ringBytes)
+    : m_prefix(prefix),
+      m_pcapng(pcapng),
+      m_snapLen(snapLen),
+      m_compress(compress),
+      m_ringBytes(1),
+      m_frame(snapLen)
+{
+    while (m_ringBytes < std::max<uint64_t>(ringBytes, sizeof(RecordHeader) + snapLen))
+    {
+        m_ringBytes <<= 1;
+    }
+    if (m_pcapng)
+    {
+        m_file = Open(m_prefix + ".pcapng");
+        // Section header block: byte-order magic, version 1.0, unknown section length
+        uint32_t shb[7] = {0x0A0D0D0A, 28, 0x1A2B3C4D, 1, 0xffffffff, 0xffffffff, 28};
+        fwrite(shb, sizeof(shb), 1, m_file);
+    }
+}
+
+AsyncPcapWriter::~AsyncPcapWriter()
+{
+    Close();
+}
+
+FILE*
+AsyncPcapWriter::Open(const std::string& name)
+{
+    FILE* file = m_compress ? popen(("gzip -1 > '" + name + ".gz'").c_str(), "w")
+                            : fopen(name.c_str(), "wb");
+    NS_ABORT_MSG_IF(!file, "Cannot open capture file " << name);
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    return file;
+}
+
+void
+AsyncPcapWriter::WriteFileHeader(FILE* file, uint32_t dataLinkType)
+{
+    // Nanosecond-resolution pcap, version 2.4
+    uint32_t header[6] = {0xa1b23c4d, 2 | (4 << 16), 0, 0, m_snapLen, dataLinkType};
+    fwrite(header, sizeof(header), 1, file);
+}
+
+void
+AsyncPcapWriter::WriteInterfaceDescription(uint32_t dataLinkType)
+{
+    // Interface description block with an if_tsresol option of 10^-9 s
+    uint32_t idb[8] = {1, 32, dataLinkType, m_snapLen, 9 | (1 << 16), 9, 0, 32};
+    fwrite(idb, sizeof(idb), 1, m_file);
+}
+
+void
+AsyncPcapWriter::Attach(Ptr<NetDevice> device, uint32_t dataLinkType, bool promiscuous)
+{
+    NS_ABORT_MSG_IF(m_writer.joinable(), "Devices must be attached before the simulation");
+    auto ring = std::make_unique<Ring>();
+    ring->data.resize(m_ringBytes);
+    if (m_pcapng)
+    {
+        WriteInterfaceDescription(dataLinkType);
+    }
+    else
+    {
+        std::ostringstream name;
+        name << m_prefix << "-" << device->GetNode()->GetId() << "-" << device->GetIfIndex()
+             << ".pcap";
+        ring->file = Open(name.str());
+        WriteFileHeader(ring->file, dataLinkType);
+    }
+    device->TraceConnectWithoutContext(
+        promiscuous ? "PromiscSniffer" : "Sniffer",
+        MakeBoundCallback(&AsyncPcapWriter::Capture, this, static_cast<uint32_t>(m_rings.size())));
+    m_rings.push_back(std::move(ring));
+}
+
+void
+AsyncPcapWriter::Capture(AsyncPcapWriter* writer, uint32_t interface, Ptr<const Packet> packet)
+{
+    if (!writer->m_writer.joinable())
+    {
+        writer->m_writer = std::thread(&AsyncPcapWriter::Run, writer);
+    }
+    RecordHeader header;
+    header.timeNs = Simulator::Now().GetNanoSeconds();
+    header.originalLength = packet->GetSize();
+    header.capturedLength = std::min(header.originalLength, writer->m_snapLen);
+    packet->CopyData(writer->m_frame.data(), header.capturedLength);
+
+    Ring& ring = *writer->m_rings[interface];
+    writer->Push(ring, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    writer->Push(ring, writer->m_frame.data(), header.capturedLength);
+}
+
+void
+AsyncPcapWriter::Push(Ring& ring, const uint8_t* bytes, uint64_t size)
+{
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    while (head + size - ring.tail.load(std::memory_order_acquire) > m_ringBytes)
+    {
+        m_wakeUp.notify_one(); // ring full: let the writer catch up
+        std::this_thread::yield();
+    }
+    uint64_t offset = head & (m_ringBytes - 1);
+    uint64_t first = std::min(size, m_ringBytes - offset);
+    memcpy(ring.data.data() + offset, bytes, first);
+    memcpy(ring.data.data(), bytes + first, size - first);
+    ring.head.store(head + size, std::memory_order_release);
+}
+
+void
+AsyncPcapWriter::Pop(Ring& ring, uint8_t* bytes, uint64_t size)
+{
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t offset = tail & (m_ringBytes - 1);
+    uint64_t first = std::min(size, m_ringBytes - offset);
+    memcpy(bytes, ring.data.data() + offset, first);
+    memcpy(bytes + first, ring.data.data(), size - first);
+    ring.tail.store(tail + size, std::memory_order_release);
+}
+
+bool
+AsyncPcapWriter::DrainOnce()
+{
+    bool drained = false;
+    for (uint32_t interface = 0; interface < m_rings.size(); ++interface)
+    {
+        Ring& ring = *m_rings[interface];
+        // A record is only complete once head has moved past its frame bytes
+        while (true)
+        {
+            uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+            uint64_t available = ring.head.load(std::memory_order_acquire) - tail;
+            if (available < sizeof(RecordHeader))
+            {
+                break;
+            }
+            RecordHeader header;
+            uint64_t offset = tail & (m_ringBytes - 1);
+            uint64_t first = std::min<uint64_t>(sizeof(header), m_ringBytes - offset);
+            memcpy(&header, ring.data.data() + offset, first);
+            memcpy(reinterpret_cast<uint8_t*>(&header) + first,
+                   ring.data.data(),
+                   sizeof(header) - first);
+            if (available < sizeof(header) + header.capturedLength)
+            {
+                break;
+            }
+            ring.tail.store(tail + sizeof(header), std::memory_order_relaxed);
+
+            uint32_t padded = (header.capturedLength + 3) & ~3u;
+            m_out.assign(padded + 32, 0);
+            if (m_pcapng)
+            {
+                // Enhanced packet block
+                uint32_t blockLength = 32 + padded;
+                uint32_t epb[7] = {6,
+                                   blockLength,
+                                   interface,
+                                   static_cast<uint32_t>(header.timeNs >> 32),
+                                   static_cast<uint32_t>(header.timeNs),
+                                   header.capturedLength,
+                                   header.originalLength};
+                memcpy(m_out.data(), epb, sizeof(epb));
+                Pop(ring, m_out.data() + sizeof(epb), header.capturedLength);
+                memcpy(m_out.data() + sizeof(epb) + padded, &blockLength, 4);
+                fwrite(m_out.data(), blockLength, 1, m_file);
+            }
+            else
+            {
+                uint32_t record[4] = {static_cast<uint32_t>(header.timeNs / 1000000000),
+                                      static_cast<uint32_t>(header.timeNs % 1000000000),
+                                      header.capturedLength,
+                                      header.originalLength};
+                memcpy(m_out.data(), record, sizeof(record));
+                Pop(ring, m_out.data() + sizeof(record), header.capturedLength);
+                fwrite(m_out.data(), sizeof(record) + header.capturedLength, 1, ring.file);
+            }
+            drained = true;
+        }
+    }
+    return drained;
+}
+
+void
+AsyncPcapWriter::Run()
+{
+    while (!m_stop.load())
+    {
+        if (!DrainOnce())
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+    DrainOnce();
+}
+
+void
+AsyncPcapWriter::Close()
+{
+    if (m_writer.joinable())
+    {
+        m_stop.store(true);
+        m_wakeUp.notify_one();
+        m_writer.join();
+    }
+    else
+    {
+        DrainOnce();
+    }
+    for (auto& ring : m_rings)
+    {
+        CloseFile(ring->file);
+    }
+    CloseFile(m_file);
+}
+
+void
+AsyncPcapWriter::CloseFile(FILE*& file)
+{
+    if (file)
+    {
+        if (m_compress)
+        {
+            pclose(file);
+        }
+        else
+        {
+            fclose(file);
+        }
+        file = nullptr;
+    }
+}
+
+/**
+ * Asynchronous, filterable ASCII trace of CSMA devices.
+ *
+ * Stands in for the helpers' EnableAsciiAll on busy links. Event types ('+' enqueue,
+ * '-' dequeue, 'd' drop, 'r' receive) and nodes that are filtered out are never
+ * connected, so they cost nothing. A kept event copies only the time, the packet size
+ * and the first bytes of the packet (enough for its headers) into a block, and a
+ * formatter thread turns the blocks into text. Lines keep the helpers' layout,
+ * "<event> <time> <context> <headers>", but the headers are decoded from the packet
+ * bytes instead of being printed from packet metadata: Ethernet, ARP, PPP, IPv4, IPv6
+ * and its extension headers, ICMP, ICMPv6, UDP and TCP are shown, the rest as payload.
+ */
+class AsyncAsciiTrace
+{
+  public:
+    /**
+     * \param fileName output file
+     * \param events the event types to keep, e.g. "+-dr" for all of them
+     * \param nodes comma-separated ids of the nodes to keep; all nodes if empty
+     */
+    AsyncAsciiTrace(const std::string& fileName,
+                    const std::string& events,
+                    const std::string& nodes);
+    ~AsyncAsciiTrace();
+
+    /// Trace every CSMA device of the kept nodes.
+    void AttachAll();
+
+    /// Format the pending events, stop the formatter thread and close the file.
+    void Close();
+
+  private:
+    static const uint32_t CAPTURE_BYTES = 128;
+    static const uint32_t BLOCK_BYTES = 1 << 16;
+    static const uint32_t MAX_PENDING_BLOCKS = 64;
+
+    /// What the captured bytes start with
+    enum Framing
+    {
+        PPP,
+        ETHERNET,
+        NETWORK //!< received packets, whose link header has been removed
+    };
+
+    /// One connected trace source
+    struct Source
+    {
+        char event;
+        Framing framing;
+        std::string context; //!< configuration path printed on every line
+    };
+
+    /// Event header in a block, followed by 'captured' packet bytes
+    struct Event
+    {
+        int64_t timeNs;
+        uint32_t source;
+        uint32_t size;
+        uint32_t captured;
+    };
+
+    void Connect(Ptr<Object> object,
+                 const std::string& traceSource,
+                 char event,
+                 Framing framing,
+                 const std::string& context);
+    static void Capture(AsyncAsciiTrace* trace, uint32_t source, Ptr<const Packet> packet);
+    void Flush();
+    void Run();
+    void Format(const Event& event, const uint8_t* bytes);
+    void FormatNetwork(uint16_t etherType, const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatIpv4(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatIpv6(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatArp(const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatTransport(uint8_t protocol, const uint8_t* p, uint32_t captured, uint32_t size);
+    void FormatPayload(uint32_t size);
+    void FormatMac(const uint8_t* p);
+    void FormatAddress(int family, const uint8_t* p);
+
+    static uint16_t Read16(const uint8_t* p)
+    {
+        return (p[0] << 8) | p[1];
+    }
+
+    static uint32_t Read32(const uint8_t* p)
+    {
+        return (static_cast<uint32_t>(Read16(p)) << 16) | Read16(p + 2);
+    }
+
+    FILE* m_file;
+    std::string m_events;
+    std::set<uint32_t> m_nodes;
+    std::vector<Source> m_sources;
+    std::vector<uint8_t> m_block;             //!< block being filled, simulation thread
+    std::deque<std::vector<uint8_t>> m_queue; //!< blocks waiting for the formatter
+    std::ostringstream m_line;                //!< formatter thread
+    std::thread m_formatter;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_drained;
+    bool m_stop;
+};
+
+AsyncAsciiTrace::AsyncAsciiTrace(const std::string& fileName,
+                                 const std::string& events,
+                                 const std::string& nodes)
+    : m_events(events),
+      m_stop(false)
+{
+    std::istringstream list(nodes);
+    std::string id;
+    while (std::getline(list, id, ','))
+    {
+        m_nodes.insert(std::stoul(id));
+    }
+    m_file = fopen(fileName.c_str(), "w");
+    NS_ABORT_MSG_IF(!m_file, "Cannot open ASCII trace " << fileName);
+    setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+    m_block.reserve(BLOCK_BYTES + sizeof(Event) + CAPTURE_BYTES);
+    m_line << std::setprecision(9);
+    m_formatter = std::thread(&AsyncAsciiTrace::Run, this);
+}
+
+AsyncAsciiTrace::~AsyncAsciiTrace()
+{
+    Close();
+}
+
+void
+AsyncAsciiTrace::AttachAll()
+{
+    for (uint32_t i = 0; i < NodeList::GetNNodes(); ++i)
+    {
+        if (!m_nodes.empty() && m_nodes.find(i) == m_nodes.end())
+        {
+            continue;
+        }
+        Ptr<Node> node = NodeList::GetNode(i);
+        for (uint32_t j = 0; j < node->GetNDevices(); ++j)
+        {
+            Ptr<NetDevice> device = node->GetDevice(j);
+            Ptr<Object> queue;
+            Framing framing;
+            std::ostringstream context;
+            context << "/NodeList/" << i << "/DeviceList/" << j << "/";
+            if (Ptr<CsmaNetDevice> csma = DynamicCast<CsmaNetDevice>(device))
+            {
+                queue = csma->GetQueue();
+                framing = ETHERNET;
+                context << "$ns3::CsmaNetDevice/";
+            }
+            else
+            {
+                continue;
+            }
+            Connect(queue, "Enqueue", '+', framing, context.str() + "TxQueue/Enqueue");
+            Connect(queue, "Dequeue", '-', framing, context.str() + "TxQueue/Dequeue");
+            Connect(queue, "Drop", 'd', framing, context.str() + "TxQueue/Drop");
+            Connect(device, "PhyRxDrop", 'd', framing, context.str() + "PhyRxDrop");
+            Connect(device, "MacRx", 'r', NETWORK, context.str() + "MacRx");
+        }
+    }
+}
+
+void
+AsyncAsciiTrace::Connect(Ptr<Object> object,
+                         const std::string& traceSource,
+                         char event,
+                         Framing framing,
+                         const std::string& context)
+{
+    if (m_events.find(event) == std::string::npos)
+    {
+        return;
+    }
+    uint32_t source = m_sources.size();
+    m_sources.push_back(Source{event, framing, context});
+    object->TraceConnectWithoutContext(traceSource,
+                                       MakeBoundCallback(&AsyncAsciiTrace::Capture, this, source));
+}
+
+void
+AsyncAsciiTrace::Capture(AsyncAsciiTrace* trace, uint32_t source, Ptr<const Packet> packet)
+{
+    Event event;
+    event.timeNs = Simulator::Now().GetNanoSeconds();
+    event.source = source;
+    event.size = packet->GetSize();
+    event.captured = event.size < CAPTURE_BYTES ? event.size : CAPTURE_BYTES;
+
+    std::vector<uint8_t>& block = trace->m_block;
+    std::size_t offset = block.size();
+    block.resize(offset + sizeof(Event) + event.captured);
+    memcpy(block.data() + offset, &event, sizeof(Event));
+    packet->CopyData(block.data() + offset + sizeof(Event), event.captured);
+    if (block.size() >= BLOCK_BYTES)
+    {
+        trace->Flush();
+    }
+}
+
+void
+AsyncAsciiTrace::Flush()
+{
+    if (m_block.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A formatter that cannot keep up holds the simulation back instead of using up memory
+    while (m_queue.size() >= MAX_PENDING_BLOCKS)
+    {
+        m_drained.wait(lock);
+    }
+    m_queue.push_back(std::move(m_block));
+    m_block = std::vector<uint8_t>();
+    m_block.reserve(BLOCK_BYTES + sizeof(Event) + CAPTURE_BYTES);
+    m_wakeUp.notify_one();
+}
+
+void
+AsyncAsciiTrace::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        while (!m_stop && m_queue.empty())
+        {
+            m_wakeUp.wait(lock);
+        }
+        if (m_queue.empty())
+        {
+            break;
+        }
+        std::vector<uint8_t> block = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_drained.notify_one();
+        lock.unlock();
+        for (std::size_t offset = 0; offset < block.size();)
+        {
+            Event event;
+            memcpy(&event, block.data() + offset, sizeof(Event));
+            Format(event, block.data() + offset + sizeof(Event));
+            offset += sizeof(Event) + event.captured;
+        }
+        lock.lock();
+    }
+}
+
+void
+AsyncAsciiTrace::Close()
+{
+    if (!m_formatter.joinable())
+    {
+        return;
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_formatter.join();
+    fclose(m_file);
+}
+
+void
+AsyncAsciiTrace::Format(const Event& event, const uint8_t* bytes)
+{
+    const Source& source = m_sources[event.source];
+    m_line.str("");
+    m_line << source.event << " " << event.timeNs / 1e9 << " " << source.context << " ";
+    switch (source.framing)
+    {
+    case PPP:
+        if (event.captured < 2)
+        {
+            FormatPayload(event.size);
+            break;
+        }
+        m_line << "ns3::PppHeader (Point-to-Point Protocol: ";
+        switch (Read16(bytes))
+        {
+        case 0x0021:
+            m_line << "IP (0x0021)) ";
+            FormatNetwork(0x0800, bytes + 2, event.captured - 2, event.size - 2);
+            break;
+        case 0x0057:
+            m_line << "IPv6 (0x0057)) ";
+            FormatNetwork(0x86dd, bytes + 2, event.captured - 2, event.size - 2);
+            break;
+        default:
+            m_line << "UNKNOWN (0x" << std::hex << Read16(bytes) << std::dec << ")) ";
+            FormatPayload(event.size - 2);
+        }
+        break;
+    case ETHERNET: {
+        if (event.captured < 14)
+        {
+            FormatPayload(event.size);
+            break;
+        }
+        uint16_t lengthType = Read16(bytes + 12);
+        m_line << "ns3::EthernetHeader ( length/type=0x" << std::hex << lengthType << std::dec
+               << ", source=";
+        FormatMac(bytes + 6);
+        m_line << ", destination=";
+        FormatMac(bytes);
+        m_line << ") ";
+        if (lengthType <= 1500 && event.captured >= 22)
+        {
+            // LLC/SNAP encapsulation
+            m_line << "ns3::LlcSnapHeader (type 0x" << std::hex << Read16(bytes + 20) << std::dec
+                   << ") ";
+            FormatNetwork(Read16(bytes + 20), bytes + 22, event.captured - 22, lengthType - 8);
+        }
+        else
+        {
+            FormatNetwork(lengthType, bytes + 14, event.captured - 14, event.size - 14);
+        }
+        break;
+    }
+    case NETWORK: {
+        uint16_t etherType = 0;
+        if (event.captured >= 4 && Read16(bytes) == 1 && Read16(bytes + 2) == 0x0800)
+        {
+            etherType = 0x0806;
+        }
+        else if (event.captured >= 1 && bytes[0] >> 4 == 4)
+        {
+            etherType = 0x0800;
+        }
+        else if (event.captured >= 1 && bytes[0] >> 4 == 6)
+        {
+            etherType = 0x86dd;
+        }
+        FormatNetwork(etherType, bytes, event.captured, event.size);
+        break;
+    }
+    }
+    m_line << "\n";
+    const std::string line = m_line.str();
+    fwrite(line.data(), line.size(), 1, m_file);
+}
+
+void
+AsyncAsciiTrace::FormatNetwork(uint16_t etherType,
+                               const uint8_t* p,
+                               uint32_t captured,
+                               uint32_t size)
+{
+    switch (etherType)
+    {
+    case 0x0800:
+        FormatIpv4(p, captured, size);
+        break;
+    case 0x86dd:
+        FormatIpv6(p, captured, size);
+        break;
+    case 0x0806:
+        FormatArp(p, captured, size);
+        break;
+    default:
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatIpv4(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    uint32_t headerLength = (p[0] & 0x0f) * 4;
+    if (captured < 20 || captured < headerLength)
+    {
+        FormatPayload(size);
+        return;
+    }
+    uint16_t totalLength = Read16(p + 2);
+    uint16_t fragment = Read16(p + 6);
+    uint32_t offset = (fragment & 0x1fff) * 8;
+    m_line << "ns3::Ipv4Header (tos 0x" << std::hex << static_cast<uint32_t>(p[1]) << std::dec
+           << " ttl " << static_cast<uint32_t>(p[8]) << " id " << Read16(p + 4) << " protocol "
+           << static_cast<uint32_t>(p[9]) << " offset (bytes) " << offset << " flags [";
+    if (fragment & 0x4000)
+    {
+        m_line << (fragment & 0x2000 ? "DF|MF" : "DF");
+    }
+    else
+    {
+        m_line << (fragment & 0x2000 ? "MF" : "none");
+    }
+    m_line << "] length: " << totalLength << " ";
+    FormatAddress(AF_INET, p + 12);
+    m_line << " > ";
+    FormatAddress(AF_INET, p + 16);
+    m_line << ") ";
+    // The IP length leaves out any Ethernet padding and trailer
+    size = std::min<uint32_t>(size, totalLength) - headerLength;
+    if (offset == 0)
+    {
+        FormatTransport(p[9], p + headerLength, captured - headerLength, size);
+    }
+    else
+    {
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatIpv6(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    if (captured < 40)
+    {
+        FormatPayload(size);
+        return;
+    }
+    uint32_t versionClassFlow = Read32(p);
+    uint16_t payloadLength = Read16(p + 4);
+    uint8_t nextHeader = p[6];
+    m_line << "ns3::Ipv6Header (Version 6 Traffic class: 0x" << std::hex
+           << ((versionClassFlow >> 20) & 0xff) << " Flow Label: 0x" << (versionClassFlow & 0xfffff)
+           << std::dec << " Payload Length: " << payloadLength << " Next Header: "
+           << static_cast<uint32_t>(nextHeader) << " Hop Limit: " << static_cast<uint32_t>(p[7])
+           << " ) ";
+    FormatAddress(AF_INET6, p + 8);
+    m_line << " > ";
+    FormatAddress(AF_INET6, p + 24);
+    m_line << ") ";
+    p += 40;
+    captured -= 40;
+    size = std::min<uint32_t>(size - 40, payloadLength);
+
+    // Extension headers, up to the transport header or a non-first fragment
+    while (true)
+    {
+        if ((nextHeader == 0 || nextHeader == 43 || nextHeader == 60) && captured >= 8)
+        {
+            uint32_t length = (p[1] + 1) * 8;
+            m_line << (nextHeader == 0    ? "ns3::Ipv6ExtensionHopByHopHeader"
+                       : nextHeader == 43 ? "ns3::Ipv6ExtensionRoutingHeader"
+                                          : "ns3::Ipv6ExtensionDestinationHeader")
+                   << " (Next header: " << static_cast<uint32_t>(p[0]) << " length: " << length
+                   << ") ";
+            if (length > captured || length > size)
+            {
+                FormatPayload(size);
+                return;
+            }
+            nextHeader = p[0];
+            p += length;
+            captured -= length;
+            size -= length;
+        }
+        else if (nextHeader == 44 && captured >= 8 && size >= 8)
+        {
+            uint16_t offsetFlags = Read16(p + 2);
+            m_line << "ns3::Ipv6ExtensionFragmentHeader (Next header: "
+                   << static_cast<uint32_t>(p[0]) << " Fragment offset: " << (offsetFlags & 0xfff8)
+                   << " More fragments: " << (offsetFlags & 1) << " Identification: "
+                   << Read32(p + 4) << ") ";
+            nextHeader = p[0];
+            p += 8;
+            captured -= 8;
+            size -= 8;
+            if ((offsetFlags & 0xfff8) != 0)
+            {
+                FormatPayload(size);
+                return;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    FormatTransport(nextHeader, p, captured, size);
+}
+
+void
+AsyncAsciiTrace::FormatArp(const uint8_t* p, uint32_t captured, uint32_t size)
+{
+    if (captured < 28 || p[4] != 6 || p[5] != 4)
+    {
+        FormatPayload(size);
+        return;
+    }
+    bool request = Read16(p + 6) == 1;
+    m_line << "ns3::ArpHeader (" << (request ? "request" : "reply") << " source mac: ";
+    FormatMac(p + 8);
+    m_line << " source ipv4: ";
+    FormatAddress(AF_INET, p + 14);
+    if (!request)
+    {
+        m_line << " dest mac: ";
+        FormatMac(p + 18);
+    }
+    m_line << " dest ipv4: ";
+    FormatAddress(AF_INET, p + 24);
+    m_line << ") ";
+    FormatPayload(size - 28);
+}
+
+void
+AsyncAsciiTrace::FormatTransport(uint8_t protocol,
+                                 const uint8_t* p,
+                                 uint32_t captured,
+                                 uint32_t size)
+{
+    if (protocol == 17 && captured >= 8 && size >= 8)
+    {
+        m_line << "ns3::UdpHeader (length: " << Read16(p + 4) << " " << Read16(p) << " > "
+               << Read16(p + 2) << ") ";
+        FormatPayload(size - 8);
+    }
+    else if (protocol == 6 && captured >= 20 && size >= (p[12] >> 4) * 4u)
+    {
+        static const char* names[] = {"FIN", "SYN", "RST", "PSH", "ACK", "URG", "ECE", "CWR"};
+        uint32_t headerLength = (p[12] >> 4) * 4;
+        m_line << "ns3::TcpHeader (" << Read16(p) << " > " << Read16(p + 2);
+        if (p[13] != 0)
+        {
+            m_line << " [";
+            const char* separator = "";
+            for (uint32_t bit = 0; bit < 8; ++bit)
+            {
+                if (p[13] & (1 << bit))
+                {
+                    m_line << separator << names[bit];
+                    separator = "|";
+                }
+            }
+            m_line << "]";
+        }
+        m_line << " Seq=" << Read32(p + 4) << " Ack=" << Read32(p + 8) << " Win=" << Read16(p + 14)
+               << ") ";
+        FormatPayload(size - headerLength);
+    }
+    else if ((protocol == 1 || protocol == 58) && captured >= 4 && size >= 4)
+    {
+        m_line << (protocol == 1 ? "ns3::Icmpv4Header (type=" : "ns3::Icmpv6Header (type=")
+               << static_cast<uint32_t>(p[0]) << ", code=" << static_cast<uint32_t>(p[1]) << ") ";
+        FormatPayload(size - 4);
+    }
+    else
+    {
+        FormatPayload(size);
+    }
+}
+
+void
+AsyncAsciiTrace::FormatPayload(uint32_t size)
+{
+    if (size > 0)
+    {
+        m_line << "Payload (size=" << size << ")";
+    }
+}
+
+void
+AsyncAsciiTrace::FormatMac(const uint8_t* p)
+{
+    char text[18];
+    snprintf(text,
+             sizeof(text),
+             "%02x:%02x:%02x:%02x:%02x:%02x",
+             p[0],
+             p[1],
+             p[2],
+             p[3],
+             p[4],
+             p[5]);
+    m_line << text;
+}
+
+void
+AsyncAsciiTrace::FormatAddress(int family, const uint8_t* p)
+{
+    char text[INET6_ADDRSTRLEN];
+    m_line << inet_ntop(family, p, text, sizeof(text));
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -27,14 +1173,71 @@ main(int argc, char* argv[])
     // Allow the user to override any of the defaults and the above Bind() at
     // run-time, via command-line arguments
     //
+    bool hybrid = false;
+    Time spinThreshold = MicroSeconds(200);
+    Time maxLag = MilliSeconds(1);
+    int32_t cpu = -1;
+    bool fifo = false;
+    bool asyncPcap = false;
+    uint32_t snapLen = 65535;
+    bool pcapng = false;
+    bool compressPcap = false;
+    bool asyncAscii = false;
+    std::string asciiEvents = "+-dr";
+    std::string asciiNodes;
+
     CommandLine cmd(__FILE__);
+    cmd.AddValue("hybrid", "Pace events with sleep-then-spin waits in the scheduler", hybrid);
+    cmd.AddValue("spinThreshold",
+                 "Time before a deadline at which --hybrid starts spinning",
+                 spinThreshold);
+    cmd.AddValue("maxLag", "Lag behind real time above which an alarm is raised", maxLag);
+    cmd.AddValue("cpu", "Pin the simulation to this CPU (-1: no pinning)", cpu);
+    cmd.AddValue("fifo", "Run the simulation under the SCHED_FIFO realtime policy", fifo);
+    cmd.AddValue("asyncPcap", "Write the pcap capture from a separate thread", asyncPcap);
+    cmd.AddValue("snapLen", "Bytes kept from each captured frame with --asyncPcap", snapLen);
+    cmd.AddValue("pcapng", "Write a single pcapng file with --asyncPcap", pcapng);
+    cmd.AddValue("compressPcap", "Gzip the capture written with --asyncPcap", compressPcap);
+    cmd.AddValue("asyncAscii", "Format the ASCII trace on a separate thread", asyncAscii);
+    cmd.AddValue("asciiEvents", "Events kept with --asyncAscii: any of + - d r", asciiEvents);
+    cmd.AddValue("asciiNodes",
+                 "Comma-separated ids of the nodes traced with --asyncAscii, all if empty",
+                 asciiNodes);
     cmd.Parse(argc, argv);
 
     //
     // But since this is a realtime script, don't allow the user to mess with
     // that.
     //
-    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::RealtimeSimulatorImpl"));
+    // In hybrid mode the scheduler does the waiting, so the default simulator is enough.
+    //
+    GlobalValue::Bind("SimulatorImplementationType",
+                      StringValue(hybrid ? "ns3::DefaultSimulatorImpl"
+                                         : "ns3::RealtimeSimulatorImpl"));
+    GlobalValue::Bind("SchedulerType", StringValue("ns3::HybridRealtimeScheduler"));
+    Config::SetDefault("ns3::HybridRealtimeScheduler::Pace", BooleanValue(hybrid));
+    Config::SetDefault("ns3::HybridRealtimeScheduler::SpinThreshold", TimeValue(spinThreshold));
+    g_lagTelemetry.maxLag = maxLag;
+
+    if (cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+        {
+            NS_LOG_UNCOND("Cannot pin to CPU " << cpu << ": " << std::strerror(errno));
+        }
+    }
+    if (fifo)
+    {
+        struct sched_param param;
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+        if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+        {
+            NS_LOG_UNCOND("Cannot switch to SCHED_FIFO: " << std::strerror(errno));
+        }
+    }
 
     //
     // Explicitly create the nodes required by the topology (shown above).
@@ -90,16 +1293,66 @@ main(int argc, char* argv[])
     apps.Start(Seconds(2.0));
     apps.Stop(Seconds(10.0));
 
-    AsciiTraceHelper ascii;
-    csma.EnableAsciiAll(ascii.CreateFileStream("realtime-udp-echo.tr"));
-    csma.EnablePcapAll("realtime-udp-echo", false);
+    std::unique_ptr<AsyncAsciiTrace> asyncAsciiTrace;
+    if (asyncAscii)
+    {
+        asyncAsciiTrace =
+            std::make_unique<AsyncAsciiTrace>("realtime-udp-echo.tr", asciiEvents, asciiNodes);
+        asyncAsciiTrace->AttachAll();
+    }
+    else
+    {
+        AsciiTraceHelper ascii;
+        csma.EnableAsciiAll(ascii.CreateFileStream("realtime-udp-echo.tr"));
+    }
+    Ptr<AsyncPcapWriter> pcapWriter;
+    if (asyncPcap)
+    {
+        pcapWriter =
+            Create<AsyncPcapWriter>("realtime-udp-echo", pcapng, snapLen, compressPcap, 1 << 20);
+        for (uint32_t j = 0; j < d.GetN(); ++j)
+        {
+            pcapWriter->Attach(d.Get(j), 1, false); // DLT_EN10MB
+        }
+    }
+    else
+    {
+        csma.EnablePcapAll("realtime-udp-echo", false);
+    }
 
     //
     // Now, do the actual simulation.
     //
     Simulator::Stop(Seconds(11.0));
     NS_LOG_INFO("Run Simulation.");
+    g_lagTelemetry.running = true;
     Simulator::Run();
+    g_lagTelemetry.running = false;
+    if (pcapWriter)
+    {
+        pcapWriter->Close();
+    }
+    if (asyncAsciiTrace)
+    {
+        asyncAsciiTrace->Close();
+    }
+
+    const LogLinearHistogram& lag = g_lagTelemetry.lagNs;
+    const LogLinearHistogram& jitter = g_lagTelemetry.jitterNs;
+    std::cout << "Lag behind real time over " << lag.GetCount() << " events (us): p50 "
+              << lag.GetQuantile(0.5) / 1e3 << ", p99 " << lag.GetQuantile(0.99) / 1e3
+              << ", p99.9 " << lag.GetQuantile(0.999) / 1e3 << ", max " << lag.GetMax() / 1e3
+              << std::endl;
+    std::cout << "Jitter between consecutive events (us): p50 " << jitter.GetQuantile(0.5) / 1e3
+              << ", p99 " << jitter.GetQuantile(0.99) / 1e3 << ", max " << jitter.GetMax() / 1e3
+              << std::endl;
+    std::cout << "Events later than " << maxLag.As(Time::US) << ": " << g_lagTelemetry.alarms;
+    if (g_lagTelemetry.alarms > 0)
+    {
+        std::cout << " (first at " << g_lagTelemetry.firstAlarm.As(Time::S) << ")";
+    }
+    std::cout << std::endl;
+
     Simulator::Destroy();
     NS_LOG_INFO("Done.");
 
@@ -6,15 +6,111 @@
 #include "ns3/aodv-module.h"
 #include "ns3/applications-module.h"
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("UdpUAVNetwork");
 
-// Function to send UDP packets from UAVs to the GCS
-void SendPacket(Ptr<Socket> socket, Ipv4Address gcsAddr, uint16_t port) {
-    Ptr<Packet> packet = Create<Packet>(512); // 512-byte packet
-    socket->SendTo(packet, 0, InetSocketAddress(gcsAddr, port));
-    Simulator::Schedule(Seconds(2.0), &SendPacket, socket, gcsAddr, port); // Schedule next packet
+// Timer wheel driving the periodic sends of all nodes from a single scheduler
+// event per occupied slot, instead of one self-rescheduling event per node.
+// Senders keep their own phase offset: the slot is (first send time mod period).
+class PeriodicSenderWheel {
+public:
+    PeriodicSenderWheel(Time period, Time slot)
+        : m_slotTs(slot.GetTimeStep()),
+          m_numSlots(static_cast<uint32_t>(period.GetTimeStep() / slot.GetTimeStep())),
+          m_slots(m_numSlots),
+          m_nextId(0),
+          m_tick(0),
+          m_nextTick(0) {}
+
+    // Register a sender whose first transmission happens after 'delay'; returns
+    // an id that can be passed to Remove().
+    uint32_t Add(Time delay, Callback<void> send) {
+        int64_t tick = (Simulator::Now() + delay).GetTimeStep() / m_slotTs;
+        uint32_t slot = static_cast<uint32_t>(tick % m_numSlots);
+        uint32_t id = m_nextId++;
+        m_slots[slot].push_back(Entry{id, tick, send});
+        m_slotOf[id] = slot;
+        m_occupied.insert(slot);
+        if (!m_event.IsRunning() || tick < m_nextTick) {
+            ScheduleAt(tick);
+        }
+        return id;
+    }
+
+    void Remove(uint32_t id) {
+        auto it = m_slotOf.find(id);
+        if (it == m_slotOf.end()) {
+            return;
+        }
+        // Entries are only nulled here and compacted on the next visit of the
+        // slot, so Remove() is safe to call from within a send callback.
+        for (Entry &e : m_slots[it->second]) {
+            if (e.id == id) {
+                e.send.Nullify();
+            }
+        }
+        m_slotOf.erase(it);
+    }
+
+private:
+    struct Entry {
+        uint32_t id;
+        int64_t firstTick;
+        Callback<void> send;
+    };
+
+    void ScheduleAt(int64_t tick) {
+        Simulator::Cancel(m_event);
+        m_nextTick = tick;
+        m_event = Simulator::Schedule(TimeStep(tick * m_slotTs) - Simulator::Now(),
+                                      &PeriodicSenderWheel::Tick, this);
+    }
+
+    void Tick() {
+        m_tick = m_nextTick;
+        uint32_t slot = static_cast<uint32_t>(m_tick % m_numSlots);
+        std::vector<Entry> &entries = m_slots[slot];
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i].send.IsNull() && entries[i].firstTick <= m_tick) {
+                entries[i].send();
+            }
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const Entry &e) { return e.send.IsNull(); }),
+                      entries.end());
+        if (entries.empty()) {
+            m_occupied.erase(slot);
+        }
+        if (m_occupied.empty()) {
+            return;
+        }
+        // Jump straight to the next occupied slot; empty slots cost nothing.
+        auto next = m_occupied.upper_bound(slot);
+        uint32_t delta = (next != m_occupied.end()) ? *next - slot
+                                                    : m_numSlots - slot + *m_occupied.begin();
+        ScheduleAt(m_tick + delta);
+    }
+
+    int64_t m_slotTs;
+    uint32_t m_numSlots;
+    std::vector<std::vector<Entry>> m_slots;
+    std::set<uint32_t> m_occupied;
+    std::map<uint32_t, uint32_t> m_slotOf;
+    uint32_t m_nextId;
+    int64_t m_tick;
+    int64_t m_nextTick;
+    EventId m_event;
+};
+
+// Function to send UDP packets from UAVs to the GCS; rescheduling is done by the wheel
+void SendPacket(Ptr<Socket> socket, Address gcsAddr, Ptr<Packet> prototype) {
+    socket->SendTo(prototype->Copy(), 0, gcsAddr); // Copy-on-write, no per-report payload allocation
 }
 
 // Function to receive packets at the GCS
@@ -30,6 +126,11 @@ int main(int argc, char *argv[]) {
     int numUAVs = 5;
     double simTime = 60.0;
 
+    CommandLine cmd;
+    cmd.AddValue("numUAVs", "Number of UAV nodes", numUAVs);
+    cmd.AddValue("simTime", "Simulation time in seconds", simTime);
+    cmd.Parse(argc, argv);
+
     // Create nodes (UAVs + 1 Ground Control Station)
     NodeContainer uavs;
     uavs.Create(numUAVs);
@@ -87,10 +188,13 @@ int main(int argc, char *argv[]) {
     gcsSocket->Bind(InetSocketAddress(Ipv4Address::GetAny(), port));
     gcsSocket->SetRecvCallback(MakeCallback(&ReceivePacket));
 
-    // Setup UDP Clients in UAVs
+    // Setup UDP Clients in UAVs, all driven every 2 s by one timer wheel
+    PeriodicSenderWheel wheel(Seconds(2.0), MilliSeconds(10));
+    Ptr<Packet> prototype = Create<Packet>(512); // 512-byte packet shared by all UAVs
+    Address gcsAddr = InetSocketAddress(gcsInterface.GetAddress(0), port);
     for (int i = 0; i < numUAVs; i++) {
         Ptr<Socket> uavSocket = Socket::CreateSocket(uavs.Get(i), UdpSocketFactory::GetTypeId());
-        Simulator::Schedule(Seconds(2.0 + i * 1.0), &SendPacket, uavSocket, gcsInterface.GetAddress(0), port);
+        wheel.Add(Seconds(2.0 + i * 1.0), MakeBoundCallback(&SendPacket, uavSocket, gcsAddr, prototype));
     }
 
     // Run the simulation
@@ -0,0 +1,256 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/aodv-module.h"
+#include "ns3/wifi-module.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// RREQ-storm benchmark for AODV in dense MANETs (the 802.11b adhoc setting of
+// manet-routing-compare, Large/74.cc, and the AODV scripts built like it).
+//
+// numNodes nodes sit distance metres apart on a square grid; with the default 50 m
+// spacing and the ~116 m range of the 1 Mb/s DSSS settings below, each node hears
+// about twenty others. At stormTime, numPairs random sources each send one UDP
+// packet to a random destination at the same instant, so every packet starts its
+// own route discovery and the RREQ floods overlap. AODV control packets (UDP port
+// 654) are counted as the IP layers send and deliver them. It prints a CSV row:
+//   nodes,pairs,ctrlTx,ctrlRx,rreqRx,rrepRx,rerrRx,delivered,meanDiscoveryMs,
+//   maxDiscoveryMs,wallS,ctrlRxPerWallS,rssKb
+// delivered is the fraction of pairs whose packet arrived; a pair's discovery time is
+// from stormTime to that arrival. ctrlRxPerWallS is the rate at which the simulation
+// processes control packets; each costs AODV lookups in its route table, RREQ id cache
+// and neighbour list, which is where dense floods spend their time.
+//
+//   for n in 50 200 800 3200; do
+//     ./ns3 run "aodv-rreq-storm-benchmark --numNodes=$n --numPairs=$((n / 4))";
+//   done
+//
+// HELLO messages are off by default so the storm is all that is counted; --hello=1
+// adds them (they are RREPs, and show in rrepRx).
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("AodvRreqStormBenchmark");
+
+static const uint16_t AODV_PORT = 654;
+
+/// AODV packet and delivery counters
+struct StormStats
+{
+    uint64_t controlTx{0};
+    uint64_t controlRx{0};
+    uint64_t rxByType[5]{};     //!< by AODV message type: 1 RREQ, 2 RREP, 3 RERR
+    std::vector<Time> delivery; //!< per pair; zero until its packet arrives
+};
+
+/**
+ * \param packet a packet starting at its UDP header
+ * \param type set to the AODV message type if it is an AODV control packet
+ * \return whether it is an AODV control packet
+ */
+static bool
+PeekAodvType(Ptr<const Packet> packet, uint8_t& type)
+{
+    UdpHeader udp;
+    if (packet->GetSize() <= udp.GetSerializedSize() || packet->PeekHeader(udp) == 0 ||
+        udp.GetDestinationPort() != AODV_PORT)
+    {
+        return false;
+    }
+    uint8_t bytes[9];
+    packet->CopyData(bytes, udp.GetSerializedSize() + 1);
+    type = bytes[udp.GetSerializedSize()];
+    return true;
+}
+
+static void
+SendOutgoing(StormStats* stats,
+             const Ipv4Header& header,
+             Ptr<const Packet> packet,
+             uint32_t /* interface */)
+{
+    uint8_t type;
+    if (header.GetProtocol() == UdpL4Protocol::PROT_NUMBER && PeekAodvType(packet, type))
+    {
+        stats->controlTx++;
+    }
+}
+
+static void
+LocalDeliver(StormStats* stats,
+             const Ipv4Header& header,
+             Ptr<const Packet> packet,
+             uint32_t /* interface */)
+{
+    uint8_t type;
+    if (header.GetProtocol() == UdpL4Protocol::PROT_NUMBER && PeekAodvType(packet, type))
+    {
+        stats->controlRx++;
+        if (type < 5)
+        {
+            stats->rxByType[type]++;
+        }
+    }
+}
+
+static void
+PairReceive(StormStats* stats, uint32_t pair, Ptr<Socket> socket)
+{
+    while (socket->Recv())
+    {
+        if (stats->delivery[pair].IsZero())
+        {
+            stats->delivery[pair] = Simulator::Now();
+        }
+    }
+}
+
+static void
+SendOne(Ptr<Socket> socket)
+{
+    socket->Send(Create<Packet>(64));
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t numNodes = 200;
+    uint32_t numPairs = 50;
+    double distance = 50;
+    double stormTime = 1;
+    double duration = 10;
+    bool hello = false;
+    bool printHeader = false;
+    std::string phyMode = "DsssRate1Mbps";
+
+    CommandLine cmd;
+    cmd.AddValue("numNodes", "Number of nodes", numNodes);
+    cmd.AddValue("numPairs", "Number of simultaneous route discoveries", numPairs);
+    cmd.AddValue("distance", "Distance between grid neighbours (m)", distance);
+    cmd.AddValue("stormTime", "Time the discoveries start (s)", stormTime);
+    cmd.AddValue("duration", "Time simulated after the storm starts (s)", duration);
+    cmd.AddValue("hello", "Enable AODV HELLO messages", hello);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(numNodes < 2 || numNodes > 65534, "numNodes must be in [2, 65534]");
+    NS_ABORT_MSG_IF(numPairs > 50000, "At most 50000 pairs, one port each");
+
+    Config::SetDefault("ns3::WifiRemoteStationManager::NonUnicastMode", StringValue(phyMode));
+    Config::SetDefault("ns3::aodv::RoutingProtocol::EnableHello", BooleanValue(hello));
+
+    NodeContainer nodes;
+    nodes.Create(numNodes);
+
+    // The PHY and channel of the grid scripts: about 116 m of range at 1 Mb/s
+    YansWifiPhyHelper wifiPhy;
+    wifiPhy.Set("RxGain", DoubleValue(-10));
+    YansWifiChannelHelper wifiChannel;
+    wifiChannel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+    wifiChannel.AddPropagationLoss("ns3::FriisPropagationLossModel");
+    wifiPhy.SetChannel(wifiChannel.Create());
+
+    WifiHelper wifi;
+    wifi.SetStandard(WIFI_STANDARD_80211b);
+    wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                 "DataMode",
+                                 StringValue(phyMode),
+                                 "ControlMode",
+                                 StringValue(phyMode));
+    WifiMacHelper wifiMac;
+    wifiMac.SetType("ns3::AdhocWifiMac");
+    NetDeviceContainer devices = wifi.Install(wifiPhy, wifiMac, nodes);
+
+    uint32_t gridWidth = static_cast<uint32_t>(std::ceil(std::sqrt(numNodes)));
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                  "DeltaX",
+                                  DoubleValue(distance),
+                                  "DeltaY",
+                                  DoubleValue(distance),
+                                  "GridWidth",
+                                  UintegerValue(gridWidth),
+                                  "LayoutType",
+                                  StringValue("RowFirst"));
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.Install(nodes);
+
+    AodvHelper aodv;
+    InternetStackHelper internet;
+    internet.SetRoutingHelper(aodv);
+    internet.Install(nodes);
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase("10.0.0.0", "255.255.0.0");
+    Ipv4InterfaceContainer interfaces = ipv4.Assign(devices);
+
+    StormStats stats;
+    stats.delivery.resize(numPairs);
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::Ipv4L3Protocol/SendOutgoing",
+                                  MakeBoundCallback(&SendOutgoing, &stats));
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::Ipv4L3Protocol/LocalDeliver",
+                                  MakeBoundCallback(&LocalDeliver, &stats));
+
+    // Random distinct endpoints per pair, each pair on its own port
+    Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable>();
+    TypeId udp = UdpSocketFactory::GetTypeId();
+    for (uint32_t pair = 0; pair < numPairs; ++pair)
+    {
+        uint32_t source = pick->GetInteger(0, numNodes - 1);
+        uint32_t destination = pick->GetInteger(0, numNodes - 2);
+        destination += destination >= source ? 1 : 0;
+        uint16_t port = 10000 + pair;
+
+        Ptr<Socket> sink = Socket::CreateSocket(nodes.Get(destination), udp);
+        sink->Bind(InetSocketAddress(Ipv4Address::GetAny(), port));
+        sink->SetRecvCallback(MakeBoundCallback(&PairReceive, &stats, pair));
+
+        Ptr<Socket> sender = Socket::CreateSocket(nodes.Get(source), udp);
+        sender->Connect(InetSocketAddress(interfaces.GetAddress(destination), port));
+        Simulator::Schedule(Seconds(stormTime), &SendOne, sender);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Simulator::Stop(Seconds(stormTime + duration));
+    Simulator::Run();
+    double wallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t delivered = 0;
+    double totalMs = 0;
+    double maxMs = 0;
+    for (const Time& arrival : stats.delivery)
+    {
+        if (!arrival.IsZero())
+        {
+            double ms = (arrival - Seconds(stormTime)).GetSeconds() * 1000;
+            delivered++;
+            totalMs += ms;
+            maxMs = std::max(maxMs, ms);
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage); // ru_maxrss is in KiB on Linux
+
+    if (printHeader)
+    {
+        std::cout << "nodes,pairs,ctrlTx,ctrlRx,rreqRx,rrepRx,rerrRx,delivered,meanDiscoveryMs,"
+                     "maxDiscoveryMs,wallS,ctrlRxPerWallS,rssKb"
+                  << std::endl;
+    }
+    std::cout << numNodes << "," << numPairs << "," << stats.controlTx << "," << stats.controlRx
+              << "," << stats.rxByType[1] << "," << stats.rxByType[2] << "," << stats.rxByType[3]
+              << "," << (numPairs > 0 ? static_cast<double>(delivered) / numPairs : 0) << ","
+              << (delivered > 0 ? totalMs / delivered : 0) << "," << maxMs << "," << wallSeconds
+              << "," << stats.controlRx / wallSeconds << "," << usage.ru_maxrss << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Prints a binary log written by BinaryLog (see the WSN script Small/226.cc and the
+// block ack script Large/20.cc, option --binaryLog) as text, one line per record in
+// simulation time order:
+//   +<seconds>s [<level>] <message>
+// with the writing thread's index after the level when several threads logged.
+//
+//   ./ns3 run "binary-log-decode --input=wsn.blog"
+//
+// The file must come from a build for the same platform, as records are stored in
+// host layout and byte order.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("BinaryLogDecode");
+
+/// Must match BinaryLog::Record in the scripts
+struct Record
+{
+    int64_t timeNs;
+    uint16_t formatId;
+    uint8_t numArgs;
+    char tags[4];
+    uint64_t args[4];
+};
+
+struct ThreadRecord
+{
+    uint32_t thread;
+    Record record;
+};
+
+static bool
+EarlierThan(const ThreadRecord& a, const ThreadRecord& b)
+{
+    return a.record.timeNs < b.record.timeNs;
+}
+
+static std::string
+LevelName(uint32_t level)
+{
+    switch (level)
+    {
+    case LOG_ERROR:
+        return "ERROR";
+    case LOG_WARN:
+        return "WARN";
+    case LOG_DEBUG:
+        return "DEBUG";
+    case LOG_INFO:
+        return "INFO";
+    case LOG_FUNCTION:
+        return "FUNCT";
+    case LOG_LOGIC:
+        return "LOGIC";
+    default:
+        return "LEVEL " + std::to_string(level);
+    }
+}
+
+static std::string
+Format(const std::string& format, const Record& record)
+{
+    std::ostringstream oss;
+    uint32_t arg = 0;
+    for (std::size_t pos = 0; pos < format.size(); ++pos)
+    {
+        if (format.compare(pos, 2, "{}") != 0 || arg == record.numArgs)
+        {
+            oss << format[pos];
+            continue;
+        }
+        uint64_t value = record.args[arg];
+        switch (record.tags[arg++])
+        {
+        case 'u':
+            oss << value;
+            break;
+        case 'i':
+            oss << static_cast<int64_t>(value);
+            break;
+        case 'f': {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            oss << d;
+            break;
+        }
+        case 't':
+            oss << static_cast<int64_t>(value) << "ns";
+            break;
+        case 'a':
+            oss << Ipv4Address(static_cast<uint32_t>(value));
+            break;
+        case 'm':
+            for (int shift = 40; shift >= 0; shift -= 8)
+            {
+                oss << std::hex << std::setw(2) << std::setfill('0') << ((value >> shift) & 0xff)
+                    << std::dec << (shift > 0 ? ":" : "");
+            }
+            break;
+        default:
+            oss << "?";
+        }
+        pos++;
+    }
+    return oss.str();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string input;
+
+    CommandLine cmd;
+    cmd.AddValue("input", "Binary log to decode", input);
+    cmd.Parse(argc, argv);
+
+    FILE* file = fopen(input.c_str(), "rb");
+    NS_ABORT_MSG_IF(!file, "Cannot open binary log " << input);
+    char magic[8];
+    NS_ABORT_MSG_IF(fread(magic, 8, 1, file) != 1 || std::string(magic, 8) != "NS3BLOG1",
+                    input << " is not a binary log");
+
+    // The format table is at the end; its offset is the last thing in the file
+    uint64_t formatsOffset;
+    NS_ABORT_MSG_IF(fseek(file, -8, SEEK_END) != 0 || fread(&formatsOffset, 8, 1, file) != 1,
+                    input << " was not closed; no format table");
+    fseek(file, formatsOffset, SEEK_SET);
+    uint32_t numFormats = 0;
+    NS_ABORT_MSG_IF(fread(&numFormats, 4, 1, file) != 1, "Truncated format table");
+    std::vector<std::pair<uint32_t, std::string>> formats(numFormats);
+    for (auto& format : formats)
+    {
+        uint32_t header[2];
+        NS_ABORT_MSG_IF(fread(header, sizeof(header), 1, file) != 1, "Truncated format table");
+        format.first = header[0];
+        format.second.resize(header[1]);
+        NS_ABORT_MSG_IF(header[1] > 0 && fread(&format.second[0], header[1], 1, file) != 1,
+                        "Truncated format table");
+    }
+
+    std::vector<ThreadRecord> records;
+    uint32_t numThreads = 0;
+    fseek(file, 8, SEEK_SET);
+    while (static_cast<uint64_t>(ftell(file)) < formatsOffset)
+    {
+        uint32_t header[2];
+        NS_ABORT_MSG_IF(fread(header, sizeof(header), 1, file) != 1, "Truncated record block");
+        numThreads = std::max(numThreads, header[0] + 1);
+        std::size_t first = records.size();
+        records.resize(first + header[1]);
+        for (uint32_t i = 0; i < header[1]; ++i)
+        {
+            records[first + i].thread = header[0];
+            NS_ABORT_MSG_IF(fread(&records[first + i].record, sizeof(Record), 1, file) != 1,
+                            "Truncated record block");
+        }
+    }
+    fclose(file);
+
+    // Each thread's records are in order already; a stable sort interleaves the threads
+    std::stable_sort(records.begin(), records.end(), EarlierThan);
+    std::cout << std::fixed;
+    for (const ThreadRecord& entry : records)
+    {
+        NS_ABORT_MSG_IF(entry.record.formatId >= formats.size(),
+                        "Unknown format " << entry.record.formatId);
+        const auto& format = formats[entry.record.formatId];
+        std::cout << "+" << std::setprecision(9) << entry.record.timeNs / 1e9 << "s ["
+                  << LevelName(format.first) << "]";
+        if (numThreads > 1)
+        {
+            std::cout << " thread " << entry.thread;
+        }
+        std::cout << " " << Format(format.second, entry.record) << "\n";
+    }
+    return 0;
+}
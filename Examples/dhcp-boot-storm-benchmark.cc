@@ -0,0 +1,369 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/internet-apps-module.h"
+#include "ns3/csma-module.h"
+
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// DHCP boot-storm benchmark for the InterVLANRoutingWithDHCP scenario at campus scale.
+//
+// numClients hosts share one CSMA broadcast domain with a DHCP server and all start
+// their DHCP clients at the same instant. The run stops as soon as every client holds
+// a lease and prints a CSV row:
+//   clients,simTimeToFullS,wallS,events,eventsPerWallS,leasesPerWallS
+// wallS covers Simulator::Run() only, not building the nodes, devices and stacks.
+// The server is the stock DhcpServer, so these numbers measure ns-3's own lease store.
+//
+// DhcpLeasePool below is a standalone data-structure prototype for a faster lease
+// store: DhcpServer keeps its leases in private members with no hook to replace them,
+// so the storm does not use it. --poolBenchmark exercises it on its own instead:
+// O(1) allocate/release through a free list threaded through the lease array, and
+// lease expiry batched per second through a timer wheel. It prints:
+//   leases,allocPerS,releasePerS,expirePerS
+//
+//   ./ns3 run "dhcp-boot-storm-benchmark --numClients=10000 --printHeader=1"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("DhcpBootStormBenchmark");
+
+/**
+ * Address pool for a DHCP server, benchmarked on its own by --poolBenchmark; the
+ * simulated storm uses the stock DhcpServer. Free addresses sit on an intrusive
+ * doubly-linked list threaded through the lease array, so allocate, release and
+ * taking back a returning client's old address are all O(1) whatever the pool size.
+ * Released and expired addresses go to the back of the list, which keeps them for
+ * their previous owner as long as possible. Expiry is batched: leases are filed in
+ * one-second wheel slots and a whole slot is processed at once.
+ */
+class DhcpLeasePool
+{
+  public:
+    static constexpr uint32_t NONE = 0xffffffff;
+
+    DhcpLeasePool(Ipv4Address minAddress, Ipv4Address maxAddress, uint32_t maxLeaseTimeS)
+        : m_base(minAddress.Get()),
+          m_size(maxAddress.Get() - minAddress.Get() + 1),
+          m_leases(m_size),
+          m_freeHead(NONE),
+          m_freeTail(NONE),
+          m_free(0),
+          m_wheel(WheelSize(maxLeaseTimeS), NONE),
+          m_now(0)
+    {
+        for (uint32_t i = 0; i < m_size; ++i)
+        {
+            PushFree(i); // lowest addresses are handed out first
+        }
+    }
+
+    /// Lease an address to 'chaddr' for 'leaseTimeS' seconds; returns 0.0.0.0 if exhausted.
+    Ipv4Address Allocate(uint64_t chaddr, uint32_t leaseTimeS)
+    {
+        uint32_t offset;
+        auto known = m_byClient.find(chaddr);
+        if (known != m_byClient.end())
+        {
+            offset = known->second; // renewal, or a returning client getting its address back
+            if (!m_leases[offset].bound)
+            {
+                Unlink(offset);
+            }
+        }
+        else if (m_freeHead != NONE)
+        {
+            offset = m_freeHead;
+            Unlink(offset);
+            if (m_leases[offset].chaddr != 0)
+            {
+                m_byClient.erase(m_leases[offset].chaddr); // recycled from another client
+            }
+            m_byClient[chaddr] = offset;
+        }
+        else
+        {
+            return Ipv4Address::GetAny();
+        }
+        Lease& lease = m_leases[offset];
+        lease.chaddr = chaddr;
+        lease.expiry = m_now + leaseTimeS;
+        if (!lease.bound)
+        {
+            lease.bound = true;
+            File(offset);
+        }
+        return Ipv4Address(m_base + offset);
+    }
+
+    /// DHCPRELEASE: the address goes back to the pool but stays tied to the client.
+    void Release(uint64_t chaddr)
+    {
+        auto known = m_byClient.find(chaddr);
+        if (known != m_byClient.end() && m_leases[known->second].bound)
+        {
+            m_leases[known->second].bound = false;
+            PushFree(known->second);
+        }
+    }
+
+    /// Advance to 'nowS' seconds, expiring leases in per-second batches.
+    uint32_t AdvanceTo(uint32_t nowS)
+    {
+        uint32_t expired = 0;
+        while (m_now < nowS)
+        {
+            m_now++;
+            uint32_t slot = m_now % m_wheel.size();
+            uint32_t offset = m_wheel[slot];
+            m_wheel[slot] = NONE;
+            while (offset != NONE)
+            {
+                Lease& lease = m_leases[offset];
+                uint32_t next = lease.nextInSlot;
+                lease.filed = false;
+                if (!lease.bound)
+                {
+                    // released since it was filed; nothing left to expire
+                }
+                else if (lease.expiry <= m_now)
+                {
+                    lease.bound = false;
+                    PushFree(offset);
+                    expired++;
+                }
+                else
+                {
+                    File(offset); // renewed since it was filed
+                }
+                offset = next;
+            }
+        }
+        return expired;
+    }
+
+    uint32_t GetFree() const
+    {
+        return m_free;
+    }
+
+  private:
+    struct Lease
+    {
+        uint64_t chaddr = 0;
+        uint32_t expiry = 0;
+        uint32_t nextInSlot = NONE;
+        uint32_t freePrev = NONE;
+        uint32_t freeNext = NONE;
+        bool bound = false;
+        bool filed = false;
+    };
+
+    static uint32_t WheelSize(uint32_t maxLeaseTimeS)
+    {
+        uint32_t size = 1;
+        while (size <= maxLeaseTimeS)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    void File(uint32_t offset)
+    {
+        Lease& lease = m_leases[offset];
+        if (lease.filed)
+        {
+            return; // still in a wheel slot; it is re-filed from there if renewed
+        }
+        uint32_t slot = lease.expiry % m_wheel.size();
+        lease.nextInSlot = m_wheel[slot];
+        lease.filed = true;
+        m_wheel[slot] = offset;
+    }
+
+    void PushFree(uint32_t offset)
+    {
+        m_leases[offset].freePrev = m_freeTail;
+        m_leases[offset].freeNext = NONE;
+        if (m_freeTail != NONE)
+        {
+            m_leases[m_freeTail].freeNext = offset;
+        }
+        else
+        {
+            m_freeHead = offset;
+        }
+        m_freeTail = offset;
+        m_free++;
+    }
+
+    void Unlink(uint32_t offset)
+    {
+        Lease& lease = m_leases[offset];
+        if (lease.freePrev != NONE)
+        {
+            m_leases[lease.freePrev].freeNext = lease.freeNext;
+        }
+        else
+        {
+            m_freeHead = lease.freeNext;
+        }
+        if (lease.freeNext != NONE)
+        {
+            m_leases[lease.freeNext].freePrev = lease.freePrev;
+        }
+        else
+        {
+            m_freeTail = lease.freePrev;
+        }
+        m_free--;
+    }
+
+    uint32_t m_base;
+    uint32_t m_size;
+    std::vector<Lease> m_leases;
+    uint32_t m_freeHead;
+    uint32_t m_freeTail;
+    uint32_t m_free;
+    std::unordered_map<uint64_t, uint32_t> m_byClient;
+    std::vector<uint32_t> m_wheel;
+    uint32_t m_now;
+};
+
+static double
+WallSeconds(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+static uint32_t g_leased = 0;
+static uint32_t g_numClients = 0;
+static Time g_fullTime;
+
+static void
+NewLease(const Ipv4Address& address)
+{
+    if (++g_leased == g_numClients)
+    {
+        g_fullTime = Simulator::Now();
+        Simulator::Stop();
+    }
+}
+
+static void
+RunPoolBenchmark(uint32_t numLeases, bool printHeader)
+{
+    const uint32_t leaseTime = 30;
+    DhcpLeasePool pool(Ipv4Address("172.30.0.10"),
+                       Ipv4Address(Ipv4Address("172.30.0.10").Get() + numLeases - 1),
+                       leaseTime);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t c = 1; c <= numLeases; ++c)
+    {
+        NS_ABORT_MSG_IF(pool.Allocate(c, leaseTime) == Ipv4Address::GetAny(), "Pool exhausted");
+    }
+    double allocSeconds = WallSeconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t c = 1; c <= numLeases; c += 2)
+    {
+        pool.Release(c);
+    }
+    double releaseSeconds = WallSeconds(start);
+
+    start = std::chrono::steady_clock::now();
+    uint32_t expired = pool.AdvanceTo(leaseTime + 1);
+    double expireSeconds = WallSeconds(start);
+    NS_ABORT_MSG_IF(pool.GetFree() != numLeases, "Leases left after expiry");
+
+    if (printHeader)
+    {
+        std::cout << "leases,allocPerS,releasePerS,expirePerS" << std::endl;
+    }
+    std::cout << numLeases << "," << numLeases / allocSeconds << ","
+              << (numLeases / 2) / releaseSeconds << "," << expired / expireSeconds << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t numClients = 1000;
+    double maxTime = 120.0;
+    bool poolBenchmark = false;
+    bool printHeader = false;
+
+    CommandLine cmd;
+    cmd.AddValue("numClients", "Number of DHCP clients booting at once", numClients);
+    cmd.AddValue("maxTime", "Give up after this many simulated seconds", maxTime);
+    cmd.AddValue("poolBenchmark", "Benchmark the lease pool data structure only", poolBenchmark);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+
+    if (poolBenchmark)
+    {
+        RunPoolBenchmark(numClients, printHeader);
+        return 0;
+    }
+
+    g_numClients = numClients;
+
+    NodeContainer server;
+    server.Create(1);
+    NodeContainer clients;
+    clients.Create(numClients);
+
+    CsmaHelper csma;
+    csma.SetChannelAttribute("DataRate", StringValue("1Gbps"));
+    csma.SetChannelAttribute("Delay", TimeValue(MicroSeconds(1)));
+    NetDeviceContainer devices = csma.Install(NodeContainer(server, clients));
+
+    InternetStackHelper internet;
+    internet.Install(server);
+    internet.Install(clients);
+
+    NetDeviceContainer clientDevices;
+    for (uint32_t i = 1; i < devices.GetN(); ++i)
+    {
+        clientDevices.Add(devices.Get(i));
+    }
+
+    DhcpHelper dhcp;
+    ApplicationContainer serverApp = dhcp.InstallDhcpServer(devices.Get(0),
+                                                            Ipv4Address("172.30.0.1"),
+                                                            Ipv4Address("172.30.0.0"),
+                                                            Ipv4Mask("/16"),
+                                                            Ipv4Address("172.30.0.10"),
+                                                            Ipv4Address("172.30.255.254"));
+    serverApp.Start(Seconds(0.0));
+
+    // Boot storm: every client starts at the same instant
+    ApplicationContainer clientApps = dhcp.InstallDhcpClient(clientDevices);
+    clientApps.Start(Seconds(1.0));
+    for (uint32_t i = 0; i < clientApps.GetN(); ++i)
+    {
+        clientApps.Get(i)->TraceConnectWithoutContext("NewLease", MakeCallback(&NewLease));
+    }
+
+    Simulator::Stop(Seconds(maxTime));
+    auto start = std::chrono::steady_clock::now();
+    Simulator::Run();
+    double wallSeconds = WallSeconds(start);
+    uint64_t events = Simulator::GetEventCount();
+
+    if (printHeader)
+    {
+        std::cout << "clients,simTimeToFullS,wallS,events,eventsPerWallS,leasesPerWallS"
+                  << std::endl;
+    }
+    std::cout << numClients << ","
+              << (g_leased == numClients ? (g_fullTime - Seconds(1.0)).GetSeconds() : -1.0)
+              << "," << wallSeconds << "," << events << "," << events / wallSeconds << ","
+              << g_leased / wallSeconds << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}
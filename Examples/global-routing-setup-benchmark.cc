@@ -0,0 +1,379 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/point-to-point-layout-module.h"
+#include "ns3/nix-vector-routing-module.h"
+#include "ns3/applications-module.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Setup-time benchmark for global routing on generated topologies.
+//
+// Builds a rows x cols point-to-point router grid (the shape of the matrix and
+// multi-switch scripts, scaled up) and times every pre-Simulator::Run phase:
+// stack installation, address assignment and route population. With
+// --routing=global, Ipv4GlobalRoutingHelper::PopulateRoutingTables runs one SPF per
+// router over the global LSDB on one thread. With --routing=parallel,
+// ParallelSpfRouting below computes shortest-path routes to every link subnet with
+// one SPF per router spread over --threads worker threads (0 for one per core) and
+// installs them as Ipv4StaticRouting network routes; equal-cost ties may pick a
+// different next hop than global routing. With --routing=nix, Nix-vector routing
+// computes routes on demand. A single corner-to-corner UDP packet confirms the routes
+// work.
+//
+//   for n in 10 32 71 100 142; do
+//     for r in global parallel; do
+//       ./ns3 run "global-routing-setup-benchmark --rows=$n --cols=$n --routing=$r";
+//     done;
+//   done
+//
+// Output is a single CSV row (add --printHeader for the column names):
+//   routing,threads,routers,links,stackS,addressS,routesS,runS,rssKb,cornerRx
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("GlobalRoutingSetupBenchmark");
+
+static double
+WallSeconds(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+/**
+ * Shortest-path routes for point-to-point topologies, computed on several threads.
+ *
+ * Build() turns the point-to-point links of all nodes into a graph in compressed
+ * adjacency form: per node, the outgoing edges with their interface, next-hop address
+ * and interface metric. The graph and the list of link subnets are read-only from then
+ * on and shared by all workers. Populate() starts a pool of worker threads that take
+ * routers from an atomic counter and run one Dijkstra SPF each. Every worker owns its
+ * scratch space, the distance and first-hop arrays and the heap, so workers share
+ * nothing writable. A finished SPF yields the first hop towards every link subnet the
+ * router is not attached to, through the nearer end of the link, as global routing
+ * routes them. The calling thread installs those routes into the router's
+ * Ipv4StaticRouting while the workers go on, since ns-3 objects are not thread-safe.
+ * At most a few results per worker wait to be installed, which bounds the memory.
+ */
+class ParallelSpfRouting
+{
+  public:
+    /// Build the graph from the point-to-point devices of all nodes.
+    void Build();
+
+    /**
+     * Compute and install the routes of all routers.
+     * \param numThreads number of worker threads
+     */
+    void Populate(uint32_t numThreads);
+
+  private:
+    static const uint32_t NONE = 0xffffffff;
+
+    /// A point-to-point link seen from one end
+    struct Edge
+    {
+        uint32_t to;         //!< Node at the other end.
+        uint32_t interface;  //!< Outgoing interface.
+        Ipv4Address gateway; //!< Address of the other end.
+        uint32_t metric;     //!< Interface metric.
+    };
+
+    /// The subnet of a point-to-point link and its two ends
+    struct Link
+    {
+        Ipv4Address network;
+        Ipv4Mask mask;
+        uint32_t a;
+        uint32_t b;
+    };
+
+    /// Per-worker SPF state, reused from one router to the next
+    struct Scratch
+    {
+        std::vector<uint32_t> distance;
+        std::vector<uint32_t> firstHop; //!< First edge on the path, per node.
+        std::vector<std::pair<uint32_t, uint32_t>> heap; //!< (distance, node)
+    };
+
+    /**
+     * Run the SPF of one router.
+     * \param source the router
+     * \param scratch the worker's scratch space
+     * \return the first-hop edge towards each link subnet, NONE if none is needed
+     */
+    std::vector<uint32_t> Spf(uint32_t source, Scratch& scratch) const;
+
+    std::vector<uint32_t> m_offsets; //!< Edges of node u are [m_offsets[u], m_offsets[u + 1]).
+    std::vector<Edge> m_edges;       //!< Edges of all nodes.
+    std::vector<Link> m_links;       //!< Link subnets.
+};
+
+void
+ParallelSpfRouting::Build()
+{
+    uint32_t numNodes = NodeList::GetNNodes();
+    m_offsets.assign(numNodes + 1, 0);
+    m_edges.clear();
+    m_links.clear();
+    for (uint32_t u = 0; u < numNodes; ++u)
+    {
+        Ptr<Ipv4> ipv4 = NodeList::GetNode(u)->GetObject<Ipv4>();
+        for (uint32_t i = 1; ipv4 && i < ipv4->GetNInterfaces(); ++i)
+        {
+            Ptr<PointToPointNetDevice> device =
+                DynamicCast<PointToPointNetDevice>(ipv4->GetNetDevice(i));
+            if (!device || !device->GetChannel() || !ipv4->IsUp(i) || ipv4->GetNAddresses(i) == 0)
+            {
+                continue;
+            }
+            Ptr<Channel> channel = device->GetChannel();
+            Ptr<NetDevice> peer =
+                channel->GetDevice(0) == device ? channel->GetDevice(1) : channel->GetDevice(0);
+            Ptr<Ipv4> peerIpv4 = peer->GetNode()->GetObject<Ipv4>();
+            int32_t peerInterface = peerIpv4 ? peerIpv4->GetInterfaceForDevice(peer) : -1;
+            if (peerInterface < 0 || peerIpv4->GetNAddresses(peerInterface) == 0)
+            {
+                continue;
+            }
+            uint32_t v = peer->GetNode()->GetId();
+            m_edges.push_back(Edge{v,
+                                   i,
+                                   peerIpv4->GetAddress(peerInterface, 0).GetLocal(),
+                                   ipv4->GetMetric(i)});
+            if (u < v)
+            {
+                Ipv4InterfaceAddress local = ipv4->GetAddress(i, 0);
+                m_links.push_back(
+                    Link{local.GetLocal().CombineMask(local.GetMask()), local.GetMask(), u, v});
+            }
+        }
+        m_offsets[u + 1] = m_edges.size();
+    }
+}
+
+std::vector<uint32_t>
+ParallelSpfRouting::Spf(uint32_t source, Scratch& scratch) const
+{
+    std::vector<uint32_t>& distance = scratch.distance;
+    std::vector<uint32_t>& firstHop = scratch.firstHop;
+    std::vector<std::pair<uint32_t, uint32_t>>& heap = scratch.heap;
+    auto later = std::greater<std::pair<uint32_t, uint32_t>>();
+
+    distance.assign(m_offsets.size() - 1, NONE);
+    firstHop.assign(m_offsets.size() - 1, NONE);
+    heap.clear();
+    distance[source] = 0;
+    heap.emplace_back(0, source);
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        uint32_t d = heap.back().first;
+        uint32_t u = heap.back().second;
+        heap.pop_back();
+        if (d > distance[u])
+        {
+            continue; // stale entry, u was reached more cheaply since
+        }
+        for (uint32_t e = m_offsets[u]; e < m_offsets[u + 1]; ++e)
+        {
+            uint32_t v = m_edges[e].to;
+            uint32_t candidate = d + m_edges[e].metric;
+            if (candidate < distance[v])
+            {
+                distance[v] = candidate;
+                firstHop[v] = u == source ? e : firstHop[u];
+                heap.emplace_back(candidate, v);
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+        }
+    }
+
+    std::vector<uint32_t> routes(m_links.size(), NONE);
+    for (uint32_t l = 0; l < m_links.size(); ++l)
+    {
+        const Link& link = m_links[l];
+        if (link.a == source || link.b == source)
+        {
+            continue; // attached: the interface route covers it
+        }
+        uint32_t nearer = distance[link.a] <= distance[link.b] ? link.a : link.b;
+        routes[l] = firstHop[nearer];
+    }
+    return routes;
+}
+
+void
+ParallelSpfRouting::Populate(uint32_t numThreads)
+{
+    uint32_t numNodes = m_offsets.size() - 1;
+    const std::size_t maxPending = 4 * numThreads;
+    std::atomic<uint32_t> nextSource{0};
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+    std::deque<std::pair<uint32_t, std::vector<uint32_t>>> done;
+
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        workers.emplace_back([&]() {
+            Scratch scratch;
+            for (uint32_t source = nextSource++; source < numNodes; source = nextSource++)
+            {
+                std::vector<uint32_t> routes = Spf(source, scratch);
+                std::unique_lock<std::mutex> lock(mutex);
+                space.wait(lock, [&]() { return done.size() < maxPending; });
+                done.emplace_back(source, std::move(routes));
+                ready.notify_one();
+            }
+        });
+    }
+
+    Ipv4StaticRoutingHelper staticRouting;
+    for (uint32_t installed = 0; installed < numNodes; ++installed)
+    {
+        std::pair<uint32_t, std::vector<uint32_t>> result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&]() { return !done.empty(); });
+            result = std::move(done.front());
+            done.pop_front();
+        }
+        space.notify_one();
+
+        Ptr<Ipv4> ipv4 = NodeList::GetNode(result.first)->GetObject<Ipv4>();
+        if (!ipv4)
+        {
+            continue;
+        }
+        Ptr<Ipv4StaticRouting> routing = staticRouting.GetStaticRouting(ipv4);
+        for (uint32_t l = 0; l < m_links.size(); ++l)
+        {
+            uint32_t e = result.second[l];
+            if (e != NONE)
+            {
+                routing->AddNetworkRouteTo(m_links[l].network,
+                                           m_links[l].mask,
+                                           m_edges[e].gateway,
+                                           m_edges[e].interface);
+            }
+        }
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t rows = 10;
+    uint32_t cols = 10;
+    std::string routing = "global";
+    uint32_t threads = 0;
+    bool printHeader = false;
+
+    CommandLine cmd;
+    cmd.AddValue("rows", "Number of router rows in the grid", rows);
+    cmd.AddValue("cols", "Number of router columns in the grid", cols);
+    cmd.AddValue("routing", "Routing to benchmark: global, parallel or nix", routing);
+    cmd.AddValue("threads", "Worker threads for --routing=parallel, 0 for one per core", threads);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(rows < 1 || cols < 1, "rows and cols must be at least 1");
+    NS_ABORT_MSG_IF(routing != "global" && routing != "parallel" && routing != "nix",
+                    "Unknown routing " << routing);
+    if (routing != "parallel")
+    {
+        threads = 1;
+    }
+    else if (threads == 0)
+    {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute("DataRate", StringValue("1Gbps"));
+    p2p.SetChannelAttribute("Delay", StringValue("1ms"));
+    PointToPointGridHelper grid(rows, cols, p2p);
+
+    auto start = std::chrono::steady_clock::now();
+    InternetStackHelper stack;
+    Ipv4NixVectorHelper nix;
+    if (routing == "nix")
+    {
+        stack.SetRoutingHelper(nix);
+    }
+    grid.InstallStack(stack);
+    double stackSeconds = WallSeconds(start);
+
+    start = std::chrono::steady_clock::now();
+    grid.AssignIpv4Addresses(Ipv4AddressHelper("10.0.0.0", "255.255.255.0"),
+                             Ipv4AddressHelper("20.0.0.0", "255.255.255.0"));
+    double addressSeconds = WallSeconds(start);
+
+    start = std::chrono::steady_clock::now();
+    if (routing == "global")
+    {
+        Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    }
+    else if (routing == "parallel")
+    {
+        ParallelSpfRouting parallel;
+        parallel.Build();
+        parallel.Populate(threads);
+    }
+    double routesSeconds = WallSeconds(start);
+
+    // One corner-to-corner packet to exercise the computed routes
+    uint16_t port = 9;
+    UdpServerHelper server(port);
+    ApplicationContainer serverApps = server.Install(grid.GetNode(rows - 1, cols - 1));
+    serverApps.Start(Seconds(0.0));
+
+    UdpClientHelper client(grid.GetIpv4Address(rows - 1, cols - 1), port);
+    client.SetAttribute("MaxPackets", UintegerValue(1));
+    client.SetAttribute("Interval", TimeValue(Seconds(1.0)));
+    client.SetAttribute("PacketSize", UintegerValue(64));
+    ApplicationContainer clientApps = client.Install(grid.GetNode(0, 0));
+    clientApps.Start(Seconds(1.0));
+
+    start = std::chrono::steady_clock::now();
+    Simulator::Stop(Seconds(10.0));
+    Simulator::Run();
+    double runSeconds = WallSeconds(start);
+
+    uint64_t cornerRx = DynamicCast<UdpServer>(serverApps.Get(0))->GetReceived();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage); // ru_maxrss is in KiB on Linux
+    uint32_t routers = rows * cols;
+    uint32_t links = rows * (cols - 1) + cols * (rows - 1);
+
+    if (printHeader)
+    {
+        std::cout << "routing,threads,routers,links,stackS,addressS,routesS,runS,rssKb,cornerRx"
+                  << std::endl;
+    }
+    std::cout << routing << "," << threads << "," << routers << "," << links << ","
+              << stackSeconds << "," << addressSeconds << "," << routesSeconds << ","
+              << runSeconds << "," << usage.ru_maxrss << "," << cornerRx << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}
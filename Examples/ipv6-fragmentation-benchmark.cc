@@ -0,0 +1,407 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/applications-module.h"
+
+#include <sys/resource.h>
+
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// IPv6 fragmentation and reassembly benchmark, built on the FragmentationIpv6 examples
+// (n0 -- router -- n1 over CSMA, large UDP datagrams fragmented at the source).
+//
+// By default one point of the MTU x datagram size x loss rate space is simulated per
+// process: numPackets UDP datagrams of packetSize bytes cross links with the given
+// MTU, the router drops each fragment with probability lossRate, and the CPU time
+// (user + system) spent per reassembled datagram is reported. Sweep from the shell:
+//
+//   for m in 1280 1500 9000; do for s in 1500 4096 16384 65000; do for l in 0 0.01 0.05; do
+//     ./ns3 run "ipv6-fragmentation-benchmark --mtu=$m --packetSize=$s --lossRate=$l";
+//   done; done; done
+//
+// With --reassemblyBenchmark the same space is swept in-process over two fragment
+// reassemblers with no simulator around them: "copy", which slices every fragment
+// out of the datagram and appends it in place to the partial datagram, as
+// Ipv6ExtensionFragment does with Packet::AddAtEnd, and "view", where fragments are
+// views over the original buffer, reassembly only links them in offset order and the
+// payload is copied once on delivery. The difference is the per-fragment slice copy
+// and allocation. Incomplete datagrams time out through a one-second timer wheel.
+//
+// Output is one CSV row per point (add --printHeader for the column names):
+//   mode,mtu,packetSize,lossRate,sent,reassembled,cpuUsPerDatagram
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("Ipv6FragmentationBenchmark");
+
+/// Bytes of IPv6 header plus fragment extension header in every fragment
+static const uint32_t FRAGMENT_OVERHEAD = 40 + 8;
+/// RFC 8200 reassembly timeout
+static const uint32_t REASSEMBLY_TIMEOUT_S = 60;
+
+static double
+CpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec +
+           usage.ru_stime.tv_usec / 1e6;
+}
+
+/// Immutable datagram payload shared by all fragments cut from it.
+class DatagramBuffer : public SimpleRefCount<DatagramBuffer>
+{
+  public:
+    explicit DatagramBuffer(std::vector<uint8_t> bytes)
+        : m_bytes(std::move(bytes))
+    {
+    }
+
+    const uint8_t* GetData() const
+    {
+        return m_bytes.data();
+    }
+
+  private:
+    std::vector<uint8_t> m_bytes;
+};
+
+/// A fragment that refers to [offset, offset + length) of its datagram; nothing is copied.
+struct FragmentView
+{
+    Ptr<const DatagramBuffer> buffer;
+    uint32_t offset;
+    uint32_t length;
+    bool last;
+};
+
+/**
+ * Reassembles fragments (keyed by fragment identification) by linking views in
+ * offset order. Payload bytes are copied exactly once, into the delivered datagram.
+ * Coverage is tracked by offset: an exact duplicate is ignored and a fragment that
+ * overlaps another one discards the whole datagram, as RFC 5722 requires, so only
+ * bytes that were actually received count towards completion.
+ * Partially received datagrams are filed in one-second timer wheel slots and dropped
+ * REASSEMBLY_TIMEOUT_S seconds after their first fragment.
+ */
+class ViewReassembler
+{
+  public:
+    ViewReassembler()
+        : m_wheel(REASSEMBLY_TIMEOUT_S + 1),
+          m_now(0),
+          m_timedOut(0)
+    {
+    }
+
+    /// Add a fragment; returns true and fills 'datagram' when it completes one.
+    bool Receive(uint32_t id, const FragmentView& fragment, std::vector<uint8_t>& datagram)
+    {
+        auto it = m_pending.find(id);
+        if (it == m_pending.end())
+        {
+            it = m_pending.emplace(id, Pending()).first;
+            it->second.expiry = m_now + REASSEMBLY_TIMEOUT_S;
+            m_wheel[it->second.expiry % m_wheel.size()].push_back(id);
+        }
+        Pending& pending = it->second;
+
+        // Fragments nearly always arrive in order, so the insertion point is at the back
+        auto pos = pending.fragments.end();
+        while (pos != pending.fragments.begin() && (pos - 1)->offset > fragment.offset)
+        {
+            --pos;
+        }
+        bool overlapsPrevious = pos != pending.fragments.begin() &&
+                                (pos - 1)->offset + (pos - 1)->length > fragment.offset;
+        bool overlapsNext =
+            pos != pending.fragments.end() && fragment.offset + fragment.length > pos->offset;
+        if (overlapsPrevious || overlapsNext)
+        {
+            bool duplicate = overlapsPrevious && (pos - 1)->offset == fragment.offset &&
+                             (pos - 1)->length == fragment.length;
+            if (!duplicate)
+            {
+                m_pending.erase(it);
+            }
+            return false;
+        }
+        pending.fragments.insert(pos, fragment);
+        pending.received += fragment.length;
+        if (fragment.last)
+        {
+            pending.total = fragment.offset + fragment.length;
+        }
+        if (pending.total == 0 || pending.received < pending.total)
+        {
+            return false;
+        }
+        // Disjoint fragments that add up to the total cover it exactly unless one of
+        // them lies beyond the last fragment, which makes the datagram inconsistent
+        const FragmentView& back = pending.fragments.back();
+        if (back.offset + back.length != pending.total)
+        {
+            m_pending.erase(it);
+            return false;
+        }
+
+        datagram.resize(pending.total);
+        for (const FragmentView& view : pending.fragments)
+        {
+            memcpy(datagram.data() + view.offset, view.buffer->GetData() + view.offset, view.length);
+        }
+        m_pending.erase(it); // its wheel entry is skipped when the slot comes due
+        return true;
+    }
+
+    /// Advance the clock to 'nowS' seconds and drop datagrams that timed out.
+    void AdvanceTo(uint32_t nowS)
+    {
+        while (m_now < nowS)
+        {
+            m_now++;
+            std::vector<uint32_t>& slot = m_wheel[m_now % m_wheel.size()];
+            for (uint32_t id : slot)
+            {
+                auto it = m_pending.find(id);
+                if (it != m_pending.end() && it->second.expiry <= m_now)
+                {
+                    m_pending.erase(it);
+                    m_timedOut++;
+                }
+            }
+            slot.clear();
+        }
+    }
+
+    uint32_t GetTimedOut() const
+    {
+        return m_timedOut;
+    }
+
+  private:
+    struct Pending
+    {
+        std::vector<FragmentView> fragments;
+        uint32_t received = 0;
+        uint32_t total = 0; ///< known once the last fragment arrived
+        uint32_t expiry = 0;
+    };
+
+    std::unordered_map<uint32_t, Pending> m_pending;
+    std::vector<std::vector<uint32_t>> m_wheel;
+    uint32_t m_now;
+    uint32_t m_timedOut;
+};
+
+/**
+ * Reference reassembler mirroring the copying path of Ipv6ExtensionFragment: every
+ * fragment owns a copy of its slice, and each arriving fragment is appended in place
+ * to what has been reassembled so far, with the amortized growth of Packet::AddAtEnd.
+ * Fragments are assumed to arrive in order, so a datagram is
+ * given up as soon as a gap shows instead of being held until the reassembly timeout;
+ * this flatters the copying path at high loss rates.
+ */
+class CopyReassembler
+{
+  public:
+    bool Receive(uint32_t id, uint32_t offset, const std::vector<uint8_t>& fragment, bool last,
+                 std::vector<uint8_t>& datagram)
+    {
+        std::vector<uint8_t>& partial = m_pending[id];
+        if (partial.size() != offset)
+        {
+            m_pending.erase(id); // a fragment was lost
+            return false;
+        }
+        partial.insert(partial.end(), fragment.begin(), fragment.end());
+        if (!last)
+        {
+            return false;
+        }
+        datagram.swap(partial);
+        m_pending.erase(id);
+        return true;
+    }
+
+  private:
+    std::unordered_map<uint32_t, std::vector<uint8_t>> m_pending;
+};
+
+static void
+RunReassemblyBenchmark(uint32_t numPackets, bool printHeader)
+{
+    if (printHeader)
+    {
+        std::cout << "mode,mtu,packetSize,lossRate,sent,reassembled,cpuUsPerDatagram" << std::endl;
+    }
+
+    for (uint32_t mtu : {1280u, 1500u, 9000u})
+    {
+        // Fragment payloads must be multiples of 8 bytes
+        uint32_t fragmentPayload = (mtu - FRAGMENT_OVERHEAD) & ~7u;
+        for (uint32_t size : {1500u, 4096u, 16384u, 65000u})
+        {
+            for (double loss : {0.0, 0.01, 0.05})
+            {
+                std::vector<uint8_t> payload(size);
+                for (uint32_t i = 0; i < size; ++i)
+                {
+                    payload[i] = static_cast<uint8_t>(i);
+                }
+                std::vector<uint8_t> datagram;
+
+                // Datagrams are sent one millisecond apart
+                std::mt19937 rng(1);
+                std::bernoulli_distribution drop(loss);
+                ViewReassembler view;
+                uint32_t reassembled = 0;
+                double start = CpuSeconds();
+                for (uint32_t id = 0; id < numPackets; ++id)
+                {
+                    view.AdvanceTo(id / 1000);
+                    Ptr<const DatagramBuffer> buffer = Create<DatagramBuffer>(payload);
+                    for (uint32_t offset = 0; offset < size; offset += fragmentPayload)
+                    {
+                        FragmentView fragment{buffer,
+                                              offset,
+                                              std::min(fragmentPayload, size - offset),
+                                              offset + fragmentPayload >= size};
+                        if (!drop(rng) && view.Receive(id, fragment, datagram))
+                        {
+                            reassembled++;
+                        }
+                    }
+                }
+                double viewSeconds = CpuSeconds() - start;
+                std::cout << "view," << mtu << "," << size << "," << loss << "," << numPackets
+                          << "," << reassembled << ","
+                          << viewSeconds * 1e6 / std::max<uint32_t>(reassembled, 1) << std::endl;
+
+                rng.seed(1);
+                CopyReassembler copy;
+                reassembled = 0;
+                start = CpuSeconds();
+                for (uint32_t id = 0; id < numPackets; ++id)
+                {
+                    std::vector<uint8_t> original(payload);
+                    for (uint32_t offset = 0; offset < size; offset += fragmentPayload)
+                    {
+                        uint32_t length = std::min(fragmentPayload, size - offset);
+                        std::vector<uint8_t> fragment(original.begin() + offset,
+                                                      original.begin() + offset + length);
+                        if (!drop(rng) && copy.Receive(id,
+                                                       offset,
+                                                       fragment,
+                                                       offset + length >= size,
+                                                       datagram))
+                        {
+                            reassembled++;
+                        }
+                    }
+                }
+                double copySeconds = CpuSeconds() - start;
+                std::cout << "copy," << mtu << "," << size << "," << loss << "," << numPackets
+                          << "," << reassembled << ","
+                          << copySeconds * 1e6 / std::max<uint32_t>(reassembled, 1) << std::endl;
+            }
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    uint32_t mtu = 1500;
+    uint32_t packetSize = 4096;
+    double lossRate = 0.0;
+    uint32_t numPackets = 10000;
+    bool reassemblyBenchmark = false;
+    bool printHeader = false;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("mtu", "MTU of both CSMA links in bytes", mtu);
+    cmd.AddValue("packetSize", "UDP datagram size in bytes", packetSize);
+    cmd.AddValue("lossRate", "Probability that the router drops a fragment", lossRate);
+    cmd.AddValue("numPackets", "Number of datagrams to send", numPackets);
+    cmd.AddValue("reassemblyBenchmark",
+                 "Sweep the copy and view reassemblers without a simulation",
+                 reassemblyBenchmark);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+
+    if (reassemblyBenchmark)
+    {
+        RunReassemblyBenchmark(numPackets, printHeader);
+        return 0;
+    }
+
+    Ptr<Node> n0 = CreateObject<Node>();
+    Ptr<Node> r = CreateObject<Node>();
+    Ptr<Node> n1 = CreateObject<Node>();
+
+    NodeContainer net1(n0, r);
+    NodeContainer net2(r, n1);
+    NodeContainer all(n0, r, n1);
+
+    InternetStackHelper internetv6;
+    internetv6.SetIpv4StackInstall(false);
+    internetv6.Install(all);
+
+    CsmaHelper csma;
+    csma.SetChannelAttribute("DataRate", DataRateValue(DataRate("10Gbps")));
+    csma.SetChannelAttribute("Delay", TimeValue(MicroSeconds(10)));
+    csma.SetDeviceAttribute("Mtu", UintegerValue(mtu));
+    NetDeviceContainer d1 = csma.Install(net1);
+    NetDeviceContainer d2 = csma.Install(net2);
+
+    // Fragments are dropped as they arrive at the router
+    Ptr<RateErrorModel> errorModel = CreateObject<RateErrorModel>();
+    errorModel->SetAttribute("ErrorUnit", EnumValue(RateErrorModel::ERROR_UNIT_PACKET));
+    errorModel->SetAttribute("ErrorRate", DoubleValue(lossRate));
+    d1.Get(1)->SetAttribute("ReceiveErrorModel", PointerValue(errorModel));
+
+    Ipv6AddressHelper ipv6;
+    ipv6.SetBase(Ipv6Address("2001:1::"), Ipv6Prefix(64));
+    Ipv6InterfaceContainer i1 = ipv6.Assign(d1);
+    i1.SetForwarding(1, true);
+    i1.SetDefaultRouteInAllNodes(1);
+    ipv6.SetBase(Ipv6Address("2001:2::"), Ipv6Prefix(64));
+    Ipv6InterfaceContainer i2 = ipv6.Assign(d2);
+    i2.SetForwarding(0, true);
+    i2.SetDefaultRouteInAllNodes(0);
+
+    uint16_t port = 42;
+    UdpServerHelper server(port);
+    ApplicationContainer serverApps = server.Install(n1);
+    serverApps.Start(Seconds(0.0));
+
+    UdpClientHelper client(i2.GetAddress(1, 1), port);
+    client.SetAttribute("MaxPackets", UintegerValue(numPackets));
+    client.SetAttribute("Interval", TimeValue(MilliSeconds(1)));
+    client.SetAttribute("PacketSize", UintegerValue(packetSize));
+    ApplicationContainer clientApps = client.Install(n0);
+    clientApps.Start(Seconds(2.0)); // after duplicate address detection
+
+    double start = CpuSeconds();
+    Simulator::Stop(Seconds(2.0 + numPackets / 1000.0 + 1.0));
+    Simulator::Run();
+    double cpuSeconds = CpuSeconds() - start;
+
+    uint64_t reassembled = DynamicCast<UdpServer>(serverApps.Get(0))->GetReceived();
+    if (printHeader)
+    {
+        std::cout << "mode,mtu,packetSize,lossRate,sent,reassembled,cpuUsPerDatagram" << std::endl;
+    }
+    std::cout << "ns3," << mtu << "," << packetSize << "," << lossRate << "," << numPackets << ","
+              << reassembled << "," << cpuSeconds * 1e6 / std::max<uint64_t>(reassembled, 1)
+              << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}
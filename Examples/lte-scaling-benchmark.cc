@@ -0,0 +1,255 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// Multi-cell LTE/EPC scaling benchmark.
+//
+// Builds numEnbs eNodeBs on a square grid, uesPerEnb UEs around each of them and
+// bearersPerUe EPS bearers per UE (one default + dedicated bearers selected by
+// destination port), then pushes downlink UDP from a remote host through the
+// PGW/S1-U GTP-U tunnels. One configuration is run per process so that peak RSS
+// is attributable to it; sweep the grid from the shell, e.g.
+//
+//   for e in 1 4 16; do for u in 10 50 100; do for b in 1 2; do
+//     ./ns3 run "lte-scaling-benchmark --numEnbs=$e --uesPerEnb=$u --bearersPerUe=$b";
+//   done; done; done
+//
+// Output is a single CSV row (add --printHeader for the column names):
+//   enbs,uesPerEnb,bearersPerUe,setupS,attachedUes,attachSimS,attachWallS,runS,events,
+//   eventsPerSimS,rssKbPerUe,gtpuMbps
+// setupS covers building the topology only. RRC connection establishment and bearer
+// activation run inside Simulator::Run, which at hundreds of UEs is where most of the
+// attach cost is: attachSimS and attachWallS are the simulated and wall-clock time,
+// from the start of the run, at which the last of attachedUes UEs reached RRC
+// CONNECTED. Dedicated bearer activation follows and is part of runS. gtpuMbps is the
+// downlink goodput from the start of the flows at 1 s, so simTime must exceed 1.
+//
+// --fastPhy (on by default) turns off the per-TB error models and per-RB PDSCH CQI, as
+// in Large/184.cc; interference and SINR are still computed per RB.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("LteScalingBenchmark");
+
+static double
+WallSeconds(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+/// RRC connection establishment progress during the run
+struct AttachProgress
+{
+    uint32_t connected{0};
+    Time lastSim;
+    double lastWallS{0};
+    std::chrono::steady_clock::time_point runStart;
+};
+
+static void
+ConnectionEstablished(AttachProgress* progress,
+                      uint64_t /* imsi */,
+                      uint16_t /* cellId */,
+                      uint16_t /* rnti */)
+{
+    progress->connected++;
+    progress->lastSim = Simulator::Now();
+    progress->lastWallS = WallSeconds(progress->runStart);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t numEnbs = 4;
+    uint32_t uesPerEnb = 10;
+    uint32_t bearersPerUe = 1;
+    double simTime = 5.0;
+    double interSiteDistance = 500.0;
+    double packetInterval = 0.01;
+    bool fastPhy = true;
+    bool printHeader = false;
+
+    CommandLine cmd;
+    cmd.AddValue("numEnbs", "Number of eNodeBs (placed on a square grid)", numEnbs);
+    cmd.AddValue("uesPerEnb", "Number of UEs attached to each eNodeB", uesPerEnb);
+    cmd.AddValue("bearersPerUe", "EPS bearers per UE (default bearer included)", bearersPerUe);
+    cmd.AddValue("simTime", "Simulated time in seconds", simTime);
+    cmd.AddValue("interSiteDistance", "Distance between neighbouring eNodeBs in meters", interSiteDistance);
+    cmd.AddValue("packetInterval", "Downlink packet interval per bearer in seconds", packetInterval);
+    cmd.AddValue("fastPhy", "Turn off the per-TB error models and per-RB CQI", fastPhy);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(simTime <= 1.0, "simTime must exceed 1 s, when the flows start");
+
+    if (fastPhy)
+    {
+        Config::SetDefault("ns3::LteSpectrumPhy::CtrlErrorModelEnabled", BooleanValue(false));
+        Config::SetDefault("ns3::LteSpectrumPhy::DataErrorModelEnabled", BooleanValue(false));
+        Config::SetDefault("ns3::LteHelper::UsePdschForCqiGeneration", BooleanValue(false));
+        Config::SetDefault("ns3::LteAmc::AmcModel", EnumValue(LteAmc::PiroEW2010));
+        Config::SetDefault("ns3::LteUePhy::EnableUplinkPowerControl", BooleanValue(false));
+    }
+    Config::SetDefault("ns3::LteEnbRrc::SrsPeriodicity", UintegerValue(320));
+
+    auto setupStart = std::chrono::steady_clock::now();
+
+    Ptr<LteHelper> lteHelper = CreateObject<LteHelper>();
+    Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper>();
+    lteHelper->SetEpcHelper(epcHelper);
+
+    // Remote host behind the PGW
+    Ptr<Node> pgw = epcHelper->GetPgwNode();
+    NodeContainer remoteHostContainer;
+    remoteHostContainer.Create(1);
+    Ptr<Node> remoteHost = remoteHostContainer.Get(0);
+    InternetStackHelper internet;
+    internet.Install(remoteHostContainer);
+
+    PointToPointHelper p2ph;
+    p2ph.SetDeviceAttribute("DataRate", DataRateValue(DataRate("100Gb/s")));
+    p2ph.SetChannelAttribute("Delay", TimeValue(MilliSeconds(10)));
+    NetDeviceContainer internetDevices = p2ph.Install(pgw, remoteHost);
+    Ipv4AddressHelper ipv4h;
+    ipv4h.SetBase("1.0.0.0", "255.0.0.0");
+    ipv4h.Assign(internetDevices);
+
+    Ipv4StaticRoutingHelper ipv4RoutingHelper;
+    Ptr<Ipv4StaticRouting> remoteHostStaticRouting =
+        ipv4RoutingHelper.GetStaticRouting(remoteHost->GetObject<Ipv4>());
+    remoteHostStaticRouting->AddNetworkRouteTo(Ipv4Address("7.0.0.0"), Ipv4Mask("255.0.0.0"), 1);
+
+    // eNodeBs on a square grid, UEs uniformly in a disc around their serving eNodeB
+    NodeContainer enbNodes;
+    enbNodes.Create(numEnbs);
+    uint32_t gridWidth = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(numEnbs))));
+
+    MobilityHelper enbMobility;
+    enbMobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                     "MinX", DoubleValue(0.0),
+                                     "MinY", DoubleValue(0.0),
+                                     "DeltaX", DoubleValue(interSiteDistance),
+                                     "DeltaY", DoubleValue(interSiteDistance),
+                                     "GridWidth", UintegerValue(gridWidth),
+                                     "LayoutType", StringValue("RowFirst"));
+    enbMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    enbMobility.Install(enbNodes);
+    NetDeviceContainer enbLteDevs = lteHelper->InstallEnbDevice(enbNodes);
+
+    NodeContainer ueNodes;
+    NetDeviceContainer ueLteDevs;
+    std::vector<NodeContainer> uesOfEnb(numEnbs);
+    for (uint32_t e = 0; e < numEnbs; ++e)
+    {
+        uesOfEnb[e].Create(uesPerEnb);
+        Vector enbPos = enbNodes.Get(e)->GetObject<MobilityModel>()->GetPosition();
+
+        MobilityHelper ueMobility;
+        Ptr<UniformDiscPositionAllocator> disc = CreateObject<UniformDiscPositionAllocator>();
+        disc->SetX(enbPos.x);
+        disc->SetY(enbPos.y);
+        disc->SetRho(interSiteDistance / 2.0);
+        ueMobility.SetPositionAllocator(disc);
+        ueMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+        ueMobility.Install(uesOfEnb[e]);
+
+        ueNodes.Add(uesOfEnb[e]);
+        ueLteDevs.Add(lteHelper->InstallUeDevice(uesOfEnb[e]));
+    }
+
+    internet.Install(ueNodes);
+    Ipv4InterfaceContainer ueIpIfaces = epcHelper->AssignUeIpv4Address(ueLteDevs);
+    for (uint32_t i = 0; i < ueNodes.GetN(); ++i)
+    {
+        Ptr<Ipv4StaticRouting> ueStaticRouting =
+            ipv4RoutingHelper.GetStaticRouting(ueNodes.Get(i)->GetObject<Ipv4>());
+        ueStaticRouting->SetDefaultRoute(epcHelper->GetUeDefaultGatewayAddress(), 1);
+    }
+
+    for (uint32_t i = 0; i < ueLteDevs.GetN(); ++i)
+    {
+        lteHelper->Attach(ueLteDevs.Get(i), enbLteDevs.Get(i / uesPerEnb));
+    }
+
+    // One downlink flow per bearer; bearer b > 0 is a dedicated bearer matched on port
+    uint16_t basePort = 10000;
+    ApplicationContainer clientApps;
+    ApplicationContainer sinkApps;
+    for (uint32_t i = 0; i < ueNodes.GetN(); ++i)
+    {
+        for (uint32_t b = 0; b < bearersPerUe; ++b)
+        {
+            uint16_t port = basePort + b;
+            PacketSinkHelper sink("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+            sinkApps.Add(sink.Install(ueNodes.Get(i)));
+
+            UdpClientHelper client(ueIpIfaces.GetAddress(i), port);
+            client.SetAttribute("Interval", TimeValue(Seconds(packetInterval)));
+            client.SetAttribute("MaxPackets", UintegerValue(1000000));
+            client.SetAttribute("PacketSize", UintegerValue(1024));
+            clientApps.Add(client.Install(remoteHost));
+
+            if (b > 0)
+            {
+                Ptr<EpcTft> tft = Create<EpcTft>();
+                EpcTft::PacketFilter dlpf;
+                dlpf.localPortStart = port;
+                dlpf.localPortEnd = port;
+                tft->Add(dlpf);
+                lteHelper->ActivateDedicatedEpsBearer(ueLteDevs.Get(i),
+                                                      EpsBearer(EpsBearer::NGBR_VIDEO_TCP_DEFAULT),
+                                                      tft);
+            }
+        }
+    }
+    sinkApps.Start(Seconds(0.5));
+    clientApps.Start(Seconds(1.0));
+    clientApps.Stop(Seconds(simTime));
+
+    AttachProgress attach;
+    Config::ConnectWithoutContext("/NodeList/*/DeviceList/*/LteUeRrc/ConnectionEstablished",
+                                  MakeBoundCallback(&ConnectionEstablished, &attach));
+
+    double setupSeconds = WallSeconds(setupStart);
+
+    auto runStart = std::chrono::steady_clock::now();
+    attach.runStart = runStart;
+    Simulator::Stop(Seconds(simTime));
+    Simulator::Run();
+    double runSeconds = WallSeconds(runStart);
+
+    uint64_t rxBytes = 0;
+    for (uint32_t i = 0; i < sinkApps.GetN(); ++i)
+    {
+        rxBytes += DynamicCast<PacketSink>(sinkApps.Get(i))->GetTotalRx();
+    }
+    uint64_t events = Simulator::GetEventCount();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage); // ru_maxrss is in KiB on Linux
+    uint32_t totalUes = numEnbs * uesPerEnb;
+
+    if (printHeader)
+    {
+        std::cout << "enbs,uesPerEnb,bearersPerUe,setupS,attachedUes,attachSimS,attachWallS,runS,"
+                     "events,eventsPerSimS,rssKbPerUe,gtpuMbps"
+                  << std::endl;
+    }
+    std::cout << numEnbs << "," << uesPerEnb << "," << bearersPerUe << "," << setupSeconds << ","
+              << attach.connected << "," << attach.lastSim.GetSeconds() << "," << attach.lastWallS
+              << "," << runSeconds << "," << events << "," << events / simTime << ","
+              << static_cast<double>(usage.ru_maxrss) / totalUes << ","
+              << rxBytes * 8.0 / (simTime - 1.0) / 1e6 << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}
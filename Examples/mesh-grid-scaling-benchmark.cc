@@ -0,0 +1,270 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/mesh-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/applications-module.h"
+
+#include <sys/resource.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+// Large-mesh benchmark for 802.11s (Dot11sStack), the stack the mesh scripts
+// (Large/160.cc, 210.cc, Small/294.cc, 321.cc) install on four or five nodes.
+//
+// side x side mesh points sit step metres apart, one interface each, and numFlows
+// random pairs exchange low-rate UDP so HWMP keeps discovering and refreshing paths.
+// After the warm-up, which covers peering and the first discoveries, the mesh
+// statistics are reset; at the end each mesh point's counters are read back and split
+// by control path:
+//   - HWMP path selection: PREQ, PREP and PERR elements sent and received, and the
+//     PREQs the node originated;
+//   - airtime metric: HWMP computes the link metric once per received HWMP action
+//     frame, so metricEvals is the number of those frames;
+//   - peer link management: links opened and closed, and Open/Confirm/Close frames.
+// The per-node counters go to statsFile as CSV:
+//   node,preqTx,preqRx,prepTx,prepRx,perrTx,perrRx,preqInitiated,metricEvals,
+//   linksOpened,linksClosed,peerMgtTx,peerMgtRx
+// and a summary row, rates per simulated second of the window, to stdout:
+//   meshPoints,cpuPerSimS,wallS,preqRxPerS,prepRxPerS,perrRxPerS,metricEvalsPerS,
+//   peerMgtRxPerS,linksOpened,delivered,rssKb
+// The path whose rate grows fastest with side is the one that dominates the CPU.
+//
+//   for s in 4 8 12 16 20; do
+//     ./ns3 run "mesh-grid-scaling-benchmark --side=$s --numFlows=$s";
+//   done
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("MeshGridScalingBenchmark");
+
+/**
+ * Counters of one mesh point, summed from MeshHelper::Report by element and attribute,
+ * e.g. "HwmpProtocolMac.rxPreq" over all interfaces. The counters of a Statistics
+ * element belong to the element around it.
+ */
+static std::map<std::string, uint64_t>
+ReadMeshStats(MeshHelper& mesh, Ptr<NetDevice> device)
+{
+    std::ostringstream report;
+    mesh.Report(device, report);
+    const std::string text = report.str();
+
+    std::map<std::string, uint64_t> counters;
+    std::string element;
+    std::size_t pos = 0;
+    while (pos < text.size())
+    {
+        if (text[pos] == '<' && pos + 1 < text.size() && std::isalpha(text[pos + 1]))
+        {
+            std::size_t end = pos + 1;
+            while (end < text.size() && std::isalnum(text[end]))
+            {
+                end++;
+            }
+            std::string name = text.substr(pos + 1, end - pos - 1);
+            if (name != "Statistics")
+            {
+                element = name;
+            }
+            pos = end;
+            continue;
+        }
+        if (text[pos] != '=')
+        {
+            pos++;
+            continue;
+        }
+        // name="value", with optional blanks after '='
+        std::size_t nameEnd = pos;
+        std::size_t nameStart = nameEnd;
+        while (nameStart > 0 && std::isalnum(text[nameStart - 1]))
+        {
+            nameStart--;
+        }
+        std::size_t value = pos + 1;
+        while (value < text.size() && std::isspace(text[value]))
+        {
+            value++;
+        }
+        if (value < text.size() && text[value] == '"' && nameStart < nameEnd)
+        {
+            char* parsedEnd = nullptr;
+            uint64_t number = std::strtoull(text.c_str() + value + 1, &parsedEnd, 10);
+            if (parsedEnd != text.c_str() + value + 1 && *parsedEnd == '"')
+            {
+                counters[element + "." + text.substr(nameStart, nameEnd - nameStart)] += number;
+            }
+        }
+        pos = value;
+    }
+    return counters;
+}
+
+static double
+CpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void
+StartMeasurement(MeshHelper* mesh, NetDeviceContainer devices, double* cpuAtStart)
+{
+    for (uint32_t i = 0; i < devices.GetN(); ++i)
+    {
+        mesh->ResetStats(devices.Get(i));
+    }
+    *cpuAtStart = CpuSeconds();
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t side = 8;
+    double step = 100;
+    uint32_t numFlows = 8;
+    double warmup = 10;
+    double measure = 10;
+    std::string statsFile = "mesh-grid-stats.csv";
+    bool printHeader = false;
+
+    CommandLine cmd;
+    cmd.AddValue("side", "Mesh points per grid row and column", side);
+    cmd.AddValue("step", "Distance between grid neighbours (m)", step);
+    cmd.AddValue("numFlows", "Number of random UDP flows", numFlows);
+    cmd.AddValue("warmup", "Seconds simulated before measuring", warmup);
+    cmd.AddValue("measure", "Seconds simulated while measuring", measure);
+    cmd.AddValue("statsFile", "CSV file for the per-node counters", statsFile);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+
+    uint32_t meshPoints = side * side;
+    NS_ABORT_MSG_IF(meshPoints < 2 || meshPoints > 65534, "side must be in [2, 255]");
+    NS_ABORT_MSG_IF(numFlows > 50000, "At most 50000 flows, one port each");
+
+    auto start = std::chrono::steady_clock::now();
+
+    NodeContainer nodes;
+    nodes.Create(meshPoints);
+
+    // The PHY and mesh set-up of the ns-3 mesh example
+    YansWifiPhyHelper wifiPhy;
+    YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
+    wifiPhy.SetChannel(wifiChannel.Create());
+
+    MeshHelper mesh = MeshHelper::Default();
+    mesh.SetStackInstaller("ns3::Dot11sStack");
+    mesh.SetSpreadInterfaceChannels(MeshHelper::SPREAD_CHANNELS);
+    mesh.SetMacType("RandomStart", TimeValue(Seconds(0.1)));
+    mesh.SetNumberOfInterfaces(1);
+    NetDeviceContainer devices = mesh.Install(wifiPhy, nodes);
+
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                  "DeltaX",
+                                  DoubleValue(step),
+                                  "DeltaY",
+                                  DoubleValue(step),
+                                  "GridWidth",
+                                  UintegerValue(side),
+                                  "LayoutType",
+                                  StringValue("RowFirst"));
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.Install(nodes);
+
+    InternetStackHelper internet;
+    internet.Install(nodes);
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase("10.0.0.0", "255.255.0.0");
+    Ipv4InterfaceContainer interfaces = ipv4.Assign(devices);
+
+    // Random distinct endpoints per flow, each flow on its own port
+    Ptr<UniformRandomVariable> pick = CreateObject<UniformRandomVariable>();
+    std::vector<ApplicationContainer> servers;
+    for (uint32_t flow = 0; flow < numFlows; ++flow)
+    {
+        uint32_t source = pick->GetInteger(0, meshPoints - 1);
+        uint32_t destination = pick->GetInteger(0, meshPoints - 2);
+        destination += destination >= source ? 1 : 0;
+        uint16_t port = 10000 + flow;
+
+        UdpServerHelper server(port);
+        servers.push_back(server.Install(nodes.Get(destination)));
+
+        UdpClientHelper client(interfaces.GetAddress(destination), port);
+        client.SetAttribute("MaxPackets", UintegerValue(0));
+        client.SetAttribute("Interval", TimeValue(Seconds(1.0)));
+        client.SetAttribute("PacketSize", UintegerValue(256));
+        ApplicationContainer clientApps = client.Install(nodes.Get(source));
+        clientApps.Start(Seconds(1.0 + pick->GetValue(0, 1)));
+    }
+
+    double cpuAtStart = 0;
+    Simulator::Schedule(Seconds(warmup), &StartMeasurement, &mesh, devices, &cpuAtStart);
+    Simulator::Stop(Seconds(warmup + measure));
+    Simulator::Run();
+    double cpuPerSimS = (CpuSeconds() - cpuAtStart) / measure;
+    double wallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream perNode(statsFile);
+    NS_ABORT_MSG_IF(!perNode, "Cannot open " << statsFile);
+    perNode << "node,preqTx,preqRx,prepTx,prepRx,perrTx,perrRx,preqInitiated,metricEvals,"
+               "linksOpened,linksClosed,peerMgtTx,peerMgtRx"
+            << std::endl;
+    std::map<std::string, uint64_t> total;
+    for (uint32_t i = 0; i < devices.GetN(); ++i)
+    {
+        std::map<std::string, uint64_t> stats = ReadMeshStats(mesh, devices.Get(i));
+        for (const auto& counter : stats)
+        {
+            total[counter.first] += counter.second;
+        }
+        perNode << nodes.Get(i)->GetId() << "," << stats["HwmpProtocolMac.txPreq"] << ","
+                << stats["HwmpProtocolMac.rxPreq"] << "," << stats["HwmpProtocolMac.txPrep"] << ","
+                << stats["HwmpProtocolMac.rxPrep"] << "," << stats["HwmpProtocolMac.txPerr"] << ","
+                << stats["HwmpProtocolMac.rxPerr"] << "," << stats["Hwmp.initiatedPreq"] << ","
+                << stats["HwmpProtocolMac.rxMgt"] << ","
+                << stats["PeerManagementProtocol.linksOpened"] << ","
+                << stats["PeerManagementProtocol.linksClosed"] << ","
+                << stats["PeerManagementProtocolMac.txMgt"] << ","
+                << stats["PeerManagementProtocolMac.rxMgt"] << std::endl;
+    }
+
+    uint64_t delivered = 0;
+    for (const ApplicationContainer& server : servers)
+    {
+        delivered += DynamicCast<UdpServer>(server.Get(0))->GetReceived();
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage); // ru_maxrss is in KiB on Linux
+
+    if (printHeader)
+    {
+        std::cout << "meshPoints,cpuPerSimS,wallS,preqRxPerS,prepRxPerS,perrRxPerS,"
+                     "metricEvalsPerS,peerMgtRxPerS,linksOpened,delivered,rssKb"
+                  << std::endl;
+    }
+    std::cout << meshPoints << "," << cpuPerSimS << "," << wallSeconds << ","
+              << total["HwmpProtocolMac.rxPreq"] / measure << ","
+              << total["HwmpProtocolMac.rxPrep"] / measure << ","
+              << total["HwmpProtocolMac.rxPerr"] / measure << ","
+              << total["HwmpProtocolMac.rxMgt"] / measure << ","
+              << total["PeerManagementProtocolMac.rxMgt"] / measure << ","
+              << total["PeerManagementProtocol.linksOpened"] << "," << delivered << ","
+              << usage.ru_maxrss << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}
@@ -0,0 +1,492 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// CGNAT translation-table benchmark for the NatExample scenario scaled to many flows.
+//
+// NatTable keeps the translation state of a NAT router with a pool of public
+// addresses:
+//  - outbound (private addr, private port, proto) and inbound (public addr, public
+//    port, proto) lookups use open-addressing hash tables with linear probing;
+//  - public ports are handed out from one 64k-bit bitmap per public address and
+//    protocol, scanned a word at a time;
+//  - idle mappings expire through a timer wheel with one-second slots: a mapping is
+//    filed once under its expiry second and only re-filed, lazily, when its slot
+//    comes round and it turns out to have been used since.
+//
+// The benchmark creates numFlows mappings, pushes packetsPerFlow translations per
+// flow in both directions, then lets every mapping idle out, and prints a CSV row:
+//   flows,publicAddrs,createPerS,translatePerS,expirePerS,expired,bytesPerMapping
+//
+//   ./ns3 run "nat-table-benchmark --numFlows=100000 --printHeader=1"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("NatTableBenchmark");
+
+/// Open-addressing hash map from a 64-bit key to a 32-bit value (linear probing,
+/// backward-shift deletion so lookups never have to skip tombstones). The table
+/// doubles whenever an insertion would take the load factor above 0.5, so probe runs
+/// stay short and always end at an empty slot.
+class FlatKeyMap
+{
+  public:
+    static constexpr uint32_t NOT_FOUND = std::numeric_limits<uint32_t>::max();
+
+    explicit FlatKeyMap(uint32_t expectedEntries)
+    {
+        uint32_t bits = 4;
+        while ((1u << bits) < expectedEntries * 2) // keep the load factor <= 0.5
+        {
+            bits++;
+        }
+        m_shift = 64 - bits;
+        m_mask = (1u << bits) - 1;
+        m_slots.assign(1u << bits, Slot{EMPTY, 0});
+        m_size = 0;
+    }
+
+    uint32_t Find(uint64_t key) const
+    {
+        for (uint32_t i = Home(key);; i = (i + 1) & m_mask)
+        {
+            if (m_slots[i].key == key)
+            {
+                return m_slots[i].value;
+            }
+            if (m_slots[i].key == EMPTY)
+            {
+                return NOT_FOUND;
+            }
+        }
+    }
+
+    void Insert(uint64_t key, uint32_t value)
+    {
+        if ((m_size + 1) * 2 > m_slots.size())
+        {
+            Grow();
+        }
+        uint32_t i = Home(key);
+        while (m_slots[i].key != EMPTY && m_slots[i].key != key)
+        {
+            i = (i + 1) & m_mask;
+        }
+        if (m_slots[i].key == EMPTY)
+        {
+            m_size++;
+        }
+        m_slots[i] = Slot{key, value};
+    }
+
+    void Erase(uint64_t key)
+    {
+        uint32_t i = Home(key);
+        while (m_slots[i].key != key)
+        {
+            if (m_slots[i].key == EMPTY)
+            {
+                return;
+            }
+            i = (i + 1) & m_mask;
+        }
+        // Shift later members of the probe run back into the hole
+        for (uint32_t j = (i + 1) & m_mask; m_slots[j].key != EMPTY; j = (j + 1) & m_mask)
+        {
+            uint32_t home = Home(m_slots[j].key);
+            bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+            if (movable)
+            {
+                m_slots[i] = m_slots[j];
+                i = j;
+            }
+        }
+        m_slots[i].key = EMPTY;
+        m_size--;
+    }
+
+    uint64_t GetMemoryBytes() const
+    {
+        return m_slots.size() * sizeof(Slot);
+    }
+
+  private:
+    static constexpr uint64_t EMPTY = std::numeric_limits<uint64_t>::max();
+
+    struct Slot
+    {
+        uint64_t key;
+        uint32_t value;
+    };
+
+    uint32_t Home(uint64_t key) const
+    {
+        return static_cast<uint32_t>((key * 0x9E3779B97F4A7C15ULL) >> m_shift) & m_mask;
+    }
+
+    void Grow()
+    {
+        NS_ABORT_MSG_IF(m_mask >= 0x7FFFFFFFu, "FlatKeyMap cannot grow beyond 2^31 slots");
+        std::vector<Slot> old(m_mask * 2 + 2, Slot{EMPTY, 0});
+        old.swap(m_slots);
+        m_shift--;
+        m_mask = m_mask * 2 + 1;
+        m_size = 0;
+        for (const Slot& slot : old)
+        {
+            if (slot.key != EMPTY)
+            {
+                Insert(slot.key, slot.value);
+            }
+        }
+    }
+
+    uint32_t m_shift;
+    uint32_t m_mask;
+    uint32_t m_size; ///< occupied slots
+    std::vector<Slot> m_slots;
+};
+
+/// NAT translation state: mappings, both lookup directions, port bitmaps and expiry.
+class NatTable
+{
+  public:
+    static constexpr uint32_t NO_MAPPING = FlatKeyMap::NOT_FOUND;
+
+    NatTable(Ipv4Address firstPublicAddress,
+             uint32_t numPublicAddresses,
+             uint32_t expectedMappings,
+             uint32_t idleTimeoutS)
+        : m_firstPublic(firstPublicAddress.Get()),
+          m_numPublic(numPublicAddresses),
+          m_publicHint(0),
+          m_outbound(expectedMappings),
+          m_inbound(expectedMappings),
+          m_ports(numPublicAddresses * 2 * PORT_WORDS, 0),
+          m_portHint(numPublicAddresses * 2, FIRST_PORT / 64),
+          m_idleTimeout(idleTimeoutS),
+          m_wheel(WheelSize(idleTimeoutS), NO_MAPPING),
+          m_now(0),
+          m_freeList(NO_MAPPING),
+          m_live(0)
+    {
+        m_mappings.reserve(expectedMappings);
+    }
+
+    /// Translate an outbound packet, creating the mapping on first use.
+    /// Returns the mapping index, or NO_MAPPING if the public port pool is exhausted.
+    uint32_t TranslateOutbound(Ipv4Address privateAddress, uint16_t privatePort, uint8_t proto)
+    {
+        uint64_t key = OutKey(privateAddress.Get(), privatePort, proto);
+        uint32_t index = m_outbound.Find(key);
+        if (index == NO_MAPPING)
+        {
+            index = Create(key, proto);
+            if (index == NO_MAPPING)
+            {
+                return NO_MAPPING;
+            }
+        }
+        m_mappings[index].lastUsed = m_now;
+        return index;
+    }
+
+    /// Translate an inbound packet; returns NO_MAPPING if no mapping exists.
+    uint32_t TranslateInbound(Ipv4Address publicAddress, uint16_t publicPort, uint8_t proto)
+    {
+        uint32_t addrIndex = publicAddress.Get() - m_firstPublic;
+        if (addrIndex >= m_numPublic)
+        {
+            return NO_MAPPING;
+        }
+        uint32_t index = m_inbound.Find(InKey(addrIndex, publicPort, proto));
+        if (index != NO_MAPPING)
+        {
+            m_mappings[index].lastUsed = m_now;
+        }
+        return index;
+    }
+
+    Ipv4Address GetPublicAddress(uint32_t mapping) const
+    {
+        return Ipv4Address(m_firstPublic + m_mappings[mapping].publicAddrIndex);
+    }
+
+    uint16_t GetPublicPort(uint32_t mapping) const
+    {
+        return m_mappings[mapping].publicPort;
+    }
+
+    /// Advance the clock to 'nowS' seconds, expiring mappings idle for the timeout.
+    /// Returns the number of mappings expired.
+    uint32_t AdvanceTo(uint32_t nowS)
+    {
+        uint32_t expired = 0;
+        while (m_now < nowS)
+        {
+            m_now++;
+            uint32_t slot = m_now % m_wheel.size();
+            uint32_t index = m_wheel[slot];
+            m_wheel[slot] = NO_MAPPING;
+            while (index != NO_MAPPING)
+            {
+                uint32_t next = m_mappings[index].nextInSlot;
+                uint32_t due = m_mappings[index].lastUsed + m_idleTimeout;
+                if (due <= m_now)
+                {
+                    Release(index);
+                    expired++;
+                }
+                else
+                {
+                    File(index, due); // used since it was filed; look again later
+                }
+                index = next;
+            }
+        }
+        return expired;
+    }
+
+    uint32_t GetLiveMappings() const
+    {
+        return m_live;
+    }
+
+    /// Bytes held by the table per live mapping at its current capacity.
+    double GetBytesPerMapping() const
+    {
+        uint64_t bytes = m_outbound.GetMemoryBytes() + m_inbound.GetMemoryBytes() +
+                         m_mappings.capacity() * sizeof(Mapping) +
+                         m_ports.size() * sizeof(uint64_t) + m_wheel.size() * sizeof(uint32_t);
+        return m_live ? static_cast<double>(bytes) / m_live : 0.0;
+    }
+
+  private:
+    static constexpr uint16_t FIRST_PORT = 1024;
+    static constexpr uint32_t PORT_WORDS = 65536 / 64;
+
+    struct Mapping
+    {
+        uint64_t outKey;
+        uint32_t publicAddrIndex;
+        uint32_t lastUsed;
+        uint32_t nextInSlot; ///< wheel bucket link, or free-list link once released
+        uint16_t publicPort;
+        uint8_t proto;
+    };
+
+    static uint32_t WheelSize(uint32_t idleTimeoutS)
+    {
+        uint32_t size = 1;
+        while (size <= idleTimeoutS)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static uint64_t OutKey(uint32_t addr, uint16_t port, uint8_t proto)
+    {
+        return (static_cast<uint64_t>(addr) << 24) | (static_cast<uint64_t>(port) << 8) | proto;
+    }
+
+    static uint64_t InKey(uint32_t addrIndex, uint16_t port, uint8_t proto)
+    {
+        return (static_cast<uint64_t>(addrIndex) << 24) | (static_cast<uint64_t>(port) << 8) |
+               proto;
+    }
+
+    static uint32_t ProtoIndex(uint8_t proto)
+    {
+        return proto == 6 ? 0 : 1; // TCP, everything else shares the UDP pool
+    }
+
+    /// Take a free port from the first public address that has one.
+    bool AllocatePort(uint8_t proto, uint32_t* addrIndex, uint16_t* port)
+    {
+        for (uint32_t tried = 0; tried < m_numPublic; ++tried)
+        {
+            uint32_t a = (m_publicHint + tried) % m_numPublic;
+            uint32_t pool = a * 2 + ProtoIndex(proto);
+            uint64_t* words = &m_ports[pool * PORT_WORDS];
+            for (uint32_t n = 0; n < PORT_WORDS; ++n)
+            {
+                uint32_t w = m_portHint[pool];
+                if (words[w] != ~0ULL)
+                {
+                    uint32_t bit = __builtin_ctzll(~words[w]);
+                    words[w] |= 1ULL << bit;
+                    *addrIndex = a;
+                    *port = static_cast<uint16_t>(w * 64 + bit);
+                    m_publicHint = a;
+                    return true;
+                }
+                w = (w + 1 == PORT_WORDS) ? FIRST_PORT / 64 : w + 1;
+                m_portHint[pool] = w;
+            }
+        }
+        return false;
+    }
+
+    void FreePort(uint32_t addrIndex, uint8_t proto, uint16_t port)
+    {
+        uint32_t pool = addrIndex * 2 + ProtoIndex(proto);
+        m_ports[pool * PORT_WORDS + port / 64] &= ~(1ULL << (port % 64));
+    }
+
+    uint32_t Create(uint64_t outKey, uint8_t proto)
+    {
+        uint32_t addrIndex;
+        uint16_t port;
+        if (!AllocatePort(proto, &addrIndex, &port))
+        {
+            return NO_MAPPING;
+        }
+        uint32_t index;
+        if (m_freeList != NO_MAPPING)
+        {
+            index = m_freeList;
+            m_freeList = m_mappings[index].nextInSlot;
+        }
+        else
+        {
+            index = m_mappings.size();
+            m_mappings.push_back(Mapping());
+        }
+        m_mappings[index] = Mapping{outKey, addrIndex, m_now, NO_MAPPING, port, proto};
+        m_outbound.Insert(outKey, index);
+        m_inbound.Insert(InKey(addrIndex, port, proto), index);
+        File(index, m_now + m_idleTimeout);
+        m_live++;
+        return index;
+    }
+
+    void File(uint32_t index, uint32_t due)
+    {
+        uint32_t slot = due % m_wheel.size();
+        m_mappings[index].nextInSlot = m_wheel[slot];
+        m_wheel[slot] = index;
+    }
+
+    void Release(uint32_t index)
+    {
+        Mapping& m = m_mappings[index];
+        m_outbound.Erase(m.outKey);
+        m_inbound.Erase(InKey(m.publicAddrIndex, m.publicPort, m.proto));
+        FreePort(m.publicAddrIndex, m.proto, m.publicPort);
+        m.nextInSlot = m_freeList;
+        m_freeList = index;
+        m_live--;
+    }
+
+    uint32_t m_firstPublic;
+    uint32_t m_numPublic;
+    uint32_t m_publicHint;             ///< public address the last port came from
+    FlatKeyMap m_outbound;
+    FlatKeyMap m_inbound;
+    std::vector<uint64_t> m_ports;     ///< one 64k-bit bitmap per (public address, proto)
+    std::vector<uint32_t> m_portHint;  ///< next bitmap word to scan, per pool
+    uint32_t m_idleTimeout;
+    std::vector<uint32_t> m_wheel;     ///< per-second buckets of mapping indices
+    uint32_t m_now;
+    std::vector<Mapping> m_mappings;
+    uint32_t m_freeList;
+    uint32_t m_live;
+};
+
+static double
+WallSeconds(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t numFlows = 100000;
+    uint32_t packetsPerFlow = 10;
+    uint32_t flowsPerHost = 16;
+    uint32_t idleTimeout = 30;
+    bool printHeader = false;
+
+    CommandLine cmd;
+    cmd.AddValue("numFlows", "Number of concurrent flows (mappings)", numFlows);
+    cmd.AddValue("packetsPerFlow", "Translations per flow and direction", packetsPerFlow);
+    cmd.AddValue("flowsPerHost", "Flows sharing one private host address", flowsPerHost);
+    cmd.AddValue("idleTimeout", "Idle mapping timeout in seconds", idleTimeout);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+    // Each host's flows take source ports 49152 + (0 .. flowsPerHost - 1)
+    NS_ABORT_MSG_IF(flowsPerHost < 1 || flowsPerHost > 16384,
+                    "flowsPerHost must be between 1 and 16384");
+
+    const uint8_t udp = 17;
+    const uint32_t portsPerAddress = 65536 - 1024;
+    uint32_t numPublic = (numFlows + portsPerAddress - 1) / portsPerAddress;
+    NatTable nat(Ipv4Address("10.1.1.2"), numPublic, numFlows, idleTimeout);
+
+    // Private side of the NatExample topology, scaled: 192.168.0.0/16 hosts
+    uint32_t privateBase = Ipv4Address("192.168.0.1").Get();
+
+    // Visit flows in a shuffled order so lookups do not walk the tables sequentially
+    Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable>();
+    std::vector<uint32_t> order(numFlows);
+    for (uint32_t i = 0; i < numFlows; ++i)
+    {
+        order[i] = i;
+    }
+    for (uint32_t i = numFlows; i > 1; --i)
+    {
+        std::swap(order[i - 1], order[rng->GetInteger(0, i - 1)]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> mappings(numFlows);
+    for (uint32_t i = 0; i < numFlows; ++i)
+    {
+        mappings[i] = nat.TranslateOutbound(Ipv4Address(privateBase + i / flowsPerHost),
+                                            49152 + i % flowsPerHost,
+                                            udp);
+        NS_ABORT_MSG_IF(mappings[i] == NatTable::NO_MAPPING, "Public port pool exhausted");
+    }
+    double createSeconds = WallSeconds(start);
+    double bytesPerMapping = nat.GetBytesPerMapping();
+
+    // Echo-style traffic: every flow sends and receives once per simulated second
+    start = std::chrono::steady_clock::now();
+    uint64_t translations = 0;
+    for (uint32_t round = 1; round <= packetsPerFlow; ++round)
+    {
+        nat.AdvanceTo(round);
+        for (uint32_t i : order)
+        {
+            uint32_t out = nat.TranslateOutbound(Ipv4Address(privateBase + i / flowsPerHost),
+                                                 49152 + i % flowsPerHost,
+                                                 udp);
+            uint32_t in = nat.TranslateInbound(nat.GetPublicAddress(out), nat.GetPublicPort(out), udp);
+            NS_ABORT_MSG_IF(in != out, "Inbound translation mismatch for flow " << i);
+            translations += 2;
+        }
+    }
+    double translateSeconds = WallSeconds(start);
+
+    start = std::chrono::steady_clock::now();
+    uint32_t expired = nat.AdvanceTo(packetsPerFlow + idleTimeout + 1);
+    double expireSeconds = WallSeconds(start);
+    NS_ABORT_MSG_IF(nat.GetLiveMappings() != 0, "Mappings left after the idle timeout");
+
+    if (printHeader)
+    {
+        std::cout << "flows,publicAddrs,createPerS,translatePerS,expirePerS,expired,bytesPerMapping"
+                  << std::endl;
+    }
+    std::cout << numFlows << "," << numPublic << "," << numFlows / createSeconds << ","
+              << translations / translateSeconds << "," << expired / expireSeconds << ","
+              << expired << "," << bytesPerMapping << std::endl;
+
+    return 0;
+}
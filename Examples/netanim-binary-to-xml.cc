@@ -0,0 +1,276 @@
+#include "ns3/core-module.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+// Converts a binary animation trace to NetAnim XML.
+//
+// The matrix-topology (95.cc), VANET (186.cc) and fat-tree (187.cc) scripts write the
+// trace with BinaryAnimTrace when run with --binaryAnim; the file layout is described
+// there. Positions come back in metres, times in seconds. The Wi-Fi PHY has no
+// end-of-transmission trace, so a wireless packet's last bit is taken as sent when it
+// was first sent, and as received by everyone from the moment it was sent; the
+// reception end times are exact.
+//
+//   ./ns3 run "netanim-binary-to-xml --input=n-node-ppp.anim.bin --output=n-node-ppp.anim.xml"
+//
+// A summary of the records found is printed to standard output.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("NetAnimBinaryToXml");
+
+/**
+ * Sequential reader for the varint-encoded records. Reading past the end of the file,
+ * as happens when the simulation was killed before the trace was closed, sets a flag
+ * instead of failing so the records before it are still converted.
+ */
+class AnimTraceReader
+{
+  public:
+    explicit AnimTraceReader(const std::string& fileName)
+        : m_truncated(false)
+    {
+        m_file = fopen(fileName.c_str(), "rb");
+        NS_ABORT_MSG_IF(!m_file, "Cannot open animation trace " << fileName);
+        char magic[8];
+        NS_ABORT_MSG_IF(fread(magic, 8, 1, m_file) != 1 || std::string(magic, 8) != "NS3ANIM1",
+                        fileName << " is not a binary animation trace");
+    }
+
+    ~AnimTraceReader()
+    {
+        fclose(m_file);
+    }
+
+    /// Whether a new record starts here.
+    bool HasRecord()
+    {
+        int c = getc(m_file);
+        if (c == EOF)
+        {
+            return false;
+        }
+        ungetc(c, m_file);
+        return !m_truncated;
+    }
+
+    bool IsTruncated() const
+    {
+        return m_truncated;
+    }
+
+    uint8_t GetByte()
+    {
+        int c = getc(m_file);
+        if (c == EOF)
+        {
+            m_truncated = true;
+            return 0;
+        }
+        return static_cast<uint8_t>(c);
+    }
+
+    uint64_t GetVarint()
+    {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = GetByte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+        return value;
+    }
+
+    int64_t GetSigned()
+    {
+        uint64_t value = GetVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    std::string GetString()
+    {
+        std::string value(GetVarint(), '\0');
+        if (!value.empty() && fread(&value[0], value.size(), 1, m_file) != 1)
+        {
+            m_truncated = true;
+        }
+        return value;
+    }
+
+  private:
+    FILE* m_file;
+    bool m_truncated;
+};
+
+static std::string
+XmlEscape(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '&':
+            escaped += "&amp;";
+            break;
+        case '<':
+            escaped += "&lt;";
+            break;
+        case '>':
+            escaped += "&gt;";
+            break;
+        case '"':
+            escaped += "&quot;";
+            break;
+        default:
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static double
+ToSeconds(int64_t ns)
+{
+    return ns / 1e9;
+}
+
+static void
+WriteMetadata(std::ostream& out, const std::string& meta)
+{
+    if (!meta.empty())
+    {
+        out << " meta-info=\"" << XmlEscape(meta) << "\"";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string input;
+    std::string output;
+
+    CommandLine cmd;
+    cmd.AddValue("input", "Binary animation trace to convert", input);
+    cmd.AddValue("output", "NetAnim XML file to write", output);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(input.empty() || output.empty(), "Both --input and --output are required");
+
+    AnimTraceReader reader(input);
+    std::ofstream out(output);
+    NS_ABORT_MSG_IF(!out, "Cannot open " << output);
+    out << "<anim ver=\"netanim-3.108\" filetype=\"animation\" >\n";
+
+    int64_t nowNs = 0;
+    std::vector<int64_t> x;
+    std::vector<int64_t> y;
+    std::unordered_map<uint64_t, int64_t> wirelessTxStart; // uid -> first bit sent, ns
+    std::vector<uint64_t> records(7, 0);
+    std::ostringstream record;
+    record << std::fixed << std::setprecision(9);
+
+    while (reader.HasRecord())
+    {
+        // Buffered so that a record cut short by the end of the file is not written
+        record.str("");
+        uint8_t type = reader.GetByte();
+        nowNs += reader.GetVarint();
+        switch (type)
+        {
+        case 1: {
+            uint64_t node = reader.GetVarint();
+            if (node >= x.size())
+            {
+                x.resize(node + 1, 0);
+                y.resize(node + 1, 0);
+            }
+            x[node] = reader.GetSigned();
+            y[node] = reader.GetSigned();
+            record << "<node id=\"" << node << "\" sysId=\"0\" locX=\"" << x[node] / 100.0
+                   << "\" locY=\"" << y[node] / 100.0 << "\" />\n";
+            break;
+        }
+        case 2: {
+            uint64_t node = reader.GetVarint();
+            NS_ABORT_MSG_IF(node >= x.size(), "Position change for unknown node " << node);
+            x[node] += reader.GetSigned();
+            y[node] += reader.GetSigned();
+            record << "<nu p=\"p\" t=\"" << ToSeconds(nowNs) << "\" id=\"" << node << "\" x=\""
+                   << x[node] / 100.0 << "\" y=\"" << y[node] / 100.0 << "\" />\n";
+            break;
+        }
+        case 3: {
+            uint64_t from = reader.GetVarint();
+            uint64_t to = reader.GetVarint();
+            record << "<link fromId=\"" << from << "\" toId=\"" << to
+                   << "\" fd=\"\" td=\"\" ld=\"\" />\n";
+            break;
+        }
+        case 4: {
+            reader.GetVarint(); // uid, not part of NetAnim's wired packet element
+            uint64_t from = reader.GetVarint();
+            uint64_t to = reader.GetVarint();
+            int64_t txNs = reader.GetVarint();
+            int64_t rxNs = reader.GetVarint();
+            std::string meta = reader.GetString();
+            record << "<p fId=\"" << from << "\" fbTx=\"" << ToSeconds(nowNs) << "\" lbTx=\""
+                   << ToSeconds(nowNs + txNs) << "\"";
+            WriteMetadata(record, meta);
+            record << " tId=\"" << to << "\" fbRx=\"" << ToSeconds(nowNs + rxNs - txNs)
+                   << "\" lbRx=\"" << ToSeconds(nowNs + rxNs) << "\" />\n";
+            break;
+        }
+        case 5: {
+            uint64_t uid = reader.GetVarint();
+            uint64_t from = reader.GetVarint();
+            std::string meta = reader.GetString();
+            wirelessTxStart[uid] = nowNs;
+            record << "<pr uId=\"" << uid << "\" fId=\"" << from << "\" fbTx=\""
+                   << ToSeconds(nowNs) << "\" lbTx=\"" << ToSeconds(nowNs) << "\"";
+            WriteMetadata(record, meta);
+            record << " />\n";
+            break;
+        }
+        case 6: {
+            uint64_t uid = reader.GetVarint();
+            uint64_t to = reader.GetVarint();
+            auto tx = wirelessTxStart.find(uid);
+            int64_t fbRxNs = tx != wirelessTxStart.end() ? tx->second : nowNs;
+            record << "<wpr uId=\"" << uid << "\" tId=\"" << to << "\" fbRx=\""
+                   << ToSeconds(fbRxNs) << "\" lbRx=\"" << ToSeconds(nowNs) << "\" />\n";
+            break;
+        }
+        default:
+            NS_FATAL_ERROR("Unknown record type " << static_cast<uint32_t>(type) << " at "
+                                                  << ToSeconds(nowNs) << " s");
+        }
+        if (reader.IsTruncated())
+        {
+            break;
+        }
+        out << record.str();
+        records[type]++;
+    }
+    out << "</anim>\n";
+
+    std::cout << "nodes " << records[1] << ", position changes " << records[2] << ", links "
+              << records[3] << ", wired packets " << records[4] << ", wireless transmissions "
+              << records[5] << ", wireless receptions " << records[6] << ", last record at "
+              << ToSeconds(nowNs) << " s" << std::endl;
+    if (reader.IsTruncated())
+    {
+        std::cout << "The trace ends in the middle of a record; it was not closed" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/olsr-module.h"
+#include "ns3/wifi-module.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// Control-plane scaling benchmark for OLSR on the adhoc grid of wifi-simple-adhoc-grid
+// (Large/41.cc), grown to thousands of nodes.
+//
+// numNodes 802.11b nodes sit distance metres apart on a grid, square unless gridWidth
+// is given, with the PHY and channel settings of the grid script. They run OLSR and no
+// application, so everything simulated is control plane: HELLO and TC generation and
+// flooding, MPR selection, routing table computation, and the Wi-Fi frames carrying
+// the messages. After a warm-up that lets the topology sets fill, the process CPU time
+// and the OLSR counters are taken over the measurement window. It prints a CSV row:
+//   nodes,gridWidth,cpuPerSimS,wallS,pktTxPerS,msgRxPerS,tableRecomputesPerS,routeCoverage,rssKb
+// routeCoverage is the mean routing table size at the end over numNodes - 1; 1 means
+// every node has a route to every other node.
+//
+//   for n in 100 400 1024 2025 4096; do
+//     ./ns3 run "olsr-grid-scaling-benchmark --numNodes=$n";
+//   done
+//
+// ns-3's OLSR recomputes the MPR set and the whole routing table from its neighbour and
+// topology sets on every change to them; tableRecomputesPerS counts those full
+// recomputations, the work an incremental MPR and route repair would cut. The Yans
+// channel hands every frame to every PHY, so the radio share of cpuPerSimS grows with
+// the square of the node count whatever the routing protocol does.
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("OlsrGridScalingBenchmark");
+
+/// OLSR activity over the measurement window
+struct ControlPlaneStats
+{
+    uint64_t packetsTx{0};
+    uint64_t messagesRx{0};
+    uint64_t tableRecomputes{0};
+    double cpuAtStart{0};
+};
+
+static double
+CpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void
+OlsrTx(ControlPlaneStats* stats,
+       const olsr::PacketHeader& /* header */,
+       const olsr::MessageList& /* messages */)
+{
+    stats->packetsTx++;
+}
+
+static void
+OlsrRx(ControlPlaneStats* stats,
+       const olsr::PacketHeader& /* header */,
+       const olsr::MessageList& messages)
+{
+    stats->messagesRx += messages.size();
+}
+
+static void
+RoutingTableChanged(ControlPlaneStats* stats, uint32_t /* size */)
+{
+    stats->tableRecomputes++; // fired at the end of every full table computation
+}
+
+static void
+StartMeasurement(ControlPlaneStats* stats)
+{
+    *stats = ControlPlaneStats();
+    stats->cpuAtStart = CpuSeconds();
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t numNodes = 400;
+    uint32_t gridWidth = 0;
+    double distance = 100;
+    Time helloInterval = Seconds(2);
+    Time tcInterval = Seconds(5);
+    double warmup = 20;
+    double measure = 10;
+    bool printHeader = false;
+    std::string phyMode = "DsssRate1Mbps";
+
+    CommandLine cmd;
+    cmd.AddValue("numNodes", "Number of nodes in the grid", numNodes);
+    cmd.AddValue("gridWidth", "Nodes per grid row, 0 for a square grid", gridWidth);
+    cmd.AddValue("distance", "Distance between grid neighbours (m)", distance);
+    cmd.AddValue("helloInterval", "OLSR HELLO interval", helloInterval);
+    cmd.AddValue("tcInterval", "OLSR TC interval", tcInterval);
+    cmd.AddValue("warmup", "Seconds simulated before measuring", warmup);
+    cmd.AddValue("measure", "Seconds simulated while measuring", measure);
+    cmd.AddValue("printHeader", "Print the CSV header before the result row", printHeader);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(numNodes < 2 || numNodes > 65534, "numNodes must be in [2, 65534]");
+    if (gridWidth == 0)
+    {
+        gridWidth = static_cast<uint32_t>(std::ceil(std::sqrt(numNodes)));
+    }
+
+    Config::SetDefault("ns3::WifiRemoteStationManager::NonUnicastMode", StringValue(phyMode));
+    Config::SetDefault("ns3::olsr::RoutingProtocol::HelloInterval", TimeValue(helloInterval));
+    Config::SetDefault("ns3::olsr::RoutingProtocol::TcInterval", TimeValue(tcInterval));
+
+    auto start = std::chrono::steady_clock::now();
+
+    NodeContainer nodes;
+    nodes.Create(numNodes);
+
+    // The PHY, channel and MAC of the grid script
+    YansWifiPhyHelper wifiPhy;
+    wifiPhy.Set("RxGain", DoubleValue(-10));
+    YansWifiChannelHelper wifiChannel;
+    wifiChannel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+    wifiChannel.AddPropagationLoss("ns3::FriisPropagationLossModel");
+    wifiPhy.SetChannel(wifiChannel.Create());
+
+    WifiHelper wifi;
+    wifi.SetStandard(WIFI_STANDARD_80211b);
+    wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                 "DataMode",
+                                 StringValue(phyMode),
+                                 "ControlMode",
+                                 StringValue(phyMode));
+    WifiMacHelper wifiMac;
+    wifiMac.SetType("ns3::AdhocWifiMac");
+    NetDeviceContainer devices = wifi.Install(wifiPhy, wifiMac, nodes);
+
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                  "MinX",
+                                  DoubleValue(0.0),
+                                  "MinY",
+                                  DoubleValue(0.0),
+                                  "DeltaX",
+                                  DoubleValue(distance),
+                                  "DeltaY",
+                                  DoubleValue(distance),
+                                  "GridWidth",
+                                  UintegerValue(gridWidth),
+                                  "LayoutType",
+                                  StringValue("RowFirst"));
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.Install(nodes);
+
+    OlsrHelper olsr;
+    Ipv4StaticRoutingHelper staticRouting;
+    Ipv4ListRoutingHelper list;
+    list.Add(staticRouting, 0);
+    list.Add(olsr, 10);
+    InternetStackHelper internet;
+    internet.SetRoutingHelper(list);
+    internet.Install(nodes);
+
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase("10.0.0.0", "255.255.0.0");
+    ipv4.Assign(devices);
+
+    ControlPlaneStats stats;
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::olsr::RoutingProtocol/Tx",
+                                  MakeBoundCallback(&OlsrTx, &stats));
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::olsr::RoutingProtocol/Rx",
+                                  MakeBoundCallback(&OlsrRx, &stats));
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::olsr::RoutingProtocol/RoutingTableChanged",
+                                  MakeBoundCallback(&RoutingTableChanged, &stats));
+    Simulator::Schedule(Seconds(warmup), &StartMeasurement, &stats);
+
+    Simulator::Stop(Seconds(warmup + measure));
+    Simulator::Run();
+    double cpuPerSimS = (CpuSeconds() - stats.cpuAtStart) / measure;
+    double wallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t routes = 0;
+    for (uint32_t i = 0; i < numNodes; ++i)
+    {
+        routes += nodes.Get(i)->GetObject<olsr::RoutingProtocol>()->GetRoutingTableEntries().size();
+    }
+    double routeCoverage = static_cast<double>(routes) / numNodes / (numNodes - 1);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage); // ru_maxrss is in KiB on Linux
+
+    if (printHeader)
+    {
+        std::cout << "nodes,gridWidth,cpuPerSimS,wallS,pktTxPerS,msgRxPerS,tableRecomputesPerS,"
+                     "routeCoverage,rssKb"
+                  << std::endl;
+    }
+    std::cout << numNodes << "," << gridWidth << "," << cpuPerSimS << "," << wallSeconds << ","
+              << stats.packetsTx / measure << "," << stats.messagesRx / measure << ","
+              << stats.tableRecomputes / measure << "," << routeCoverage << ","
+              << usage.ru_maxrss << std::endl;
+
+    Simulator::Destroy();
+    return 0;
+}